@@ -71,11 +71,38 @@ AC_DEFUN([AC_SCU_EGG],[dnl
    )
 
    if test "x${EEASTER_EGGS}" != "xno";then
+      AC_CHECK_LIB([m], [sin], [], [AC_MSG_ERROR([missing required library])])
       AC_DEFINE_UNQUOTED(SCU_EASTER_EGGS, 1, [enable easter egg widget])
    fi
 ])dnl
 
 
+# AC_SCU_IO_URING
+# ______________________________________________________________________________
+AC_DEFUN([AC_SCU_IO_URING],[dnl
+
+   enableval=""
+   AC_ARG_ENABLE(
+      io-uring,
+      [AS_HELP_STRING([--enable-io-uring], [submit batched unlinks through io_uring [no]])],
+      [ EIO_URING=$enableval ],
+      [ EIO_URING=$enableval ]
+   )
+
+   if test "x${EIO_URING}" != "xyes";then
+      EIO_URING="no"
+   else
+      AC_CHECK_DECL(
+         [IORING_OP_UNLINKAT],
+         [AC_DEFINE_UNQUOTED(USE_IO_URING, 1, [Batch unlinks through io_uring])],
+         [AC_MSG_ERROR([io_uring headers do not provide IORING_OP_UNLINKAT])],
+         [[#include <linux/io_uring.h>]]
+      )
+   fi
+   SCU_IO_URING=${EIO_URING}
+])dnl
+
+
 # AC_SCU_SYMLINKS
 # ______________________________________________________________________________
 AC_DEFUN([AC_SCU_SYMLINKS],[dnl
@@ -97,6 +124,141 @@ AC_DEFUN([AC_SCU_SYMLINKS],[dnl
 ])dnl
 
 
+# AC_SCU_POLICY
+# ______________________________________________________________________________
+AC_DEFUN([AC_SCU_POLICY],[dnl
+
+   withval=""
+   AC_ARG_WITH(
+      policy,
+      [AS_HELP_STRING([--with-policy=file], [restrict widget paths with root owned allow-list [no]])],
+      [ WPOLICY=$withval ],
+      [ WPOLICY=$withval ]
+   )
+
+   if test "x${WPOLICY}" == "xyes";then
+      WPOLICY=/etc/securecoreutils/policy
+   elif test "x${WPOLICY}" == "x";then
+      WPOLICY=no
+   fi
+   case $WPOLICY in
+      no|/*) ;;
+      *) AC_MSG_ERROR([policy file must be an absolute path.]);;
+   esac
+
+   SCU_POLICY=${WPOLICY}
+   if test "x${SCU_POLICY}" != "xno";then
+      AC_DEFINE_UNQUOTED(SCU_POLICY, ["${SCU_POLICY}"], [Allow-list of paths per widget and group])
+      AC_DEFINE_UNQUOTED(SCU_POLICY_IMAGE, ["${SCU_POLICY}.bin"], [Compiled image of allow-list])
+   fi
+])dnl
+
+
+# AC_SCU_BROKER
+# ______________________________________________________________________________
+AC_DEFUN([AC_SCU_BROKER],[dnl
+
+   withval=""
+   AC_ARG_WITH(
+      broker-socket,
+      [AS_HELP_STRING([--with-broker-socket=file], [UNIX socket of broker widget [/run/securecoreutils.sock]])],
+      [ WBROKER_SOCKET=$withval ],
+      [ WBROKER_SOCKET=$withval ]
+   )
+
+   if test "x${WBROKER_SOCKET}" == "xyes" || test "x${WBROKER_SOCKET}" == "x";then
+      WBROKER_SOCKET=/run/securecoreutils.sock
+   fi
+   case $WBROKER_SOCKET in
+      /*) ;;
+      *) AC_MSG_ERROR([broker socket must be an absolute path.]);;
+   esac
+
+   SCU_BROKER_SOCKET=${WBROKER_SOCKET}
+   AC_DEFINE_UNQUOTED(SCU_BROKER_SOCKET, ["${SCU_BROKER_SOCKET}"], [UNIX socket of broker widget])
+])dnl
+
+
+# AC_SCU_FOLLOW
+# ______________________________________________________________________________
+AC_DEFUN([AC_SCU_FOLLOW],[dnl
+
+   withval=""
+   AC_ARG_WITH(
+      follow-dir,
+      [AS_HELP_STRING([--with-follow-dir=dir], [directory of tail follow hub sockets [/run/securecoreutils]])],
+      [ WFOLLOW_DIR=$withval ],
+      [ WFOLLOW_DIR=$withval ]
+   )
+
+   if test "x${WFOLLOW_DIR}" == "xyes" || test "x${WFOLLOW_DIR}" == "x";then
+      WFOLLOW_DIR=/run/securecoreutils
+   fi
+   case $WFOLLOW_DIR in
+      /*) ;;
+      *) AC_MSG_ERROR([follow directory must be an absolute path.]);;
+   esac
+
+   SCU_FOLLOW_DIR=${WFOLLOW_DIR}
+   AC_DEFINE_UNQUOTED(SCU_FOLLOW_DIR, ["${SCU_FOLLOW_DIR}"], [directory of tail follow hub sockets])
+])dnl
+
+
+# AC_SCU_METRICS
+# ______________________________________________________________________________
+AC_DEFUN([AC_SCU_METRICS],[dnl
+
+   withval=""
+   AC_ARG_WITH(
+      metrics,
+      [AS_HELP_STRING([--with-metrics=file], [append a record of every run to root owned ring file [no]])],
+      [ WMETRICS=$withval ],
+      [ WMETRICS=$withval ]
+   )
+
+   if test "x${WMETRICS}" == "xyes";then
+      WMETRICS=/run/securecoreutils/metrics.ring
+   elif test "x${WMETRICS}" == "x";then
+      WMETRICS=no
+   fi
+   case $WMETRICS in
+      no|/*) ;;
+      *) AC_MSG_ERROR([metrics journal must be an absolute path.]);;
+   esac
+
+   SCU_METRICS=${WMETRICS}
+   if test "x${WMETRICS}" != "xno";then
+      AC_DEFINE_UNQUOTED(SCU_METRICS, ["${SCU_METRICS}"], [ring file of metrics journal])
+   fi
+])dnl
+
+
+# AC_SCU_USDT
+# ______________________________________________________________________________
+AC_DEFUN([AC_SCU_USDT],[dnl
+
+   enableval=""
+   AC_ARG_ENABLE(
+      usdt,
+      [AS_HELP_STRING([--enable-usdt], [add static tracepoints for bpftrace and systemtap [no]])],
+      [ EUSDT=$enableval ],
+      [ EUSDT=$enableval ]
+   )
+
+   if test "x${EUSDT}" != "xyes";then
+      EUSDT="no"
+   else
+      AC_CHECK_HEADERS(
+         [sys/sdt.h],
+         [AC_DEFINE_UNQUOTED(USE_USDT, 1, [Add USDT probes])],
+         [AC_MSG_ERROR([USDT probes require sys/sdt.h from systemtap])]
+      )
+   fi
+   SCU_USDT=${EUSDT}
+   AC_SUBST([SCU_USDT], [${SCU_USDT}])
+])dnl
+
+
 # AC_SCU_WIDGET_TAIL
 # ______________________________________________________________________________
 AC_DEFUN([AC_SCU_WIDGET_TAIL],[dnl
@@ -156,6 +318,13 @@ AC_DEFUN([AC_SCU_WIDGET_ZCAT],[dnl
       [ ELZMA=$enableval ]
    )
    enableval=""
+   AC_ARG_ENABLE(
+      zstd,
+      [AS_HELP_STRING([--disable-zstd], [disable zstd support [auto]])],
+      [ EZSTD=$enableval ],
+      [ EZSTD=$enableval ]
+   )
+   enableval=""
    AC_ARG_ENABLE(
       zlib,
       [AS_HELP_STRING([--disable-zlib], [disable zlib support [auto]])],
@@ -163,6 +332,20 @@ AC_DEFUN([AC_SCU_WIDGET_ZCAT],[dnl
       [ EZLIB=$enableval ]
    )
    withval=""
+   AC_ARG_WITH(
+      inflate,
+      [AS_HELP_STRING([--with-inflate=backend], [gzip inflate backend: libdeflate, zlib-ng, or zlib [auto]])],
+      [ WINFLATE=$withval ],
+      [ WINFLATE=$withval ]
+   )
+   enableval=""
+   AC_ARG_ENABLE(
+      dlopen-codecs,
+      [AS_HELP_STRING([--disable-dlopen-codecs], [link compression libraries instead of loading them on first use [auto]])],
+      [ EDLOPEN_CODECS=$enableval ],
+      [ EDLOPEN_CODECS=$enableval ]
+   )
+   withval=""
    AC_ARG_WITH(
       tail-timeout,
       [AS_HELP_STRING([--with-tail-timeout=seconds], [terminate tail after seconds [0]])],
@@ -170,6 +353,10 @@ AC_DEFUN([AC_SCU_WIDGET_ZCAT],[dnl
       [ WTAIL_TIMEOUT=$withval ]
    )
 
+   # codec libraries found below are dropped from LIBS again when they are
+   # loaded on first use
+   SCU_CODEC_SAVE_LIBS="${LIBS}"
+
    # check zlib
    USE_ZLIB=no;
    if test "x${EZLIB}" != "xno";then
@@ -186,6 +373,43 @@ AC_DEFUN([AC_SCU_WIDGET_ZCAT],[dnl
       fi
    fi
 
+   # check gzip inflate backend, libdeflate decodes whole members from a
+   # mapped file and zlib-ng replaces zlib in compat mode, both select
+   # CPU specific code paths at runtime
+   INFLATE_BACKEND=none
+   if test "x${USE_ZLIB}" = "xyes";then
+      INFLATE_BACKEND=zlib
+      AC_CHECK_DECL([ZLIBNG_VERSION], [INFLATE_BACKEND=zlib-ng], [], [[#include <zlib.h>]])
+      case "x${WINFLATE}" in
+         x|xyes|xauto|xlibdeflate)
+         USE_LIBDEFLATE=yes
+         AC_CHECK_HEADERS([libdeflate.h],                            [], [USE_LIBDEFLATE=no])
+         AC_SEARCH_LIBS([libdeflate_gzip_decompress_ex], [deflate],  [], [USE_LIBDEFLATE=no])
+         if test "x${USE_LIBDEFLATE}" = "xyes";then
+            INFLATE_BACKEND=libdeflate
+            AC_DEFINE_UNQUOTED(USE_LIBDEFLATE, 1, [Use libdeflate for gzip])
+         elif test "x${WINFLATE}" = "xlibdeflate";then
+            AC_MSG_ERROR([unable to locate libdeflate library and headers])
+         fi
+         ;;
+
+         xzlib-ng)
+         if test "x${INFLATE_BACKEND}" != "xzlib-ng";then
+            AC_MSG_ERROR([zlib.h is not provided by zlib-ng in compat mode])
+         fi
+         ;;
+
+         xzlib|xno)
+         ;;
+
+         *)
+         AC_MSG_ERROR([unknown inflate backend ${WINFLATE}])
+         ;;
+      esac
+   elif test "x${WINFLATE}" != "x" && test "x${WINFLATE}" != "xno";then
+      AC_MSG_ERROR([--with-inflate requires zlib support])
+   fi
+
    # check libbz2
    USE_BZIP2=no
    if test "x${EBZIP2}" != "xno";then
@@ -216,6 +440,89 @@ AC_DEFUN([AC_SCU_WIDGET_ZCAT],[dnl
       fi
    fi
 
+   # check libzstd
+   USE_ZSTD=no;
+   if test "x${EZSTD}" != "xno";then
+      USE_ZSTD=yes;
+      AC_CHECK_HEADERS([zstd.h],                     [], [USE_ZSTD=no])
+      AC_SEARCH_LIBS([ZSTD_createDStream],   [zstd], [], [USE_ZSTD=no])
+      AC_SEARCH_LIBS([ZSTD_decompressStream],[zstd], [], [USE_ZSTD=no])
+      if test "x${USE_ZSTD}" = "xyes";then
+         AC_DEFINE_UNQUOTED(USE_ZSTD, 1, [Use libzstd])
+      elif test "x${EZSTD}" == "xyes";then
+         AC_MSG_ERROR([unable to locate zstd library and headers])
+      fi
+   fi
+
+   # check dlopen, widgets which never decode skip loading codec libraries
+   DLOPEN_CODECS=no
+   if test "x${EDLOPEN_CODECS}" != "xno";then
+      LIBS_CODECS="${LIBS}"
+      LIBS="${SCU_CODEC_SAVE_LIBS}"
+      DLOPEN_CODECS=yes
+      AC_CHECK_HEADERS([dlfcn.h],        [], [DLOPEN_CODECS=no])
+      AC_SEARCH_LIBS([dlopen],     [dl], [], [DLOPEN_CODECS=no])
+      if test "x${DLOPEN_CODECS}" = "xyes";then
+         AC_DEFINE_UNQUOTED(SCU_CODEC_DLOPEN, 1, [load compression libraries on first use])
+      elif test "x${EDLOPEN_CODECS}" == "xyes";then
+         AC_MSG_ERROR([unable to locate dlopen])
+      else
+         LIBS="${LIBS_CODECS}"
+      fi
+   fi
+
+])dnl
+
+
+# AC_SCU_WIDGET_ZCAT_CACHE
+# ______________________________________________________________________________
+AC_DEFUN([AC_SCU_WIDGET_ZCAT_CACHE],[dnl
+
+   withval=""
+   AC_ARG_WITH(
+      zcat-cache,
+      [AS_HELP_STRING([--with-zcat-cache=dir], [cache decompressed archives in root owned dir [no]])],
+      [ WZCAT_CACHE=$withval ],
+      [ WZCAT_CACHE=$withval ]
+   )
+   withval=""
+   AC_ARG_WITH(
+      zcat-cache-size,
+      [AS_HELP_STRING([--with-zcat-cache-size=MB], [maximum size of zcat cache [1024]])],
+      [ WZCAT_CACHE_SIZE=$withval ],
+      [ WZCAT_CACHE_SIZE=$withval ]
+   )
+
+   if test "x${WZCAT_CACHE}" == "xyes";then
+      WZCAT_CACHE=/var/cache/securecoreutils
+   elif test "x${WZCAT_CACHE}" == "x";then
+      WZCAT_CACHE=no
+   fi
+   case $WZCAT_CACHE in
+      no|/*) ;;
+      *) AC_MSG_ERROR([zcat cache must be an absolute path.]);;
+   esac
+
+   if test "x${WZCAT_CACHE_SIZE}" == "x" || \
+      test "x${WZCAT_CACHE_SIZE}" == "xyes" || \
+      test "x${WZCAT_CACHE_SIZE}" == "xno";then
+      WZCAT_CACHE_SIZE=1024
+   fi
+   case $WZCAT_CACHE_SIZE in
+      ''|*[[!0-9]]*)
+      AC_MSG_ERROR([zcat cache size must be a numeric value.])
+      ;;
+
+      *)
+      ;;
+   esac
+
+   SCU_ZCAT_CACHE=${WZCAT_CACHE}
+   if test "x${SCU_ZCAT_CACHE}" != "xno";then
+      AC_DEFINE_UNQUOTED(SCU_ZCAT_CACHE, ["${SCU_ZCAT_CACHE}"], [Directory for cache of decompressed archives])
+      AC_DEFINE_UNQUOTED(SCU_ZCAT_CACHE_SIZE, [(${WZCAT_CACHE_SIZE}LL*1024LL*1024LL)], [Maximum size of zcat cache in bytes])
+      SCU_ZCAT_CACHE="${SCU_ZCAT_CACHE} (${WZCAT_CACHE_SIZE} MB)"
+   fi
 ])dnl
 
 
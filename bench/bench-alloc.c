@@ -0,0 +1,165 @@
+/*
+ *  Secure Core Utilities
+ *  Copyright (C) 2015, 2017 David M. Syzdek <david@syzdek.net>.
+ *
+ *  @SYZDEK_BSD_LICENSE_START@
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of David M. Syzdek nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ *  IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ *  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL DAVID M SYZDEK BE LIABLE FOR
+ *  ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ *  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ *  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ *  OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ *  SUCH DAMAGE.
+ *
+ *  @SYZDEK_BSD_LICENSE_END@
+ */
+/**
+ *  @file bench/bench-alloc.c
+ *  Preloaded by bench-count to count heap allocations of a command
+ */
+
+///////////////
+//           //
+//  Headers  //
+//           //
+///////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Headers
+#endif
+
+#ifdef HAVE_CONFIG_H
+#   include "config.h"
+#endif
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+
+//////////////////
+//              //
+//  Prototypes  //
+//              //
+//////////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Prototypes
+#endif
+
+#ifdef __GLIBC__
+extern void * __libc_malloc(size_t size);
+extern void * __libc_calloc(size_t nmemb, size_t size);
+extern void * __libc_realloc(void * ptr, size_t size);
+extern void * __libc_memalign(size_t alignment, size_t size);
+
+void * malloc(size_t size);
+void * calloc(size_t nmemb, size_t size);
+void * realloc(void * ptr, size_t size);
+int posix_memalign(void ** memptr, size_t alignment, size_t size);
+void * aligned_alloc(size_t alignment, size_t size);
+#endif
+
+static void bench_alloc_report(void) __attribute__((destructor));
+
+
+/////////////////
+//             //
+//  Variables  //
+//             //
+/////////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Variables
+#endif
+
+// only counts, threads of the command may race an increment but the
+// fixed workloads of bench-check are single threaded
+static uint64_t bench_allocs = 0;
+
+
+/////////////////
+//             //
+//  Functions  //
+//             //
+/////////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Functions
+#endif
+
+#ifdef __GLIBC__
+void * malloc(size_t size)
+{
+   bench_allocs++;
+   return(__libc_malloc(size));
+}
+
+
+void * calloc(size_t nmemb, size_t size)
+{
+   bench_allocs++;
+   return(__libc_calloc(nmemb, size));
+}
+
+
+/// a realloc which moves or grows a block is still one allocation
+void * realloc(void * ptr, size_t size)
+{
+   bench_allocs++;
+   return(__libc_realloc(ptr, size));
+}
+
+
+int posix_memalign(void ** memptr, size_t alignment, size_t size)
+{
+   bench_allocs++;
+   if ((*memptr = __libc_memalign(alignment, size)) == NULL)
+      return(12); // ENOMEM
+   return(0);
+}
+
+
+void * aligned_alloc(size_t alignment, size_t size)
+{
+   bench_allocs++;
+   return(__libc_memalign(alignment, size));
+}
+#endif
+
+
+/// writes count to descriptor named by BENCH_ALLOC_FD on exit
+static void bench_alloc_report(void)
+{
+   int            fd;
+   int            len;
+   char           buff[32];
+   const char   * str;
+
+   if ((str = getenv("BENCH_ALLOC_FD")) == NULL)
+      return;
+   fd  = atoi(str);
+   len = snprintf(buff, sizeof(buff), "%" PRIu64 "\n", bench_allocs);
+   if (pwrite(fd, buff, (size_t)len, 0) != len)
+      return;
+   return;
+}
+
+
+/* end of source */
@@ -0,0 +1,245 @@
+#!/bin/sh
+#
+#   Secure Core Utilities
+#   Copyright (C) 2015, 2017 David M. Syzdek <david@syzdek.net>.
+#
+#   @SYZDEK_BSD_LICENSE_START@
+#
+#   Redistribution and use in source and binary forms, with or without
+#   modification, are permitted provided that the following conditions are
+#   met:
+#
+#      * Redistributions of source code must retain the above copyright
+#        notice, this list of conditions and the following disclaimer.
+#      * Redistributions in binary form must reproduce the above copyright
+#        notice, this list of conditions and the following disclaimer in the
+#        documentation and/or other materials provided with the distribution.
+#      * Neither the name of David M. Syzdek nor the
+#        names of its contributors may be used to endorse or promote products
+#        derived from this software without specific prior written permission.
+#
+#   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+#   IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+#   THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+#   PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL DAVID M SYZDEK BE LIABLE FOR
+#   ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+#   DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+#   SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+#   CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+#   LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+#   OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+#   SUCH DAMAGE.
+#
+#   @SYZDEK_BSD_LICENSE_END@
+#
+#   bench/bench-check.sh - compares counts of fixed workloads to baseline
+#
+#   Environment:
+#      SCU            path to securecoreutils binary   [src/securecoreutils]
+#      BENCH_BINDIR   directory containing bench-corpus and bench-count [bench]
+#      BENCH_ALLOC    absolute path of bench-alloc.so, allocations are not
+#                     counted when unset                [none]
+#      BENCH_DIR      absolute directory for generated files [$PWD/bench-data]
+#      BENCH_BASELINE baseline file                    [bench/bench-check.baseline]
+#      BENCH_UPDATE   rewrite baseline from this run when "yes" [no]
+#
+#   Baseline lines are "workload metric value tolerance", a tolerance is
+#   either a percentage ("10%") or an absolute count ("+4") and a value of
+#   "-" records nothing to compare.  A count above value plus tolerance
+#   fails, counts reported as -1 by bench-count are skipped.
+#
+#   Only syscalls and allocations are compared, neither needs perf events.
+#   The baseline records the architecture, C library and shared libraries
+#   (including codec libraries loaded on first use) the counts depend on.
+#   The check exits 77 (skipped) when they differ or ptrace is unavailable.
+#
+
+SCU=${SCU:-src/securecoreutils}
+BENCH_BINDIR=${BENCH_BINDIR:-bench}
+BENCH_ALLOC=${BENCH_ALLOC:-""}
+BENCH_DIR=${BENCH_DIR:-`pwd`/bench-data}
+BENCH_BASELINE=${BENCH_BASELINE:-bench/bench-check.baseline}
+BENCH_UPDATE=${BENCH_UPDATE:-no}
+
+# default tolerance of new baseline entries
+BENCH_TOLERANCE="syscalls:+3 allocs:+2"
+
+
+bench_die()
+{
+   echo "bench-check: $*" 1>&2
+   exit 1
+}
+
+
+bench_skip()
+{
+   echo "bench-check: skipping, $*" 1>&2
+   exit 77
+}
+
+
+# prints C library, gzip backend and versions of the shared libraries
+# which are linked or may be loaded by the binary
+bench_fingerprint()
+{
+   LDCONFIG=`command -v ldconfig || echo /sbin/ldconfig`
+   LIBS=`{
+      ldd "${SCU}" 2> /dev/null | sed -n -e 's/^.*=> \(\/[^ ]*\) .*$/\1/p'
+      for SONAME in libz.so.1 libdeflate.so.0 libbz2.so.1.0 liblzma.so.5 libzstd.so.1;do
+         "${LDCONFIG}" -p 2> /dev/null | sed -n -e "s/^[[:space:]]*${SONAME} (.*) => //p" | head -1
+      done
+   } | while read LIB;do basename "\`readlink -f "${LIB}"\`";done | sort -u | tr '\n' ' ' | sed -e 's/ $//g'`
+   BACKEND=`"${SCU}" zcat --version 2> /dev/null | sed -n -e 's/^.*(gzip backend: \(.*\))$/\1/p'`
+   echo "`uname -m` `getconf GNU_LIBC_VERSION 2> /dev/null || echo unknown libc`; gzip backend ${BACKEND}; ${LIBS}"
+}
+
+
+# runs workload once and prints "workload metric count" for each counter
+bench_count()
+{
+   NAME="$1"
+   shift
+   if test "x${BENCH_ALLOC}" = "x";then
+      RESULT=`"${BENCH_BINDIR}/bench-count" -o /dev/null "$@"`
+   else
+      RESULT=`"${BENCH_BINDIR}/bench-count" -a "${BENCH_ALLOC}" -o /dev/null "$@"`
+   fi
+   test $? -eq 0 || bench_die "${NAME} failed: $*"
+   echo "${RESULT}" | ${AWK:-awk} -v name="${NAME}" '
+   {
+      n = split($0, kv, ",");
+      for (i = 1; i <= n; i++)
+      {
+         split(kv[i], pair, ":");
+         gsub(/"/, "", pair[1]);
+         if ( (pair[1] == "syscalls") || (pair[1] == "allocs") )
+            printf("%s %s %s\n", name, pair[1], pair[2]);
+      };
+   }'
+}
+
+
+test -x "${SCU}"                       || bench_die "missing ${SCU}"
+test -x "${BENCH_BINDIR}/bench-corpus" || bench_die "missing ${BENCH_BINDIR}/bench-corpus"
+test -x "${BENCH_BINDIR}/bench-count"  || bench_die "missing ${BENCH_BINDIR}/bench-count"
+case "${BENCH_DIR}" in
+   /*) ;;
+   *) bench_die "BENCH_DIR must be an absolute path";;
+esac
+mkdir -p "${BENCH_DIR}" || bench_die "unable to create ${BENCH_DIR}"
+"${SCU}" pathcheck -d "${BENCH_DIR}" || bench_die "BENCH_DIR must pass pathcheck (no symlinks or hidden directories)"
+
+
+# counts are only comparable with the libraries of the baseline
+FINGERPRINT=`bench_fingerprint`
+PROBE=`"${BENCH_BINDIR}/bench-count" -o /dev/null "${SCU}" --version 2> /dev/null`
+case "${PROBE}" in
+   *'"syscalls":-1'*|"") PTRACE=no;;
+   *) PTRACE=yes;;
+esac
+if test "x${BENCH_UPDATE}" = "xyes";then
+   test "x${PTRACE}" = "xyes" || bench_die "unable to count syscalls, ptrace is unavailable"
+else
+   test -f "${BENCH_BASELINE}" || bench_die "missing ${BENCH_BASELINE}"
+   BASE_FINGERPRINT=`sed -n -e 's/^# fingerprint: //p' "${BENCH_BASELINE}"`
+   test "x${FINGERPRINT}" = "x${BASE_FINGERPRINT}" \
+      || bench_skip "baseline recorded on \"${BASE_FINGERPRINT}\", not \"${FINGERPRINT}\""
+   test "x${PTRACE}" = "xyes" || bench_skip "ptrace is unavailable"
+fi
+
+
+# fixed inputs, bench-corpus output does not depend on time or machine
+CORPUS="${BENCH_DIR}/check-4M.log"
+DEEP="${BENCH_DIR}/check-depth/d/d/d/d/d/d/d/d/d/d/d/d/d/d/d"
+SCRATCH="${BENCH_DIR}/check-scratch.txt"
+if test ! -f "${CORPUS}";then
+   "${BENCH_BINDIR}/bench-corpus" -s syslog 4M > "${CORPUS}" \
+      || bench_die "unable to generate ${CORPUS}"
+fi
+mkdir -p "${DEEP}" && : > "${DEEP}/file" || bench_die "unable to create ${DEEP}/file"
+if test ! -f "${CORPUS}.gz" && command -v gzip > /dev/null 2>&1;then
+   gzip -n -6 -c < "${CORPUS}" > "${CORPUS}.gz" || bench_die "unable to generate ${CORPUS}.gz"
+fi
+
+
+# counts of this run
+{
+   bench_count cat           "${SCU}" cat "${CORPUS}"
+   bench_count tail-n10      "${SCU}" tail -n 10 "${CORPUS}"
+   bench_count tail-n100000  "${SCU}" tail -n 100000 "${CORPUS}"
+   bench_count tail-c65536   "${SCU}" tail -c 65536 "${CORPUS}"
+   if test -f "${CORPUS}.gz";then
+      bench_count zcat-gzip  "${SCU}" zcat -C "${CORPUS}.gz"
+   fi
+   bench_count pathcheck-16  "${SCU}" pathcheck "${DEEP}/file"
+   echo "scratch" > "${SCRATCH}"
+   bench_count touch         "${SCU}" touch "${SCRATCH}"
+   bench_count rm            "${SCU}" rm "${SCRATCH}"
+} > "${BENCH_DIR}/check.counts" || exit 1
+
+
+# writes new baseline, keeping tolerances of existing entries
+if test "x${BENCH_UPDATE}" = "xyes";then
+   ${AWK:-awk} -v defaults="${BENCH_TOLERANCE}" -v baseline="${BENCH_BASELINE}" -v fingerprint="${FINGERPRINT}" '
+   BEGIN {
+      n = split(defaults, list, " ");
+      for (i = 1; i <= n; i++) { split(list[i], pair, ":"); def[pair[1]] = pair[2]; };
+      while ((getline line < baseline) > 0)
+         if ( (line !~ /^#/) && (split(line, f, " ") == 4) )
+            tol[f[1] " " f[2]] = f[4];
+      printf("# bench-check baseline, regenerate with: make bench-baseline\n");
+      printf("# fingerprint: %s\n", fingerprint);
+      printf("# %-16s %-14s %12s  %s\n", "workload", "metric", "value", "tolerance");
+   }
+   {
+      t = ((($1 " " $2) in tol)) ? tol[$1 " " $2] : def[$2];
+      printf("  %-16s %-14s %12s  %s\n", $1, $2, ($3 < 0) ? "-" : $3, t);
+   }' "${BENCH_DIR}/check.counts" > "${BENCH_DIR}/check.baseline" \
+      || bench_die "unable to write ${BENCH_BASELINE}"
+   mv "${BENCH_DIR}/check.baseline" "${BENCH_BASELINE}" || bench_die "unable to write ${BENCH_BASELINE}"
+   rm -f "${BENCH_DIR}/check.counts"
+   echo "bench-check: wrote ${BENCH_BASELINE}"
+   exit 0
+fi
+
+
+# compares counts of this run to baseline
+${AWK:-awk} -v baseline="${BENCH_BASELINE}" '
+BEGIN {
+   while ((getline line < baseline) > 0)
+   {
+      if ( (line ~ /^#/) || (split(line, f, " ") != 4) )
+         continue;
+      base[f[1] " " f[2]] = f[3];
+      tol[f[1] " " f[2]]  = f[4];
+   };
+}
+{
+   key = $1 " " $2;
+   if ( (!(key in base)) || (base[key] == "-") || ($3 < 0) )
+   {
+      printf("SKIP  %-16s %-14s %12s\n", $1, $2, ($3 < 0) ? "n/a" : $3);
+      next;
+   };
+   t = tol[key];
+   if (substr(t, length(t), 1) == "%")
+      limit = base[key] * (1 + substr(t, 1, length(t) - 1) / 100);
+   else
+      limit = base[key] + t;
+   status = ($3 > limit) ? "FAIL" : "PASS";
+   failed += ($3 > limit) ? 1 : 0;
+   printf("%s  %-16s %-14s %12s  baseline %s, limit %.0f\n", status, $1, $2, $3, base[key], limit);
+}
+END {
+   if (failed > 0)
+   {
+      printf("bench-check: %i counts above baseline\n", failed);
+      exit(1);
+   };
+}' "${BENCH_DIR}/check.counts"
+RC=$?
+rm -f "${BENCH_DIR}/check.counts"
+exit ${RC}
+
+# end of script
@@ -0,0 +1,212 @@
+#!/bin/sh
+#
+#   Secure Core Utilities
+#   Copyright (C) 2015, 2017 David M. Syzdek <david@syzdek.net>.
+#
+#   @SYZDEK_BSD_LICENSE_START@
+#
+#   Redistribution and use in source and binary forms, with or without
+#   modification, are permitted provided that the following conditions are
+#   met:
+#
+#      * Redistributions of source code must retain the above copyright
+#        notice, this list of conditions and the following disclaimer.
+#      * Redistributions in binary form must reproduce the above copyright
+#        notice, this list of conditions and the following disclaimer in the
+#        documentation and/or other materials provided with the distribution.
+#      * Neither the name of David M. Syzdek nor the
+#        names of its contributors may be used to endorse or promote products
+#        derived from this software without specific prior written permission.
+#
+#   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+#   IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+#   THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+#   PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL DAVID M SYZDEK BE LIABLE FOR
+#   ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+#   DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+#   SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+#   CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+#   LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+#   OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+#   SUCH DAMAGE.
+#
+#   @SYZDEK_BSD_LICENSE_END@
+#
+#   bench/bench-codecs.sh - measures decompression speed of zcat widget
+#
+#   Environment:
+#      SCU            path to securecoreutils binary   [src/securecoreutils]
+#      BENCH_BINDIR   directory containing bench-corpus and bench-run [bench]
+#      BENCH_DIR      absolute directory for generated corpus [$PWD/bench-data]
+#      BENCH_SIZE     size of each uncompressed corpus  [64M]
+#      BENCH_SHAPES   corpus shapes                     [syslog json access]
+#      BENCH_REPEAT   runs per measurement              [3]
+#      BENCH_BUFFERS  compressed read sizes (SCU_INPUT_BUFF) [16384 65536 1048576]
+#      BENCH_JOBS     zcat -s -j thread counts, N is the number of CPUs [1 2 4 N]
+#      BENCH_GENERATIONS  rotated generations decoded with -s [8]
+#      BENCH_GZIP_BUILDS  additional builds compared on gzip archives,
+#                     as space separated label=path pairs [none]
+#
+#   Writes one JSON object per line to standard out.
+#
+
+SCU=${SCU:-src/securecoreutils}
+BENCH_BINDIR=${BENCH_BINDIR:-bench}
+BENCH_DIR=${BENCH_DIR:-`pwd`/bench-data}
+BENCH_SIZE=${BENCH_SIZE:-64M}
+BENCH_SHAPES=${BENCH_SHAPES:-"syslog json access"}
+BENCH_REPEAT=${BENCH_REPEAT:-3}
+BENCH_GZIP_BUILDS=${BENCH_GZIP_BUILDS:-""}
+BENCH_BUFFERS=${BENCH_BUFFERS:-"16384 65536 1048576"}
+BENCH_JOBS=${BENCH_JOBS:-"1 2 4 N"}
+BENCH_GENERATIONS=${BENCH_GENERATIONS:-8}
+unset SCU_INPUT_BUFF
+
+# codec:compressor:suffix:default level:levels
+BENCH_CODECS="gzip:gzip:gz:6:1 6 9
+bzip2:bzip2:bz2:9:1 9
+xz:xz:xz:6:0 6 9
+compress:compress:Z:16:16
+zstd:zstd:zst:3:1 3 19"
+
+
+bench_die()
+{
+   echo "bench-codecs: $*" 1>&2
+   exit 1
+}
+
+
+# prints gzip backend reported by zcat widget of a build
+bench_backend()
+{
+   "$1" zcat --version 2> /dev/null \
+      | sed -n -e 's/^.*(gzip backend: \(.*\))$/\1/p'
+}
+
+
+# runs command BENCH_REPEAT times and prints fastest run
+bench_measure()
+{
+   BEST=""
+   BEST_NS=""
+   I=0
+   while test $I -lt ${BENCH_REPEAT};do
+      RESULT=`"${BENCH_BINDIR}/bench-run" -o /dev/null "$@"` || return 1
+      NS=`echo "${RESULT}" | sed -e 's/^"wall_ns":\([0-9]*\),.*$/\1/g'`
+      if test "x${BEST_NS}" = "x" || test ${NS} -lt ${BEST_NS};then
+         BEST="${RESULT}"
+         BEST_NS=${NS}
+      fi
+      I=`expr $I + 1`
+   done
+   echo "${BEST}"
+}
+
+
+# appends derived throughput fields to raw measurement
+bench_report()
+{
+   echo "$1" | ${AWK:-awk} -v prefix="$2" -v bytes="$3" -v csize="$4" '
+   {
+      n = split($0, kv, ",");
+      for (i = 1; i <= n; i++)
+      {
+         split(kv[i], pair, ":");
+         gsub(/"/, "", pair[1]);
+         v[pair[1]] = pair[2];
+      };
+      mbs = (v["wall_ns"] > 0) ? (bytes / 1048576) / (v["wall_ns"] / 1e9) : 0;
+      cpb = (v["cycles"] >= 0) ? sprintf("%.3f", v["cycles"] / bytes) : "null";
+      ipb = (v["instructions"] >= 0) ? sprintf("%.3f", v["instructions"] / bytes) : "null";
+      sys = (v["syscalls"] >= 0) ? v["syscalls"] : "null";
+      printf("{%s,\"bytes\":%s,\"compressed_bytes\":%s,\"ratio\":%.3f,", prefix, bytes, csize, (csize > 0) ? bytes / csize : 0);
+      printf("\"wall_ns\":%s,\"user_us\":%s,\"sys_us\":%s,\"mb_per_s\":%.2f,", v["wall_ns"], v["user_us"], v["sys_us"], mbs);
+      printf("\"cycles_per_byte\":%s,\"instructions_per_byte\":%s,", cpb, ipb);
+      printf("\"syscalls\":%s,\"maxrss_kb\":%s,\"status\":%s}\n", sys, v["maxrss_kb"], v["status"]);
+   }'
+}
+
+
+test -x "${SCU}"                     || bench_die "missing ${SCU}"
+test -x "${BENCH_BINDIR}/bench-corpus" || bench_die "missing ${BENCH_BINDIR}/bench-corpus"
+test -x "${BENCH_BINDIR}/bench-run"    || bench_die "missing ${BENCH_BINDIR}/bench-run"
+case "${BENCH_DIR}" in
+   /*) ;;
+   *) bench_die "BENCH_DIR must be an absolute path";;
+esac
+mkdir -p "${BENCH_DIR}" || bench_die "unable to create ${BENCH_DIR}"
+CPUS=`getconf _NPROCESSORS_ONLN 2> /dev/null || echo 1`
+BENCH_JOBS=`for JOBS in ${BENCH_JOBS};do test "x${JOBS}" = "xN" && echo ${CPUS} || echo ${JOBS};done | sort -n -u`
+BACKEND=`bench_backend "${SCU}"`
+"${SCU}" pathcheck -d "${BENCH_DIR}" || bench_die "BENCH_DIR must pass pathcheck (no symlinks or hidden directories)"
+
+
+for SHAPE in ${BENCH_SHAPES};do
+   CORPUS="${BENCH_DIR}/${SHAPE}-${BENCH_SIZE}.log"
+   if test ! -f "${CORPUS}";then
+      "${BENCH_BINDIR}/bench-corpus" -s "${SHAPE}" "${BENCH_SIZE}" > "${CORPUS}" \
+         || bench_die "unable to generate ${CORPUS}"
+   fi
+   BYTES=`wc -c < "${CORPUS}" | tr -d ' '`
+
+   # baseline: plain file through cat widget
+   RESULT=`bench_measure "${SCU}" cat "${CORPUS}"` || bench_die "cat failed on ${CORPUS}"
+   bench_report "${RESULT}" "\"widget\":\"cat\",\"shape\":\"${SHAPE}\",\"codec\":\"plain\",\"level\":0" ${BYTES} ${BYTES}
+
+   echo "${BENCH_CODECS}" | while IFS=: read CODEC TOOL SUFFIX DEFAULT LEVELS;do
+      if ! command -v "${TOOL}" > /dev/null 2>&1;then
+         echo "bench-codecs: skipping ${CODEC}, ${TOOL} not found" 1>&2
+         continue
+      fi
+      for LEVEL in ${LEVELS};do
+         ARCHIVE="${BENCH_DIR}/${SHAPE}-${BENCH_SIZE}-${LEVEL}.log.${SUFFIX}"
+         if test ! -f "${ARCHIVE}";then
+            if test "x${CODEC}" = "xcompress";then
+               "${TOOL}" -c -b "${LEVEL}" < "${CORPUS}" > "${ARCHIVE}"
+            else
+               "${TOOL}" -c "-${LEVEL}" < "${CORPUS}" > "${ARCHIVE}"
+            fi
+         fi
+         CSIZE=`wc -c < "${ARCHIVE}" | tr -d ' '`
+         for BUFFER in ${BENCH_BUFFERS};do
+            RESULT=`SCU_INPUT_BUFF=${BUFFER}; export SCU_INPUT_BUFF; bench_measure "${SCU}" zcat -C "${ARCHIVE}"` || bench_die "zcat failed on ${ARCHIVE}"
+            bench_report "${RESULT}" "\"widget\":\"zcat\",\"shape\":\"${SHAPE}\",\"codec\":\"${CODEC}\",\"level\":${LEVEL},\"backend\":\"${BACKEND}\",\"buffer\":${BUFFER},\"jobs\":1" ${BYTES} ${CSIZE}
+         done
+      done
+
+      # rotated generations of the default level decoded concurrently
+      SERIES="${BENCH_DIR}/series-${SHAPE}-${BENCH_SIZE}-${CODEC}"
+      mkdir -p "${SERIES}" || bench_die "unable to create ${SERIES}"
+      GEN=1
+      while test ${GEN} -le ${BENCH_GENERATIONS};do
+         if test ! -f "${SERIES}/${SHAPE}.log.${GEN}.${SUFFIX}";then
+            cp "${BENCH_DIR}/${SHAPE}-${BENCH_SIZE}-${DEFAULT}.log.${SUFFIX}" "${SERIES}/${SHAPE}.log.${GEN}.${SUFFIX}" \
+               || bench_die "unable to create ${SERIES}"
+         fi
+         GEN=`expr ${GEN} + 1`
+      done
+      CSIZE=`cat "${SERIES}/${SHAPE}.log".*.${SUFFIX} | wc -c | tr -d ' '`
+      for JOBS in ${BENCH_JOBS};do
+         RESULT=`bench_measure "${SCU}" zcat -C -s -j ${JOBS} "${SERIES}/${SHAPE}.log"` || bench_die "zcat failed on ${SERIES}"
+         bench_report "${RESULT}" "\"widget\":\"zcat\",\"shape\":\"${SHAPE}\",\"codec\":\"${CODEC}\",\"level\":${DEFAULT},\"backend\":\"${BACKEND}\",\"buffer\":65536,\"jobs\":${JOBS},\"generations\":${BENCH_GENERATIONS}" `expr ${BYTES} \* ${BENCH_GENERATIONS}` ${CSIZE}
+      done
+   done
+
+   # same gzip archives decoded by builds with other inflate backends
+   for BUILD in ${BENCH_GZIP_BUILDS};do
+      LABEL=`echo "${BUILD}" | sed -e 's/=.*$//g'`
+      BINARY=`echo "${BUILD}" | sed -e 's/^[^=]*=//g'`
+      test -x "${BINARY}" || bench_die "missing ${BINARY}"
+      BUILD_BACKEND=`bench_backend "${BINARY}"`
+      for ARCHIVE in "${BENCH_DIR}/${SHAPE}-${BENCH_SIZE}"-*.log.gz;do
+         test -f "${ARCHIVE}" || continue
+         LEVEL=`echo "${ARCHIVE}" | sed -e 's/^.*-\([0-9]*\)\.log\.gz$/\1/g'`
+         CSIZE=`wc -c < "${ARCHIVE}" | tr -d ' '`
+         RESULT=`bench_measure "${BINARY}" zcat -C "${ARCHIVE}"` || bench_die "zcat failed on ${ARCHIVE}"
+         bench_report "${RESULT}" "\"widget\":\"zcat\",\"shape\":\"${SHAPE}\",\"codec\":\"gzip\",\"level\":${LEVEL},\"backend\":\"${BUILD_BACKEND}\",\"build\":\"${LABEL}\",\"buffer\":65536,\"jobs\":1" ${BYTES} ${CSIZE}
+      done
+   done
+done
+
+# end of script
@@ -0,0 +1,325 @@
+/*
+ *  Secure Core Utilities
+ *  Copyright (C) 2015, 2017 David M. Syzdek <david@syzdek.net>.
+ *
+ *  @SYZDEK_BSD_LICENSE_START@
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of David M. Syzdek nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ *  IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ *  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL DAVID M SYZDEK BE LIABLE FOR
+ *  ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ *  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ *  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ *  OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ *  SUCH DAMAGE.
+ *
+ *  @SYZDEK_BSD_LICENSE_END@
+ */
+/**
+ *  @file bench/bench-corpus.c
+ *  Generates reproducible synthetic log files for benchmarks
+ */
+
+///////////////
+//           //
+//  Headers  //
+//           //
+///////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Headers
+#endif
+
+#ifdef HAVE_CONFIG_H
+#   include "config.h"
+#endif
+
+#include <assert.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <unistd.h>
+#include <getopt.h>
+
+
+///////////////////
+//               //
+//  Definitions  //
+//               //
+///////////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Definitions
+#endif
+
+#undef PROGRAM_NAME
+#define PROGRAM_NAME "bench-corpus"
+
+#define BENCH_SHAPE_SYSLOG    0
+#define BENCH_SHAPE_JSON      1
+#define BENCH_SHAPE_ACCESS    2
+#define BENCH_SHAPE_MIXED     3
+
+// 2021-07-24 00:00:00 UTC, fixed so the corpus is identical between runs
+#define BENCH_EPOCH           1627084800
+
+
+/////////////////
+//             //
+//  Variables  //
+//             //
+/////////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Variables
+#endif
+
+static const char * const bench_hosts[]   = { "web01", "web02", "web03", "db01", "db02", "cache01", "batch07", "edge12", NULL };
+static const char * const bench_daemons[] = { "sshd", "cron", "kernel", "systemd", "postfix/smtpd", "named", "dhclient", "sudo", NULL };
+static const char * const bench_levels[]  = { "debug", "info", "info", "info", "notice", "warn", "error", NULL };
+static const char * const bench_methods[] = { "GET", "GET", "GET", "POST", "PUT", "DELETE", "HEAD", NULL };
+static const char * const bench_paths[]   = { "/api/v1/items", "/api/v1/users", "/static/app.js", "/static/site.css", "/login", "/health", "/api/v2/search", NULL };
+static const char * const bench_agents[]  = { "curl/7.68.0", "Mozilla/5.0 (X11; Linux x86_64)", "python-requests/2.25.1", "Go-http-client/1.1", NULL };
+static const char * const bench_words[]   =
+{
+   "connection", "accepted", "closed", "timeout", "session", "opened", "for", "user",
+   "request", "completed", "failed", "retrying", "backend", "upstream", "cache", "miss",
+   "hit", "queue", "depth", "exceeded", "worker", "started", "stopped", "reload", NULL
+};
+static const char * const bench_months[]  = { "Jan", "Feb", "Mar", "Apr", "May", "Jun", "Jul", "Aug", "Sep", "Oct", "Nov", "Dec" };
+
+
+//////////////////
+//              //
+//  Prototypes  //
+//              //
+//////////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Prototypes
+#endif
+
+int main(int argc, char * argv[]);
+static const char * bench_pick(uint64_t * state, const char * const * list);
+static uint64_t bench_rand(uint64_t * state);
+static int bench_line(char * buff, size_t size, int shape, uint64_t * state, time_t t);
+static void bench_usage(void);
+
+
+/////////////////
+//             //
+//  Functions  //
+//             //
+/////////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Functions
+#endif
+
+int main(int argc, char * argv[])
+{
+   int            c;
+   int            shape;
+   int            len;
+   uint64_t       state;
+   uint64_t       size;
+   uint64_t       written;
+   time_t         t;
+   char         * endptr;
+   char           line[1024];
+
+   static char   short_opt[] = "hs:S:";
+
+   shape = BENCH_SHAPE_SYSLOG;
+   state = UINT64_C(0x5eed5ec0de5eed);
+
+   while((c = getopt(argc, argv, short_opt)) != -1)
+   {
+      switch(c)
+      {
+         case 'h':
+         bench_usage();
+         return(0);
+
+         case 's':
+         if (!(strcasecmp(optarg, "syslog")))
+            shape = BENCH_SHAPE_SYSLOG;
+         else if (!(strcasecmp(optarg, "json")))
+            shape = BENCH_SHAPE_JSON;
+         else if (!(strcasecmp(optarg, "access")))
+            shape = BENCH_SHAPE_ACCESS;
+         else if (!(strcasecmp(optarg, "mixed")))
+            shape = BENCH_SHAPE_MIXED;
+         else
+         {
+            fprintf(stderr, "%s: unknown shape -- %s\n", PROGRAM_NAME, optarg);
+            return(1);
+         };
+         break;
+
+         case 'S':
+         state = strtoull(optarg, &endptr, 0);
+         if ((endptr == optarg) || (endptr[0] != '\0') || (state == 0))
+         {
+            fprintf(stderr, "%s: invalid seed -- %s\n", PROGRAM_NAME, optarg);
+            return(1);
+         };
+         break;
+
+         case '?':
+         fprintf(stderr, "Try `%s -h' for more information.\n", PROGRAM_NAME);
+         return(1);
+
+         default:
+         break;
+      };
+   };
+
+   if ((argc - optind) != 1)
+   {
+      bench_usage();
+      return(1);
+   };
+
+   // size accepts K, M, and G suffixes
+   size = strtoull(argv[optind], &endptr, 10);
+   switch(endptr[0])
+   {
+      case 'g': case 'G': size *= 1024; /* FALLTHROUGH */
+      case 'm': case 'M': size *= 1024; /* FALLTHROUGH */
+      case 'k': case 'K': size *= 1024; endptr++; break;
+      default: break;
+   };
+   if ((endptr == argv[optind]) || (endptr[0] != '\0'))
+   {
+      fprintf(stderr, "%s: invalid size -- %s\n", PROGRAM_NAME, argv[optind]);
+      return(1);
+   };
+
+   t       = BENCH_EPOCH;
+   written = 0;
+   while (written < size)
+   {
+      // advance clock by 0-3 seconds so timestamps stay monotonic
+      t  += (time_t)(bench_rand(&state) % 4);
+      len = bench_line(line, sizeof(line), shape, &state, t);
+      if ((uint64_t)len > (size - written))
+      {
+         len = (int)(size - written);
+         line[len-1] = '\n';
+      };
+      if (fwrite(line, (size_t)len, 1, stdout) != 1)
+      {
+         fprintf(stderr, "%s: %s\n", PROGRAM_NAME, strerror(errno));
+         return(1);
+      };
+      written += (uint64_t)len;
+   };
+
+   return(0);
+}
+
+
+static const char * bench_pick(uint64_t * state, const char * const * list)
+{
+   size_t count;
+   for(count = 0; list[count] != NULL; count++);
+   return(list[bench_rand(state) % count]);
+}
+
+
+/// xorshift64*, used instead of rand(3) so output does not depend on libc
+static uint64_t bench_rand(uint64_t * state)
+{
+   *state ^= *state >> 12;
+   *state ^= *state << 25;
+   *state ^= *state >> 27;
+   return(*state * UINT64_C(0x2545f4914f6cdd1d));
+}
+
+
+static int bench_line(char * buff, size_t size, int shape, uint64_t * state, time_t t)
+{
+   struct tm      tm;
+   uint64_t       r;
+   uint64_t       id;
+   const char   * s1;
+   const char   * s2;
+   const char   * w1;
+   const char   * w2;
+   const char   * w3;
+
+   // values are drawn in a fixed order since argument evaluation order is
+   // unspecified and would otherwise make the corpus compiler dependent
+   gmtime_r(&t, &tm);
+   r  = bench_rand(state);
+   id = bench_rand(state) & UINT64_C(0xffffffffffff);
+   w1 = bench_pick(state, bench_words);
+   w2 = bench_pick(state, bench_words);
+   w3 = bench_pick(state, bench_words);
+
+   if (shape == BENCH_SHAPE_MIXED)
+      shape = (int)(r % 3);
+
+   switch(shape)
+   {
+      case BENCH_SHAPE_JSON:
+      s1 = bench_pick(state, bench_levels);
+      s2 = bench_pick(state, bench_hosts);
+      return(snprintf(buff, size,
+         "{\"ts\":\"%04i-%02i-%02iT%02i:%02i:%02i.%03uZ\",\"level\":\"%s\",\"host\":\"%s\","
+         "\"req_id\":\"%012" PRIx64 "\",\"latency_ms\":%u,\"msg\":\"%s %s %s\"}\n",
+         tm.tm_year+1900, tm.tm_mon+1, tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec,
+         (unsigned)(r % 1000), s1, s2, id, (unsigned)((r >> 16) % 2500), w1, w2, w3));
+
+      case BENCH_SHAPE_ACCESS:
+      s1 = bench_pick(state, bench_methods);
+      s2 = bench_pick(state, bench_paths);
+      w1 = bench_pick(state, bench_agents);
+      return(snprintf(buff, size,
+         "10.%u.%u.%u - - [%02i/%s/%04i:%02i:%02i:%02i +0000] \"%s %s/%u HTTP/1.1\" %u %u \"-\" \"%s\"\n",
+         (unsigned)(r % 4), (unsigned)((r >> 8) % 256), (unsigned)((r >> 16) % 256),
+         tm.tm_mday, bench_months[tm.tm_mon], tm.tm_year+1900, tm.tm_hour, tm.tm_min, tm.tm_sec,
+         s1, s2, (unsigned)((r >> 24) % 10000), (((r >> 40) % 10) == 0) ? 404 : 200,
+         (unsigned)((r >> 32) % 65536), w1));
+
+      default:
+      break;
+   };
+
+   s1 = bench_pick(state, bench_hosts);
+   s2 = bench_pick(state, bench_daemons);
+   return(snprintf(buff, size,
+      "%s %2i %02i:%02i:%02i %s %s[%u]: %s %s %s for user%u from 10.0.%u.%u port %u\n",
+      bench_months[tm.tm_mon], tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec,
+      s1, s2, (unsigned)(r % 32768), w1, w2, w3,
+      (unsigned)((r >> 16) % 64), (unsigned)((r >> 24) % 256), (unsigned)((r >> 32) % 256),
+      (unsigned)(1024 + ((r >> 40) % 64511))));
+}
+
+
+static void bench_usage(void)
+{
+   printf("Usage: %s [-s shape] [-S seed] size[K|M|G]\n", PROGRAM_NAME);
+   printf("  -s shape                  syslog, json, access, or mixed [syslog]\n");
+   printf("  -S seed                   non-zero seed for generator\n");
+   return;
+}
+
+
+/* end of source */
@@ -0,0 +1,337 @@
+/*
+ *  Secure Core Utilities
+ *  Copyright (C) 2015, 2017 David M. Syzdek <david@syzdek.net>.
+ *
+ *  @SYZDEK_BSD_LICENSE_START@
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of David M. Syzdek nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ *  IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ *  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL DAVID M SYZDEK BE LIABLE FOR
+ *  ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ *  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ *  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ *  OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ *  SUCH DAMAGE.
+ *
+ *  @SYZDEK_BSD_LICENSE_END@
+ */
+/**
+ *  @file bench/bench-count.c
+ *  Runs a command once and reports counts which do not depend on load
+ */
+
+///////////////
+//           //
+//  Headers  //
+//           //
+///////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Headers
+#endif
+
+#ifdef HAVE_CONFIG_H
+#   include "config.h"
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#ifdef __linux__
+#include <sys/ptrace.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+
+///////////////////
+//               //
+//  Definitions  //
+//               //
+///////////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Definitions
+#endif
+
+#undef PROGRAM_NAME
+#define PROGRAM_NAME "bench-count"
+
+
+//////////////////
+//              //
+//  Prototypes  //
+//              //
+//////////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Prototypes
+#endif
+
+int main(int argc, char * argv[]);
+static int64_t bench_allocs(int fd);
+static int bench_instructions_open(pid_t pid);
+static int64_t bench_instructions_read(int fd);
+static int bench_trace(pid_t pid, int64_t * syscalls, int * status);
+
+
+/////////////////
+//             //
+//  Functions  //
+//             //
+/////////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Functions
+#endif
+
+int main(int argc, char * argv[])
+{
+   int               c;
+   int               x;
+   int               status;
+   int               alloc_fd;
+   int               counter;
+   char              str[16];
+   int64_t           syscalls;
+   pid_t             pid;
+   FILE            * fs;
+   const char      * infile;
+   const char      * outfile;
+   const char      * preload;
+
+   static char   short_opt[] = "+a:hi:o:";
+
+   infile   = NULL;
+   outfile  = "/dev/null";
+   preload  = NULL;
+   alloc_fd = -1;
+
+   while((c = getopt(argc, argv, short_opt)) != -1)
+   {
+      switch(c)
+      {
+         case 'a':
+         preload = optarg;
+         break;
+
+         case 'h':
+         printf("Usage: %s [-a bench-alloc.so] [-i input] [-o output] command [args]\n", PROGRAM_NAME);
+         return(0);
+
+         case 'i':
+         infile = optarg;
+         break;
+
+         case 'o':
+         outfile = optarg;
+         break;
+
+         case '?':
+         fprintf(stderr, "Try `%s -h' for more information.\n", PROGRAM_NAME);
+         return(1);
+
+         default:
+         break;
+      };
+   };
+   if ((argc - optind) < 1)
+   {
+      fprintf(stderr, "%s: missing required argument\n", PROGRAM_NAME);
+      return(1);
+   };
+
+   // preloaded library writes count of allocations to an unlinked file
+   if (preload != NULL)
+   {
+      if ((fs = tmpfile()) == NULL)
+      {
+         fprintf(stderr, "%s: tmpfile: %s\n", PROGRAM_NAME, strerror(errno));
+         return(1);
+      };
+      alloc_fd = fileno(fs);
+   };
+
+   if ((pid = fork()) == -1)
+   {
+      fprintf(stderr, "%s: fork: %s\n", PROGRAM_NAME, strerror(errno));
+      return(1);
+   };
+   if (pid == 0)
+   {
+      if (preload != NULL)
+      {
+         snprintf(str, sizeof(str), "%i", alloc_fd);
+         setenv("BENCH_ALLOC_FD", str, 1);
+         setenv("LD_PRELOAD", preload, 1);
+      };
+      if (infile != NULL)
+      {
+         if ((x = open(infile, O_RDONLY)) == -1)
+            _exit(127);
+         dup2(x, STDIN_FILENO);
+         close(x);
+      };
+      if ((x = open(outfile, O_WRONLY|O_CREAT|O_TRUNC, 0644)) == -1)
+         _exit(127);
+      dup2(x, STDOUT_FILENO);
+      close(x);
+#ifdef __linux__
+      if (ptrace(PTRACE_TRACEME, 0, NULL, NULL) == -1)
+         _exit(127);
+#endif
+      raise(SIGSTOP);
+      execvp(argv[optind], &argv[optind]);
+      _exit(127);
+   };
+
+   if ((waitpid(pid, &status, WUNTRACED) == -1) || (!(WIFSTOPPED(status))))
+   {
+      fprintf(stderr, "%s: %s did not start\n", PROGRAM_NAME, argv[optind]);
+      return(1);
+   };
+   counter = bench_instructions_open(pid);
+
+   if (bench_trace(pid, &syscalls, &status) == -1)
+   {
+      fprintf(stderr, "%s: ptrace: %s\n", PROGRAM_NAME, strerror(errno));
+      kill(pid, SIGKILL);
+      return(1);
+   };
+
+   printf("\"instructions\":%" PRIi64 ",", bench_instructions_read(counter));
+   printf("\"syscalls\":%" PRIi64 ",", syscalls);
+   printf("\"allocs\":%" PRIi64 ",", bench_allocs(alloc_fd));
+   printf("\"status\":%i\n", (WIFEXITED(status)) ? WEXITSTATUS(status) : 128 + WTERMSIG(status));
+
+   return(((WIFEXITED(status)) && (WEXITSTATUS(status) == 0)) ? 0 : 1);
+}
+
+
+/// returns -1 when command was not run with the allocation counter
+static int64_t bench_allocs(int fd)
+{
+   char              buff[32];
+   ssize_t           len;
+
+   if (fd == -1)
+      return(-1);
+   if ((len = pread(fd, buff, sizeof(buff) - 1, 0)) <= 0)
+      return(-1);
+   buff[len] = '\0';
+
+   return((int64_t)strtoll(buff, NULL, 10));
+}
+
+
+/// attaches a counter of user space instructions, enabled at exec
+static int bench_instructions_open(pid_t pid)
+{
+#ifdef __linux__
+   struct perf_event_attr   attr;
+
+   memset(&attr, 0, sizeof(attr));
+   attr.size            = sizeof(attr);
+   attr.type            = PERF_TYPE_HARDWARE;
+   attr.config          = PERF_COUNT_HW_INSTRUCTIONS;
+   attr.disabled        = 1;
+   attr.enable_on_exec  = 1;
+   attr.exclude_kernel  = 1;
+   attr.exclude_hv      = 1;
+
+   return((int)syscall(__NR_perf_event_open, &attr, pid, -1, -1, 0));
+#else
+   return(-1);
+#endif
+}
+
+
+/// returns -1 when counter is unavailable (no PMU or perf_event_paranoid)
+static int64_t bench_instructions_read(int fd)
+{
+   uint64_t value;
+   if (fd == -1)
+      return(-1);
+   if (read(fd, &value, sizeof(value)) != (ssize_t)sizeof(value))
+      return(-1);
+   close(fd);
+   return((int64_t)value);
+}
+
+
+/// counts system calls entered by the command after exec, threads the
+/// command starts are not traced
+static int bench_trace(pid_t pid, int64_t * syscalls, int * status)
+{
+#ifdef __linux__
+   int               sig;
+   int               counting;
+   int               insyscall;
+
+   *syscalls = 0;
+   counting  = 0;
+   insyscall = 0;
+
+   if (ptrace(PTRACE_SETOPTIONS, pid, NULL, (void *)(long)(PTRACE_O_TRACESYSGOOD|PTRACE_O_TRACEEXEC|PTRACE_O_EXITKILL)) == -1)
+      return(-1);
+   if (ptrace(PTRACE_SYSCALL, pid, NULL, NULL) == -1)
+      return(-1);
+
+   while (waitpid(pid, status, 0) != -1)
+   {
+      if (!(WIFSTOPPED(*status)))
+         return(0);
+      sig = 0;
+
+      // every system call stops once on entry and once on exit
+      if (WSTOPSIG(*status) == (SIGTRAP|0x80))
+      {
+         *syscalls += ((counting) && (!(insyscall))) ? 1 : 0;
+         insyscall  = !(insyscall);
+      }
+
+      // exec event stops inside execve, before its exit
+      else if ((*status >> 8) == (SIGTRAP | (PTRACE_EVENT_EXEC << 8)))
+      {
+         counting  = 1;
+         insyscall = 1;
+      }
+      else if (WSTOPSIG(*status) != SIGTRAP)
+      {
+         sig = WSTOPSIG(*status);
+      };
+
+      if (ptrace(PTRACE_SYSCALL, pid, NULL, (void *)(long)sig) == -1)
+         return(-1);
+   };
+
+   return(-1);
+#else
+   *syscalls = -1;
+   return((waitpid(pid, status, 0) == -1) ? -1 : 0);
+#endif
+}
+
+
+/* end of source */
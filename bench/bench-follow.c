@@ -0,0 +1,359 @@
+/*
+ *  Secure Core Utilities
+ *  Copyright (C) 2015, 2017 David M. Syzdek <david@syzdek.net>.
+ *
+ *  @SYZDEK_BSD_LICENSE_START@
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of David M. Syzdek nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ *  IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ *  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL DAVID M SYZDEK BE LIABLE FOR
+ *  ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ *  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ *  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ *  OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ *  SUCH DAMAGE.
+ *
+ *  @SYZDEK_BSD_LICENSE_END@
+ */
+/**
+ *  @file bench/bench-follow.c
+ *  Appends to a file followed by a command and reports output latency
+ */
+
+///////////////
+//           //
+//  Headers  //
+//           //
+///////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Headers
+#endif
+
+#ifdef HAVE_CONFIG_H
+#   include "config.h"
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+
+///////////////////
+//               //
+//  Definitions  //
+//               //
+///////////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Definitions
+#endif
+
+#undef PROGRAM_NAME
+#define PROGRAM_NAME "bench-follow"
+
+#define BENCH_SAMPLES_MAX     100000
+#define BENCH_TIMEOUT_MS      5000
+
+
+//////////////////
+//              //
+//  Prototypes  //
+//              //
+//////////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Prototypes
+#endif
+
+int main(int argc, char * argv[]);
+static int bench_cmp(const void * a, const void * b);
+static int bench_drain(int fd, const char * marker, int timeout_ms);
+static uint64_t bench_now(void);
+static void bench_sleep(uint64_t ns);
+static int64_t bench_switches(pid_t pid);
+
+
+/////////////////
+//             //
+//  Functions  //
+//             //
+/////////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Functions
+#endif
+
+int main(int argc, char * argv[])
+{
+   int               c;
+   int               x;
+   int               fd;
+   int               out_fd[2];
+   int               samples;
+   int               idle_ms;
+   int               interval_ms;
+   int               status;
+   int64_t           before;
+   int64_t           after;
+   uint64_t          start;
+   uint64_t        * ns;
+   uint64_t          sum;
+   char              line[64];
+   pid_t             pid;
+   const char      * file;
+
+   static char   short_opt[] = "+hd:i:n:";
+
+   samples     = 100;
+   idle_ms     = 2000;
+   interval_ms = 50;
+
+   while((c = getopt(argc, argv, short_opt)) != -1)
+   {
+      switch(c)
+      {
+         case 'h':
+         printf("Usage: %s [-d interval_ms] [-i idle_ms] [-n samples] file command [args]\n", PROGRAM_NAME);
+         return(0);
+
+         case 'd':
+         interval_ms = atoi(optarg);
+         break;
+
+         case 'i':
+         idle_ms = atoi(optarg);
+         break;
+
+         case 'n':
+         samples = atoi(optarg);
+         break;
+
+         case '?':
+         fprintf(stderr, "Try `%s -h' for more information.\n", PROGRAM_NAME);
+         return(1);
+
+         default:
+         break;
+      };
+   };
+   if ((argc - optind) < 2)
+   {
+      fprintf(stderr, "%s: missing required argument\n", PROGRAM_NAME);
+      return(1);
+   };
+   if ( (samples < 1) || (samples > BENCH_SAMPLES_MAX) || (idle_ms < 0) || (interval_ms < 0) )
+   {
+      fprintf(stderr, "%s: invalid argument\n", PROGRAM_NAME);
+      return(1);
+   };
+   file = argv[optind++];
+
+   if ((fd = open(file, O_WRONLY|O_APPEND)) == -1)
+   {
+      fprintf(stderr, "%s: %s: %s\n", PROGRAM_NAME, file, strerror(errno));
+      return(1);
+   };
+   if ((ns = calloc((size_t)samples, sizeof(uint64_t))) == NULL)
+   {
+      fprintf(stderr, "%s: out of virtual memory\n", PROGRAM_NAME);
+      return(1);
+   };
+   if (pipe(out_fd) == -1)
+   {
+      fprintf(stderr, "%s: pipe: %s\n", PROGRAM_NAME, strerror(errno));
+      return(1);
+   };
+
+   if ((pid = fork()) == -1)
+   {
+      fprintf(stderr, "%s: fork: %s\n", PROGRAM_NAME, strerror(errno));
+      return(1);
+   };
+   if (pid == 0)
+   {
+      close(out_fd[0]);
+      dup2(out_fd[1], STDOUT_FILENO);
+      close(out_fd[1]);
+      execvp(argv[optind], &argv[optind]);
+      _exit(127);
+   };
+   close(out_fd[1]);
+
+   // the command is following once a first append reaches the pipe
+   if ( (write(fd, "bench-follow start\n", 19) != 19) ||
+        (bench_drain(out_fd[0], "bench-follow start\n", BENCH_TIMEOUT_MS) == -1) )
+   {
+      fprintf(stderr, "%s: command is not following %s\n", PROGRAM_NAME, file);
+      kill(pid, SIGKILL);
+      waitpid(pid, &status, 0);
+      return(1);
+   };
+
+   // context switches of an idle follower are its wakeups
+   before = bench_switches(pid);
+   bench_sleep((uint64_t)idle_ms * 1000000);
+   after  = bench_switches(pid);
+
+   for(x = 0, sum = 0; x < samples; x++)
+   {
+      snprintf(line, sizeof(line), "bench-follow %i\n", x);
+      start = bench_now();
+      if ( (write(fd, line, strlen(line)) != (ssize_t)strlen(line)) ||
+           (bench_drain(out_fd[0], line, BENCH_TIMEOUT_MS) == -1) )
+      {
+         fprintf(stderr, "%s: append %i was not followed\n", PROGRAM_NAME, x);
+         kill(pid, SIGKILL);
+         waitpid(pid, &status, 0);
+         return(1);
+      };
+      ns[x]  = bench_now() - start;
+      sum   += ns[x];
+      bench_sleep((uint64_t)interval_ms * 1000000);
+   };
+
+   kill(pid, SIGTERM);
+   waitpid(pid, &status, 0);
+   close(out_fd[0]);
+   close(fd);
+
+   qsort(ns, (size_t)samples, sizeof(uint64_t), bench_cmp);
+   printf("\"samples\":%i,", samples);
+   printf("\"min_us\":%.1f,", (double)ns[0] / 1000.0);
+   printf("\"median_us\":%.1f,", (double)ns[(samples - 1) / 2] / 1000.0);
+   x = ((samples * 9) / 10 > 0) ? (samples * 9) / 10 - 1 : 0;
+   printf("\"p90_us\":%.1f,", (double)ns[x] / 1000.0);
+   printf("\"max_us\":%.1f,", (double)ns[samples - 1] / 1000.0);
+   printf("\"mean_us\":%.1f,", (double)sum / (double)samples / 1000.0);
+   printf("\"idle_ms\":%i,", idle_ms);
+   if ( (before == -1) || (after == -1) || (idle_ms == 0) )
+      printf("\"wakeups_per_s\":null\n");
+   else
+      printf("\"wakeups_per_s\":%.1f\n", (double)(after - before) * 1000.0 / (double)idle_ms);
+
+   free(ns);
+
+   return(0);
+}
+
+
+static int bench_cmp(const void * a, const void * b)
+{
+   const uint64_t * x = a;
+   const uint64_t * y = b;
+   return((*x > *y) ? 1 : ((*x < *y) ? -1 : 0));
+}
+
+
+/// reads output until it ends with marker, returns -1 on timeout or EOF
+static int bench_drain(int fd, const char * marker, int timeout_ms)
+{
+   char              buff[4096];
+   char              tail[64];
+   size_t            mlen;
+   size_t            tlen;
+   ssize_t           len;
+   struct pollfd     pfd;
+
+   mlen = strlen(marker);
+   tlen = 0;
+   pfd.fd     = fd;
+   pfd.events = POLLIN;
+
+   while (poll(&pfd, 1, timeout_ms) == 1)
+   {
+      if ((len = read(fd, buff, sizeof(buff))) <= 0)
+         return(-1);
+
+      // keeps the last bytes of output to compare against marker
+      if ((size_t)len >= mlen)
+      {
+         memcpy(tail, &buff[(size_t)len - mlen], mlen);
+         tlen = mlen;
+      }
+      else
+      {
+         if ((tlen + (size_t)len) > mlen)
+         {
+            memmove(tail, &tail[tlen + (size_t)len - mlen], mlen - (size_t)len);
+            tlen = mlen - (size_t)len;
+         };
+         memcpy(&tail[tlen], buff, (size_t)len);
+         tlen += (size_t)len;
+      };
+      if ( (tlen == mlen) && (!(memcmp(tail, marker, mlen))) )
+         return(0);
+   };
+
+   return(-1);
+}
+
+
+static uint64_t bench_now(void)
+{
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return(((uint64_t)ts.tv_sec * 1000000000) + (uint64_t)ts.tv_nsec);
+}
+
+
+static void bench_sleep(uint64_t ns)
+{
+   struct timespec ts;
+   ts.tv_sec  = (time_t)(ns / 1000000000);
+   ts.tv_nsec = (long)(ns % 1000000000);
+   while ( (nanosleep(&ts, &ts) == -1) && (errno == EINTR) );
+   return;
+}
+
+
+/// returns voluntary and involuntary context switches of process, or -1
+/// when /proc is not available
+static int64_t bench_switches(pid_t pid)
+{
+   int64_t        total;
+   long long      value;
+   char           path[64];
+   char           line[256];
+   FILE         * fs;
+
+   snprintf(path, sizeof(path), "/proc/%li/status", (long)pid);
+   if ((fs = fopen(path, "r")) == NULL)
+      return(-1);
+   total = 0;
+   while (fgets(line, sizeof(line), fs) != NULL)
+   {
+      if (sscanf(line, "voluntary_ctxt_switches: %lli", &value) == 1)
+         total += value;
+      if (sscanf(line, "nonvoluntary_ctxt_switches: %lli", &value) == 1)
+         total += value;
+   };
+   fclose(fs);
+
+   return(total);
+}
+
+
+/* end of source */
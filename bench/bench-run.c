@@ -0,0 +1,326 @@
+/*
+ *  Secure Core Utilities
+ *  Copyright (C) 2015, 2017 David M. Syzdek <david@syzdek.net>.
+ *
+ *  @SYZDEK_BSD_LICENSE_START@
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of David M. Syzdek nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ *  IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ *  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL DAVID M SYZDEK BE LIABLE FOR
+ *  ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ *  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ *  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ *  OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ *  SUCH DAMAGE.
+ *
+ *  @SYZDEK_BSD_LICENSE_END@
+ */
+/**
+ *  @file bench/bench-run.c
+ *  Runs a command once and reports resource usage for benchmarks
+ */
+
+///////////////
+//           //
+//  Headers  //
+//           //
+///////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Headers
+#endif
+
+#ifdef HAVE_CONFIG_H
+#   include "config.h"
+#endif
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#ifdef __linux__
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+
+///////////////////
+//               //
+//  Definitions  //
+//               //
+///////////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Definitions
+#endif
+
+#undef PROGRAM_NAME
+#define PROGRAM_NAME "bench-run"
+
+#define BENCH_CNT_CYCLES         0
+#define BENCH_CNT_INSTRUCTIONS   1
+#define BENCH_CNT_SYSCALLS       2
+#define BENCH_CNT_MAX            3
+
+
+//////////////////
+//              //
+//  Prototypes  //
+//              //
+//////////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Prototypes
+#endif
+
+int main(int argc, char * argv[]);
+static int bench_counter_open(int type, pid_t pid);
+static int64_t bench_counter_read(int fd);
+static uint64_t bench_nsec(const struct timespec * ts);
+static int bench_syscall_tracepoint(void);
+
+
+/////////////////
+//             //
+//  Functions  //
+//             //
+/////////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Functions
+#endif
+
+int main(int argc, char * argv[])
+{
+   int               c;
+   int               x;
+   int               status;
+   int               sync_fd[2];
+   int               counters[BENCH_CNT_MAX];
+   char              go;
+   pid_t             pid;
+   const char      * infile;
+   const char      * outfile;
+   struct rusage     ru;
+   struct timespec   start;
+   struct timespec   stop;
+
+   static char   short_opt[] = "+hi:o:";
+
+   infile  = NULL;
+   outfile = "/dev/null";
+
+   while((c = getopt(argc, argv, short_opt)) != -1)
+   {
+      switch(c)
+      {
+         case 'h':
+         printf("Usage: %s [-i input] [-o output] command [args]\n", PROGRAM_NAME);
+         return(0);
+
+         case 'i':
+         infile = optarg;
+         break;
+
+         case 'o':
+         outfile = optarg;
+         break;
+
+         case '?':
+         fprintf(stderr, "Try `%s -h' for more information.\n", PROGRAM_NAME);
+         return(1);
+
+         default:
+         break;
+      };
+   };
+   if ((argc - optind) < 1)
+   {
+      fprintf(stderr, "%s: missing required argument\n", PROGRAM_NAME);
+      return(1);
+   };
+
+   // child blocks on pipe until counters are attached
+   if (pipe(sync_fd) == -1)
+   {
+      fprintf(stderr, "%s: pipe: %s\n", PROGRAM_NAME, strerror(errno));
+      return(1);
+   };
+
+   clock_gettime(CLOCK_MONOTONIC, &start);
+   if ((pid = fork()) == -1)
+   {
+      fprintf(stderr, "%s: fork: %s\n", PROGRAM_NAME, strerror(errno));
+      return(1);
+   };
+   if (pid == 0)
+   {
+      close(sync_fd[1]);
+      if (read(sync_fd[0], &go, 1) != 1)
+         _exit(127);
+      close(sync_fd[0]);
+      if (infile != NULL)
+      {
+         if ((x = open(infile, O_RDONLY)) == -1)
+            _exit(127);
+         dup2(x, STDIN_FILENO);
+         close(x);
+      };
+      if ((x = open(outfile, O_WRONLY|O_CREAT|O_TRUNC, 0644)) == -1)
+         _exit(127);
+      dup2(x, STDOUT_FILENO);
+      close(x);
+      execvp(argv[optind], &argv[optind]);
+      _exit(127);
+   };
+   close(sync_fd[0]);
+
+   for(x = 0; x < BENCH_CNT_MAX; x++)
+      counters[x] = bench_counter_open(x, pid);
+
+   go = 1;
+   if (write(sync_fd[1], &go, 1) != 1)
+   {
+      fprintf(stderr, "%s: write: %s\n", PROGRAM_NAME, strerror(errno));
+      kill(pid, SIGKILL);
+   };
+   close(sync_fd[1]);
+
+   if (wait4(pid, &status, 0, &ru) == -1)
+   {
+      fprintf(stderr, "%s: wait: %s\n", PROGRAM_NAME, strerror(errno));
+      return(1);
+   };
+   clock_gettime(CLOCK_MONOTONIC, &stop);
+
+   printf("\"wall_ns\":%" PRIu64 ",", bench_nsec(&stop) - bench_nsec(&start));
+   printf("\"user_us\":%" PRIi64 ",", (int64_t)ru.ru_utime.tv_sec * 1000000 + ru.ru_utime.tv_usec);
+   printf("\"sys_us\":%" PRIi64 ",",  (int64_t)ru.ru_stime.tv_sec * 1000000 + ru.ru_stime.tv_usec);
+   printf("\"maxrss_kb\":%li,", (long)ru.ru_maxrss);
+   printf("\"cycles\":%" PRIi64 ",", bench_counter_read(counters[BENCH_CNT_CYCLES]));
+   printf("\"instructions\":%" PRIi64 ",", bench_counter_read(counters[BENCH_CNT_INSTRUCTIONS]));
+   printf("\"syscalls\":%" PRIi64 ",", bench_counter_read(counters[BENCH_CNT_SYSCALLS]));
+   printf("\"status\":%i\n", (WIFEXITED(status)) ? WEXITSTATUS(status) : 128 + WTERMSIG(status));
+
+   return(((WIFEXITED(status)) && (WEXITSTATUS(status) == 0)) ? 0 : 1);
+}
+
+
+/// attaches a counter to the child, enabled once the child calls exec
+static int bench_counter_open(int type, pid_t pid)
+{
+#ifdef __linux__
+   struct perf_event_attr   attr;
+
+   memset(&attr, 0, sizeof(attr));
+   attr.size            = sizeof(attr);
+   attr.disabled        = 1;
+   attr.enable_on_exec  = 1;
+   attr.inherit         = 1;
+   attr.exclude_kernel  = (type == BENCH_CNT_SYSCALLS) ? 0 : 1;
+   attr.exclude_hv      = 1;
+
+   switch(type)
+   {
+      case BENCH_CNT_CYCLES:
+      attr.type   = PERF_TYPE_HARDWARE;
+      attr.config = PERF_COUNT_HW_CPU_CYCLES;
+      break;
+
+      case BENCH_CNT_INSTRUCTIONS:
+      attr.type   = PERF_TYPE_HARDWARE;
+      attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+      break;
+
+      case BENCH_CNT_SYSCALLS:
+      attr.type   = PERF_TYPE_TRACEPOINT;
+      if ((attr.config = (uint64_t)bench_syscall_tracepoint()) == (uint64_t)-1)
+         return(-1);
+      break;
+
+      default:
+      return(-1);
+   };
+
+   return((int)syscall(__NR_perf_event_open, &attr, pid, -1, -1, 0));
+#else
+   assert(type >= 0);
+   assert(pid > 0);
+   return(-1);
+#endif
+}
+
+
+/// returns -1 when counter is unavailable (no PMU or perf_event_paranoid)
+static int64_t bench_counter_read(int fd)
+{
+   uint64_t value;
+   if (fd == -1)
+      return(-1);
+   if (read(fd, &value, sizeof(value)) != (ssize_t)sizeof(value))
+      return(-1);
+   close(fd);
+   return((int64_t)value);
+}
+
+
+static uint64_t bench_nsec(const struct timespec * ts)
+{
+   return(((uint64_t)ts->tv_sec * 1000000000) + (uint64_t)ts->tv_nsec);
+}
+
+
+/// looks up id of raw_syscalls:sys_enter in tracefs
+static int bench_syscall_tracepoint(void)
+{
+   int            id;
+   FILE         * fs;
+   const char   * paths[] =
+   {
+      "/sys/kernel/tracing/events/raw_syscalls/sys_enter/id",
+      "/sys/kernel/debug/tracing/events/raw_syscalls/sys_enter/id",
+      NULL
+   };
+   int            x;
+
+   for(x = 0; paths[x] != NULL; x++)
+   {
+      if ((fs = fopen(paths[x], "r")) == NULL)
+         continue;
+      if (fscanf(fs, "%i", &id) != 1)
+         id = -1;
+      fclose(fs);
+      if (id != -1)
+         return(id);
+   };
+
+   return(-1);
+}
+
+
+/* end of source */
@@ -0,0 +1,127 @@
+#!/bin/sh
+#
+#   Secure Core Utilities
+#   Copyright (C) 2015, 2017 David M. Syzdek <david@syzdek.net>.
+#
+#   @SYZDEK_BSD_LICENSE_START@
+#
+#   Redistribution and use in source and binary forms, with or without
+#   modification, are permitted provided that the following conditions are
+#   met:
+#
+#      * Redistributions of source code must retain the above copyright
+#        notice, this list of conditions and the following disclaimer.
+#      * Redistributions in binary form must reproduce the above copyright
+#        notice, this list of conditions and the following disclaimer in the
+#        documentation and/or other materials provided with the distribution.
+#      * Neither the name of David M. Syzdek nor the
+#        names of its contributors may be used to endorse or promote products
+#        derived from this software without specific prior written permission.
+#
+#   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+#   IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+#   THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+#   PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL DAVID M SYZDEK BE LIABLE FOR
+#   ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+#   DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+#   SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+#   CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+#   LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+#   OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+#   SUCH DAMAGE.
+#
+#   @SYZDEK_BSD_LICENSE_END@
+#   bench/bench-startup.sh - measures exec-to-exit latency of widgets
+#
+#   Environment:
+#      SCU            path to securecoreutils binary   [src/securecoreutils]
+#      BENCH_BINDIR   directory containing bench-run   [bench]
+#      BENCH_DIR      absolute directory for scratch files [$PWD/bench-data]
+#      BENCH_RUNS     executions per widget            [500]
+#      BENCH_STARTUP_BUILDS  additional builds to compare, as space
+#                     separated label=path pairs       [none]
+#
+#   Writes one JSON object per line to standard out.
+#
+
+SCU=${SCU:-src/securecoreutils}
+BENCH_BINDIR=${BENCH_BINDIR:-bench}
+BENCH_DIR=${BENCH_DIR:-`pwd`/bench-data}
+BENCH_RUNS=${BENCH_RUNS:-500}
+BENCH_STARTUP_BUILDS=${BENCH_STARTUP_BUILDS:-""}
+
+
+bench_die()
+{
+   echo "bench-startup: $*" 1>&2
+   exit 1
+}
+
+
+# runs widget BENCH_RUNS times and prints wall time of each run
+bench_runs()
+{
+   BINARY="$1"
+   WIDGET="$2"
+   FILE="${BENCH_DIR}/startup.txt"
+   I=0
+   while test $I -lt ${BENCH_RUNS};do
+      # rm needs a file to remove, touch and cat an existing one
+      echo "startup" > "${FILE}" || return 1
+      RESULT=`"${BENCH_BINDIR}/bench-run" -o /dev/null "${BINARY}" "${WIDGET}" "${FILE}"` || return 1
+      echo "${RESULT}" | sed -e 's/^"wall_ns":\([0-9]*\),.*$/\1/g'
+      I=`expr $I + 1`
+   done
+   rm -f "${FILE}"
+}
+
+
+# summarizes wall times of runs
+bench_report()
+{
+   sort -n | ${AWK:-awk} -v prefix="$1" '
+   { ns[NR] = $1; sum += $1; }
+   END {
+      printf("{%s,\"runs\":%i,\"min_us\":%.1f,", prefix, NR, ns[1] / 1000);
+      printf("\"median_us\":%.1f,\"p90_us\":%.1f,", ns[int((NR + 1) / 2)] / 1000, ns[int(NR * 0.9)] / 1000);
+      printf("\"mean_us\":%.1f}\n", (sum / NR) / 1000);
+   }'
+}
+
+
+# prints shared objects loaded at exec
+bench_libs()
+{
+   if command -v ldd > /dev/null 2>&1;then
+      ldd "$1" 2> /dev/null | grep -c '=>'
+   else
+      echo "null"
+   fi
+}
+
+
+test -x "${SCU}"                    || bench_die "missing ${SCU}"
+test -x "${BENCH_BINDIR}/bench-run" || bench_die "missing ${BENCH_BINDIR}/bench-run"
+case "${BENCH_DIR}" in
+   /*) ;;
+   *) bench_die "BENCH_DIR must be an absolute path";;
+esac
+mkdir -p "${BENCH_DIR}" || bench_die "unable to create ${BENCH_DIR}"
+"${SCU}" pathcheck -d "${BENCH_DIR}" || bench_die "BENCH_DIR must pass pathcheck (no symlinks or hidden directories)"
+
+
+for BUILD in "current=${SCU}" ${BENCH_STARTUP_BUILDS};do
+   LABEL=`echo "${BUILD}" | sed -e 's/=.*$//g'`
+   BINARY=`echo "${BUILD}" | sed -e 's/^[^=]*=//g'`
+   test -x "${BINARY}" || bench_die "missing ${BINARY}"
+   LIBS=`bench_libs "${BINARY}"`
+   for WIDGET in cat rm touch;do
+      bench_runs "${BINARY}" "${WIDGET}" > "${BENCH_DIR}/startup.ns" \
+         || bench_die "${WIDGET} failed with ${BINARY}"
+      bench_report "\"widget\":\"${WIDGET}\",\"build\":\"${LABEL}\",\"shared_objects\":${LIBS}" \
+         < "${BENCH_DIR}/startup.ns"
+   done
+   rm -f "${BENCH_DIR}/startup.ns"
+done
+
+# end of script
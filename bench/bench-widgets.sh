@@ -0,0 +1,198 @@
+#!/bin/sh
+#
+#   Secure Core Utilities
+#   Copyright (C) 2015, 2017 David M. Syzdek <david@syzdek.net>.
+#
+#   @SYZDEK_BSD_LICENSE_START@
+#
+#   Redistribution and use in source and binary forms, with or without
+#   modification, are permitted provided that the following conditions are
+#   met:
+#
+#      * Redistributions of source code must retain the above copyright
+#        notice, this list of conditions and the following disclaimer.
+#      * Redistributions in binary form must reproduce the above copyright
+#        notice, this list of conditions and the following disclaimer in the
+#        documentation and/or other materials provided with the distribution.
+#      * Neither the name of David M. Syzdek nor the
+#        names of its contributors may be used to endorse or promote products
+#        derived from this software without specific prior written permission.
+#
+#   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+#   IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+#   THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+#   PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL DAVID M SYZDEK BE LIABLE FOR
+#   ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+#   DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+#   SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+#   CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+#   LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+#   OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+#   SUCH DAMAGE.
+#
+#   @SYZDEK_BSD_LICENSE_END@
+#
+#   bench/bench-widgets.sh - measures cat, tail, pathcheck and startup
+#
+#   Environment:
+#      SCU            path to securecoreutils binary   [src/securecoreutils]
+#      BENCH_BINDIR   directory containing bench-corpus, bench-follow and
+#                     bench-run                        [bench]
+#      BENCH_DIR      absolute directory for generated logs [$PWD/bench-data]
+#      BENCH_COMMIT   label of the build recorded in every result
+#                     [git describe of current directory]
+#      BENCH_SIZES    sizes of generated logs          [1M 64M 1G]
+#      BENCH_LINES    line counts requested from tail -n [10 1000 100000]
+#      BENCH_DEPTHS   directory depths of checked paths [1 4 16 64]
+#      BENCH_REPEAT   runs per measurement             [3]
+#      BENCH_RUNS     runs per pathcheck and startup measurement [200]
+#      BENCH_FOLLOW_SAMPLES  appends timed through tail -f [100]
+#
+#   Writes one JSON object per line to standard out, every object starts
+#   with the "bench" and "commit" keys and keys are never renamed.
+#
+
+SCU=${SCU:-src/securecoreutils}
+BENCH_BINDIR=${BENCH_BINDIR:-bench}
+BENCH_DIR=${BENCH_DIR:-`pwd`/bench-data}
+BENCH_COMMIT=${BENCH_COMMIT:-`git describe --always --dirty 2> /dev/null || echo unknown`}
+BENCH_SIZES=${BENCH_SIZES:-"1M 64M 1G"}
+BENCH_LINES=${BENCH_LINES:-"10 1000 100000"}
+BENCH_DEPTHS=${BENCH_DEPTHS:-"1 4 16 64"}
+BENCH_REPEAT=${BENCH_REPEAT:-3}
+BENCH_RUNS=${BENCH_RUNS:-200}
+BENCH_FOLLOW_SAMPLES=${BENCH_FOLLOW_SAMPLES:-100}
+BENCH_SCRIPTDIR=`dirname "$0"`
+
+
+bench_die()
+{
+   echo "bench-widgets: $*" 1>&2
+   exit 1
+}
+
+
+# runs command BENCH_REPEAT times and prints fastest run
+bench_measure()
+{
+   BEST=""
+   BEST_NS=""
+   I=0
+   while test $I -lt ${BENCH_REPEAT};do
+      RESULT=`"${BENCH_BINDIR}/bench-run" -o /dev/null "$@"` || return 1
+      NS=`echo "${RESULT}" | sed -e 's/^"wall_ns":\([0-9]*\),.*$/\1/g'`
+      if test "x${BEST_NS}" = "x" || test ${NS} -lt ${BEST_NS};then
+         BEST="${RESULT}"
+         BEST_NS=${NS}
+      fi
+      I=`expr $I + 1`
+   done
+   echo "${BEST}"
+}
+
+
+# prints raw measurement, with throughput when bytes were all copied
+bench_report()
+{
+   echo "$1" | ${AWK:-awk} -v prefix="$2" -v bytes="$3" -v copied="$4" '
+   {
+      n = split($0, kv, ",");
+      for (i = 1; i <= n; i++)
+      {
+         split(kv[i], pair, ":");
+         gsub(/"/, "", pair[1]);
+         v[pair[1]] = pair[2];
+      };
+      mbs = (v["wall_ns"] > 0) ? (bytes / 1048576) / (v["wall_ns"] / 1e9) : 0;
+      ins = (v["instructions"] >= 0) ? v["instructions"] : "null";
+      sys = (v["syscalls"] >= 0) ? v["syscalls"] : "null";
+      printf("{%s,\"bytes\":%s,\"wall_ns\":%s,\"user_us\":%s,\"sys_us\":%s,", prefix, bytes, v["wall_ns"], v["user_us"], v["sys_us"]);
+      if (copied == "yes")
+         printf("\"mb_per_s\":%.2f,", mbs);
+      printf("\"instructions\":%s,\"syscalls\":%s,\"maxrss_kb\":%s}\n", ins, sys, v["maxrss_kb"]);
+   }'
+}
+
+
+# prints microseconds of path check and open reported by --stats
+bench_pathcheck()
+{
+   FILE="$1"
+   I=0
+   while test $I -lt ${BENCH_RUNS};do
+      "${BENCH_BINDIR}/bench-run" -o /dev/null "${SCU}" --stats pathcheck "${FILE}" 2>&1 > /dev/null \
+         | sed -n -e 's/^.* stats: wall \([0-9.]*\) ms; pathcheck \([0-9.]*\) ms, open \([0-9.]*\) ms,.*$/\1 \2 \3/p'
+      I=`expr $I + 1`
+   done
+}
+
+
+test -x "${SCU}"                       || bench_die "missing ${SCU}"
+test -x "${BENCH_BINDIR}/bench-corpus" || bench_die "missing ${BENCH_BINDIR}/bench-corpus"
+test -x "${BENCH_BINDIR}/bench-follow" || bench_die "missing ${BENCH_BINDIR}/bench-follow"
+test -x "${BENCH_BINDIR}/bench-run"    || bench_die "missing ${BENCH_BINDIR}/bench-run"
+case "${BENCH_DIR}" in
+   /*) ;;
+   *) bench_die "BENCH_DIR must be an absolute path";;
+esac
+mkdir -p "${BENCH_DIR}" || bench_die "unable to create ${BENCH_DIR}"
+"${SCU}" pathcheck -d "${BENCH_DIR}" || bench_die "BENCH_DIR must pass pathcheck (no symlinks or hidden directories)"
+PREFIX="\"commit\":\"${BENCH_COMMIT}\""
+
+
+# cat throughput and tail -n latency against size of log
+for SIZE in ${BENCH_SIZES};do
+   CORPUS="${BENCH_DIR}/syslog-${SIZE}.log"
+   if test ! -f "${CORPUS}";then
+      "${BENCH_BINDIR}/bench-corpus" -s syslog "${SIZE}" > "${CORPUS}" \
+         || bench_die "unable to generate ${CORPUS}"
+   fi
+   BYTES=`wc -c < "${CORPUS}" | tr -d ' '`
+
+   RESULT=`bench_measure "${SCU}" cat "${CORPUS}"` || bench_die "cat failed on ${CORPUS}"
+   bench_report "${RESULT}" "\"bench\":\"cat\",${PREFIX},\"size\":\"${SIZE}\"" ${BYTES} yes
+
+   for LINES in ${BENCH_LINES};do
+      RESULT=`bench_measure "${SCU}" tail -n "${LINES}" "${CORPUS}"` || bench_die "tail failed on ${CORPUS}"
+      bench_report "${RESULT}" "\"bench\":\"tail-n\",${PREFIX},\"size\":\"${SIZE}\",\"lines\":${LINES}" ${BYTES} no
+   done
+done
+
+
+# tail -f latency from append to output, and wakeups while idle
+FOLLOW="${BENCH_DIR}/follow.log"
+: > "${FOLLOW}" || bench_die "unable to create ${FOLLOW}"
+RESULT=`"${BENCH_BINDIR}/bench-follow" -n "${BENCH_FOLLOW_SAMPLES}" "${FOLLOW}" "${SCU}" tail -f "${FOLLOW}"` \
+   || bench_die "tail -f failed on ${FOLLOW}"
+echo "{\"bench\":\"tail-f\",${PREFIX},${RESULT}}"
+rm -f "${FOLLOW}"
+
+
+# path check cost against depth of path
+for DEPTH in ${BENCH_DEPTHS};do
+   DIR="${BENCH_DIR}/depth-${DEPTH}"
+   I=1
+   while test $I -lt ${DEPTH};do
+      DIR="${DIR}/d"
+      I=`expr $I + 1`
+   done
+   mkdir -p "${DIR}" && : > "${DIR}/file" || bench_die "unable to create ${DIR}/file"
+   bench_pathcheck "${DIR}/file" > "${BENCH_DIR}/pathcheck.ms"
+   test -s "${BENCH_DIR}/pathcheck.ms" || bench_die "pathcheck failed on ${DIR}/file"
+   sort -n -k 2 < "${BENCH_DIR}/pathcheck.ms" | ${AWK:-awk} -v prefix="\"bench\":\"pathcheck\",${PREFIX},\"depth\":${DEPTH}" '
+   { wall[NR] = $1; check[NR] = $2; open[NR] = $3; }
+   END {
+      printf("{%s,\"runs\":%i,\"min_us\":%.1f,", prefix, NR, check[1] * 1000);
+      printf("\"median_us\":%.1f,\"p90_us\":%.1f,", check[int((NR + 1) / 2)] * 1000, check[int(NR * 0.9)] * 1000);
+      printf("\"open_median_us\":%.1f,\"wall_median_us\":%.1f}\n", open[int((NR + 1) / 2)] * 1000, wall[int((NR + 1) / 2)] * 1000);
+   }'
+   rm -f "${BENCH_DIR}/pathcheck.ms"
+done
+
+
+# exec-to-exit latency
+SCU="${SCU}" BENCH_BINDIR="${BENCH_BINDIR}" BENCH_DIR="${BENCH_DIR}" BENCH_RUNS="${BENCH_RUNS}" \
+   ${SHELL:-/bin/sh} "${BENCH_SCRIPTDIR}/bench-startup.sh" \
+   | sed -e "s/^{/{\"bench\":\"startup\",${PREFIX},/g"
+
+# end of script
@@ -0,0 +1,165 @@
+/*
+ *  Secure Core Utilities
+ *  Copyright (C) 2015, 2017 David M. Syzdek <david@syzdek.net>.
+ *
+ *  @SYZDEK_BSD_LICENSE_START@
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of David M. Syzdek nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ *  IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ *  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL DAVID M SYZDEK BE LIABLE FOR
+ *  ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ *  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ *  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ *  OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ *  SUCH DAMAGE.
+ *
+ *  @SYZDEK_BSD_LICENSE_END@
+ */
+/**
+ *  @file libsecurecoreutils.h
+ *  Public interface for validated reads of plain and compressed files
+ *
+ *  Functions return 0 or one of the SCU_LIB_E* codes, SCU_LIB_ERRNO means
+ *  errno holds the cause.  The library validates paths exactly as the
+ *  securecoreutils widgets do, including the path policy configured when
+ *  it was built.  Once scu_lib_init() has returned, handles may be used
+ *  from several threads as long as each handle is used by one thread at a
+ *  time.
+ */
+#ifndef __LIBSECURECOREUTILS_H
+#define __LIBSECURECOREUTILS_H 1
+
+
+///////////////
+//           //
+//  Headers  //
+//           //
+///////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Headers
+#endif
+
+#include <stddef.h>
+#include <inttypes.h>
+#include <sys/types.h>
+
+
+///////////////////
+//               //
+//  Definitions  //
+//               //
+///////////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Definitions
+#endif
+
+#define SCU_LIB_API_VERSION   1     // raised only for incompatible changes
+
+#define SCU_LIB_ESUCCESS      0
+#define SCU_LIB_ERRNO         1     // see errno
+#define SCU_LIB_EPATH         2     // path contains illegal pattern
+#define SCU_LIB_EFILE         3     // not a regular file
+#define SCU_LIB_EANCHOR       4     // not an absolute path
+#define SCU_LIB_EDIR          5     // not a directory
+#define SCU_LIB_ECODEC        6     // unable to determine compression algorithm
+#define SCU_LIB_ECORRUPT      7     // compressed file is corrupt or truncated
+#define SCU_LIB_EPOLICY       8     // path not permitted by policy
+#define SCU_LIB_EPOLFILE      9     // policy file is invalid or insecure
+#define SCU_LIB_ELIBRARY      10    // compression library is not available
+
+#define SCU_LIB_TAIL_BYTES    0x02  // count bytes instead of lines
+#define SCU_LIB_TAIL_START    0x01  // count from beginning of file instead of end
+
+#define SCU_LIB_RANGE_EOF     UINT64_MAX
+
+
+//////////////////
+//              //
+//  Data Types  //
+//              //
+//////////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Data Types
+#endif
+
+typedef struct scu_lib_file scu_lib_file;
+
+/// receives decoded data, returns 0 to continue or -1 with errno set to stop
+typedef int (*scu_lib_output)(void * ctx, const char * buff, size_t len);
+
+
+//////////////////
+//              //
+//  Prototypes  //
+//              //
+//////////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Prototypes
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// returns SCU_LIB_API_VERSION of the library in use
+int scu_lib_api_version(void);
+
+/// closes file and releases decoder state
+void scu_lib_close(scu_lib_file * fp);
+
+/// returns name of codec detected when file was opened ("raw" if plain)
+const char * scu_lib_codec(scu_lib_file * fp);
+
+/// loads path policy rules of widget (NULL for "cat") for the calling
+/// user, done implicitly by the first call needing it
+int scu_lib_init(const char * widget);
+
+/// validates path, opens file, and detects codec from magic number
+int scu_lib_open(scu_lib_file ** fpp, const char * path);
+
+/// validates path without opening it
+int scu_lib_pathcheck(const char * path);
+
+/// passes up to len decoded bytes starting at offset to out, len may be
+/// SCU_LIB_RANGE_EOF
+int scu_lib_range(scu_lib_file * fp, uint64_t offset, uint64_t len, scu_lib_output out, void * ctx);
+
+/// reads decoded data into buffer, returns bytes read, 0 at end of file, or
+/// -1 after storing an error code in errp (if not NULL)
+ssize_t scu_lib_read(scu_lib_file * fp, void * buff, size_t size, int * errp);
+
+/// passes remaining decoded data to out
+int scu_lib_stream(scu_lib_file * fp, scu_lib_output out, void * ctx);
+
+/// returns description of error code, SCU_LIB_ERRNO is described from errno
+const char * scu_lib_strerror(int err);
+
+/// passes last count lines (or bytes with SCU_LIB_TAIL_BYTES) of file to
+/// out, or everything after the first count with SCU_LIB_TAIL_START
+int scu_lib_tail(scu_lib_file * fp, int flags, uint64_t count, scu_lib_output out, void * ctx);
+
+/// returns package version string
+const char * scu_lib_version(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif /* end of header */
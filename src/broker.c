@@ -0,0 +1,532 @@
+/*
+ *  Secure Core Utilities
+ *  Copyright (C) 2015, 2017 David M. Syzdek <david@syzdek.net>.
+ *
+ *  @SYZDEK_BSD_LICENSE_START@
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of David M. Syzdek nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ *  IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ *  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL DAVID M SYZDEK BE LIABLE FOR
+ *  ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ *  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ *  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ *  OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ *  SUCH DAMAGE.
+ *
+ *  @SYZDEK_BSD_LICENSE_END@
+ */
+#include "broker.h"
+
+///////////////
+//           //
+//  Headers  //
+//           //
+///////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Headers
+#endif
+
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <poll.h>
+#include <pwd.h>
+#include <grp.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include "input.h"
+#include "policy.h"
+
+
+//////////////////
+//              //
+//  Prototypes  //
+//              //
+//////////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Prototypes
+#endif
+
+static int scu_broker_address(struct sockaddr_un * sa, const char * sockpath);
+static int scu_broker_allowed(const struct ucred * cred, gid_t gid);
+static int scu_broker_bind(scu_config * cnf, int sd, gid_t gid);
+static int scu_broker_decode(const struct stat * sb);
+static void scu_broker_serve(int sd, uid_t uid);
+
+
+/////////////////
+//             //
+//  Functions  //
+//             //
+/////////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Functions
+#endif
+
+static int scu_broker_address(struct sockaddr_un * sa, const char * sockpath)
+{
+   memset(sa, 0, sizeof(struct sockaddr_un));
+   sa->sun_family = AF_UNIX;
+   if (strlen(sockpath) >= sizeof(sa->sun_path))
+   {
+      errno = ENAMETOOLONG;
+      return(-1);
+   };
+   strncpy(sa->sun_path, sockpath, sizeof(sa->sun_path) - 1);
+   return(0);
+}
+
+
+/// accepts root and members of the broker group, kernel supplied credentials
+/// cannot be forged by the client
+static int scu_broker_allowed(const struct ucred * cred, gid_t gid)
+{
+   int                  x;
+   int                  ngids;
+   gid_t                gids[256];
+   struct passwd      * pw;
+
+   if (cred->uid == 0)
+      return(1);
+   if (gid == (gid_t)-1)
+      return(0);
+   if (cred->gid == gid)
+      return(1);
+   if ((pw = getpwuid(cred->uid)) == NULL)
+      return(0);
+   ngids = (int)(sizeof(gids) / sizeof(gid_t));
+   if (getgrouplist(pw->pw_name, pw->pw_gid, gids, &ngids) == -1)
+      return(0);
+   for(x = 0; (x < ngids); x++)
+      if (gids[x] == gid)
+         return(1);
+   return(0);
+}
+
+
+/// binds listener to SCU_BROKER_SOCKET, which must be within a directory
+/// only root can modify so the name cannot be swapped between the checks
+static int scu_broker_bind(scu_config * cnf, int sd, gid_t gid)
+{
+   int                  rc;
+   int                  dfd;
+   char                 dir[sizeof(SCU_BROKER_SOCKET)];
+   const char         * path;
+   const char         * name;
+   mode_t               mask;
+   struct stat          sb;
+   struct sockaddr_un   sa;
+
+   path = SCU_BROKER_SOCKET;
+   if ( (scu_broker_address(&sa, path) == -1) ||
+        ((name = strrchr(path, '/')) == NULL) ||
+        (name == path) )
+   {
+      fprintf(stderr, "%s: %s: %s: invalid socket path\n", PROGRAM_NAME, cnf->widget->name, path);
+      return(-1);
+   };
+   memcpy(dir, path, (size_t)(name - path));
+   dir[name - path] = '\0';
+   name = &name[1];
+
+   if ((dfd = open(dir, O_PATH|O_DIRECTORY|O_NOFOLLOW|O_CLOEXEC)) == -1)
+   {
+      fprintf(stderr, "%s: %s: %s: %s\n", PROGRAM_NAME, cnf->widget->name, dir, strerror(errno));
+      return(-1);
+   };
+   if ( (fstat(dfd, &sb) == -1) || (sb.st_uid != 0) || ((sb.st_mode & (S_IWGRP|S_IWOTH)) != 0) )
+   {
+      fprintf(stderr, "%s: %s: %s: directory must be owned and writable only by root\n", PROGRAM_NAME, cnf->widget->name, dir);
+      close(dfd);
+      return(-1);
+   };
+
+   // only a stale socket of a previous broker is replaced
+   if (fstatat(dfd, name, &sb, AT_SYMLINK_NOFOLLOW) == 0)
+   {
+      if ( (!(S_ISSOCK(sb.st_mode))) || (sb.st_uid != 0) || (unlinkat(dfd, name, 0) == -1) )
+      {
+         fprintf(stderr, "%s: %s: %s: refusing to replace existing file\n", PROGRAM_NAME, cnf->widget->name, SCU_BROKER_SOCKET);
+         close(dfd);
+         return(-1);
+      };
+   };
+
+   // socket is created with its final mode and is never reachable with
+   // looser permissions, the group is set without following symlinks
+   mask = umask((gid == (gid_t)-1) ? 0177 : 0117);
+   rc   = bind(sd, (struct sockaddr *)&sa, sizeof(sa));
+   umask(mask);
+   if ( (rc == -1) ||
+        ( (gid != (gid_t)-1) && (fchownat(dfd, name, 0, gid, AT_SYMLINK_NOFOLLOW) == -1) ) )
+   {
+      fprintf(stderr, "%s: %s: %s: %s\n", PROGRAM_NAME, cnf->widget->name, SCU_BROKER_SOCKET, strerror(errno));
+      close(dfd);
+      return(-1);
+   };
+   close(dfd);
+
+   return(0);
+}
+
+
+/// decodes the verified file on standard in to standard out in a child
+/// of the broker, the path is never opened again
+static int scu_broker_decode(const struct stat * sb)
+{
+   char                 buff[SCU_BUFF_MAX];
+   ssize_t              len;
+   ssize_t              rc;
+   ssize_t              off;
+   scu_input          * inp;
+
+   if (scu_input_fdopen(&inp, STDIN_FILENO, sb) != 0)
+      return(1);
+
+   while ((len = scu_input_read(inp, buff, sizeof(buff))) > 0)
+   {
+      for(off = 0; (off < len); off += rc)
+      {
+         if ((rc = write(STDOUT_FILENO, &buff[off], (size_t)(len - off))) == -1)
+         {
+            scu_input_close(inp);
+            return(1);
+         };
+      };
+   };
+   scu_input_close(inp);
+
+   return((len == -1) ? 1 : 0);
+}
+
+
+int scu_broker_listen(scu_config * cnf, gid_t gid)
+{
+   int                  rc;
+   int                  sd;
+   int                  fd;
+   nfds_t               nfds;
+   nfds_t               x;
+   socklen_t            len;
+   struct ucred         cred;
+   struct pollfd        pfds[SCU_BROKER_CLIENTS + 1];
+   uid_t                uids[SCU_BROKER_CLIENTS + 1];
+
+   assert(cnf != NULL);
+
+   if (geteuid() != 0)
+   {
+      fprintf(stderr, "%s: %s: broker must run as root\n", PROGRAM_NAME, cnf->widget->name);
+      return(1);
+   };
+
+   // requests are checked against rules of the requesting user
+   if ((rc = scu_policy_preload("cat")) != 0)
+   {
+      fprintf(stderr, "%s: %s: %s\n", PROGRAM_NAME, cnf->widget->name, scu_strerror(rc));
+      return(1);
+   };
+   if (!(scu_policy_loaded()))
+   {
+      fprintf(stderr, "%s: %s: refusing to serve requests without a path policy\n", PROGRAM_NAME, cnf->widget->name);
+      return(1);
+   };
+
+   // decoders are reaped by the kernel and closed clients are not fatal
+   signal(SIGCHLD, SIG_IGN);
+   signal(SIGPIPE, SIG_IGN);
+
+   if ((sd = socket(AF_UNIX, SOCK_SEQPACKET|SOCK_CLOEXEC, 0)) == -1)
+   {
+      fprintf(stderr, "%s: %s: socket: %s\n", PROGRAM_NAME, cnf->widget->name, strerror(errno));
+      return(1);
+   };
+   if (scu_broker_bind(cnf, sd, gid) == -1)
+   {
+      close(sd);
+      return(1);
+   };
+   if (listen(sd, SOMAXCONN) == -1)
+   {
+      fprintf(stderr, "%s: %s: %s: %s\n", PROGRAM_NAME, cnf->widget->name, SCU_BROKER_SOCKET, strerror(errno));
+      close(sd);
+      return(1);
+   };
+   if ((cnf->verbose))
+      printf("%s: %s: listening on %s\n", PROGRAM_NAME, cnf->widget->name, SCU_BROKER_SOCKET);
+   fflush(stdout);
+
+   pfds[0].fd     = sd;
+   pfds[0].events = POLLIN;
+   nfds           = 1;
+   while(1)
+   {
+      if (poll(pfds, nfds, -1) == -1)
+      {
+         if (errno == EINTR)
+            continue;
+         fprintf(stderr, "%s: %s: poll: %s\n", PROGRAM_NAME, cnf->widget->name, strerror(errno));
+         break;
+      };
+
+      // clients are authenticated once, when they connect
+      if ((pfds[0].revents & POLLIN) != 0)
+      {
+         len = sizeof(cred);
+         if ((fd = accept4(sd, NULL, NULL, SOCK_NONBLOCK|SOCK_CLOEXEC)) == -1)
+            continue;
+         if ( (nfds > SCU_BROKER_CLIENTS) ||
+              (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) == -1) ||
+              (!(scu_broker_allowed(&cred, gid))) )
+         {
+            close(fd);
+            continue;
+         };
+         pfds[nfds].fd      = fd;
+         pfds[nfds].events  = POLLIN;
+         pfds[nfds].revents = 0;
+         uids[nfds]         = cred.uid;
+         nfds++;
+      };
+
+      for(x = 1; (x < nfds); x++)
+      {
+         if (pfds[x].revents == 0)
+            continue;
+         if ((pfds[x].revents & POLLIN) != 0)
+            scu_broker_serve(pfds[x].fd, uids[x]);
+         if ((pfds[x].revents & (POLLHUP|POLLERR|POLLNVAL)) != 0)
+         {
+            close(pfds[x].fd);
+            pfds[x] = pfds[nfds - 1];
+            uids[x] = uids[nfds - 1];
+            pfds[x].revents = 0;
+            nfds--;
+            x--;
+         };
+      };
+   };
+
+   for(x = 0; (x < nfds); x++)
+      close(pfds[x].fd);
+
+   return(1);
+}
+
+
+int scu_broker_open(const char * sockpath, uint32_t op, const char * path, int * fdp)
+{
+   int                  sd;
+   size_t               len;
+   ssize_t              rc;
+   struct iovec         iov;
+   struct msghdr        msg;
+   struct cmsghdr     * cmsg;
+   struct sockaddr_un   sa;
+   scu_broker_reply     rep;
+   scu_broker_request   req;
+   union
+   {
+      char              buff[CMSG_SPACE(sizeof(int))];
+      struct cmsghdr    align;
+   } ctl;
+
+   assert(sockpath != NULL);
+   assert(path     != NULL);
+   assert(fdp      != NULL);
+
+   *fdp = -1;
+   if ((len = strlen(path)) >= sizeof(req.path))
+   {
+      errno = ENAMETOOLONG;
+      return(SCU_ERRNO);
+   };
+   if (scu_broker_address(&sa, sockpath) == -1)
+      return(SCU_ERRNO);
+   if ((sd = socket(AF_UNIX, SOCK_SEQPACKET|SOCK_CLOEXEC, 0)) == -1)
+      return(SCU_ERRNO);
+   if (connect(sd, (struct sockaddr *)&sa, sizeof(sa)) == -1)
+   {
+      close(sd);
+      return(SCU_ERRNO);
+   };
+
+   req.magic = SCU_BROKER_MAGIC;
+   req.op    = op;
+   memcpy(req.path, path, len + 1);
+   if (send(sd, &req, offsetof(scu_broker_request, path) + len + 1, 0) == -1)
+   {
+      close(sd);
+      return(SCU_ERRNO);
+   };
+
+   memset(&msg, 0, sizeof(msg));
+   iov.iov_base       = &rep;
+   iov.iov_len        = sizeof(rep);
+   msg.msg_iov        = &iov;
+   msg.msg_iovlen     = 1;
+   msg.msg_control    = ctl.buff;
+   msg.msg_controllen = sizeof(ctl.buff);
+   rc = recvmsg(sd, &msg, MSG_CMSG_CLOEXEC);
+   close(sd);
+   if (rc == -1)
+      return(SCU_ERRNO);
+   if ( (rc != (ssize_t)sizeof(rep)) || (rep.magic != SCU_BROKER_MAGIC) )
+   {
+      errno = EPROTO;
+      return(SCU_ERRNO);
+   };
+
+   for(cmsg = CMSG_FIRSTHDR(&msg); (cmsg != NULL); cmsg = CMSG_NXTHDR(&msg, cmsg))
+      if ( (cmsg->cmsg_level == SOL_SOCKET) && (cmsg->cmsg_type == SCM_RIGHTS) )
+         memcpy(fdp, CMSG_DATA(cmsg), sizeof(int));
+   if (rep.status != 0)
+   {
+      if (*fdp != -1)
+         close(*fdp);
+      *fdp  = -1;
+      errno = rep.err;
+      return(rep.status);
+   };
+   if (*fdp == -1)
+   {
+      errno = EPROTO;
+      return(SCU_ERRNO);
+   };
+
+   return(0);
+}
+
+
+/// validates one request with the rules of the client and replies with a
+/// descriptor, data itself never passes through the broker
+static void scu_broker_serve(int sd, uid_t uid)
+{
+   int                  fd;
+   int                  pipefd[2];
+   ssize_t              len;
+   pid_t                pid;
+   struct iovec         iov;
+   struct msghdr        msg;
+   struct cmsghdr     * cmsg;
+   scu_path             p;
+   scu_broker_reply     rep;
+   scu_broker_request   req;
+   union
+   {
+      char              buff[CMSG_SPACE(sizeof(int))];
+      struct cmsghdr    align;
+   } ctl;
+
+   if ((len = recv(sd, &req, sizeof(req), 0)) < (ssize_t)offsetof(scu_broker_request, path))
+      return;
+
+   fd          = -1;
+   rep.magic   = SCU_BROKER_MAGIC;
+   rep.status  = 0;
+   rep.err     = 0;
+   if ( (req.magic != SCU_BROKER_MAGIC) || (len == (ssize_t)offsetof(scu_broker_request, path)) ||
+        (req.path[len - offsetof(scu_broker_request, path) - 1] != '\0') ||
+        ((req.op != SCU_BROKER_OPEN) && (req.op != SCU_BROKER_DECODE)) )
+   {
+      rep.status = SCU_ERRNO;
+      rep.err    = EPROTO;
+   }
+   else if ((rep.status = scu_policy_peer(uid)) == 0)
+   {
+      scu_policy_select((req.op == SCU_BROKER_OPEN) ? "cat" : "zcat");
+      rep.status = scu_pathopen(&p, req.path, 0, O_RDONLY);
+      rep.err    = errno;
+   };
+
+   // compressed files are decoded by a child writing into a pipe, the
+   // child keeps only the verified file and the pipe, and no descriptor
+   // of the listener or of other clients
+   if ( (rep.status == 0) && (req.op == SCU_BROKER_DECODE) )
+   {
+      if (pipe2(pipefd, O_CLOEXEC) == -1)
+      {
+         rep.status = SCU_ERRNO;
+         rep.err    = errno;
+      }
+      else if ((pid = fork()) == 0)
+      {
+         if ( (dup2(p.fd, STDIN_FILENO) == -1) || (dup2(pipefd[1], STDOUT_FILENO) == -1) )
+            _exit(1);
+#ifdef HAVE_CLOSE_RANGE
+         if (close_range(STDERR_FILENO + 1, ~0U, 0) == -1)
+            _exit(1);
+#else
+         for(fd = (int)sysconf(_SC_OPEN_MAX); (fd > STDERR_FILENO); fd--)
+            close(fd);
+#endif
+         _exit(scu_broker_decode(&p.sb));
+      }
+      else
+      {
+         close(pipefd[1]);
+         fd = pipefd[0];
+         if (pid == -1)
+         {
+            rep.status = SCU_ERRNO;
+            rep.err    = errno;
+            close(fd);
+            fd = -1;
+         };
+      };
+      scu_pathclose(&p);
+   }
+   else if (rep.status == 0)
+   {
+      fd   = p.fd;
+      p.fd = -1;
+      scu_pathclose(&p);
+   };
+
+   memset(&msg, 0, sizeof(msg));
+   iov.iov_base   = &rep;
+   iov.iov_len    = sizeof(rep);
+   msg.msg_iov    = &iov;
+   msg.msg_iovlen = 1;
+   if (fd != -1)
+   {
+      msg.msg_control    = ctl.buff;
+      msg.msg_controllen = sizeof(ctl.buff);
+      cmsg               = CMSG_FIRSTHDR(&msg);
+      cmsg->cmsg_level   = SOL_SOCKET;
+      cmsg->cmsg_type    = SCM_RIGHTS;
+      cmsg->cmsg_len     = CMSG_LEN(sizeof(int));
+      memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+   };
+   sendmsg(sd, &msg, MSG_NOSIGNAL|MSG_DONTWAIT);
+   if (fd != -1)
+      close(fd);
+
+   return;
+}
+
+/* end of source */
@@ -0,0 +1,122 @@
+/*
+ *  Secure Core Utilities
+ *  Copyright (C) 2015, 2017 David M. Syzdek <david@syzdek.net>.
+ *
+ *  @SYZDEK_BSD_LICENSE_START@
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of David M. Syzdek nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ *  IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ *  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL DAVID M SYZDEK BE LIABLE FOR
+ *  ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ *  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ *  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ *  OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ *  SUCH DAMAGE.
+ *
+ *  @SYZDEK_BSD_LICENSE_END@
+ */
+/**
+ *  @file broker.h
+ *  Hands validated read-only descriptors to unprivileged clients
+ */
+#ifndef __SRC_BROKER_H
+#define __SRC_BROKER_H 1
+
+
+///////////////
+//           //
+//  Headers  //
+//           //
+///////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Headers
+#endif
+
+#include "securecoreutils.h"
+
+#include <stddef.h>
+
+
+///////////////////
+//               //
+//  Definitions  //
+//               //
+///////////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Definitions
+#endif
+
+#ifndef SCU_BROKER_SOCKET
+#define SCU_BROKER_SOCKET  "/run/securecoreutils.sock"
+#endif
+#define SCU_BROKER_MAGIC   0x42554353  // "SCUB"
+#define SCU_BROKER_CLIENTS 256         // connections served at once
+
+#define SCU_BROKER_OPEN    1           // reply carries descriptor of file
+#define SCU_BROKER_DECODE  2           // reply carries pipe of decompressed file
+
+
+//////////////////
+//              //
+//  Data Types  //
+//              //
+//////////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Data Types
+#endif
+
+typedef struct scu_broker_reply   scu_broker_reply;
+typedef struct scu_broker_request scu_broker_request;
+
+
+struct scu_broker_reply
+{
+   uint32_t             magic;
+   int32_t              status;     // scu error code, 0 if a descriptor is attached
+   int32_t              err;        // errno of SCU_ERRNO
+};
+
+
+// path is sent without unused trailing bytes
+struct scu_broker_request
+{
+   uint32_t             magic;
+   uint32_t             op;
+   char                 path[PATH_MAX];
+};
+
+
+//////////////////
+//              //
+//  Prototypes  //
+//              //
+//////////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Prototypes
+#endif
+
+/// serves requests of root and members of gid (-1 for root only) on
+/// SCU_BROKER_SOCKET until killed, requires a loaded path policy
+int scu_broker_listen(scu_config * cnf, gid_t gid);
+
+/// asks broker for a descriptor of path, returns scu error code
+int scu_broker_open(const char * sockpath, uint32_t op, const char * path, int * fdp);
+
+
+#endif /* end of header */
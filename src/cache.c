@@ -0,0 +1,450 @@
+/*
+ *  Secure Core Utilities
+ *  Copyright (C) 2015, 2017 David M. Syzdek <david@syzdek.net>.
+ *
+ *  @SYZDEK_BSD_LICENSE_START@
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of David M. Syzdek nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ *  IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ *  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL DAVID M SYZDEK BE LIABLE FOR
+ *  ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ *  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ *  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ *  OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ *  SUCH DAMAGE.
+ *
+ *  @SYZDEK_BSD_LICENSE_END@
+ */
+#include "cache.h"
+
+///////////////
+//           //
+//  Headers  //
+//           //
+///////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Headers
+#endif
+
+#include <assert.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <time.h>
+
+
+//////////////////
+//              //
+//  Data Types  //
+//              //
+//////////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Data Types
+#endif
+
+typedef struct scu_cache_entry scu_cache_entry;
+typedef struct scu_cache_source scu_cache_source;
+
+
+/// identity of the archive an entry was decoded from, stored at the start
+/// of each entry and compared with the archive on every hit
+struct scu_cache_source
+{
+   uint64_t             dev;
+   uint64_t             ino;
+   uint64_t             size;
+   int64_t              mtime;
+   int64_t              mtime_nsec;
+   int64_t              ctime;
+   int64_t              ctime_nsec;
+};
+
+
+struct scu_cache
+{
+   int                  dfd;
+   int                  fd;
+   int                  srcfd;
+   int                  failed;
+   off_t                size;
+   scu_cache_source     src;
+   char                 key[192];
+   char                 tmpname[224];
+};
+
+
+struct scu_cache_entry
+{
+   time_t               mtime;
+   off_t                size;
+   char               * name;
+};
+
+
+//////////////////
+//              //
+//  Prototypes  //
+//              //
+//////////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Prototypes
+#endif
+
+static int scu_cache_compare(const void * a, const void * b);
+static int scu_cache_dir(void);
+static void scu_cache_evict(int dfd);
+static void scu_cache_key(scu_input * inp, char * key, size_t size);
+static int scu_cache_source_get(int fd, const struct stat * sb, scu_cache_source * src);
+
+
+/////////////////
+//             //
+//  Functions  //
+//             //
+/////////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Functions
+#endif
+
+void scu_cache_abort(scu_cache * cache)
+{
+   if (cache == NULL)
+      return;
+   close(cache->fd);
+   unlinkat(cache->dfd, cache->tmpname, 0);
+   close(cache->dfd);
+   free(cache);
+   return;
+}
+
+
+int scu_cache_commit(scu_cache * cache)
+{
+   scu_cache_source     src;
+
+   if (cache == NULL)
+      return(0);
+
+   // archive modified while it was decoded may not match the output
+   if (scu_cache_source_get(cache->srcfd, NULL, &src) == -1)
+      cache->failed = 1;
+   if (memcmp(&src, &cache->src, sizeof(src)) != 0)
+      cache->failed = 1;
+
+   if ((cache->failed))
+   {
+      scu_cache_abort(cache);
+      return(-1);
+   };
+   if (close(cache->fd) == -1)
+   {
+      cache->fd = -1;
+      scu_cache_abort(cache);
+      return(-1);
+   };
+   cache->fd = -1;
+
+   // rename is atomic, concurrent readers see either no entry or all of it
+   if (renameat(cache->dfd, cache->tmpname, cache->dfd, cache->key) == -1)
+   {
+      scu_cache_abort(cache);
+      return(-1);
+   };
+
+   scu_cache_evict(cache->dfd);
+
+   close(cache->dfd);
+   free(cache);
+
+   return(0);
+}
+
+
+static int scu_cache_compare(const void * a, const void * b)
+{
+   const scu_cache_entry * ea = a;
+   const scu_cache_entry * eb = b;
+   if (ea->mtime == eb->mtime)
+      return(0);
+   return((ea->mtime < eb->mtime) ? -1 : 1);
+}
+
+
+scu_cache * scu_cache_create(scu_input * inp)
+{
+   int            dfd;
+   scu_cache    * cache;
+
+   assert(inp != NULL);
+
+   if ((dfd = scu_cache_dir()) == -1)
+      return(NULL);
+
+   if ((cache = malloc(sizeof(scu_cache))) == NULL)
+   {
+      close(dfd);
+      return(NULL);
+   };
+   memset(cache, 0, sizeof(scu_cache));
+   cache->dfd   = dfd;
+   cache->srcfd = scu_input_fd(inp);
+   scu_cache_source_get(-1, scu_input_stat(inp), &cache->src);
+
+   scu_cache_key(inp, cache->key, sizeof(cache->key));
+   snprintf(cache->tmpname, sizeof(cache->tmpname), "tmp-%li-%s", (long)getpid(), cache->key);
+
+   if ((cache->fd = openat(dfd, cache->tmpname, O_WRONLY|O_CREAT|O_EXCL|O_NOFOLLOW|O_CLOEXEC, 0600)) == -1)
+   {
+      close(dfd);
+      free(cache);
+      return(NULL);
+   };
+   scu_cache_write(cache, &cache->src, sizeof(cache->src));
+
+   return(cache);
+}
+
+
+/// opens cache directory if configured and only writable by the current user
+static int scu_cache_dir(void)
+{
+#ifdef SCU_ZCAT_CACHE
+   int            dfd;
+   scu_path       p;
+
+   if (scu_pathopen(&p, SCU_ZCAT_CACHE, SCU_ODIR|SCU_ONOPOLICY, O_RDONLY|O_DIRECTORY) != 0)
+      return(-1);
+   if ( (p.sb.st_uid != geteuid()) ||
+        ((p.sb.st_mode & (S_IWGRP|S_IWOTH)) != 0) )
+   {
+      scu_pathclose(&p);
+      return(-1);
+   };
+   dfd  = p.fd;
+   p.fd = -1;
+   scu_pathclose(&p);
+
+   return(dfd);
+#else
+   return(-1);
+#endif
+}
+
+
+/// removes least recently used entries until cache fits SCU_ZCAT_CACHE_SIZE
+static void scu_cache_evict(int dfd)
+{
+   int                  fd;
+   size_t               count;
+   size_t               x;
+   off_t                total;
+   time_t               now;
+   DIR                * dp;
+   struct dirent      * de;
+   struct stat          sb;
+   scu_cache_entry    * entries;
+   scu_cache_entry    * ptr;
+
+   if ((fd = dup(dfd)) == -1)
+      return;
+   if ((dp = fdopendir(fd)) == NULL)
+   {
+      close(fd);
+      return;
+   };
+
+   now     = time(NULL);
+   total   = 0;
+   count   = 0;
+   entries = NULL;
+   while ((de = readdir(dp)) != NULL)
+   {
+      if (de->d_name[0] == '.')
+         continue;
+      if (fstatat(dfd, de->d_name, &sb, AT_SYMLINK_NOFOLLOW) == -1)
+         continue;
+      if (!(S_ISREG(sb.st_mode)))
+         continue;
+
+      // partial entries left by interrupted decodes
+      if (!(strncmp(de->d_name, "tmp-", 4)))
+      {
+         if ((now - sb.st_mtime) > 3600)
+            unlinkat(dfd, de->d_name, 0);
+         continue;
+      };
+
+      if ((ptr = realloc(entries, sizeof(scu_cache_entry) * (count+1))) == NULL)
+         break;
+      entries = ptr;
+      if ((entries[count].name = strdup(de->d_name)) == NULL)
+         break;
+      entries[count].mtime = sb.st_mtime;
+      entries[count].size  = sb.st_size;
+      total += sb.st_size;
+      count++;
+   };
+   closedir(dp);
+
+   if (total > (off_t)SCU_ZCAT_CACHE_SIZE)
+   {
+      qsort(entries, count, sizeof(scu_cache_entry), scu_cache_compare);
+      for(x = 0; ((x < count) && (total > (off_t)SCU_ZCAT_CACHE_SIZE)); x++)
+         if (unlinkat(dfd, entries[x].name, 0) == 0)
+            total -= entries[x].size;
+   };
+
+   for(x = 0; x < count; x++)
+      free(entries[x].name);
+   free(entries);
+
+   return;
+}
+
+
+int scu_cache_fetch(scu_input * inp)
+{
+   int                  dfd;
+   int                  fd;
+   char                 key[192];
+   struct stat          sb;
+   scu_cache_source     src;
+   scu_cache_source     cur;
+   scu_cache_source     ent;
+
+   assert(inp != NULL);
+
+   if ((dfd = scu_cache_dir()) == -1)
+      return(-1);
+
+   // archive must still be the file which was opened and validated
+   scu_cache_source_get(-1, scu_input_stat(inp), &src);
+   if ( (scu_cache_source_get(scu_input_fd(inp), NULL, &cur) == -1) ||
+        (memcmp(&src, &cur, sizeof(src)) != 0) )
+   {
+      close(dfd);
+      return(-1);
+   };
+
+   scu_cache_key(inp, key, sizeof(key));
+   fd = openat(dfd, key, O_RDONLY|O_NOFOLLOW|O_CLOEXEC);
+   close(dfd);
+   if (fd == -1)
+      return(-1);
+
+   if ( (fstat(fd, &sb) == -1) || (!(S_ISREG(sb.st_mode))) || (sb.st_uid != geteuid()) )
+   {
+      close(fd);
+      return(-1);
+   };
+
+   // key collisions and stale entries are refused by the stored identity,
+   // the descriptor is left positioned after it
+   if ( (read(fd, &ent, sizeof(ent)) != (ssize_t)sizeof(ent)) ||
+        (memcmp(&src, &ent, sizeof(src)) != 0) )
+   {
+      close(fd);
+      return(-1);
+   };
+
+   // entry modification time tracks last use for eviction
+   futimens(fd, NULL);
+
+   return(fd);
+}
+
+
+/// key is derived from the validated descriptor, not from the path name
+static void scu_cache_key(scu_input * inp, char * key, size_t size)
+{
+   scu_cache_source     src;
+
+   scu_cache_source_get(-1, scu_input_stat(inp), &src);
+
+   snprintf(key, size, "%" PRIx64 "-%" PRIx64 "-%" PRIx64 "-%" PRIx64 ".%" PRIx64 "-%" PRIx64 ".%" PRIx64 "-%s",
+      src.dev, src.ino, src.size, (uint64_t)src.mtime, (uint64_t)src.mtime_nsec,
+      (uint64_t)src.ctime, (uint64_t)src.ctime_nsec,
+      scu_input_codec_name(scu_input_codec(inp)));
+
+   return;
+}
+
+
+/// records identity of archive from sb, or from fd when sb is NULL
+static int scu_cache_source_get(int fd, const struct stat * sb, scu_cache_source * src)
+{
+   struct stat          st;
+
+   memset(src, 0, sizeof(scu_cache_source));
+   if (sb == NULL)
+   {
+      if (fstat(fd, &st) == -1)
+         return(-1);
+      sb = &st;
+   };
+
+   src->dev        = (uint64_t)sb->st_dev;
+   src->ino        = (uint64_t)sb->st_ino;
+   src->size       = (uint64_t)sb->st_size;
+   src->mtime      = (int64_t)sb->st_mtim.tv_sec;
+   src->mtime_nsec = (int64_t)sb->st_mtim.tv_nsec;
+   src->ctime      = (int64_t)sb->st_ctim.tv_sec;
+   src->ctime_nsec = (int64_t)sb->st_ctim.tv_nsec;
+
+   return(0);
+}
+
+
+void scu_cache_write(scu_cache * cache, const void * buff, size_t len)
+{
+   ssize_t              rc;
+   const char         * ptr;
+
+   if ( (cache == NULL) || ((cache->failed)) )
+      return;
+
+   // entries larger than the whole cache are not worth keeping
+   cache->size += (off_t)len;
+   if (cache->size > (off_t)SCU_ZCAT_CACHE_SIZE)
+   {
+      cache->failed = 1;
+      return;
+   };
+
+   for(ptr = buff; len > 0; ptr += rc, len -= (size_t)rc)
+   {
+      if ((rc = write(cache->fd, ptr, len)) == -1)
+      {
+         cache->failed = 1;
+         return;
+      };
+   };
+
+   return;
+}
+
+
+/* end of source */
@@ -0,0 +1,346 @@
+/*
+ *  Secure Core Utilities
+ *  Copyright (C) 2015, 2017 David M. Syzdek <david@syzdek.net>.
+ *
+ *  @SYZDEK_BSD_LICENSE_START@
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of David M. Syzdek nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ *  IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ *  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL DAVID M SYZDEK BE LIABLE FOR
+ *  ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ *  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ *  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ *  OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ *  SUCH DAMAGE.
+ *
+ *  @SYZDEK_BSD_LICENSE_END@
+ */
+#include "codec.h"
+
+///////////////
+//           //
+//  Headers  //
+//           //
+///////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Headers
+#endif
+
+#include <assert.h>
+#include <stddef.h>
+#include <pthread.h>
+#include <string.h>
+#ifdef SCU_CODEC_DLOPEN
+#include <dlfcn.h>
+#endif
+
+#include "input.h"
+
+
+//////////////////
+//              //
+//  Data Types  //
+//              //
+//////////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Data Types
+#endif
+
+#ifdef SCU_CODEC_DLOPEN
+typedef struct scu_codec_sym scu_codec_sym;
+typedef struct scu_codec_lib scu_codec_lib;
+
+
+struct scu_codec_sym
+{
+   const char         * name;
+   size_t               offset;     // offset of pointer within function table
+};
+
+
+struct scu_codec_lib
+{
+   const char * const * sonames;
+   const scu_codec_sym * syms;
+   void               * table;
+   void               * handle;
+   int                  state;      // 0 not tried, 1 loaded, -1 unavailable
+};
+#endif
+
+
+//////////////////
+//              //
+//  Prototypes  //
+//              //
+//////////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Prototypes
+#endif
+
+#ifdef SCU_CODEC_DLOPEN
+static int scu_codec_open(scu_codec_lib * lib);
+#endif
+
+
+/////////////////
+//             //
+//  Variables  //
+//             //
+/////////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Variables
+#endif
+
+#ifndef SCU_CODEC_DLOPEN
+
+// libraries are linked, tables point straight at their functions
+
+#ifdef USE_ZLIB
+scu_codec_zlib scu_zlib =
+{
+   inflateInit2_,
+   inflate,
+   inflateEnd,
+   inflateReset,
+};
+#endif
+
+#ifdef USE_LIBDEFLATE
+scu_codec_libdeflate scu_libdeflate =
+{
+   libdeflate_alloc_decompressor,
+   libdeflate_free_decompressor,
+   libdeflate_gzip_decompress_ex,
+};
+#endif
+
+#ifdef USE_BZIP2
+scu_codec_bzip2 scu_bzip2 =
+{
+   BZ2_bzDecompressInit,
+   BZ2_bzDecompress,
+   BZ2_bzDecompressEnd,
+};
+#endif
+
+#ifdef USE_LZMA
+scu_codec_lzma scu_lzma =
+{
+   lzma_stream_decoder,
+   lzma_code,
+   lzma_end,
+   lzma_stream_footer_decode,
+   lzma_index_buffer_decode,
+   lzma_index_uncompressed_size,
+   lzma_index_stream_size,
+   lzma_index_end,
+};
+#endif
+
+#ifdef USE_ZSTD
+scu_codec_zstd scu_zstd =
+{
+   ZSTD_createDStream,
+   ZSTD_initDStream,
+   ZSTD_decompressStream,
+   ZSTD_freeDStream,
+   ZSTD_getFrameContentSize,
+   ZSTD_isError,
+};
+#endif
+
+#else
+
+// libraries are loaded the first time a file needs them, so widgets which
+// never decode do not pay for loading and relocating them at exec
+
+static pthread_mutex_t scu_codec_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+#define SCU_CODEC_SYM(type, member, name) { name, offsetof(type, member) }
+
+#ifdef USE_ZLIB
+scu_codec_zlib scu_zlib;
+static const char * const scu_codec_zlib_sonames[] = { SCU_SONAME_ZLIB, NULL };
+static const scu_codec_sym scu_codec_zlib_syms[] =
+{
+   SCU_CODEC_SYM(scu_codec_zlib, inflateInit2_,  "inflateInit2_"),
+   SCU_CODEC_SYM(scu_codec_zlib, inflate,        "inflate"),
+   SCU_CODEC_SYM(scu_codec_zlib, inflateEnd,     "inflateEnd"),
+   SCU_CODEC_SYM(scu_codec_zlib, inflateReset,   "inflateReset"),
+   { NULL, 0 }
+};
+static scu_codec_lib scu_codec_zlib_lib = { scu_codec_zlib_sonames, scu_codec_zlib_syms, &scu_zlib, NULL, 0 };
+#endif
+
+#ifdef USE_LIBDEFLATE
+scu_codec_libdeflate scu_libdeflate;
+static const char * const scu_codec_libdeflate_sonames[] = { SCU_SONAME_LIBDEFLATE, NULL };
+static const scu_codec_sym scu_codec_libdeflate_syms[] =
+{
+   SCU_CODEC_SYM(scu_codec_libdeflate, alloc_decompressor, "libdeflate_alloc_decompressor"),
+   SCU_CODEC_SYM(scu_codec_libdeflate, free_decompressor,  "libdeflate_free_decompressor"),
+   SCU_CODEC_SYM(scu_codec_libdeflate, gzip_decompress_ex, "libdeflate_gzip_decompress_ex"),
+   { NULL, 0 }
+};
+static scu_codec_lib scu_codec_libdeflate_lib = { scu_codec_libdeflate_sonames, scu_codec_libdeflate_syms, &scu_libdeflate, NULL, 0 };
+#endif
+
+#ifdef USE_BZIP2
+scu_codec_bzip2 scu_bzip2;
+static const char * const scu_codec_bzip2_sonames[] = { SCU_SONAME_BZIP2, NULL };
+static const scu_codec_sym scu_codec_bzip2_syms[] =
+{
+   SCU_CODEC_SYM(scu_codec_bzip2, bzDecompressInit, "BZ2_bzDecompressInit"),
+   SCU_CODEC_SYM(scu_codec_bzip2, bzDecompress,     "BZ2_bzDecompress"),
+   SCU_CODEC_SYM(scu_codec_bzip2, bzDecompressEnd,  "BZ2_bzDecompressEnd"),
+   { NULL, 0 }
+};
+static scu_codec_lib scu_codec_bzip2_lib = { scu_codec_bzip2_sonames, scu_codec_bzip2_syms, &scu_bzip2, NULL, 0 };
+#endif
+
+#ifdef USE_LZMA
+scu_codec_lzma scu_lzma;
+static const char * const scu_codec_lzma_sonames[] = { SCU_SONAME_LZMA, NULL };
+static const scu_codec_sym scu_codec_lzma_syms[] =
+{
+   SCU_CODEC_SYM(scu_codec_lzma, stream_decoder,          "lzma_stream_decoder"),
+   SCU_CODEC_SYM(scu_codec_lzma, code,                    "lzma_code"),
+   SCU_CODEC_SYM(scu_codec_lzma, end,                     "lzma_end"),
+   SCU_CODEC_SYM(scu_codec_lzma, stream_footer_decode,    "lzma_stream_footer_decode"),
+   SCU_CODEC_SYM(scu_codec_lzma, index_buffer_decode,     "lzma_index_buffer_decode"),
+   SCU_CODEC_SYM(scu_codec_lzma, index_uncompressed_size, "lzma_index_uncompressed_size"),
+   SCU_CODEC_SYM(scu_codec_lzma, index_stream_size,       "lzma_index_stream_size"),
+   SCU_CODEC_SYM(scu_codec_lzma, index_end,               "lzma_index_end"),
+   { NULL, 0 }
+};
+static scu_codec_lib scu_codec_lzma_lib = { scu_codec_lzma_sonames, scu_codec_lzma_syms, &scu_lzma, NULL, 0 };
+#endif
+
+#ifdef USE_ZSTD
+scu_codec_zstd scu_zstd;
+static const char * const scu_codec_zstd_sonames[] = { SCU_SONAME_ZSTD, NULL };
+static const scu_codec_sym scu_codec_zstd_syms[] =
+{
+   SCU_CODEC_SYM(scu_codec_zstd, createDStream,       "ZSTD_createDStream"),
+   SCU_CODEC_SYM(scu_codec_zstd, initDStream,         "ZSTD_initDStream"),
+   SCU_CODEC_SYM(scu_codec_zstd, decompressStream,    "ZSTD_decompressStream"),
+   SCU_CODEC_SYM(scu_codec_zstd, freeDStream,         "ZSTD_freeDStream"),
+   SCU_CODEC_SYM(scu_codec_zstd, getFrameContentSize, "ZSTD_getFrameContentSize"),
+   SCU_CODEC_SYM(scu_codec_zstd, isError,             "ZSTD_isError"),
+   { NULL, 0 }
+};
+static scu_codec_lib scu_codec_zstd_lib = { scu_codec_zstd_sonames, scu_codec_zstd_syms, &scu_zstd, NULL, 0 };
+#endif
+
+#endif
+
+
+/////////////////
+//             //
+//  Functions  //
+//             //
+/////////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Functions
+#endif
+
+int scu_codec_libdeflate_loaded(void)
+{
+#if !(defined USE_LIBDEFLATE)
+   return(0);
+#elif !(defined SCU_CODEC_DLOPEN)
+   return(1);
+#else
+   int                  state;
+   pthread_mutex_lock(&scu_codec_mutex);
+   state = (scu_codec_libdeflate_lib.state == 0) ? scu_codec_open(&scu_codec_libdeflate_lib) : scu_codec_libdeflate_lib.state;
+   pthread_mutex_unlock(&scu_codec_mutex);
+   return((state == 1) ? 1 : 0);
+#endif
+}
+
+
+int scu_codec_load(int codec)
+{
+#ifdef SCU_CODEC_DLOPEN
+   int                  state;
+   scu_codec_lib      * lib;
+
+   switch(codec)
+   {
+#ifdef USE_ZLIB
+      case SCU_CODEC_GZIP:  lib = &scu_codec_zlib_lib;  break;
+#endif
+#ifdef USE_BZIP2
+      case SCU_CODEC_BZIP2: lib = &scu_codec_bzip2_lib; break;
+#endif
+#ifdef USE_LZMA
+      case SCU_CODEC_LZMA:  lib = &scu_codec_lzma_lib;  break;
+#endif
+#ifdef USE_ZSTD
+      case SCU_CODEC_ZSTD:  lib = &scu_codec_zstd_lib;  break;
+#endif
+      default:
+      return(0);
+   };
+
+   pthread_mutex_lock(&scu_codec_mutex);
+   state = (lib->state == 0) ? scu_codec_open(lib) : lib->state;
+   pthread_mutex_unlock(&scu_codec_mutex);
+
+   return((state == 1) ? 0 : SCU_ELIBRARY);
+#else
+   assert(codec >= 0);
+   return(0);
+#endif
+}
+
+
+#ifdef SCU_CODEC_DLOPEN
+/// opens first available shared object of library and fills its table,
+/// called with scu_codec_mutex held
+static int scu_codec_open(scu_codec_lib * lib)
+{
+   size_t               x;
+   void               * sym;
+
+   lib->state = -1;
+   for(x = 0; ((lib->sonames[x] != NULL) && (lib->handle == NULL)); x++)
+      lib->handle = dlopen(lib->sonames[x], RTLD_NOW|RTLD_LOCAL);
+   if (lib->handle == NULL)
+      return(-1);
+
+   for(x = 0; (lib->syms[x].name != NULL); x++)
+   {
+      if ((sym = dlsym(lib->handle, lib->syms[x].name)) == NULL)
+      {
+         dlclose(lib->handle);
+         lib->handle = NULL;
+         return(-1);
+      };
+      memcpy((char *)lib->table + lib->syms[x].offset, &sym, sizeof(sym));
+   };
+
+   lib->state = 1;
+   return(1);
+}
+#endif
+
+/* end of source */
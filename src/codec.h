@@ -0,0 +1,212 @@
+/*
+ *  Secure Core Utilities
+ *  Copyright (C) 2015, 2017 David M. Syzdek <david@syzdek.net>.
+ *
+ *  @SYZDEK_BSD_LICENSE_START@
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of David M. Syzdek nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ *  IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ *  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL DAVID M SYZDEK BE LIABLE FOR
+ *  ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ *  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ *  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ *  OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ *  SUCH DAMAGE.
+ *
+ *  @SYZDEK_BSD_LICENSE_END@
+ */
+/**
+ *  @file codec.h
+ *  Function tables of compression libraries, optionally loaded on first use
+ */
+#ifndef __SRC_CODEC_H
+#define __SRC_CODEC_H 1
+
+
+///////////////
+//           //
+//  Headers  //
+//           //
+///////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Headers
+#endif
+
+#include "securecoreutils.h"
+
+#ifdef USE_ZLIB
+#include <zlib.h>
+#endif
+
+#ifdef USE_LIBDEFLATE
+#include <libdeflate.h>
+#endif
+
+#ifdef USE_BZIP2
+#include <bzlib.h>
+#endif
+
+#ifdef USE_LZMA
+#include <lzma.h>
+#endif
+
+#ifdef USE_ZSTD
+#include <zstd.h>
+#endif
+
+
+///////////////////
+//               //
+//  Definitions  //
+//               //
+///////////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Definitions
+#endif
+
+// shared object names tried in order, may be overridden with CPPFLAGS
+#ifndef SCU_SONAME_ZLIB
+#define SCU_SONAME_ZLIB          "libz.so.1"
+#endif
+#ifndef SCU_SONAME_LIBDEFLATE
+#define SCU_SONAME_LIBDEFLATE    "libdeflate.so.0"
+#endif
+#ifndef SCU_SONAME_BZIP2
+#define SCU_SONAME_BZIP2         "libbz2.so.1.0", "libbz2.so.1"
+#endif
+#ifndef SCU_SONAME_LZMA
+#define SCU_SONAME_LZMA          "liblzma.so.5"
+#endif
+#ifndef SCU_SONAME_ZSTD
+#define SCU_SONAME_ZSTD          "libzstd.so.1"
+#endif
+
+
+//////////////////
+//              //
+//  Data Types  //
+//              //
+//////////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Data Types
+#endif
+
+#ifdef USE_ZLIB
+typedef struct scu_codec_zlib
+{
+   int (*inflateInit2_)(z_streamp strm, int windowBits, const char * version, int stream_size);
+   int (*inflate)(z_streamp strm, int flush);
+   int (*inflateEnd)(z_streamp strm);
+   int (*inflateReset)(z_streamp strm);
+} scu_codec_zlib;
+#endif
+
+#ifdef USE_LIBDEFLATE
+typedef struct scu_codec_libdeflate
+{
+   struct libdeflate_decompressor * (*alloc_decompressor)(void);
+   void (*free_decompressor)(struct libdeflate_decompressor * d);
+   enum libdeflate_result (*gzip_decompress_ex)(struct libdeflate_decompressor * d,
+      const void * in, size_t in_nbytes, void * out, size_t out_nbytes_avail,
+      size_t * actual_in_nbytes_ret, size_t * actual_out_nbytes_ret);
+} scu_codec_libdeflate;
+#endif
+
+#ifdef USE_BZIP2
+typedef struct scu_codec_bzip2
+{
+   int (*bzDecompressInit)(bz_stream * strm, int verbosity, int small);
+   int (*bzDecompress)(bz_stream * strm);
+   int (*bzDecompressEnd)(bz_stream * strm);
+} scu_codec_bzip2;
+#endif
+
+#ifdef USE_LZMA
+typedef struct scu_codec_lzma
+{
+   lzma_ret (*stream_decoder)(lzma_stream * strm, uint64_t memlimit, uint32_t flags);
+   lzma_ret (*code)(lzma_stream * strm, lzma_action action);
+   void (*end)(lzma_stream * strm);
+   lzma_ret (*stream_footer_decode)(lzma_stream_flags * options, const uint8_t * in);
+   lzma_ret (*index_buffer_decode)(lzma_index ** i, uint64_t * memlimit,
+      const lzma_allocator * allocator, const uint8_t * in, size_t * in_pos, size_t in_size);
+   lzma_vli (*index_uncompressed_size)(const lzma_index * i);
+   lzma_vli (*index_stream_size)(const lzma_index * i);
+   void (*index_end)(lzma_index * i, const lzma_allocator * allocator);
+} scu_codec_lzma;
+#endif
+
+#ifdef USE_ZSTD
+typedef struct scu_codec_zstd
+{
+   ZSTD_DStream * (*createDStream)(void);
+   size_t (*initDStream)(ZSTD_DStream * zds);
+   size_t (*decompressStream)(ZSTD_DStream * zds, ZSTD_outBuffer * output, ZSTD_inBuffer * input);
+   size_t (*freeDStream)(ZSTD_DStream * zds);
+   unsigned long long (*getFrameContentSize)(const void * src, size_t srcSize);
+   unsigned (*isError)(size_t code);
+} scu_codec_zstd;
+#endif
+
+
+/////////////////
+//             //
+//  Variables  //
+//             //
+/////////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Variables
+#endif
+
+// entries are valid once scu_codec_load() succeeded for the codec
+#ifdef USE_ZLIB
+extern scu_codec_zlib       scu_zlib;
+#endif
+#ifdef USE_LIBDEFLATE
+extern scu_codec_libdeflate scu_libdeflate;
+#endif
+#ifdef USE_BZIP2
+extern scu_codec_bzip2      scu_bzip2;
+#endif
+#ifdef USE_LZMA
+extern scu_codec_lzma       scu_lzma;
+#endif
+#ifdef USE_ZSTD
+extern scu_codec_zstd       scu_zstd;
+#endif
+
+
+//////////////////
+//              //
+//  Prototypes  //
+//              //
+//////////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Prototypes
+#endif
+
+/// returns 1 if libdeflate may be used for gzip members
+int scu_codec_libdeflate_loaded(void);
+
+/// loads library of codec (SCU_CODEC_*) unless already loaded, returns
+/// 0 or SCU_ELIBRARY
+int scu_codec_load(int codec);
+
+
+#endif /* end of header */
@@ -0,0 +1,694 @@
+/*
+ *  Secure Core Utilities
+ *  Copyright (C) 2015, 2017 David M. Syzdek <david@syzdek.net>.
+ *
+ *  @SYZDEK_BSD_LICENSE_START@
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of David M. Syzdek nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ *  IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ *  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL DAVID M SYZDEK BE LIABLE FOR
+ *  ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ *  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ *  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ *  OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ *  SUCH DAMAGE.
+ *
+ *  @SYZDEK_BSD_LICENSE_END@
+ */
+#include "securecoreutils.h"
+
+///////////////
+//           //
+//  Headers  //
+//           //
+///////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Headers
+#endif
+
+#include <stdio.h>
+#include <assert.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#ifdef HAVE_SYS_SENDFILE_H
+#include <sys/sendfile.h>
+#endif
+#ifdef HAVE_LINUX_OPENAT2_H
+#include <linux/openat2.h>
+#include <sys/syscall.h>
+#endif
+
+#include "policy.h"
+#include "probes.h"
+#include "stats.h"
+
+
+//////////////////
+//              //
+//  Data Types  //
+//              //
+//////////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Data Types
+#endif
+
+struct scu_pathdir
+{
+   int                  fd;
+   size_t               len;
+   char               * path;
+};
+
+
+//////////////////
+//              //
+//  Prototypes  //
+//              //
+//////////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Prototypes
+#endif
+
+static int scu_pathcache_dir(scu_pathcache * pc, const char * path, size_t len);
+static size_t scu_pathcache_find(scu_pathcache * pc, const char * path, size_t len);
+static int scu_pathcheck_lexical(const char * path);
+static int scu_pathcache_check(scu_pathcache * pc, scu_path * pp, const char * path, int opts);
+static int scu_pathopen_check(scu_path * pp, const char * path, int opts, int flags);
+static int scu_pathopen_parent(const char * path, size_t len);
+static int scu_pathopen_type(const struct stat * sb, int opts);
+static int scu_pathopen_walk(const char * path, size_t len);
+
+
+/////////////////
+//             //
+//  Functions  //
+//             //
+/////////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Functions
+#endif
+
+/// copies remainder of file to output, in kernel when sendfile() allows it
+int scu_copy_fd(int outfd, int infd)
+{
+   int            phase;
+   char           buff[SCU_BUFF_MAX];
+   ssize_t        len;
+
+   // time in sendfile() is counted as blocked on output
+   phase = SCU_STATS_SWAP(SCU_STATS_WRITE);
+   len   = 1;
+
+#ifdef HAVE_SYS_SENDFILE_H
+   while ((len = sendfile(outfd, infd, NULL, 0x7ffff000)) > 0)
+   {
+      SCU_STATS_COPY(len);
+      SCU_PROBE2(write, outfd, (int64_t)len);
+   };
+   if ( (len == 0) || ((errno != EINVAL) && (errno != ENOSYS)) )
+   {
+      SCU_STATS_SET(phase);
+      return((len == -1) ? -1 : 0);
+   };
+   len = 1;
+#endif
+
+   while (len > 0)
+   {
+      SCU_STATS_SET(SCU_STATS_READ);
+      len = read(infd, buff, sizeof(buff));
+      SCU_STATS_IN(len);
+      if (len <= 0)
+         break;
+      SCU_STATS_SET(SCU_STATS_WRITE);
+      len = write(outfd, buff, len);
+      SCU_STATS_OUT(len);
+      SCU_PROBE2(write, outfd, (int64_t)len);
+   };
+   SCU_STATS_SET(phase);
+
+   return((len == -1) ? -1 : 0);
+}
+
+
+/// parses number with optional unit suffix, units[n] multiplies by scale[n]
+/// and bare numbers use units[dflt]
+int scu_parse_units(const char * str, const char * units, int dflt, const uint64_t * scale, uint64_t * valp)
+{
+   char                 * end;
+   const char           * unit;
+   unsigned long long     val;
+
+   if ( (str[0] < '0') || (str[0] > '9') )
+      return(-1);
+   errno = 0;
+   val   = strtoull(str, &end, 10);
+   if (errno != 0)
+      return(-1);
+   if (end[0] != '\0')
+   {
+      if ( (end[1] != '\0') || ((unit = strchr(units, end[0])) == NULL) )
+         return(-1);
+      if (val > (UINT64_MAX / scale[unit - units]))
+         return(-1);
+      val *= scale[unit - units];
+   }
+   else if (units[0] != '\0')
+   {
+      if (val > (UINT64_MAX / scale[dflt]))
+         return(-1);
+      val *= scale[dflt];
+   };
+   *valp = (uint64_t)val;
+   return(0);
+}
+
+
+/// opens directory path[0..len) relative to its longest cached prefix
+static int scu_pathcache_dir(scu_pathcache * pc, const char * path, size_t len)
+{
+   int                  fd;
+   int                  pfd;
+   size_t               plen;
+   size_t               x;
+   char                 name[NAME_MAX+1];
+   struct stat          sb;
+   scu_pathdir        * dir;
+
+   if (pc->table == NULL)
+   {
+      if ((pc->table = calloc(SCU_PATHCACHE_SIZE, sizeof(scu_pathdir))) == NULL)
+         return(-1);
+   };
+
+   x = scu_pathcache_find(pc, path, len);
+   if (pc->table[x].path != NULL)
+      return(pc->table[x].fd);
+   if (pc->count >= (SCU_PATHCACHE_SIZE / 2))
+   {
+      errno = ENAMETOOLONG;
+      return(-1);
+   };
+
+   // resolve parent first so every ancestor is opened at most once
+   SCU_STATS_SYSCALL((len == 0) ? 1 : 2);
+   if (len == 0)
+   {
+      if ((fd = open("/", O_PATH|O_DIRECTORY|O_CLOEXEC)) == -1)
+         return(-1);
+   } else {
+      for(plen = len - 1; (path[plen] != '/'); plen--);
+      if ((pfd = scu_pathcache_dir(pc, path, plen)) == -1)
+         return(-1);
+      if ((len - plen - 1) > NAME_MAX)
+      {
+         errno = ENAMETOOLONG;
+         return(-1);
+      };
+      memcpy(name, &path[plen+1], len - plen - 1);
+      name[len - plen - 1] = '\0';
+      if ((fd = openat(pfd, name, O_PATH|O_NOFOLLOW|O_CLOEXEC)) == -1)
+         return(-1);
+      if (fstat(fd, &sb) == -1)
+      {
+         close(fd);
+         return(-1);
+      };
+      if (!(S_ISDIR(sb.st_mode)))
+      {
+         close(fd);
+         errno = (S_ISLNK(sb.st_mode)) ? ELOOP : ENOTDIR;
+         return(-1);
+      };
+   };
+
+   // the parent may have been inserted at this slot while recursing
+   for(; (pc->table[x].path != NULL); x = (x + 1) % SCU_PATHCACHE_SIZE);
+   dir = &pc->table[x];
+   if ((dir->path = strndup(path, len)) == NULL)
+   {
+      close(fd);
+      return(-1);
+   };
+   dir->len = len;
+   dir->fd  = fd;
+   pc->count++;
+
+   return(fd);
+}
+
+
+/// returns slot holding directory path[0..len) or the empty slot it would occupy
+static size_t scu_pathcache_find(scu_pathcache * pc, const char * path, size_t len)
+{
+   size_t               hash;
+   size_t               x;
+
+   // FNV-1a of prefix, collisions probe linearly
+   for(x = 0, hash = 2166136261U; (x < len); x++)
+      hash = (hash ^ (unsigned char)path[x]) * 16777619U;
+   for(x = hash % SCU_PATHCACHE_SIZE; (pc->table[x].path != NULL); x = (x + 1) % SCU_PATHCACHE_SIZE)
+      if ( (pc->table[x].len == len) && (!(memcmp(pc->table[x].path, path, len))) )
+         break;
+
+   return(x);
+}
+
+
+void scu_pathcache_free(scu_pathcache * pc)
+{
+   size_t         x;
+
+   assert(pc != NULL);
+
+   if (pc->table == NULL)
+      return;
+   for(x = 0; (x < SCU_PATHCACHE_SIZE); x++)
+   {
+      if (pc->table[x].path == NULL)
+         continue;
+      close(pc->table[x].fd);
+      free(pc->table[x].path);
+   };
+   free(pc->table);
+   pc->table = NULL;
+   pc->count = 0;
+
+   return;
+}
+
+
+int scu_pathcache_stat(scu_pathcache * pc, scu_path * pp, const char * path, int opts)
+{
+   int                  rc;
+   int                  phase;
+
+   SCU_PROBE2(pathcheck__entry, path, opts);
+   phase = SCU_STATS_SWAP(SCU_STATS_PATHCHECK);
+   SCU_STATS_PATH(path);
+   rc    = scu_pathcache_check(pc, pp, path, opts);
+   SCU_STATS_SET(phase);
+   SCU_PROBE2(pathcheck__return, path, rc);
+
+   return(rc);
+}
+
+
+static int scu_pathcache_check(scu_pathcache * pc, scu_path * pp, const char * path, int opts)
+{
+   int                  rc;
+   size_t               x;
+   const char         * name;
+
+   assert(pc   != NULL);
+   assert(pp   != NULL);
+   assert(path != NULL);
+
+   memset(pp, 0, sizeof(scu_path));
+   pp->dirfd = -1;
+   pp->fd    = -1;
+
+   if ((rc = scu_pathcheck_lexical(path)) != 0)
+      return(rc);
+   if ( ((opts & SCU_ONOPOLICY) == 0) && ((rc = scu_policy_check(path)) != 0) )
+      return(rc);
+   name     = rindex(path, '/');
+   pp->name = &name[1];
+
+   // start over rather than evict entries a deep path may still need,
+   // descriptors of a cached parent stay valid for the next path
+   for(x = 0, rc = 0; (path[x] != '\0'); x++)
+      rc += (path[x] == '/') ? 1 : 0;
+   if ( (pc->table != NULL) && ((pc->count + (size_t)rc) > (SCU_PATHCACHE_SIZE / 2)) )
+   {
+      x = scu_pathcache_find(pc, path, (size_t)(name - path));
+      if (pc->table[x].path == NULL)
+         scu_pathcache_free(pc);
+   };
+
+   // directory descriptor remains owned by the cache
+   if ((pp->dirfd = scu_pathcache_dir(pc, path, (size_t)(name - path))) == -1)
+   {
+      if (errno == ELOOP)
+         return(SCU_EFILE);
+      if ( ((opts & SCU_ONOTEXISTS) != 0) && (errno == ENOENT) )
+         return(0);
+      return(SCU_ERRNO);
+   };
+
+   SCU_STATS_SYSCALL(1);
+   if (fstatat(pp->dirfd, pp->name, &pp->sb, AT_SYMLINK_NOFOLLOW) == -1)
+   {
+      memset(&pp->sb, 0, sizeof(pp->sb));
+      if ( ((opts & SCU_ONOTEXISTS) != 0) && (errno == ENOENT) )
+         return(0);
+      return(SCU_ERRNO);
+   };
+
+   if ( ((opts & SCU_ODIR) == 0) && (!(S_ISREG(pp->sb.st_mode))) )
+      return(SCU_EFILE);
+   if ( ((opts & SCU_ODIR) != 0) && (!(S_ISDIR(pp->sb.st_mode))) )
+      return(SCU_EDIR);
+
+   return(0);
+}
+
+
+/// checks paths
+int scu_pathcheck(const char * path, int opts)
+{
+   int            rc;
+   scu_path       p;
+
+   assert(path != NULL);
+
+   rc = scu_pathopen(&p, path, opts, O_PATH);
+   scu_pathclose(&p);
+
+   return(rc);
+}
+
+
+/// verifies path is anchored and free of relative and hidden components
+static int scu_pathcheck_lexical(const char * path)
+{
+   size_t         s;
+   size_t         p;
+
+   s = strlen(path);
+
+   // verify file is anchored
+   if (path[0] != '/')
+      return(SCU_EANCHOR);
+
+   // verify path does not end in slash
+   if (path[s-1] == '/')
+      return(SCU_EPATH);
+
+   // verify there are no adjacent
+   for(p = 1; p < s; p++)
+   {
+      if ( ((path[p-1] == '.')||(path[p-1] == '/')) &&
+           ((path[p+0] == '.')||(path[p+0] == '/')) )
+      return(SCU_EPATH);
+   };
+
+   return(0);
+}
+
+
+void scu_pathclose(scu_path * pp)
+{
+   assert(pp != NULL);
+   if (pp->fd != -1)
+      close(pp->fd);
+   if (pp->dirfd != -1)
+      close(pp->dirfd);
+   pp->fd    = -1;
+   pp->dirfd = -1;
+   return;
+}
+
+
+int scu_pathopen(scu_path * pp, const char * path, int opts, int flags)
+{
+   int                  rc;
+   int                  phase;
+
+   SCU_PROBE2(pathcheck__entry, path, opts);
+   phase = SCU_STATS_SWAP(SCU_STATS_PATHCHECK);
+   SCU_STATS_PATH(path);
+   rc    = scu_pathopen_check(pp, path, opts, flags);
+   SCU_STATS_SET(phase);
+   SCU_PROBE2(pathcheck__return, path, rc);
+
+   return(rc);
+}
+
+
+/// verifies path and opens file, time after the parent is verified is
+/// counted as opening the file
+static int scu_pathopen_check(scu_path * pp, const char * path, int opts, int flags)
+{
+   int                  rc;
+   const char         * name;
+   struct stat          sb;
+
+   assert(pp   != NULL);
+   assert(path != NULL);
+
+   memset(pp, 0, sizeof(scu_path));
+   memset(&sb, 0, sizeof(sb));
+   pp->dirfd = -1;
+   pp->fd    = -1;
+
+   if ((rc = scu_pathcheck_lexical(path)) != 0)
+      return(rc);
+   if ( ((opts & SCU_ONOPOLICY) == 0) && ((rc = scu_policy_check(path)) != 0) )
+      return(rc);
+   name     = rindex(path, '/');
+   pp->name = &name[1];
+
+   if ((pp->dirfd = scu_pathopen_parent(path, (size_t)(name - path))) == -1)
+   {
+      if (errno == ELOOP)
+         return(SCU_EFILE);
+      if ( ((opts & SCU_ONOTEXISTS) != 0) && (errno == ENOENT) )
+         return(0);
+      return(SCU_ERRNO);
+   };
+
+   // type is verified before the file is opened so that device nodes and
+   // FIFOs are never opened, O_PATH descriptors do not open the file
+   flags |= O_NOFOLLOW|O_CLOEXEC|O_NOCTTY;
+   SCU_STATS_SET(SCU_STATS_OPEN);
+   if ((flags & O_PATH) == 0)
+   {
+      SCU_STATS_SYSCALL(1);
+      if (fstatat(pp->dirfd, pp->name, &pp->sb, AT_SYMLINK_NOFOLLOW) == -1)
+      {
+         if ( ((opts & SCU_ONOTEXISTS) != 0) && (errno == ENOENT) )
+            return(0);
+         rc = SCU_ERRNO;
+         scu_pathclose(pp);
+         return(rc);
+      };
+      if ((rc = scu_pathopen_type(&pp->sb, opts)) != 0)
+      {
+         scu_pathclose(pp);
+         return(rc);
+      };
+      sb = pp->sb;
+   };
+
+   // non-blocking open prevents a FIFO swapped in after the type check
+   // from stalling, the flag has no effect on regular files and directories
+   flags |= ((flags & O_PATH) == 0) ? O_NONBLOCK : 0;
+   SCU_STATS_SYSCALL(2);
+   if ((pp->fd = openat(pp->dirfd, pp->name, flags)) == -1)
+   {
+      if ( ((opts & SCU_ONOTEXISTS) != 0) && (errno == ENOENT) )
+         return(0);
+      rc = (errno == ELOOP) ? SCU_EFILE : SCU_ERRNO;
+      scu_pathclose(pp);
+      return(rc);
+   };
+   if (fstat(pp->fd, &pp->sb) == -1)
+   {
+      scu_pathclose(pp);
+      return(SCU_ERRNO);
+   };
+
+   // verify file is not a symbolic link and was not replaced after checking
+   rc = scu_pathopen_type(&pp->sb, opts);
+   if ( (rc == 0) && ((flags & O_PATH) == 0) &&
+        ( (sb.st_dev != pp->sb.st_dev) || (sb.st_ino != pp->sb.st_ino) ) )
+      rc = SCU_EFILE;
+   if (rc != 0)
+   {
+      scu_pathclose(pp);
+      return(rc);
+   };
+
+   return(0);
+}
+
+
+/// verifies file type expected by options
+static int scu_pathopen_type(const struct stat * sb, int opts)
+{
+   if (S_ISLNK(sb->st_mode))
+      return(SCU_EFILE);
+   if ( ((opts & SCU_ODIR) == 0) && (!(S_ISREG(sb->st_mode))) )
+      return(SCU_EFILE);
+   if ( ((opts & SCU_ODIR) != 0) && (!(S_ISDIR(sb->st_mode))) )
+      return(SCU_EDIR);
+   return(0);
+}
+
+
+/// opens parent directory of path without following symlinks
+static int scu_pathopen_parent(const char * path, size_t len)
+{
+#ifdef HAVE_LINUX_OPENAT2_H
+   int                  fd;
+   char               * str;
+   struct open_how      how;
+   static int           no_openat2 = 0;
+#endif
+
+   SCU_STATS_SYSCALL(1);
+   if (len == 0)
+      return(open("/", O_PATH|O_DIRECTORY|O_CLOEXEC));
+
+   // kernel refuses symlinks during a single resolution when available,
+   // otherwise the path is walked one component at a time
+#ifdef HAVE_LINUX_OPENAT2_H
+   if (!(no_openat2))
+   {
+      if ((str = strndup(path, len)) == NULL)
+         return(-1);
+      memset(&how, 0, sizeof(how));
+      how.flags   = O_PATH|O_DIRECTORY|O_CLOEXEC;
+      how.resolve = RESOLVE_NO_SYMLINKS|RESOLVE_NO_MAGICLINKS;
+      fd = (int)syscall(SYS_openat2, AT_FDCWD, str, &how, sizeof(how));
+      free(str);
+      if ( (fd != -1) || (errno != ENOSYS) )
+         return(fd);
+      no_openat2 = 1;
+   };
+#endif
+
+   return(scu_pathopen_walk(path, len));
+}
+
+
+/// opens parent directory of path one component at a time without following symlinks
+static int scu_pathopen_walk(const char * path, size_t len)
+{
+   int            fd;
+   int            dirfd;
+   char         * str;
+   char         * ptr;
+   char         * next;
+   struct stat    sb;
+
+   if ((dirfd = open("/", O_PATH|O_DIRECTORY|O_CLOEXEC)) == -1)
+      return(-1);
+   if ((str = strndup(path, len)) == NULL)
+   {
+      close(dirfd);
+      return(-1);
+   };
+
+   for(ptr = &str[1]; ((ptr != NULL) && (ptr[0] != '\0')); ptr = next)
+   {
+      if ((next = index(ptr, '/')) != NULL)
+         *next++ = '\0';
+      fd = openat(dirfd, ptr, O_PATH|O_NOFOLLOW|O_CLOEXEC);
+      close(dirfd);
+      SCU_STATS_SYSCALL(2);
+      if ((dirfd = fd) == -1)
+         break;
+      if (fstat(dirfd, &sb) == -1)
+         break;
+      if (!(S_ISDIR(sb.st_mode)))
+      {
+         errno = (S_ISLNK(sb.st_mode)) ? ELOOP : ENOTDIR;
+         break;
+      };
+   };
+   free(str);
+
+   if (ptr != NULL)
+   {
+      if (dirfd != -1)
+         close(dirfd);
+      return(-1);
+   };
+
+   return(dirfd);
+}
+
+
+const char * scu_strerror(int err)
+{
+   if (err < 0)
+      return(strerror(err));
+   switch(err)
+   {
+      case 0:
+      return("success");
+
+      case SCU_ERRNO:
+      return(strerror(errno));
+
+      case SCU_EPATH:
+      return("path contains illegal pattern");
+
+      case SCU_EFILE:
+      return("not a regular file");
+
+      case SCU_EANCHOR:
+      return("not an absolute path");
+
+      case SCU_EDIR:
+      return("not a directory");
+
+      case SCU_ECODEC:
+      return("unable to determine compression algorithm");
+
+      case SCU_ECORRUPT:
+      return("compressed file is corrupt or truncated");
+
+      case SCU_EPOLICY:
+      return("path not permitted by policy");
+
+      case SCU_EPOLFILE:
+      return("policy file is invalid or insecure");
+
+      case SCU_ELIBRARY:
+      return("compression library is not available");
+
+      default:
+      break;
+   };
+   return("unknown error");
+}
+
+int scu_is_ascii_buffer(const char * buff, ssize_t len)
+{
+   ssize_t pos;
+   assert(buff != NULL);
+
+   for(pos = 0; pos < len; pos++)
+      if ( ( ((buff[pos] < 32) || (buff[pos] > 126)) ) &&
+           ( ((buff[pos] <  9) || (buff[pos] >  13)) ) )
+         return(0);
+
+   return(1);
+}
+
+
+/* end of source */
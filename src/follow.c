@@ -0,0 +1,389 @@
+/*
+ *  Secure Core Utilities
+ *  Copyright (C) 2015, 2017 David M. Syzdek <david@syzdek.net>.
+ *
+ *  @SYZDEK_BSD_LICENSE_START@
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of David M. Syzdek nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ *  IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ *  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL DAVID M SYZDEK BE LIABLE FOR
+ *  ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ *  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ *  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ *  OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ *  SUCH DAMAGE.
+ *
+ *  @SYZDEK_BSD_LICENSE_END@
+ */
+#include "follow.h"
+
+///////////////
+//           //
+//  Headers  //
+//           //
+///////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Headers
+#endif
+
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <poll.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/file.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+
+//////////////////
+//              //
+//  Prototypes  //
+//              //
+//////////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Prototypes
+#endif
+
+static int scu_follow_connect(const struct sockaddr_un * sa, uint64_t * offp);
+static int scu_follow_dir(void);
+static void scu_follow_hub(int fd, int sd, const char * sockpath, uint64_t head);
+static int64_t scu_follow_now(void);
+static int scu_follow_spawn(int fd, const struct sockaddr_un * sa, const char * lockpath);
+
+
+/////////////////
+//             //
+//  Functions  //
+//             //
+/////////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Functions
+#endif
+
+static int scu_follow_connect(const struct sockaddr_un * sa, uint64_t * offp)
+{
+   int                  sd;
+   scu_follow_hello     hello;
+
+   if ((sd = socket(AF_UNIX, SOCK_STREAM|SOCK_CLOEXEC, 0)) == -1)
+      return(-1);
+   if (connect(sd, (const struct sockaddr *)sa, sizeof(struct sockaddr_un)) == -1)
+   {
+      close(sd);
+      return(-1);
+   };
+
+   // a hub which is exiting closes the connection without a greeting
+   if ( (recv(sd, &hello, sizeof(hello), MSG_WAITALL) != (ssize_t)sizeof(hello)) ||
+        (hello.magic != SCU_FOLLOW_MAGIC) )
+   {
+      close(sd);
+      errno = ECONNRESET;
+      return(-1);
+   };
+   *offp = hello.offset;
+
+   return(sd);
+}
+
+
+/// hub sockets are only trusted in a directory writable by root alone
+static int scu_follow_dir(void)
+{
+   struct stat          sb;
+
+   if ( (mkdir(SCU_FOLLOW_DIR, 0700) == -1) && (errno != EEXIST) )
+      return(-1);
+   if (lstat(SCU_FOLLOW_DIR, &sb) == -1)
+      return(-1);
+   if ( (!(S_ISDIR(sb.st_mode))) || (sb.st_uid != 0) || ((sb.st_mode & 022) != 0) )
+   {
+      errno = EPERM;
+      return(-1);
+   };
+   return(0);
+}
+
+
+/// reads appends of the file once and copies them to every subscriber from
+/// a ring; a subscriber which falls a whole ring behind is disconnected so
+/// it cannot stall the others
+static void scu_follow_hub(int fd, int sd, const char * sockpath, uint64_t head)
+{
+   int                  cd;
+   int                  more;
+   nfds_t               nfds;
+   nfds_t               x;
+   size_t               off;
+   size_t               end;
+   size_t               len;
+   ssize_t              rc;
+   int64_t              idle;
+   char               * ring;
+   char                 c;
+   scu_follow_hello     hello;
+   struct pollfd        pfds[SCU_FOLLOW_CLIENTS + 1];
+   uint64_t             cursors[SCU_FOLLOW_CLIENTS + 1];
+
+   if ((ring = malloc(SCU_FOLLOW_RING)) == NULL)
+      return;
+
+   pfds[0].fd     = sd;
+   pfds[0].events = POLLIN;
+   nfds           = 1;
+   idle           = scu_follow_now();
+
+   while(1)
+   {
+      // a quarter ring per pass leaves subscribers room to keep up with a
+      // burst of appends
+      for(len = 0, more = 0; (len < (SCU_FOLLOW_RING / 4)); len += (size_t)rc)
+      {
+         off = (size_t)(head % SCU_FOLLOW_RING);
+         end = ((SCU_FOLLOW_RING - off) < ((SCU_FOLLOW_RING / 4) - len)) ? (SCU_FOLLOW_RING - off) : ((SCU_FOLLOW_RING / 4) - len);
+         if ((rc = pread(fd, &ring[off], end, (off_t)head)) <= 0)
+            break;
+         head += (uint64_t)rc;
+         more  = 1;
+      };
+      more = ((more) && (len >= (SCU_FOLLOW_RING / 4))) ? 1 : 0;
+
+      for(x = 1; (x < nfds); x++)
+      {
+         if ((head - cursors[x]) > SCU_FOLLOW_RING)
+         {
+            shutdown(pfds[x].fd, SHUT_RDWR);
+            continue;
+         };
+         while (cursors[x] < head)
+         {
+            off = (size_t)(cursors[x] % SCU_FOLLOW_RING);
+            len = SCU_FOLLOW_RING - off;
+            len = ((head - cursors[x]) < len) ? (size_t)(head - cursors[x]) : len;
+            if ((rc = send(pfds[x].fd, &ring[off], len, MSG_DONTWAIT|MSG_NOSIGNAL)) <= 0)
+               break;
+            cursors[x] += (uint64_t)rc;
+         };
+         pfds[x].events = POLLIN | ((cursors[x] < head) ? POLLOUT : 0);
+      };
+
+      if (nfds == 1)
+      {
+         if ((scu_follow_now() - idle) > SCU_FOLLOW_LINGER)
+            break;
+      };
+
+      if (poll(pfds, nfds, (more) ? 0 : SCU_FOLLOW_POLL) == -1)
+      {
+         if (errno == EINTR)
+            continue;
+         break;
+      };
+
+      // subscribers never write, readable means closed or dropped
+      for(x = 1; (x < nfds); x++)
+      {
+         if ((pfds[x].revents & (POLLIN|POLLHUP|POLLERR|POLLNVAL)) == 0)
+            continue;
+         if ( ((pfds[x].revents & POLLIN) != 0) && (recv(pfds[x].fd, &c, 1, MSG_DONTWAIT) != 0) )
+            continue;
+         close(pfds[x].fd);
+         nfds--;
+         pfds[x]    = pfds[nfds];
+         cursors[x] = cursors[nfds];
+         x--;
+         if (nfds == 1)
+            idle = scu_follow_now();
+      };
+
+      if ((pfds[0].revents & POLLIN) == 0)
+         continue;
+      if ((cd = accept4(sd, NULL, NULL, SOCK_NONBLOCK|SOCK_CLOEXEC)) == -1)
+         continue;
+      hello.magic    = SCU_FOLLOW_MAGIC;
+      hello.reserved = 0;
+      hello.offset   = head;
+      if ( (nfds > SCU_FOLLOW_CLIENTS) || (send(cd, &hello, sizeof(hello), MSG_NOSIGNAL) != (ssize_t)sizeof(hello)) )
+      {
+         close(cd);
+         continue;
+      };
+      pfds[nfds].fd      = cd;
+      pfds[nfds].events  = POLLIN;
+      pfds[nfds].revents = 0;
+      cursors[nfds]      = head;
+      nfds++;
+   };
+
+   // socket is removed while the lock is still held, connections which
+   // raced the removal are closed and fall back to polling
+   unlink(sockpath);
+   for(x = 0; (x < nfds); x++)
+      close(pfds[x].fd);
+   free(ring);
+
+   return;
+}
+
+
+static int64_t scu_follow_now(void)
+{
+   struct timespec      ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return(((int64_t)ts.tv_sec * 1000) + (ts.tv_nsec / 1000000));
+}
+
+
+/// starts a detached hub holding the lock of the file for its lifetime,
+/// returns 0 if a hub was started or another process holds the lock
+static int scu_follow_spawn(int fd, const struct sockaddr_un * sa, const char * lockpath)
+{
+   int                  sd;
+   int                  lockfd;
+   int                  nullfd;
+   int                  status;
+   long                 x;
+   long                 max;
+   pid_t                pid;
+   mode_t               mask;
+
+   if ((lockfd = open(lockpath, O_RDWR|O_CREAT|O_NOFOLLOW|O_CLOEXEC, 0600)) == -1)
+      return(-1);
+   if (flock(lockfd, LOCK_EX|LOCK_NB) == -1)
+   {
+      close(lockfd);
+      return((errno == EWOULDBLOCK) ? 0 : -1);
+   };
+
+   // socket is listening before the hub exists, so the caller can connect
+   // as soon as this returns
+   unlink(sa->sun_path);
+   if ((sd = socket(AF_UNIX, SOCK_STREAM|SOCK_CLOEXEC, 0)) == -1)
+   {
+      close(lockfd);
+      return(-1);
+   };
+   mask = umask(077);
+   if ( (bind(sd, (const struct sockaddr *)sa, sizeof(struct sockaddr_un)) == -1) || (listen(sd, SOMAXCONN) == -1) )
+   {
+      umask(mask);
+      close(sd);
+      close(lockfd);
+      return(-1);
+   };
+   umask(mask);
+
+   fflush(stdout);
+   fflush(stderr);
+   if ((pid = fork()) == -1)
+   {
+      unlink(sa->sun_path);
+      close(sd);
+      close(lockfd);
+      return(-1);
+   };
+   if (pid == 0)
+   {
+      setsid();
+      if ((pid = fork()) != 0)
+         _exit((pid == -1) ? 1 : 0);
+      signal(SIGHUP,  SIG_IGN);
+      signal(SIGINT,  SIG_IGN);
+      signal(SIGALRM, SIG_IGN);
+      if (chdir("/") == -1)
+         _exit(1);
+
+      // hub must not hold the terminal or pipes of the tail which started it
+      max = sysconf(_SC_OPEN_MAX);
+      max = ((max < 0) || (max > 65536)) ? 65536 : max;
+      for(x = STDERR_FILENO + 1; (x < max); x++)
+         if ( (x != fd) && (x != sd) && (x != lockfd) )
+            close((int)x);
+      if ((nullfd = open("/dev/null", O_RDWR)) != -1)
+      {
+         dup2(nullfd, STDIN_FILENO);
+         dup2(nullfd, STDOUT_FILENO);
+         dup2(nullfd, STDERR_FILENO);
+         if (nullfd > STDERR_FILENO)
+            close(nullfd);
+      };
+      scu_follow_hub(fd, sd, sa->sun_path, (uint64_t)lseek(fd, 0, SEEK_CUR));
+      _exit(0);
+   };
+
+   close(sd);
+   close(lockfd);
+   if ( (waitpid(pid, &status, 0) == -1) || (!(WIFEXITED(status))) || (WEXITSTATUS(status) != 0) )
+      return(-1);
+
+   return(0);
+}
+
+
+int scu_follow_subscribe(int fd, uint64_t * offp)
+{
+   int                  sd;
+   int                  attempt;
+   char                 lockpath[sizeof(((struct sockaddr_un *)0)->sun_path)];
+   struct stat          sb;
+   struct sockaddr_un   sa;
+   struct timespec      ts;
+
+   assert(offp != NULL);
+
+   // only root may read through a hub, it serves whoever can connect
+   if (geteuid() != 0)
+      return(-1);
+   if (fstat(fd, &sb) == -1)
+      return(-1);
+   if (!(S_ISREG(sb.st_mode)))
+      return(-1);
+   if (scu_follow_dir() == -1)
+      return(-1);
+
+   // hubs are keyed by the file itself, not by the path used to open it
+   memset(&sa, 0, sizeof(sa));
+   sa.sun_family = AF_UNIX;
+   snprintf(sa.sun_path, sizeof(sa.sun_path), "%s/follow-%jx-%jx.sock", SCU_FOLLOW_DIR, (uintmax_t)sb.st_dev, (uintmax_t)sb.st_ino);
+   snprintf(lockpath, sizeof(lockpath), "%s/follow-%jx-%jx.lock", SCU_FOLLOW_DIR, (uintmax_t)sb.st_dev, (uintmax_t)sb.st_ino);
+
+   ts.tv_sec  = 0;
+   ts.tv_nsec = SCU_FOLLOW_POLL * 1000000;
+   for(attempt = 0; (attempt < 10); attempt++)
+   {
+      if ((sd = scu_follow_connect(&sa, offp)) != -1)
+         return(sd);
+      if (scu_follow_spawn(fd, &sa, lockpath) == -1)
+         return(-1);
+      nanosleep(&ts, NULL);
+   };
+
+   return(-1);
+}
+
+/* end of source */
@@ -0,0 +1,1481 @@
+/*
+ *  Secure Core Utilities
+ *  Copyright (C) 2015, 2017 David M. Syzdek <david@syzdek.net>.
+ *
+ *  @SYZDEK_BSD_LICENSE_START@
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of David M. Syzdek nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ *  IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ *  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL DAVID M SYZDEK BE LIABLE FOR
+ *  ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ *  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ *  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ *  OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ *  SUCH DAMAGE.
+ *
+ *  @SYZDEK_BSD_LICENSE_END@
+ */
+#include "input.h"
+
+///////////////
+//           //
+//  Headers  //
+//           //
+///////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Headers
+#endif
+
+#include <assert.h>
+#include <inttypes.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <pthread.h>
+
+#include "codec.h"
+#include "stats.h"
+#include "lzw/lzw.h"
+
+
+//////////////////
+//              //
+//  Data Types  //
+//              //
+//////////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Data Types
+#endif
+
+struct scu_input
+{
+   int               fd;
+   int               codec;
+   int               err;
+   int               eof;
+   int               done;
+   int               member;
+   size_t            inlen;
+   off_t             inpos;
+   uint8_t         * inptr;
+   struct stat       sb;
+#ifdef USE_ZLIB
+   z_stream          gz;
+#endif
+#ifdef USE_LIBDEFLATE
+   struct libdeflate_decompressor * ld;
+   const uint8_t   * map;      // whole file mapped for gzip fast path
+   size_t            maplen;
+   size_t            mappos;
+   uint8_t         * out;      // decoded gzip member
+   size_t            outcap;
+   size_t            outlen;
+   size_t            outpos;
+#endif
+#ifdef USE_BZIP2
+   bz_stream         bz2;
+#endif
+#ifdef USE_LZMA
+   lzma_stream       lzma;
+#endif
+#ifdef USE_ZSTD
+   ZSTD_DStream    * zstd;
+#endif
+   lzwFile         * lzw;
+   size_t            buffsize;
+   uint8_t           buff[];   // SCU_INPUT_BUFF unless set in environment
+};
+
+
+#ifdef USE_ZLIB
+/// state shared by threads verifying the members of a BGZF file
+typedef struct scu_input_bgzf
+{
+   const uint8_t   * map;
+   size_t            maplen;
+   size_t            next;     // offset of next member to claim
+   size_t            failed;   // offset of first failing member
+   int               err;
+   int               errnum;
+   pthread_mutex_t   mutex;
+} scu_input_bgzf;
+#endif
+
+
+/////////////////
+//             //
+//  Variables  //
+//             //
+/////////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Variables
+#endif
+
+#ifdef USE_BZIP2
+static const uint8_t scm_magic_bz2[3]   = { 0x42, 0x5a, 0x68 };                   // tar.bz2
+static const uint8_t scm_magic_bz2_blk[6] = { 0x31, 0x41, 0x59, 0x26, 0x53, 0x59 }; // first block
+static const uint8_t scm_magic_bz2_eos[6] = { 0x17, 0x72, 0x45, 0x38, 0x50, 0x90 }; // empty stream
+#endif
+#ifdef USE_ZLIB
+static const uint8_t scm_magic_gz[2]    = { 0x1f, 0x8b };                         // tar.gz
+#endif
+static const uint8_t scm_magic_z_lzw[2] = { 0x1f, 0x9d };                         // tar.Z
+#ifdef USE_LZMA
+static const uint8_t scm_magic_lzma[6]  = { 0xfd, 0x37, 0x7a, 0x58, 0x5a, 0x00 }; // tar.xz
+#endif
+#ifdef USE_ZSTD
+static const uint8_t scm_magic_zstd[4]  = { 0x28, 0xb5, 0x2f, 0xfd };             // tar.zst
+#endif
+
+
+//////////////////
+//              //
+//  Prototypes  //
+//              //
+//////////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Prototypes
+#endif
+
+#if defined(USE_BZIP2) || defined(USE_LZMA) || defined(USE_ZLIB) || defined(USE_ZSTD)
+static ssize_t scu_input_fill(scu_input * inp);
+#endif
+static size_t scu_input_bgzf_len(const uint8_t * hdr);
+static int scu_input_info_gz(scu_input * inp, uint64_t * sizep, int * exactp);
+static int scu_input_info_lzma(scu_input * inp, uint64_t * sizep, int * exactp);
+static int scu_input_info_sample(scu_input * inp, uint64_t * sizep, int * exactp);
+static int scu_input_info_zstd(scu_input * inp, uint64_t * sizep, int * exactp);
+#ifdef USE_ZLIB
+static void scu_input_map_gz(scu_input * inp);
+#endif
+static int scu_input_open_file(scu_input ** inpp, const char * path);
+static int scu_input_pread(scu_input * inp, void * buff, size_t size, off_t offset);
+#if defined(USE_BZIP2) || defined(USE_ZLIB)
+static int scu_input_next_member(scu_input * inp, const uint8_t * magic, size_t len);
+#endif
+static ssize_t scu_input_read_bz2(scu_input * inp, void * buff, size_t size);
+static ssize_t scu_input_read_gz(scu_input * inp, void * buff, size_t size);
+#ifdef USE_LIBDEFLATE
+static ssize_t scu_input_read_gz_map(scu_input * inp, void * buff, size_t size);
+#endif
+static ssize_t scu_input_read_lzma(scu_input * inp, void * buff, size_t size);
+static ssize_t scu_input_read_lzw(scu_input * inp, void * buff, size_t size);
+static ssize_t scu_input_read_raw(scu_input * inp, void * buff, size_t size);
+static ssize_t scu_input_read_zstd(scu_input * inp, void * buff, size_t size);
+#ifdef USE_ZLIB
+static void scu_input_unmap_gz(scu_input * inp);
+static int scu_input_verify_bgzf(scu_input * inp, unsigned jobs);
+static void * scu_input_verify_bgzf_worker(void * arg);
+#endif
+
+
+/////////////////
+//             //
+//  Functions  //
+//             //
+/////////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Functions
+#endif
+
+void scu_input_close(scu_input * inp)
+{
+   if (inp == NULL)
+      return;
+
+   switch(inp->codec)
+   {
+#ifdef USE_ZLIB
+      case SCU_CODEC_GZIP:
+      scu_input_unmap_gz(inp);
+      scu_zlib.inflateEnd(&inp->gz);
+      break;
+#endif
+
+#ifdef USE_BZIP2
+      case SCU_CODEC_BZIP2:
+      if ((inp->member))
+         scu_bzip2.bzDecompressEnd(&inp->bz2);
+      break;
+#endif
+
+#ifdef USE_LZMA
+      case SCU_CODEC_LZMA:
+      scu_lzma.end(&inp->lzma);
+      break;
+#endif
+
+#ifdef USE_ZSTD
+      case SCU_CODEC_ZSTD:
+      if (inp->zstd != NULL)
+         scu_zstd.freeDStream(inp->zstd);
+      break;
+#endif
+
+      case SCU_CODEC_LZW:
+      if (inp->lzw != NULL)
+      {
+         lzw_close(inp->lzw);
+         inp->fd = -1;
+      };
+      break;
+
+      default:
+      break;
+   };
+
+   if (inp->fd != -1)
+      close(inp->fd);
+
+   free(inp);
+
+   return;
+}
+
+
+int scu_input_codec(scu_input * inp)
+{
+   assert(inp != NULL);
+   return(inp->codec);
+}
+
+
+const char * scu_input_codec_name(int codec)
+{
+   switch(codec)
+   {
+      case SCU_CODEC_RAW:   return("plain");
+      case SCU_CODEC_GZIP:  return("gzip");
+      case SCU_CODEC_BZIP2: return("bzip2");
+      case SCU_CODEC_LZMA:  return("xz");
+      case SCU_CODEC_LZW:   return("compress");
+      case SCU_CODEC_ZSTD:  return("zstd");
+      default:
+      break;
+   };
+   return("unknown");
+}
+
+
+int scu_input_error(scu_input * inp)
+{
+   assert(inp != NULL);
+   return(inp->err);
+}
+
+
+int scu_input_fd(scu_input * inp)
+{
+   assert(inp != NULL);
+   return(inp->fd);
+}
+
+
+/// takes ownership of an already verified descriptor and detects codec
+/// from magic number
+int scu_input_fdopen(scu_input ** inpp, int fd, const struct stat * sb)
+{
+   ssize_t        len;
+   size_t         buffsize;
+   char         * str;
+   char         * endptr;
+   scu_input    * inp;
+
+   assert(inpp != NULL);
+   assert(fd   != -1);
+   assert(sb   != NULL);
+
+   *inpp = NULL;
+
+   // size of compressed reads may be tuned for benchmarks, but not by the
+   // caller of a setuid or sudo invocation
+   buffsize = SCU_INPUT_BUFF;
+   if ( ((str = getenv("SCU_INPUT_BUFF")) != NULL) && (str[0] != '\0') &&
+        (getenv("SUDO_UID") == NULL) && (getuid() == geteuid()) && (getgid() == getegid()) )
+   {
+      buffsize = (size_t)strtoul(str, &endptr, 0);
+      if ( (endptr[0] != '\0') || (buffsize < SCU_INPUT_BUFF_MIN) || (buffsize > SCU_INPUT_BUFF_MAX) )
+         buffsize = SCU_INPUT_BUFF;
+   };
+
+   if ((inp = malloc(sizeof(scu_input) + buffsize)) == NULL)
+   {
+      close(fd);
+      return(SCU_ERRNO);
+   };
+   memset(inp, 0, sizeof(scu_input));
+   inp->codec    = SCU_CODEC_RAW;
+   inp->fd       = fd;
+   inp->sb       = *sb;
+   inp->buffsize = buffsize;
+
+   // read magic number, bytes are handed to the decoder rather than re-read
+   len = read(inp->fd, inp->buff, 16);
+   SCU_STATS_IN(len);
+   if (len == -1)
+   {
+      scu_input_close(inp);
+      return(SCU_ERRNO);
+   };
+   inp->inptr = inp->buff;
+   inp->inlen = (size_t)len;
+   inp->inpos = len;
+   inp->eof   = (len == 0) ? 1 : 0;
+
+#ifdef USE_ZLIB
+   if ( (len >= (ssize_t)sizeof(scm_magic_gz)) && (!(memcmp(inp->buff, scm_magic_gz, sizeof(scm_magic_gz)))) )
+   {
+      if (scu_codec_load(SCU_CODEC_GZIP) != 0)
+      {
+         scu_input_close(inp);
+         return(SCU_ELIBRARY);
+      };
+      inp->codec = SCU_CODEC_GZIP;
+      if (scu_zlib.inflateInit2_(&inp->gz, 15 + 16, ZLIB_VERSION, (int)sizeof(z_stream)) != Z_OK)
+      {
+         inp->codec = SCU_CODEC_RAW;
+         scu_input_close(inp);
+         errno = ENOMEM;
+         return(SCU_ERRNO);
+      };
+      scu_input_map_gz(inp);
+   };
+#endif
+
+#ifdef USE_BZIP2
+   // "BZh" is common in text, the block size digit and the magic of the
+   // first block (or of the end of an empty stream) must follow
+   if ( (len >= 10) && (!(memcmp(inp->buff, scm_magic_bz2, sizeof(scm_magic_bz2)))) &&
+        (inp->buff[3] >= '1') && (inp->buff[3] <= '9') &&
+        ( (!(memcmp(&inp->buff[4], scm_magic_bz2_blk, sizeof(scm_magic_bz2_blk)))) ||
+          (!(memcmp(&inp->buff[4], scm_magic_bz2_eos, sizeof(scm_magic_bz2_eos)))) ) )
+   {
+      if (scu_codec_load(SCU_CODEC_BZIP2) != 0)
+      {
+         scu_input_close(inp);
+         return(SCU_ELIBRARY);
+      };
+      inp->codec = SCU_CODEC_BZIP2;
+      if (scu_bzip2.bzDecompressInit(&inp->bz2, 0, 0) != BZ_OK)
+      {
+         scu_input_close(inp);
+         errno = ENOMEM;
+         return(SCU_ERRNO);
+      };
+      inp->member = 1;
+   };
+#endif
+
+#ifdef USE_LZMA
+   if ( (len >= (ssize_t)sizeof(scm_magic_lzma)) && (!(memcmp(inp->buff, scm_magic_lzma, sizeof(scm_magic_lzma)))) )
+   {
+      if (scu_codec_load(SCU_CODEC_LZMA) != 0)
+      {
+         scu_input_close(inp);
+         return(SCU_ELIBRARY);
+      };
+      inp->codec = SCU_CODEC_LZMA;
+      if (scu_lzma.stream_decoder(&inp->lzma, UINT64_MAX, LZMA_CONCATENATED) != LZMA_OK)
+      {
+         scu_input_close(inp);
+         errno = ENOMEM;
+         return(SCU_ERRNO);
+      };
+   };
+#endif
+
+#ifdef USE_ZSTD
+   if ( (len >= (ssize_t)sizeof(scm_magic_zstd)) && (!(memcmp(inp->buff, scm_magic_zstd, sizeof(scm_magic_zstd)))) )
+   {
+      if (scu_codec_load(SCU_CODEC_ZSTD) != 0)
+      {
+         scu_input_close(inp);
+         return(SCU_ELIBRARY);
+      };
+      inp->codec = SCU_CODEC_ZSTD;
+      if ( ((inp->zstd = scu_zstd.createDStream()) == NULL) ||
+           (scu_zstd.isError(scu_zstd.initDStream(inp->zstd))) )
+      {
+         scu_input_close(inp);
+         errno = ENOMEM;
+         return(SCU_ERRNO);
+      };
+   };
+#endif
+
+   if ( (len >= (ssize_t)sizeof(scm_magic_z_lzw)) && (!(memcmp(inp->buff, scm_magic_z_lzw, sizeof(scm_magic_z_lzw)))) )
+   {
+      // liblzw parses the header itself and takes ownership of the fd
+      inp->codec = SCU_CODEC_LZW;
+      if ( (lseek(inp->fd, 0, SEEK_SET) == -1) ||
+           ((inp->lzw = lzw_fdopen(inp->fd)) == NULL) )
+      {
+         scu_input_close(inp);
+         return(SCU_ERRNO);
+      };
+      inp->inlen = 0;
+   };
+
+   *inpp = inp;
+
+   return(0);
+}
+
+
+#if defined(USE_BZIP2) || defined(USE_LZMA) || defined(USE_ZLIB) || defined(USE_ZSTD)
+/// fills input buffer from file once decoder has consumed previous data
+static ssize_t scu_input_fill(scu_input * inp)
+{
+   ssize_t len;
+
+   int     phase;
+
+   if ((inp->inlen > 0) || (inp->eof))
+      return((ssize_t)inp->inlen);
+
+   phase = SCU_STATS_SWAP(SCU_STATS_READ);
+   len   = read(inp->fd, inp->buff, inp->buffsize);
+   SCU_STATS_IN(len);
+   SCU_STATS_SET(phase);
+   if (len == -1)
+   {
+      inp->err = SCU_ERRNO;
+      return(-1);
+   };
+
+   inp->inptr  = inp->buff;
+   inp->inlen  = (size_t)len;
+   inp->inpos += len;
+   inp->eof    = (len == 0) ? 1 : 0;
+
+   return(len);
+}
+#endif
+
+
+const char * scu_input_gzip_backend(void)
+{
+#if defined(USE_LIBDEFLATE)
+   return("libdeflate");
+#elif defined(ZLIBNG_VERSION)
+   return("zlib-ng");
+#elif defined(USE_ZLIB)
+   return("zlib");
+#else
+   return("none");
+#endif
+}
+
+
+int scu_input_info(scu_input * inp, uint64_t * sizep, int * exactp)
+{
+   assert(inp    != NULL);
+   assert(sizep  != NULL);
+   assert(exactp != NULL);
+
+   *sizep  = (uint64_t)inp->sb.st_size;
+   *exactp = 1;
+
+   switch(inp->codec)
+   {
+      case SCU_CODEC_RAW:   return(0);
+      case SCU_CODEC_GZIP:  return(scu_input_info_gz(inp, sizep, exactp));
+      case SCU_CODEC_LZMA:  return(scu_input_info_lzma(inp, sizep, exactp));
+      case SCU_CODEC_ZSTD:  return(scu_input_info_zstd(inp, sizep, exactp));
+      default:
+      break;
+   };
+
+   // bzip2 and compress do not record the uncompressed size
+   return(scu_input_info_sample(inp, sizep, exactp));
+}
+
+
+/// returns length of gzip member from BGZF extra field, or 0 if not BGZF
+static size_t scu_input_bgzf_len(const uint8_t * hdr)
+{
+   if ( (hdr[0] != 0x1f) || (hdr[1] != 0x8b) || ((hdr[3] & 0x04) == 0) )
+      return(0);
+   if ( (hdr[12] != 'B') || (hdr[13] != 'C') || (hdr[14] != 2) || (hdr[15] != 0) )
+      return(0);
+   return((size_t)(hdr[16] | (hdr[17] << 8)) + 1);
+}
+
+
+/// walks gzip members using BGZF block sizes, otherwise decodes a sample
+static int scu_input_info_gz(scu_input * inp, uint64_t * sizep, int * exactp)
+{
+   int            rc;
+   off_t          pos;
+   off_t          len;
+   uint64_t       isize;
+   uint64_t       estimate;
+   uint8_t        hdr[18];
+   uint8_t        trailer[4];
+
+   *sizep = 0;
+   if (inp->sb.st_size < 18)
+      return(SCU_ECORRUPT);
+
+   // BGZF (bgzip, htslib) stores the length of each member in an extra field
+   for(pos = 0; (pos + 18) <= inp->sb.st_size; pos += len)
+   {
+      if (scu_input_pread(inp, hdr, sizeof(hdr), pos) != 0)
+         return(inp->err);
+      if ((len = (off_t)scu_input_bgzf_len(hdr)) == 0)
+         break;
+      if ((pos + len) > inp->sb.st_size)
+         return(SCU_ECORRUPT);
+      if (scu_input_pread(inp, trailer, sizeof(trailer), pos + len - 4) != 0)
+         return(inp->err);
+      *sizep += (uint64_t)trailer[0]       | ((uint64_t)trailer[1] << 8) |
+                ((uint64_t)trailer[2] << 16) | ((uint64_t)trailer[3] << 24);
+   };
+   if ( (pos > 0) && (pos >= inp->sb.st_size) )
+      return(0);
+
+   // ISIZE of the final member, as reported by gzip(1) -l, is only the
+   // size modulo 2^32 and does not include earlier members, so it cannot
+   // be trusted without decoding
+   if (scu_input_pread(inp, trailer, sizeof(trailer), inp->sb.st_size - 4) != 0)
+      return(inp->err);
+   isize = (uint64_t)trailer[0]       | ((uint64_t)trailer[1] << 8) |
+           ((uint64_t)trailer[2] << 16) | ((uint64_t)trailer[3] << 24);
+   if ((rc = scu_input_info_sample(inp, sizep, exactp)) != 0)
+      return(rc);
+   if ((*exactp))
+      return(0);
+
+   // a single member decodes to ISIZE plus a multiple of 2^32, the multiple
+   // nearest to the sampled estimate refines it unless the two disagree
+   // as they do for concatenated members
+   estimate = *sizep;
+   if (estimate > isize)
+      isize += ((estimate - isize + (UINT64_C(1) << 31)) >> 32) << 32;
+   if ( (isize >= (estimate - (estimate / 4))) && (isize <= (estimate + (estimate / 4))) )
+      *sizep = isize;
+
+   return(0);
+}
+
+
+#ifdef USE_LZMA
+/// sums uncompressed sizes recorded in the index of each xz stream
+static int scu_input_info_lzma(scu_input * inp, uint64_t * sizep, int * exactp)
+{
+   int                  rc;
+   off_t                pos;
+   size_t               in_pos;
+   uint64_t             memlimit;
+   uint64_t             ssize;
+   uint8_t              footer[LZMA_STREAM_HEADER_SIZE];
+   uint8_t            * buff;
+   lzma_index         * idx;
+   lzma_stream_flags    flags;
+
+   *sizep = 0;
+
+   // streams are located from the end of the file backwards
+   for(pos = inp->sb.st_size; pos > 0; pos -= (off_t)ssize)
+   {
+      if (pos < (2 * LZMA_STREAM_HEADER_SIZE))
+         return(SCU_ECORRUPT);
+      if (scu_input_pread(inp, footer, sizeof(footer), pos - LZMA_STREAM_HEADER_SIZE) != 0)
+         return(inp->err);
+
+      // stream padding is a multiple of four null bytes
+      if (!(footer[8] | footer[9] | footer[10] | footer[11]))
+      {
+         ssize = 4;
+         continue;
+      };
+
+      if (scu_lzma.stream_footer_decode(&flags, footer) != LZMA_OK)
+         return(SCU_ECORRUPT);
+      if ((off_t)flags.backward_size > (pos - (2 * LZMA_STREAM_HEADER_SIZE)))
+         return(SCU_ECORRUPT);
+      if ((buff = malloc((size_t)flags.backward_size)) == NULL)
+         return(SCU_ERRNO);
+      if (scu_input_pread(inp, buff, (size_t)flags.backward_size, pos - LZMA_STREAM_HEADER_SIZE - (off_t)flags.backward_size) != 0)
+      {
+         free(buff);
+         return(inp->err);
+      };
+
+      idx      = NULL;
+      in_pos   = 0;
+      memlimit = UINT64_MAX;
+      rc = scu_lzma.index_buffer_decode(&idx, &memlimit, NULL, buff, &in_pos, (size_t)flags.backward_size);
+      free(buff);
+      if (rc != LZMA_OK)
+         return( (rc == LZMA_MEM_ERROR) ? (errno = ENOMEM, SCU_ERRNO) : SCU_ECORRUPT );
+
+      *sizep += scu_lzma.index_uncompressed_size(idx);
+      ssize   = scu_lzma.index_stream_size(idx);
+      scu_lzma.index_end(idx, NULL);
+      if ((off_t)ssize > pos)
+         return(SCU_ECORRUPT);
+   };
+
+   *exactp = 1;
+
+   return(0);
+}
+#else
+static int scu_input_info_lzma(scu_input * inp, uint64_t * sizep, int * exactp)
+{
+   return(scu_input_info_sample(inp, sizep, exactp));
+}
+#endif
+
+
+/// estimates size by decoding the beginning of the file
+static int scu_input_info_sample(scu_input * inp, uint64_t * sizep, int * exactp)
+{
+   ssize_t        len;
+   uint64_t       total;
+   off_t          offset;
+   uint8_t      * buff;
+
+   if ((buff = malloc(SCU_INPUT_BUFF)) == NULL)
+      return(SCU_ERRNO);
+
+   total = 0;
+   while ( (total < SCU_INPUT_SAMPLE) && ((len = scu_input_read(inp, buff, SCU_INPUT_BUFF)) > 0) )
+      total += (uint64_t)len;
+   free(buff);
+   if (len == -1)
+      return(inp->err);
+
+   // entire file was decoded within the sample
+   if ((inp->done))
+   {
+      *sizep  = total;
+      *exactp = 1;
+      return(0);
+   };
+
+   if ((offset = scu_input_offset(inp)) < 1)
+      offset = 1;
+   *sizep  = (uint64_t)((double)total * ((double)inp->sb.st_size / (double)offset));
+   *exactp = 0;
+
+   return(0);
+}
+
+
+#ifdef USE_ZSTD
+/// sums frame content sizes while skipping frames block by block
+static int scu_input_info_zstd(scu_input * inp, uint64_t * sizep, int * exactp)
+{
+   int                  checksum;
+   off_t                pos;
+   uint32_t             magic;
+   uint32_t             bh;
+   size_t               hsize;
+   uint8_t              hdr[18];   // maximum frame header size
+   unsigned long long   fcs;
+   static const size_t  did_size[4] = { 0, 1, 2, 4 };
+   static const size_t  fcs_size[4] = { 0, 2, 4, 8 };
+
+   *sizep = 0;
+
+   for(pos = 0; pos < inp->sb.st_size; )
+   {
+      if (scu_input_pread(inp, hdr, 8, pos) != 0)
+         return(inp->err);
+      magic = (uint32_t)hdr[0] | ((uint32_t)hdr[1] << 8) | ((uint32_t)hdr[2] << 16) | ((uint32_t)hdr[3] << 24);
+
+      // skippable frames carry no content
+      if ((magic & 0xfffffff0) == 0x184d2a50)
+      {
+         pos += 8 + (off_t)((uint32_t)hdr[4] | ((uint32_t)hdr[5] << 8) | ((uint32_t)hdr[6] << 16) | ((uint32_t)hdr[7] << 24));
+         continue;
+      };
+      if (magic != 0xfd2fb528)
+         return( (pos == 0) ? SCU_ECORRUPT : 0 );
+
+      hsize  = 5 + (((hdr[4] & 0x20)) ? 0 : 1) + did_size[hdr[4] & 0x03] + fcs_size[hdr[4] >> 6];
+      hsize += ( ((hdr[4] >> 6) == 0) && ((hdr[4] & 0x20)) ) ? 1 : 0;
+      if (scu_input_pread(inp, hdr, hsize, pos) != 0)
+         return(inp->err);
+
+      // frames written without a content size require decoding
+      fcs = scu_zstd.getFrameContentSize(hdr, hsize);
+      if (fcs == ZSTD_CONTENTSIZE_ERROR)
+         return(SCU_ECORRUPT);
+      if (fcs == ZSTD_CONTENTSIZE_UNKNOWN)
+         return(scu_input_info_sample(inp, sizep, exactp));
+      *sizep += fcs;
+
+      // skip compressed blocks and checksum to locate the next frame
+      checksum = hdr[4] & 0x04;
+      pos     += (off_t)hsize;
+      do
+      {
+         if (scu_input_pread(inp, hdr, 3, pos) != 0)
+            return(inp->err);
+         bh   = (uint32_t)hdr[0] | ((uint32_t)hdr[1] << 8) | ((uint32_t)hdr[2] << 16);
+         if (((bh >> 1) & 0x03) == 3)
+            return(SCU_ECORRUPT);
+         pos += 3 + ( (((bh >> 1) & 0x03) == 1) ? 1 : (off_t)(bh >> 3) );
+      } while (!(bh & 0x01));
+      pos += ((checksum)) ? 4 : 0;
+   };
+
+   *exactp = 1;
+
+   return(0);
+}
+#else
+static int scu_input_info_zstd(scu_input * inp, uint64_t * sizep, int * exactp)
+{
+   return(scu_input_info_sample(inp, sizep, exactp));
+}
+#endif
+
+
+/// maps gzip file for whole-buffer decoding when a faster inflate is available
+#ifdef USE_LIBDEFLATE
+static void scu_input_map_gz(scu_input * inp)
+{
+   void        * map;
+   uint8_t       trailer[4];
+   size_t        cap;
+
+   if ( (inp->sb.st_size < 18) || ((uint64_t)inp->sb.st_size > (uint64_t)SIZE_MAX) )
+      return;
+   if (!(scu_codec_libdeflate_loaded()))
+      return;
+
+   // ISIZE of the final member sizes the output buffer, which grows
+   // for larger members of concatenated files up to SCU_INPUT_MAP_MAX
+   SCU_STATS_SYSCALL(1);
+   if (pread(inp->fd, trailer, sizeof(trailer), inp->sb.st_size - 4) != (ssize_t)sizeof(trailer))
+      return;
+   cap = (size_t)trailer[0]       | ((size_t)trailer[1] << 8) |
+         ((size_t)trailer[2] << 16) | ((size_t)trailer[3] << 24);
+   cap = (cap < SCU_INPUT_BUFF) ? SCU_INPUT_BUFF : cap;
+   if (cap > SCU_INPUT_MAP_MAX)
+      return;
+
+   if ((map = mmap(NULL, (size_t)inp->sb.st_size, PROT_READ, MAP_PRIVATE, inp->fd, 0)) == MAP_FAILED)
+      return;
+   madvise(map, (size_t)inp->sb.st_size, MADV_SEQUENTIAL);
+   inp->map    = map;
+   inp->maplen = (size_t)inp->sb.st_size;
+   if ( ((inp->ld = scu_libdeflate.alloc_decompressor()) == NULL) ||
+        ((inp->out = malloc(cap)) == NULL) )
+   {
+      scu_input_unmap_gz(inp);
+      return;
+   };
+   inp->outcap = cap;
+
+   // magic number is decoded from the mapping
+   inp->inlen = 0;
+   inp->inpos = 0;
+
+   return;
+}
+#elif defined(USE_ZLIB)
+static void scu_input_map_gz(scu_input * inp)
+{
+   assert(inp != NULL);
+   return;
+}
+#endif
+
+
+#if defined(USE_BZIP2) || defined(USE_ZLIB)
+/// determines if another member/stream follows the one just finished
+static int scu_input_next_member(scu_input * inp, const uint8_t * magic, size_t len)
+{
+   if (scu_input_fill(inp) == -1)
+      return(-1);
+   if (inp->inlen == 0)
+      return(0);
+   if (inp->inlen < len)
+      return(0);
+   if ((memcmp(inp->inptr, magic, len)))
+      return(0); // trailing garbage is ignored as gzip(1) does
+   return(1);
+}
+#endif
+
+
+off_t scu_input_offset(scu_input * inp)
+{
+   assert(inp != NULL);
+
+   // liblzw performs its own buffered reads of the descriptor
+   if (inp->codec == SCU_CODEC_LZW)
+      return(lseek(inp->fd, 0, SEEK_CUR));
+
+   return(inp->inpos - (off_t)inp->inlen);
+}
+
+
+int scu_input_open(scu_input ** inpp, const char * path)
+{
+   int            rc;
+   int            phase;
+
+   phase = SCU_STATS_SWAP(SCU_STATS_OPEN);
+   rc    = scu_input_open_file(inpp, path);
+   SCU_STATS_SET(phase);
+
+   return(rc);
+}
+
+
+/// verifies and opens file, then detects codec from its magic number
+static int scu_input_open_file(scu_input ** inpp, const char * path)
+{
+   int            rc;
+   scu_path       p;
+
+   assert(inpp != NULL);
+   assert(path != NULL);
+
+   *inpp = NULL;
+
+   // checks file for restriction validations and opens the verified file
+   if ((rc = scu_pathopen(&p, path, 0, O_RDONLY)) != 0)
+      return(rc);
+
+   // descriptor is owned by the input even if it fails
+   rc   = scu_input_fdopen(inpp, p.fd, &p.sb);
+   p.fd = -1;
+   scu_pathclose(&p);
+
+   return(rc);
+}
+
+
+/// reads exact number of bytes at offset without moving decoder position
+static int scu_input_pread(scu_input * inp, void * buff, size_t size, off_t offset)
+{
+   int     phase;
+   ssize_t len;
+
+   phase = SCU_STATS_SWAP(SCU_STATS_READ);
+   len   = pread(inp->fd, buff, size, offset);
+   SCU_STATS_IN(len);
+   SCU_STATS_SET(phase);
+   if (len == -1)
+   {
+      inp->err = SCU_ERRNO;
+      return(-1);
+   };
+   if ((size_t)len != size)
+   {
+      inp->err = SCU_ECORRUPT;
+      return(-1);
+   };
+
+   return(0);
+}
+
+
+ssize_t scu_input_read(scu_input * inp, void * buff, size_t size)
+{
+   int            phase;
+   ssize_t        len;
+
+   assert(inp  != NULL);
+   assert(buff != NULL);
+
+   if ((inp->done) || (size == 0))
+      return(0);
+
+   // decoders switch to the read phase while waiting on the file
+   phase = SCU_STATS_SWAP(SCU_STATS_DECODE);
+   switch(inp->codec)
+   {
+      case SCU_CODEC_GZIP:  len = scu_input_read_gz(inp, buff, size);   break;
+      case SCU_CODEC_BZIP2: len = scu_input_read_bz2(inp, buff, size);  break;
+      case SCU_CODEC_LZMA:  len = scu_input_read_lzma(inp, buff, size); break;
+      case SCU_CODEC_LZW:   len = scu_input_read_lzw(inp, buff, size);  break;
+      case SCU_CODEC_ZSTD:  len = scu_input_read_zstd(inp, buff, size); break;
+      default:              len = scu_input_read_raw(inp, buff, size);  break;
+   };
+   SCU_STATS_SET(phase);
+
+   return(len);
+}
+
+
+#ifdef USE_BZIP2
+static ssize_t scu_input_read_bz2(scu_input * inp, void * buff, size_t size)
+{
+   int rc;
+
+   inp->bz2.next_out  = buff;
+   inp->bz2.avail_out = (unsigned)size;
+
+   while ( (inp->bz2.avail_out == size) && (!(inp->done)) )
+   {
+      if (scu_input_fill(inp) == -1)
+         return(-1);
+      if (inp->inlen == 0)
+      {
+         inp->err = SCU_ECORRUPT;
+         return(-1);
+      };
+
+      inp->bz2.next_in  = (char *)inp->inptr;
+      inp->bz2.avail_in = (unsigned)inp->inlen;
+      rc = scu_bzip2.bzDecompress(&inp->bz2);
+      inp->inptr = (uint8_t *)inp->bz2.next_in;
+      inp->inlen = inp->bz2.avail_in;
+
+      if (rc == BZ_OK)
+         continue;
+      if (rc != BZ_STREAM_END)
+      {
+         inp->err = SCU_ECORRUPT;
+         return(-1);
+      };
+
+      // bzip2(1) decompresses concatenated streams
+      scu_bzip2.bzDecompressEnd(&inp->bz2);
+      inp->member = 0;
+      switch(scu_input_next_member(inp, scm_magic_bz2, sizeof(scm_magic_bz2)))
+      {
+         case -1:
+         return(-1);
+
+         case 0:
+         inp->done = 1;
+         break;
+
+         default:
+         memset(&inp->bz2, 0, sizeof(inp->bz2));
+         if (scu_bzip2.bzDecompressInit(&inp->bz2, 0, 0) != BZ_OK)
+         {
+            errno    = ENOMEM;
+            inp->err = SCU_ERRNO;
+            return(-1);
+         };
+         inp->member = 1;
+         break;
+      };
+   };
+
+   return((ssize_t)(size - inp->bz2.avail_out));
+}
+#else
+static ssize_t scu_input_read_bz2(scu_input * inp, void * buff, size_t size)
+{
+   assert(buff != NULL);
+   assert(size > 0);
+   inp->err = SCU_ECODEC;
+   return(-1);
+}
+#endif
+
+
+#ifdef USE_ZLIB
+static ssize_t scu_input_read_gz(scu_input * inp, void * buff, size_t size)
+{
+   int rc;
+
+#ifdef USE_LIBDEFLATE
+   if (inp->map != NULL)
+      return(scu_input_read_gz_map(inp, buff, size));
+#endif
+
+   inp->gz.next_out  = buff;
+   inp->gz.avail_out = (uInt)size;
+
+   while ( (inp->gz.avail_out == size) && (!(inp->done)) )
+   {
+      if (scu_input_fill(inp) == -1)
+         return(-1);
+      if (inp->inlen == 0)
+      {
+         inp->err = SCU_ECORRUPT;
+         return(-1);
+      };
+
+      inp->gz.next_in  = inp->inptr;
+      inp->gz.avail_in = (uInt)inp->inlen;
+      rc = scu_zlib.inflate(&inp->gz, Z_NO_FLUSH);
+      inp->inptr = inp->gz.next_in;
+      inp->inlen = inp->gz.avail_in;
+
+      if ( (rc == Z_OK) || (rc == Z_BUF_ERROR) )
+         continue;
+      if (rc != Z_STREAM_END)
+      {
+         inp->err = SCU_ECORRUPT;
+         if (rc == Z_MEM_ERROR)
+         {
+            errno    = ENOMEM;
+            inp->err = SCU_ERRNO;
+         };
+         return(-1);
+      };
+
+      // gzip(1) decompresses concatenated members
+      switch(scu_input_next_member(inp, scm_magic_gz, sizeof(scm_magic_gz)))
+      {
+         case -1:
+         return(-1);
+
+         case 0:
+         inp->done = 1;
+         break;
+
+         default:
+         scu_zlib.inflateReset(&inp->gz);
+         break;
+      };
+   };
+
+   return((ssize_t)(size - inp->gz.avail_out));
+}
+#else
+static ssize_t scu_input_read_gz(scu_input * inp, void * buff, size_t size)
+{
+   assert(buff != NULL);
+   assert(size > 0);
+   inp->err = SCU_ECODEC;
+   return(-1);
+}
+#endif
+
+
+#ifdef USE_LIBDEFLATE
+/// decodes whole gzip members from the mapped file
+static ssize_t scu_input_read_gz_map(scu_input * inp, void * buff, size_t size)
+{
+   size_t                  len;
+   size_t                  in_used;
+   size_t                  out_used;
+   uint8_t               * out;
+   enum libdeflate_result  rc;
+
+   while (inp->outpos == inp->outlen)
+   {
+      // gzip(1) decompresses concatenated members and ignores trailing garbage
+      if ( ((inp->maplen - inp->mappos) < sizeof(scm_magic_gz)) ||
+           ((memcmp(&inp->map[inp->mappos], scm_magic_gz, sizeof(scm_magic_gz)))) )
+      {
+         inp->done = 1;
+         return(0);
+      };
+
+      rc = scu_libdeflate.gzip_decompress_ex(inp->ld, &inp->map[inp->mappos], inp->maplen - inp->mappos,
+                                         inp->out, inp->outcap, &in_used, &out_used);
+      if (rc == LIBDEFLATE_INSUFFICIENT_SPACE)
+      {
+         // members too large to hold in memory are streamed through zlib
+         if ( ((inp->outcap * 2) > SCU_INPUT_MAP_MAX) ||
+              ((out = realloc(inp->out, inp->outcap * 2)) == NULL) )
+         {
+            if (lseek(inp->fd, (off_t)inp->mappos, SEEK_SET) == -1)
+            {
+               inp->err = SCU_ERRNO;
+               return(-1);
+            };
+            inp->inpos = (off_t)inp->mappos;
+            scu_input_unmap_gz(inp);
+            return(scu_input_read_gz(inp, buff, size));
+         };
+         inp->out     = out;
+         inp->outcap *= 2;
+         continue;
+      };
+      if (rc != LIBDEFLATE_SUCCESS)
+      {
+         inp->err = SCU_ECORRUPT;
+         return(-1);
+      };
+
+      inp->mappos += in_used;
+      inp->inpos   = (off_t)inp->mappos;
+      inp->outlen  = out_used;
+      inp->outpos  = 0;
+   };
+
+   len = inp->outlen - inp->outpos;
+   len = (len < size) ? len : size;
+   memcpy(buff, &inp->out[inp->outpos], len);
+   inp->outpos += len;
+
+   return((ssize_t)len);
+}
+#endif
+
+
+#ifdef USE_LZMA
+static ssize_t scu_input_read_lzma(scu_input * inp, void * buff, size_t size)
+{
+   lzma_ret ret;
+
+   inp->lzma.next_out  = buff;
+   inp->lzma.avail_out = size;
+
+   while ( (inp->lzma.avail_out == size) && (!(inp->done)) )
+   {
+      if (scu_input_fill(inp) == -1)
+         return(-1);
+
+      inp->lzma.next_in  = inp->inptr;
+      inp->lzma.avail_in = inp->inlen;
+      ret = scu_lzma.code(&inp->lzma, ((inp->eof)) ? LZMA_FINISH : LZMA_RUN);
+      inp->inptr = (uint8_t *)inp->lzma.next_in;
+      inp->inlen = inp->lzma.avail_in;
+
+      switch(ret)
+      {
+         case LZMA_OK:
+         break;
+
+         case LZMA_STREAM_END:
+         inp->done = 1;
+         break;
+
+         case LZMA_MEM_ERROR:
+         case LZMA_MEMLIMIT_ERROR:
+         errno    = ENOMEM;
+         inp->err = SCU_ERRNO;
+         return(-1);
+
+         default:
+         inp->err = SCU_ECORRUPT;
+         return(-1);
+      };
+   };
+
+   return((ssize_t)(size - inp->lzma.avail_out));
+}
+#else
+static ssize_t scu_input_read_lzma(scu_input * inp, void * buff, size_t size)
+{
+   assert(buff != NULL);
+   assert(size > 0);
+   inp->err = SCU_ECODEC;
+   return(-1);
+}
+#endif
+
+
+static ssize_t scu_input_read_lzw(scu_input * inp, void * buff, size_t size)
+{
+   ssize_t len;
+
+   if ((len = lzw_read(inp->lzw, buff, size)) == -1)
+   {
+      inp->err = SCU_ECORRUPT;
+      return(-1);
+   };
+   if (len == 0)
+      inp->done = 1;
+
+   return(len);
+}
+
+
+static ssize_t scu_input_read_raw(scu_input * inp, void * buff, size_t size)
+{
+   ssize_t len;
+
+   // return bytes consumed while detecting the magic number first
+   if (inp->inlen > 0)
+   {
+      len = (inp->inlen < size) ? (ssize_t)inp->inlen : (ssize_t)size;
+      memcpy(buff, inp->inptr, (size_t)len);
+      inp->inptr += len;
+      inp->inlen -= (size_t)len;
+      return(len);
+   };
+
+   SCU_STATS_SET(SCU_STATS_READ);
+   len = read(inp->fd, buff, size);
+   SCU_STATS_IN(len);
+   if (len == -1)
+   {
+      inp->err = SCU_ERRNO;
+      return(-1);
+   };
+   inp->inpos += len;
+
+   return(len);
+}
+
+
+#ifdef USE_ZSTD
+static ssize_t scu_input_read_zstd(scu_input * inp, void * buff, size_t size)
+{
+   size_t            rc;
+   ZSTD_inBuffer     in;
+   ZSTD_outBuffer    out;
+
+   out.dst  = buff;
+   out.size = size;
+   out.pos  = 0;
+
+   while ( (out.pos == 0) && (!(inp->done)) )
+   {
+      if (scu_input_fill(inp) == -1)
+         return(-1);
+      if (inp->inlen == 0)
+      {
+         // input ended on a frame boundary
+         if (inp->member == 0)
+         {
+            inp->done = 1;
+            break;
+         };
+         inp->err = SCU_ECORRUPT;
+         return(-1);
+      };
+
+      in.src  = inp->inptr;
+      in.size = inp->inlen;
+      in.pos  = 0;
+      rc = scu_zstd.decompressStream(inp->zstd, &out, &in);
+      inp->inptr += in.pos;
+      inp->inlen -= in.pos;
+
+      if ((scu_zstd.isError(rc)))
+      {
+         inp->err = SCU_ECORRUPT;
+         return(-1);
+      };
+
+      // a return of zero marks the end of a frame, more frames may follow
+      inp->member = (rc == 0) ? 0 : 1;
+   };
+
+   return((ssize_t)out.pos);
+}
+#else
+static ssize_t scu_input_read_zstd(scu_input * inp, void * buff, size_t size)
+{
+   assert(buff != NULL);
+   assert(size > 0);
+   inp->err = SCU_ECODEC;
+   return(-1);
+}
+#endif
+
+
+const struct stat * scu_input_stat(scu_input * inp)
+{
+   assert(inp != NULL);
+   return(&inp->sb);
+}
+
+
+#ifdef USE_ZLIB
+/// releases mapping and buffers of gzip fast path
+static void scu_input_unmap_gz(scu_input * inp)
+{
+#ifdef USE_LIBDEFLATE
+   if (inp->map != NULL)
+      munmap((void *)inp->map, inp->maplen);
+   if (inp->ld != NULL)
+      scu_libdeflate.free_decompressor(inp->ld);
+   free(inp->out);
+   inp->map    = NULL;
+   inp->ld     = NULL;
+   inp->out    = NULL;
+   inp->outlen = 0;
+   inp->outpos = 0;
+#else
+   assert(inp != NULL);
+#endif
+   return;
+}
+#endif
+
+
+int scu_input_verify(scu_input * inp, unsigned jobs)
+{
+#ifdef USE_ZLIB
+   int         rc;
+#endif
+   ssize_t     len;
+   uint8_t   * buff;
+
+   assert(inp != NULL);
+
+   // plain files do not carry an integrity check
+   if (inp->codec == SCU_CODEC_RAW)
+      return(SCU_ECODEC);
+
+#ifdef USE_ZLIB
+   // members of BGZF files are independent and are checked concurrently
+   if ( (inp->codec == SCU_CODEC_GZIP) && (jobs > 1) )
+      if ((rc = scu_input_verify_bgzf(inp, jobs)) != -1)
+         return(rc);
+#else
+   (void)jobs;
+#endif
+
+   // decoded data is discarded, a large buffer reduces decoder round trips
+   if ((buff = malloc(SCU_INPUT_VERIFY_BUFF)) == NULL)
+      return(SCU_ERRNO);
+
+   // decoders verify CRC32/ISIZE, block and stream CRCs, xz check fields,
+   // and zstd content checksums as each member or frame is completed
+   while ((len = scu_input_read(inp, buff, SCU_INPUT_VERIFY_BUFF)) > 0);
+   free(buff);
+
+   return((len == -1) ? inp->err : 0);
+}
+
+
+#ifdef USE_ZLIB
+/// verifies members of a BGZF file with up to jobs threads, returns -1 if
+/// the file is not a BGZF chain so the caller decodes it serially
+static int scu_input_verify_bgzf(scu_input * inp, unsigned jobs)
+{
+   int               rc;
+   size_t            pos;
+   size_t            len;
+   unsigned          x;
+   unsigned          started;
+   void            * map;
+   pthread_t       * threads;
+   scu_input_bgzf    bgzf;
+
+   if ( (inp->sb.st_size < 18) || ((uint64_t)inp->sb.st_size > (uint64_t)SIZE_MAX) )
+      return(-1);
+   if ((map = mmap(NULL, (size_t)inp->sb.st_size, PROT_READ, MAP_PRIVATE, inp->fd, 0)) == MAP_FAILED)
+      return(-1);
+
+   // the whole file must be a chain of BGZF members
+   for(pos = 0; (pos + 18) <= (size_t)inp->sb.st_size; pos += len)
+      if ( ((len = scu_input_bgzf_len((const uint8_t *)map + pos)) == 0) || ((pos + len) > (size_t)inp->sb.st_size) )
+         break;
+   if ( (pos != (size_t)inp->sb.st_size) || ((threads = calloc(jobs, sizeof(pthread_t))) == NULL) )
+   {
+      munmap(map, (size_t)inp->sb.st_size);
+      return(-1);
+   };
+
+   memset(&bgzf, 0, sizeof(bgzf));
+   bgzf.map    = map;
+   bgzf.maplen = (size_t)inp->sb.st_size;
+   bgzf.failed = bgzf.maplen;
+   pthread_mutex_init(&bgzf.mutex, NULL);
+   madvise(map, bgzf.maplen, MADV_SEQUENTIAL);
+
+   for(started = 0; started < jobs; started++)
+      if (pthread_create(&threads[started], NULL, scu_input_verify_bgzf_worker, &bgzf) != 0)
+         break;
+   if (started == 0)
+      scu_input_verify_bgzf_worker(&bgzf);
+   for(x = 0; x < started; x++)
+      pthread_join(threads[x], NULL);
+
+   pthread_mutex_destroy(&bgzf.mutex);
+   free(threads);
+   munmap(map, bgzf.maplen);
+
+   // offset of the failing member is reported as the decoder position
+   inp->inlen = 0;
+   inp->inpos = (off_t)bgzf.failed;
+   inp->done  = 1;
+   rc         = bgzf.err;
+   errno      = bgzf.errnum;
+
+   return(rc);
+}
+
+
+static void * scu_input_verify_bgzf_worker(void * arg)
+{
+   int               rc;
+   size_t            pos;
+   size_t            len;
+   uint8_t           buff[SCU_INPUT_BUFF];
+   z_stream          gz;
+   scu_input_bgzf  * bgzf;
+
+   bgzf = arg;
+
+   memset(&gz, 0, sizeof(gz));
+   if (scu_zlib.inflateInit2_(&gz, 15 + 16, ZLIB_VERSION, (int)sizeof(z_stream)) != Z_OK)
+   {
+      pthread_mutex_lock(&bgzf->mutex);
+      bgzf->err    = SCU_ERRNO;
+      bgzf->errnum = ENOMEM;
+      pthread_mutex_unlock(&bgzf->mutex);
+      return(NULL);
+   };
+
+   while(1)
+   {
+      // members are claimed in file order until the first failure
+      pthread_mutex_lock(&bgzf->mutex);
+      if ( (bgzf->next >= bgzf->maplen) || (bgzf->err != 0) )
+      {
+         pthread_mutex_unlock(&bgzf->mutex);
+         break;
+      };
+      pos          = bgzf->next;
+      len          = scu_input_bgzf_len(&bgzf->map[pos]);
+      bgzf->next  += len;
+      pthread_mutex_unlock(&bgzf->mutex);
+
+      // a member decodes to at most 64 KiB and is checked against its trailer
+      scu_zlib.inflateReset(&gz);
+      gz.next_in  = (Bytef *)(uintptr_t)&bgzf->map[pos];
+      gz.avail_in = (uInt)len;
+      do
+      {
+         gz.next_out  = buff;
+         gz.avail_out = (uInt)sizeof(buff);
+         rc = scu_zlib.inflate(&gz, Z_NO_FLUSH);
+      } while (rc == Z_OK);
+
+      if ( (rc != Z_STREAM_END) || (gz.avail_in != 0) )
+      {
+         pthread_mutex_lock(&bgzf->mutex);
+         if (pos < bgzf->failed)
+         {
+            bgzf->failed = pos;
+            bgzf->err    = (rc == Z_MEM_ERROR) ? SCU_ERRNO : SCU_ECORRUPT;
+            bgzf->errnum = (rc == Z_MEM_ERROR) ? ENOMEM    : 0;
+         };
+         pthread_mutex_unlock(&bgzf->mutex);
+      };
+   };
+
+   scu_zlib.inflateEnd(&gz);
+
+   return(NULL);
+}
+#endif
+
+
+/* end of source */
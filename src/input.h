@@ -0,0 +1,144 @@
+/*
+ *  Secure Core Utilities
+ *  Copyright (C) 2015, 2017 David M. Syzdek <david@syzdek.net>.
+ *
+ *  @SYZDEK_BSD_LICENSE_START@
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of David M. Syzdek nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ *  IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ *  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL DAVID M SYZDEK BE LIABLE FOR
+ *  ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ *  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ *  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ *  OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ *  SUCH DAMAGE.
+ *
+ *  @SYZDEK_BSD_LICENSE_END@
+ */
+/**
+ *  @file input.h
+ *  Shared input layer for reading plain and compressed files
+ */
+#ifndef __SRC_INPUT_H
+#define __SRC_INPUT_H 1
+
+
+///////////////
+//           //
+//  Headers  //
+//           //
+///////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Headers
+#endif
+
+#include "securecoreutils.h"
+
+#include <inttypes.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+
+///////////////////
+//               //
+//  Definitions  //
+//               //
+///////////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Definitions
+#endif
+
+#define SCU_CODEC_RAW      0
+#define SCU_CODEC_GZIP     1
+#define SCU_CODEC_BZIP2    2
+#define SCU_CODEC_LZMA     3
+#define SCU_CODEC_LZW      4
+#define SCU_CODEC_ZSTD     5
+
+#define SCU_INPUT_BUFF     65536
+#define SCU_INPUT_BUFF_MIN 4096
+#define SCU_INPUT_BUFF_MAX (16*1024*1024)
+#define SCU_INPUT_VERIFY_BUFF (1024*1024)
+#define SCU_INPUT_SAMPLE   (4*1024*1024)   // decoded bytes used to estimate size
+#define SCU_INPUT_MAP_MAX  (128*1024*1024) // largest gzip member decoded in memory
+
+
+//////////////////
+//              //
+//  Data Types  //
+//              //
+//////////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Data Types
+#endif
+
+typedef struct scu_input      scu_input;
+
+
+//////////////////
+//              //
+//  Prototypes  //
+//              //
+//////////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Prototypes
+#endif
+
+/// closes input and releases decoder state
+void scu_input_close(scu_input * inp);
+
+/// returns codec detected when input was opened
+int scu_input_codec(scu_input * inp);
+
+/// returns printable name of codec
+const char * scu_input_codec_name(int codec);
+
+/// returns name of library used to inflate gzip members
+const char * scu_input_gzip_backend(void);
+
+/// returns error code of last failed read
+int scu_input_error(scu_input * inp);
+
+/// reports uncompressed size from trailers and indexes without a full decode
+int scu_input_info(scu_input * inp, uint64_t * sizep, int * exactp);
+
+/// returns underlying file descriptor of input
+int scu_input_fd(scu_input * inp);
+
+/// detects codec of verified descriptor, which is closed with the input
+int scu_input_fdopen(scu_input ** inpp, int fd, const struct stat * sb);
+
+/// returns offset within compressed file of data consumed by decoder
+off_t scu_input_offset(scu_input * inp);
+
+/// validates path, opens file, and detects codec from magic number
+int scu_input_open(scu_input ** inpp, const char * path);
+
+/// reads decoded data from input
+ssize_t scu_input_read(scu_input * inp, void * buff, size_t size);
+
+/// returns file status obtained when input was opened
+const struct stat * scu_input_stat(scu_input * inp);
+
+/// decodes entire input without output, verifying codec integrity checks,
+/// members of BGZF files are checked by up to jobs threads
+int scu_input_verify(scu_input * inp, unsigned jobs);
+
+
+#endif /* end of header */
@@ -0,0 +1,327 @@
+/*
+ *  Secure Core Utilities
+ *  Copyright (C) 2015, 2017 David M. Syzdek <david@syzdek.net>.
+ *
+ *  @SYZDEK_BSD_LICENSE_START@
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of David M. Syzdek nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ *  IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ *  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL DAVID M SYZDEK BE LIABLE FOR
+ *  ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ *  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ *  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ *  OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ *  SUCH DAMAGE.
+ *
+ *  @SYZDEK_BSD_LICENSE_END@
+ */
+#include "journal.h"
+
+///////////////
+//           //
+//  Headers  //
+//           //
+///////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Headers
+#endif
+
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+
+//////////////////
+//              //
+//  Prototypes  //
+//              //
+//////////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Prototypes
+#endif
+
+static int scu_journal_check(const scu_journal_head * head, size_t len);
+#ifdef SCU_METRICS
+static int scu_journal_create(const char * path, size_t len);
+static int scu_journal_dir(const char * path);
+#endif
+
+
+/////////////////
+//             //
+//  Variables  //
+//             //
+/////////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Variables
+#endif
+
+static scu_journal_head * scu_journal_ring = NULL;
+
+
+/////////////////
+//             //
+//  Functions  //
+//             //
+/////////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Functions
+#endif
+
+void scu_journal_append(scu_config * cnf, int status)
+{
+   uint64_t             seq;
+   uid_t                uid;
+   char               * end;
+   const char         * str;
+   scu_stats          * st;
+   scu_journal_rec    * rec;
+
+   assert(cnf != NULL);
+
+   if ( (scu_journal_ring == NULL) || ((st = cnf->stats) == NULL) )
+      return;
+
+   // sudo runs widgets as root, records are kept for the original user
+   uid = getuid();
+   if ( (uid == 0) && ((str = getenv("SUDO_UID")) != NULL) && (str[0] != '\0') )
+   {
+      uid = (uid_t)strtoul(str, &end, 10);
+      if (end[0] != '\0')
+         uid = 0;
+   };
+
+   // concurrent invocations reserve distinct slots without a lock, a
+   // reader seeing seq change while copying discards the record
+   seq = __atomic_fetch_add(&scu_journal_ring->next, 1, __ATOMIC_RELAXED);
+   rec = (scu_journal_rec *)((char *)scu_journal_ring + SCU_JOURNAL_HEAD);
+   rec = &rec[seq & (scu_journal_ring->slots - 1)];
+   __atomic_store_n(&rec->seq, 0, __ATOMIC_RELAXED);
+   __atomic_thread_fence(__ATOMIC_RELEASE);
+
+   rec->time      = st->time;
+   rec->path      = st->path;
+   rec->bytes_in  = st->bytes_in;
+   rec->bytes_out = st->bytes_out;
+   rec->uid       = (uint32_t)uid;
+   rec->status    = (int32_t)status;
+   rec->wall      = st->mark - st->start;
+   rec->reserved  = 0;
+   memcpy(rec->ns, st->ns, sizeof(rec->ns));
+   memset(rec->widget, 0, sizeof(rec->widget));
+   strncpy(rec->widget, cnf->widget->name, sizeof(rec->widget) - 1);
+
+   __atomic_store_n(&rec->seq, seq + 1, __ATOMIC_RELEASE);
+
+   return;
+}
+
+
+/// verifies header describes a ring which fits in len bytes
+static int scu_journal_check(const scu_journal_head * head, size_t len)
+{
+   if (len < SCU_JOURNAL_HEAD)
+      return(-1);
+   if ( (head->magic != SCU_JOURNAL_MAGIC) || (head->recsize != sizeof(scu_journal_rec)) )
+      return(-1);
+   if ( (head->slots == 0) || ((head->slots & (head->slots - 1)) != 0) )
+      return(-1);
+   if (((size_t)head->slots * sizeof(scu_journal_rec)) > (len - SCU_JOURNAL_HEAD))
+      return(-1);
+   return(0);
+}
+
+
+#ifdef SCU_METRICS
+/// creates ring under temporary name and links it into place once the
+/// header is written, so other processes never map a partial file
+static int scu_journal_create(const char * path, size_t len)
+{
+   int                  fd;
+   char                 tmp[PATH_MAX];
+   scu_journal_head     head;
+
+   if (scu_journal_dir(path) == -1)
+      return(-1);
+   if (snprintf(tmp, sizeof(tmp), "%s.%ld", path, (long)getpid()) >= (int)sizeof(tmp))
+      return(-1);
+   if ((fd = open(tmp, O_RDWR|O_CREAT|O_EXCL|O_NOFOLLOW|O_CLOEXEC, 0600)) == -1)
+      return(-1);
+
+   memset(&head, 0, sizeof(head));
+   head.magic   = SCU_JOURNAL_MAGIC;
+   head.recsize = sizeof(scu_journal_rec);
+   head.slots   = SCU_JOURNAL_SLOTS;
+   if ( (ftruncate(fd, (off_t)len) == -1) ||
+        (pwrite(fd, &head, sizeof(head), 0) != (ssize_t)sizeof(head)) ||
+        ((link(tmp, path) == -1) && (errno != EEXIST)) )
+   {
+      close(fd);
+      unlink(tmp);
+      return(-1);
+   };
+   unlink(tmp);
+   close(fd);
+
+   // another invocation may have won the race to create the ring
+   return(open(path, O_RDWR|O_NOFOLLOW|O_CLOEXEC));
+}
+
+
+/// ring is only trusted in a directory writable by root alone
+static int scu_journal_dir(const char * path)
+{
+   char                 dir[PATH_MAX];
+   char               * ptr;
+   struct stat          sb;
+
+   strncpy(dir, path, sizeof(dir) - 1);
+   dir[sizeof(dir) - 1] = '\0';
+   if ( ((ptr = strrchr(dir, '/')) == NULL) || (ptr == dir) )
+      return(-1);
+   ptr[0] = '\0';
+
+   if ( (mkdir(dir, 0700) == -1) && (errno != EEXIST) )
+      return(-1);
+   if (lstat(dir, &sb) == -1)
+      return(-1);
+   if ( (!(S_ISDIR(sb.st_mode))) || (sb.st_uid != 0) || ((sb.st_mode & 022) != 0) )
+   {
+      errno = EPERM;
+      return(-1);
+   };
+   return(0);
+}
+#endif
+
+
+int scu_journal_map(const char * path, const scu_journal_head ** headp, size_t * lenp)
+{
+   int                  fd;
+   void               * map;
+   struct stat          sb;
+
+   assert(path  != NULL);
+   assert(headp != NULL);
+   assert(lenp  != NULL);
+
+   if ((fd = open(path, O_RDONLY|O_NOFOLLOW|O_CLOEXEC)) == -1)
+      return(SCU_ERRNO);
+   if (fstat(fd, &sb) == -1)
+   {
+      close(fd);
+      return(SCU_ERRNO);
+   };
+   if ( (!(S_ISREG(sb.st_mode))) || (sb.st_size < SCU_JOURNAL_HEAD) )
+   {
+      close(fd);
+      return(SCU_EFILE);
+   };
+
+   map = mmap(NULL, (size_t)sb.st_size, PROT_READ, MAP_SHARED, fd, 0);
+   close(fd);
+   if (map == MAP_FAILED)
+      return(SCU_ERRNO);
+   if (scu_journal_check(map, (size_t)sb.st_size) == -1)
+   {
+      munmap(map, (size_t)sb.st_size);
+      return(SCU_ECORRUPT);
+   };
+
+   *headp = map;
+   *lenp  = (size_t)sb.st_size;
+
+   return(0);
+}
+
+
+int scu_journal_open(void)
+{
+#ifdef SCU_METRICS
+   int                  fd;
+   size_t               len;
+   void               * map;
+   struct stat          sb;
+
+   // only root may append, other users neither create nor open the ring
+   if (geteuid() != 0)
+      return(0);
+
+   len = SCU_JOURNAL_HEAD + (SCU_JOURNAL_SLOTS * sizeof(scu_journal_rec));
+   if ((fd = open(SCU_METRICS, O_RDWR|O_NOFOLLOW|O_CLOEXEC)) == -1)
+   {
+      if (errno != ENOENT)
+         return(0);
+      if ((fd = scu_journal_create(SCU_METRICS, len)) == -1)
+         return(0);
+   };
+   if ( (fstat(fd, &sb) == -1) || (!(S_ISREG(sb.st_mode))) ||
+        (sb.st_uid != 0) || ((sb.st_mode & 022) != 0) || (sb.st_size < SCU_JOURNAL_HEAD) )
+   {
+      close(fd);
+      return(0);
+   };
+
+   // the mapping outlives the descriptor and is released at exit
+   map = mmap(NULL, (size_t)sb.st_size, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+   close(fd);
+   if (map == MAP_FAILED)
+      return(0);
+   if (scu_journal_check(map, (size_t)sb.st_size) == -1)
+   {
+      munmap(map, (size_t)sb.st_size);
+      return(0);
+   };
+   scu_journal_ring = map;
+
+   return(1);
+#else
+   return(0);
+#endif
+}
+
+
+int scu_journal_read(const scu_journal_head * head, uint64_t seq, scu_journal_rec * recp)
+{
+   uint64_t                seq1;
+   uint64_t                seq2;
+   const scu_journal_rec * rec;
+
+   assert(head != NULL);
+   assert(recp != NULL);
+
+   rec  = (const scu_journal_rec *)((const char *)head + SCU_JOURNAL_HEAD);
+   rec  = &rec[seq & (head->slots - 1)];
+   if ((seq1 = __atomic_load_n(&rec->seq, __ATOMIC_ACQUIRE)) != (seq + 1))
+      return(-1);
+   memcpy(recp, rec, sizeof(scu_journal_rec));
+   __atomic_thread_fence(__ATOMIC_ACQUIRE);
+   seq2 = __atomic_load_n(&rec->seq, __ATOMIC_RELAXED);
+
+   return((seq1 == seq2) ? 0 : -1);
+}
+
+/* end of source */
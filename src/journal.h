@@ -0,0 +1,133 @@
+/*
+ *  Secure Core Utilities
+ *  Copyright (C) 2015, 2017 David M. Syzdek <david@syzdek.net>.
+ *
+ *  @SYZDEK_BSD_LICENSE_START@
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of David M. Syzdek nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ *  IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ *  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL DAVID M SYZDEK BE LIABLE FOR
+ *  ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ *  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ *  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ *  OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ *  SUCH DAMAGE.
+ *
+ *  @SYZDEK_BSD_LICENSE_END@
+ */
+/**
+ *  @file journal.h
+ *  Ring of fixed-size records appended by every invocation
+ */
+#ifndef __SRC_JOURNAL_H
+#define __SRC_JOURNAL_H 1
+
+
+///////////////
+//           //
+//  Headers  //
+//           //
+///////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Headers
+#endif
+
+#include "securecoreutils.h"
+#include "stats.h"
+
+
+///////////////////
+//               //
+//  Definitions  //
+//               //
+///////////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Definitions
+#endif
+
+#define SCU_JOURNAL_MAGIC     0x314e524a55435300ULL   // "\0SCUJRN1"
+#define SCU_JOURNAL_SLOTS     16384                   // records kept, power of two
+#define SCU_JOURNAL_HEAD      4096                    // bytes before first record
+#define SCU_JOURNAL_WIDGET    16
+
+
+//////////////////
+//              //
+//  Data Types  //
+//              //
+//////////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Data Types
+#endif
+
+typedef struct scu_journal_head scu_journal_head;
+typedef struct scu_journal_rec  scu_journal_rec;
+
+
+struct scu_journal_head
+{
+   uint64_t             magic;
+   uint32_t             recsize;
+   uint32_t             slots;
+   uint64_t             next;       // next sequence number, reserved with an atomic add
+};
+
+
+// seq is zeroed while the record is written and set to its sequence
+// number plus one once complete, readers discard records it changed under
+struct scu_journal_rec
+{
+   uint64_t             seq;
+   uint64_t             time;                         // wall clock at start, nanoseconds
+   uint64_t             path;                         // hash of first checked path, 0 if none
+   uint64_t             bytes_in;
+   uint64_t             bytes_out;
+   uint32_t             uid;                          // user the widget acted for
+   int32_t              status;                       // exit code of widget
+   uint64_t             wall;                         // nanoseconds
+   uint64_t             ns[SCU_STATS_PHASES];
+   char                 widget[SCU_JOURNAL_WIDGET];
+   uint64_t             reserved;
+};
+
+
+//////////////////
+//              //
+//  Prototypes  //
+//              //
+//////////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Prototypes
+#endif
+
+/// appends record of run when journal was opened
+void scu_journal_append(scu_config * cnf, int status);
+
+/// maps journal file for reading, returns error code
+int scu_journal_map(const char * path, const scu_journal_head ** headp, size_t * lenp);
+
+/// maps journal for appending if configured and running as root, returns
+/// 1 if records will be appended
+int scu_journal_open(void);
+
+/// copies record of sequence number, returns -1 if overwritten or incomplete
+int scu_journal_read(const scu_journal_head * head, uint64_t seq, scu_journal_rec * recp);
+
+
+#endif /* end of header */
@@ -0,0 +1,262 @@
+/*
+ *  Secure Core Utilities
+ *  Copyright (C) 2015, 2017 David M. Syzdek <david@syzdek.net>.
+ *
+ *  @SYZDEK_BSD_LICENSE_START@
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of David M. Syzdek nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ *  IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ *  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL DAVID M SYZDEK BE LIABLE FOR
+ *  ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ *  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ *  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ *  OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ *  SUCH DAMAGE.
+ *
+ *  @SYZDEK_BSD_LICENSE_END@
+ */
+#include "securecoreutils.h"
+#include <libsecurecoreutils.h>
+
+///////////////
+//           //
+//  Headers  //
+//           //
+///////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Headers
+#endif
+
+#include <assert.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "input.h"
+#include "policy.h"
+#include "tail.h"
+
+
+///////////////////
+//               //
+//  Definitions  //
+//               //
+///////////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Definitions
+#endif
+
+// public values are part of the ABI and must never follow internal changes
+#if (SCU_LIB_ERRNO != SCU_ERRNO) || (SCU_LIB_EPOLFILE != SCU_EPOLFILE) || (SCU_LIB_ELIBRARY != SCU_ELIBRARY)
+#error "public error codes differ from internal error codes"
+#endif
+#if (SCU_LIB_TAIL_BYTES != SCU_TAIL_OBYTES) || (SCU_LIB_TAIL_START != SCU_TAIL_OBOL)
+#error "public tail flags differ from internal tail options"
+#endif
+
+
+//////////////////
+//              //
+//  Data Types  //
+//              //
+//////////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Data Types
+#endif
+
+struct scu_lib_file
+{
+   scu_input          * inp;
+};
+
+
+//////////////////
+//              //
+//  Prototypes  //
+//              //
+//////////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Prototypes
+#endif
+
+static int scu_lib_ready(void);
+
+
+/////////////////
+//             //
+//  Variables  //
+//             //
+/////////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Variables
+#endif
+
+static pthread_mutex_t  scu_lib_mutex  = PTHREAD_MUTEX_INITIALIZER;
+static int              scu_lib_loaded = 0;
+static int              scu_lib_status = 0;
+
+
+/////////////////
+//             //
+//  Functions  //
+//             //
+/////////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Functions
+#endif
+
+int scu_lib_api_version(void)
+{
+   return(SCU_LIB_API_VERSION);
+}
+
+
+void scu_lib_close(scu_lib_file * fp)
+{
+   if (fp == NULL)
+      return;
+   if (fp->inp != NULL)
+      scu_input_close(fp->inp);
+   free(fp);
+   return;
+}
+
+
+const char * scu_lib_codec(scu_lib_file * fp)
+{
+   assert(fp != NULL);
+   return(scu_input_codec_name(scu_input_codec(fp->inp)));
+}
+
+
+int scu_lib_init(const char * widget)
+{
+   pthread_mutex_lock(&scu_lib_mutex);
+   if (!(scu_lib_loaded))
+   {
+      scu_lib_status = scu_policy_load((widget != NULL) ? widget : "cat");
+      scu_lib_loaded = 1;
+   };
+   pthread_mutex_unlock(&scu_lib_mutex);
+   return(scu_lib_status);
+}
+
+
+int scu_lib_open(scu_lib_file ** fpp, const char * path)
+{
+   int                  rc;
+   scu_lib_file       * fp;
+
+   assert(fpp  != NULL);
+   assert(path != NULL);
+
+   *fpp = NULL;
+   if ((rc = scu_lib_ready()) != 0)
+      return(rc);
+   if ((fp = calloc(1, sizeof(scu_lib_file))) == NULL)
+      return(SCU_ERRNO);
+   if ((rc = scu_input_open(&fp->inp, path)) != 0)
+   {
+      free(fp);
+      return(rc);
+   };
+   *fpp = fp;
+
+   return(0);
+}
+
+
+int scu_lib_pathcheck(const char * path)
+{
+   int                  rc;
+   assert(path != NULL);
+   if ((rc = scu_lib_ready()) != 0)
+      return(rc);
+   return(scu_pathcheck(path, SCU_ONONE));
+}
+
+
+int scu_lib_range(scu_lib_file * fp, uint64_t offset, uint64_t len, scu_lib_output out, void * ctx)
+{
+   assert(fp  != NULL);
+   assert(out != NULL);
+   return(scu_tail_range(fp->inp, offset, len, out, ctx));
+}
+
+
+ssize_t scu_lib_read(scu_lib_file * fp, void * buff, size_t size, int * errp)
+{
+   ssize_t              len;
+
+   assert(fp   != NULL);
+   assert(buff != NULL);
+
+   if ( ((len = scu_input_read(fp->inp, buff, size)) == -1) && (errp != NULL) )
+      *errp = scu_input_error(fp->inp);
+
+   return(len);
+}
+
+
+/// policy is loaded with the default rules unless the caller chose others
+static int scu_lib_ready(void)
+{
+   return(scu_lib_init(NULL));
+}
+
+
+int scu_lib_stream(scu_lib_file * fp, scu_lib_output out, void * ctx)
+{
+   char                 buff[SCU_BUFF_MAX];
+   ssize_t              len;
+
+   assert(fp  != NULL);
+   assert(out != NULL);
+
+   while ((len = scu_input_read(fp->inp, buff, sizeof(buff))) > 0)
+      if ((*out)(ctx, buff, (size_t)len) == -1)
+         return(SCU_ERRNO);
+
+   return((len == -1) ? scu_input_error(fp->inp) : 0);
+}
+
+
+const char * scu_lib_strerror(int err)
+{
+   return(scu_strerror(err));
+}
+
+
+int scu_lib_tail(scu_lib_file * fp, int flags, uint64_t count, scu_lib_output out, void * ctx)
+{
+   assert(fp  != NULL);
+   assert(out != NULL);
+   flags &= SCU_LIB_TAIL_BYTES | SCU_LIB_TAIL_START;
+   count  = (count > INT64_MAX) ? INT64_MAX : count;
+   return(scu_tail(fp->inp, (size_t)flags, (off_t)count, out, ctx));
+}
+
+
+const char * scu_lib_version(void)
+{
+   return(PACKAGE_VERSION);
+}
+
+/* end of source */
@@ -0,0 +1,1034 @@
+/*
+ *  Secure Core Utilities
+ *  Copyright (C) 2015, 2017 David M. Syzdek <david@syzdek.net>.
+ *
+ *  @SYZDEK_BSD_LICENSE_START@
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of David M. Syzdek nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ *  IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ *  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL DAVID M SYZDEK BE LIABLE FOR
+ *  ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ *  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ *  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ *  OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ *  SUCH DAMAGE.
+ *
+ *  @SYZDEK_BSD_LICENSE_END@
+ */
+#include "policy.h"
+
+///////////////
+//           //
+//  Headers  //
+//           //
+///////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Headers
+#endif
+
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <grp.h>
+#include <pwd.h>
+
+
+///////////////////
+//               //
+//  Definitions  //
+//               //
+///////////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Definitions
+#endif
+
+#define SCU_POLICY_NONE       0xfffffffe   // widget is not named by any rule
+#define SCU_POLICY_SRC_MAX    (16*1024*1024)
+
+
+//////////////////
+//              //
+//  Data Types  //
+//              //
+//////////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Data Types
+#endif
+
+typedef struct scu_policy           scu_policy;
+typedef struct scu_policy_builder   scu_policy_builder;
+typedef struct scu_policy_entry     scu_policy_entry;
+typedef struct scu_policy_header    scu_policy_header;
+typedef struct scu_policy_node      scu_policy_node;
+typedef struct scu_policy_rule      scu_policy_rule;
+
+
+// image layout: header, nodes, child indexes, rules, labels, widget names
+struct scu_policy_header
+{
+   uint32_t             magic;
+   uint32_t             version;
+   uint64_t             src_dev;    // source file the image was compiled from
+   uint64_t             src_ino;
+   uint64_t             src_size;
+   int64_t              src_mtime;
+   uint32_t             src_mtime_nsec;
+   uint32_t             nnodes;
+   uint32_t             nchildren;
+   uint32_t             nrules;
+   uint32_t             nlabels;    // bytes of label data
+   uint32_t             nstrings;   // bytes of NUL terminated widget names
+};
+
+
+// radix trie node, children are sorted by the first byte of their label
+struct scu_policy_node
+{
+   uint32_t             label;
+   uint32_t             label_len;
+   uint32_t             child;
+   uint32_t             nchild;
+   uint32_t             rule;
+   uint32_t             nrule;
+};
+
+
+struct scu_policy_rule
+{
+   uint32_t             type;
+   uint32_t             widget;     // offset into widget names or SCU_POLICY_ANY
+   uint32_t             gid;        // group or SCU_POLICY_ANY
+};
+
+
+struct scu_policy_entry
+{
+   char               * key;
+   size_t               len;
+   scu_policy_rule      rule;
+};
+
+
+struct scu_policy_builder
+{
+   scu_policy_node    * nodes;
+   uint32_t           * children;
+   scu_policy_rule    * rules;
+   char               * labels;
+   char               * strings;
+   size_t               nnodes;
+   size_t               nchildren;
+   size_t               nrules;
+   size_t               nlabels;
+   size_t               nstrings;
+   size_t               max_nodes;
+   size_t               max_children;
+};
+
+
+struct scu_policy
+{
+   int                  enabled;
+   void               * image;
+   size_t               size;
+   uint32_t             widget;
+   int                  ngids;
+   uid_t                uid;        // user the groups belong to
+   gid_t              * gids;
+   const scu_policy_header * hdr;
+   const scu_policy_node   * nodes;
+   const uint32_t          * children;
+   const scu_policy_rule   * rules;
+   const char              * labels;
+   const char              * strings;
+};
+
+
+/////////////////
+//             //
+//  Variables  //
+//             //
+/////////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Variables
+#endif
+
+static scu_policy scu_policy_state;
+
+
+//////////////////
+//              //
+//  Prototypes  //
+//              //
+//////////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Prototypes
+#endif
+
+static int scu_policy_build(const char * src, int fd, const struct stat * sbp, char ** imagep, size_t * sizep);
+static int scu_policy_build_node(scu_policy_builder * b, scu_policy_entry * ents, size_t lo, size_t hi, size_t depth, uint32_t * idxp);
+static int scu_policy_compare(const void * a, const void * b);
+#ifdef SCU_POLICY
+static int scu_policy_groups(uid_t uid);
+static int scu_policy_invoker(void);
+static int scu_policy_map(const char * widget, const char * srcfile, const char * imgfile, int always);
+#endif
+static int scu_policy_parse(const char * src, char * buff, scu_policy_builder * b, scu_policy_entry ** entsp, size_t * countp);
+static int scu_policy_secure(const struct stat * sbp);
+#ifdef SCU_POLICY
+static int scu_policy_validate(const void * image, size_t size, const struct stat * sbp);
+#endif
+
+
+/////////////////
+//             //
+//  Functions  //
+//             //
+/////////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Functions
+#endif
+
+/// compiles policy source into an image in memory
+static int scu_policy_build(const char * src, int fd, const struct stat * sbp, char ** imagep, size_t * sizep)
+{
+   int                  rc;
+   size_t               count;
+   size_t               size;
+   size_t               x;
+   ssize_t              len;
+   uint32_t             root;
+   char               * buff;
+   char               * image;
+   scu_policy_entry   * ents;
+   scu_policy_header    hdr;
+   scu_policy_builder   b;
+
+   if (sbp->st_size > SCU_POLICY_SRC_MAX)
+   {
+      fprintf(stderr, "%s: %s: file too large\n", PROGRAM_NAME, src);
+      return(SCU_EPOLFILE);
+   };
+   if ((buff = malloc((size_t)sbp->st_size + 1)) == NULL)
+      return(SCU_ERRNO);
+   for(size = 0; (size < (size_t)sbp->st_size); size += (size_t)len)
+   {
+      if ((len = pread(fd, &buff[size], (size_t)sbp->st_size - size, (off_t)size)) == -1)
+      {
+         free(buff);
+         return(SCU_ERRNO);
+      };
+      if (len == 0)
+         break;
+   };
+   buff[size] = '\0';
+
+   memset(&b, 0, sizeof(b));
+   ents  = NULL;
+   count = 0;
+   if ((rc = scu_policy_parse(src, buff, &b, &ents, &count)) != 0)
+   {
+      free(ents);
+      free(buff);
+      free(b.rules);
+      free(b.labels);
+      free(b.strings);
+      return(rc);
+   };
+
+   // keys sharing a prefix become adjacent, which lets each node own a
+   // contiguous range of entries and of child slots
+   qsort(ents, count, sizeof(scu_policy_entry), scu_policy_compare);
+   rc = (count > 0) ? scu_policy_build_node(&b, ents, 0, count, 0, &root) : 0;
+   free(ents);
+   free(buff);
+   if (rc != 0)
+   {
+      free(b.nodes);
+      free(b.children);
+      free(b.rules);
+      free(b.labels);
+      free(b.strings);
+      return(rc);
+   };
+
+   memset(&hdr, 0, sizeof(hdr));
+   hdr.magic          = SCU_POLICY_MAGIC;
+   hdr.version        = SCU_POLICY_VERSION;
+   hdr.src_dev        = (uint64_t)sbp->st_dev;
+   hdr.src_ino        = (uint64_t)sbp->st_ino;
+   hdr.src_size       = (uint64_t)sbp->st_size;
+   hdr.src_mtime      = (int64_t)sbp->st_mtim.tv_sec;
+   hdr.src_mtime_nsec = (uint32_t)sbp->st_mtim.tv_nsec;
+   hdr.nnodes         = (uint32_t)b.nnodes;
+   hdr.nchildren      = (uint32_t)b.nchildren;
+   hdr.nrules         = (uint32_t)b.nrules;
+   hdr.nlabels        = (uint32_t)b.nlabels;
+   hdr.nstrings       = (uint32_t)b.nstrings;
+
+   size  = sizeof(hdr);
+   size += b.nnodes    * sizeof(scu_policy_node);
+   size += b.nchildren * sizeof(uint32_t);
+   size += b.nrules    * sizeof(scu_policy_rule);
+   size += b.nlabels + b.nstrings;
+   if ((image = malloc(size)) != NULL)
+   {
+      x = 0;
+      memcpy(&image[x], &hdr, sizeof(hdr));                                x += sizeof(hdr);
+      memcpy(&image[x], b.nodes, b.nnodes * sizeof(scu_policy_node));      x += b.nnodes * sizeof(scu_policy_node);
+      memcpy(&image[x], b.children, b.nchildren * sizeof(uint32_t));      x += b.nchildren * sizeof(uint32_t);
+      memcpy(&image[x], b.rules, b.nrules * sizeof(scu_policy_rule));      x += b.nrules * sizeof(scu_policy_rule);
+      memcpy(&image[x], b.labels, b.nlabels);                              x += b.nlabels;
+      memcpy(&image[x], b.strings, b.nstrings);
+   };
+
+   free(b.nodes);
+   free(b.children);
+   free(b.rules);
+   free(b.labels);
+   free(b.strings);
+
+   if (image == NULL)
+      return(SCU_ERRNO);
+
+   *imagep = image;
+   *sizep  = size;
+
+   return(0);
+}
+
+
+/// builds node for entries [lo, hi) which share their first depth bytes
+static int scu_policy_build_node(scu_policy_builder * b, scu_policy_entry * ents, size_t lo, size_t hi, size_t depth, uint32_t * idxp)
+{
+   size_t               lcp;
+   size_t               x;
+   size_t               y;
+   size_t               nchild;
+   size_t               slot;
+   uint32_t             idx;
+   uint32_t             child;
+   void               * ptr;
+   scu_policy_node    * node;
+
+   // sorted order means the first and last keys bound the common prefix
+   for(lcp = depth; (lcp < ents[lo].len) && (lcp < ents[hi-1].len); lcp++)
+      if (ents[lo].key[lcp] != ents[hi-1].key[lcp])
+         break;
+
+   if (b->nnodes == b->max_nodes)
+   {
+      b->max_nodes = (b->max_nodes == 0) ? 64 : (b->max_nodes * 2);
+      if ((ptr = realloc(b->nodes, b->max_nodes * sizeof(scu_policy_node))) == NULL)
+         return(SCU_ERRNO);
+      b->nodes = ptr;
+   };
+   idx  = (uint32_t)b->nnodes++;
+   node = &b->nodes[idx];
+   memset(node, 0, sizeof(scu_policy_node));
+
+   // label and rules, shorter keys sort first so exact matches lead the range
+   node->label     = (uint32_t)b->nlabels;
+   node->label_len = (uint32_t)(lcp - depth);
+   memcpy(&b->labels[b->nlabels], &ents[lo].key[depth], lcp - depth);
+   b->nlabels     += lcp - depth;
+   node->rule      = (uint32_t)b->nrules;
+   for(x = lo; ((x < hi) && (ents[x].len == lcp)); x++)
+      b->rules[b->nrules++] = ents[x].rule;
+   node->nrule     = (uint32_t)(b->nrules - node->rule);
+
+   // reserve contiguous child slots before descending
+   for(nchild = 0, y = x; (y < hi); nchild++)
+      for(child = (uint8_t)ents[y].key[lcp]; ((y < hi) && ((uint8_t)ents[y].key[lcp] == child)); y++);
+   if ((b->nchildren + nchild) > b->max_children)
+   {
+      while((b->nchildren + nchild) > b->max_children)
+         b->max_children = (b->max_children == 0) ? 64 : (b->max_children * 2);
+      if ((ptr = realloc(b->children, b->max_children * sizeof(uint32_t))) == NULL)
+         return(SCU_ERRNO);
+      b->children = ptr;
+   };
+   slot = b->nchildren;
+   b->nchildren += nchild;
+   b->nodes[idx].child  = (uint32_t)slot;
+   b->nodes[idx].nchild = (uint32_t)nchild;
+
+   for(y = x; (x < hi); x = y, slot++)
+   {
+      for(y = x; ((y < hi) && (ents[y].key[lcp] == ents[x].key[lcp])); y++);
+      if (scu_policy_build_node(b, ents, x, y, lcp, &child) != 0)
+         return(SCU_ERRNO);
+      b->children[slot] = child;
+   };
+
+   *idxp = idx;
+
+   return(0);
+}
+
+
+int scu_policy_check(const char * path)
+{
+   size_t                     len;
+   size_t                     pos;
+   size_t                     lo;
+   size_t                     hi;
+   size_t                     mid;
+   uint32_t                   idx;
+   uint32_t                   x;
+   int                        y;
+   uint8_t                    c;
+   const scu_policy         * pol;
+   const scu_policy_node    * node;
+   const scu_policy_rule    * rule;
+
+   assert(path != NULL);
+
+   pol = &scu_policy_state;
+   if (!(pol->enabled))
+      return(0);
+   if (pol->hdr->nnodes == 0)
+      return(SCU_EPOLICY);
+
+   len = strlen(path);
+   pos = 0;
+   idx = 0;
+   while(1)
+   {
+      node = &pol->nodes[idx];
+      if ((len - pos) < node->label_len)
+         return(SCU_EPOLICY);
+      if (memcmp(&path[pos], &pol->labels[node->label], node->label_len) != 0)
+         return(SCU_EPOLICY);
+      pos += node->label_len;
+
+      for(x = 0; (x < node->nrule); x++)
+      {
+         rule = &pol->rules[node->rule + x];
+         if ( (rule->widget != SCU_POLICY_ANY) && (rule->widget != pol->widget) )
+            continue;
+         if (rule->gid != SCU_POLICY_ANY)
+         {
+            for(y = 0; ((y < pol->ngids) && (pol->gids[y] != (gid_t)rule->gid)); y++);
+            if (y == pol->ngids)
+               continue;
+         };
+         switch(rule->type)
+         {
+            case SCU_POLICY_EXACT:
+            if (pos == len)
+               return(0);
+            break;
+
+            case SCU_POLICY_SUBTREE:
+            if (pos < len)
+               return(0);
+            break;
+
+            case SCU_POLICY_COMPONENT:
+            if (memchr(&path[pos], '/', len - pos) == NULL)
+               return(0);
+            break;
+
+            default:
+            break;
+         };
+      };
+
+      if (pos == len)
+         return(SCU_EPOLICY);
+
+      // binary search children by first byte of label
+      c  = (uint8_t)path[pos];
+      lo = node->child;
+      hi = (size_t)node->child + node->nchild;
+      while (lo < hi)
+      {
+         mid = lo + ((hi - lo) / 2);
+         if ((uint8_t)pol->labels[pol->nodes[pol->children[mid]].label] < c)
+            lo = mid + 1;
+         else
+            hi = mid;
+      };
+      if (lo == ((size_t)node->child + node->nchild))
+         return(SCU_EPOLICY);
+      idx = pol->children[lo];
+      if ((uint8_t)pol->labels[pol->nodes[idx].label] != c)
+         return(SCU_EPOLICY);
+   };
+}
+
+
+static int scu_policy_compare(const void * a, const void * b)
+{
+   int                        rc;
+   const scu_policy_entry   * ea = a;
+   const scu_policy_entry   * eb = b;
+   if ((rc = memcmp(ea->key, eb->key, (ea->len < eb->len) ? ea->len : eb->len)) != 0)
+      return(rc);
+   if (ea->len == eb->len)
+      return(0);
+   return((ea->len < eb->len) ? -1 : 1);
+}
+
+
+int scu_policy_compile(const char * src, const char * image)
+{
+   int                  rc;
+   int                  fd;
+   size_t               size;
+   size_t               off;
+   ssize_t              len;
+   char               * buff;
+   char                 tmpname[256];
+   scu_path             p;
+
+   assert(src   != NULL);
+   assert(image != NULL);
+
+   if ((rc = scu_pathopen(&p, src, SCU_ONOPOLICY, O_RDONLY)) != 0)
+      return(rc);
+   if ((rc = scu_policy_secure(&p.sb)) != 0)
+   {
+      scu_pathclose(&p);
+      return(rc);
+   };
+   rc = scu_policy_build(src, p.fd, &p.sb, &buff, &size);
+   scu_pathclose(&p);
+   if (rc != 0)
+      return(rc);
+
+   if ((rc = scu_pathopen(&p, image, SCU_ONOTEXISTS|SCU_ONOPOLICY, O_PATH)) != 0)
+   {
+      free(buff);
+      return(rc);
+   };
+   if (p.dirfd == -1)
+   {
+      free(buff);
+      errno = ENOENT;
+      return(SCU_ERRNO);
+   };
+   snprintf(tmpname, sizeof(tmpname), ".%s.tmp-%li", p.name, (long)getpid());
+
+   if ((fd = openat(p.dirfd, tmpname, O_WRONLY|O_CREAT|O_EXCL|O_NOFOLLOW|O_CLOEXEC, 0644)) == -1)
+   {
+      free(buff);
+      scu_pathclose(&p);
+      return(SCU_ERRNO);
+   };
+   for(off = 0; (off < size); off += (size_t)len)
+      if ((len = write(fd, &buff[off], size - off)) == -1)
+         break;
+   free(buff);
+
+   // descriptor is closed exactly once whether or not writing failed
+   rc = 0;
+   if ( (off < size) || (fchmod(fd, 0644) == -1) || (fsync(fd) == -1) )
+      rc = errno;
+   if ( (close(fd) == -1) && (rc == 0) )
+      rc = errno;
+
+   // rename is atomic, concurrent widgets map either the old or new image
+   if ( (rc == 0) && (renameat(p.dirfd, tmpname, p.dirfd, p.name) == -1) )
+      rc = errno;
+   if (rc != 0)
+   {
+      unlinkat(p.dirfd, tmpname, 0);
+      scu_pathclose(&p);
+      errno = rc;
+      return(SCU_ERRNO);
+   };
+   scu_pathclose(&p);
+
+   return(0);
+}
+
+
+#ifdef SCU_POLICY
+/// looks up groups of user, the previous user's groups are reused
+static int scu_policy_groups(uid_t uid)
+{
+   int                  ngids;
+   gid_t              * gids;
+   struct passwd      * pw;
+
+   if ( (scu_policy_state.gids != NULL) && (scu_policy_state.uid == uid) )
+      return(0);
+   free(scu_policy_state.gids);
+   scu_policy_state.gids  = NULL;
+   scu_policy_state.ngids = 0;
+   if ((pw = getpwuid(uid)) == NULL)
+      return(0);
+
+   ngids = 32;
+   gids  = NULL;
+   do
+   {
+      free(gids);
+      if ((gids = malloc(sizeof(gid_t) * (size_t)ngids)) == NULL)
+         return(SCU_ERRNO);
+   } while (getgrouplist(pw->pw_name, pw->pw_gid, gids, &ngids) == -1);
+   scu_policy_state.gids  = gids;
+   scu_policy_state.ngids = ngids;
+   scu_policy_state.uid   = uid;
+
+   return(0);
+}
+
+
+/// determines user the widget acts for and the groups of that user
+static int scu_policy_invoker(void)
+{
+   uid_t                uid;
+   const char         * str;
+   char               * end;
+
+   // sudo runs widgets as root, restrictions apply to the original user
+   uid = getuid();
+   if ( (uid == 0) && ((str = getenv("SUDO_UID")) != NULL) && (str[0] != '\0') )
+   {
+      uid = (uid_t)strtoul(str, &end, 10);
+      if (end[0] != '\0')
+         uid = 0;
+   };
+   if (uid == 0)
+      return(0);
+
+   scu_policy_state.enabled = 1;
+
+   return(scu_policy_groups(uid));
+}
+#endif
+
+
+int scu_policy_load(const char * widget)
+{
+   assert(widget != NULL);
+#ifdef SCU_POLICY
+   return(scu_policy_map(widget, SCU_POLICY, SCU_POLICY_IMAGE, 0));
+#else
+   return(0);
+#endif
+}
+
+
+int scu_policy_loaded(void)
+{
+#ifdef SCU_POLICY
+   return( (scu_policy_state.image != NULL) ? 1 : 0 );
+#else
+   return(0);
+#endif
+}
+
+
+int scu_policy_peer(uid_t uid)
+{
+#ifdef SCU_POLICY
+   scu_policy_state.enabled = 0;
+   if (uid == 0)
+      return(0);
+
+   // requests of other users are refused unless rules exist for them
+   if (scu_policy_state.image == NULL)
+      return(SCU_EPOLICY);
+   scu_policy_state.enabled = 1;
+   return(scu_policy_groups(uid));
+#else
+   return( (uid == 0) ? 0 : SCU_EPOLICY );
+#endif
+}
+
+
+int scu_policy_preload(const char * widget)
+{
+   assert(widget != NULL);
+#ifdef SCU_POLICY
+   return(scu_policy_map(widget, SCU_POLICY, SCU_POLICY_IMAGE, 1));
+#else
+   return(0);
+#endif
+}
+
+
+#ifdef SCU_POLICY
+/// maps image of policy source, compiling the source if the image is stale
+static int scu_policy_map(const char * widget, const char * srcfile, const char * imgfile, int always)
+{
+   int                  rc;
+   size_t               off;
+   void               * image;
+   size_t               size;
+   scu_path             src;
+   scu_path             p;
+   scu_policy         * pol;
+
+   assert(widget != NULL);
+
+   pol = &scu_policy_state;
+   if ((rc = scu_policy_invoker()) != 0)
+      return(rc);
+   if ( (!(pol->enabled)) && (!(always)) )
+      return(0);
+
+   // policy is optional, but once present it must be trustworthy
+   if ((rc = scu_pathopen(&src, srcfile, SCU_ONOTEXISTS|SCU_ONOPOLICY, O_RDONLY)) != 0)
+      return(rc);
+   if (src.fd == -1)
+   {
+      scu_pathclose(&src);
+      pol->enabled = 0;
+      return(0);
+   };
+   if ((rc = scu_policy_secure(&src.sb)) != 0)
+   {
+      scu_pathclose(&src);
+      return(rc);
+   };
+
+   // map compiled image if it matches the current source
+   image = NULL;
+   if ((rc = scu_pathopen(&p, imgfile, SCU_ONOTEXISTS|SCU_ONOPOLICY, O_RDONLY)) != 0)
+   {
+      scu_pathclose(&src);
+      return(rc);
+   };
+   if (p.fd != -1)
+   {
+      if ((rc = scu_policy_secure(&p.sb)) != 0)
+      {
+         scu_pathclose(&p);
+         scu_pathclose(&src);
+         return(rc);
+      };
+      size = (size_t)p.sb.st_size;
+      if (size >= sizeof(scu_policy_header))
+      {
+         if ((image = mmap(NULL, size, PROT_READ, MAP_PRIVATE, p.fd, 0)) == MAP_FAILED)
+            image = NULL;
+         if ( (image != NULL) && (scu_policy_validate(image, size, &src.sb) != 0) )
+         {
+            munmap(image, size);
+            image = NULL;
+         };
+      };
+   };
+   scu_pathclose(&p);
+
+   // stale or missing image falls back to compiling the source in memory
+   if (image == NULL)
+   {
+      if ((rc = scu_policy_build(srcfile, src.fd, &src.sb, (char **)&image, &size)) != 0)
+      {
+         scu_pathclose(&src);
+         return(rc);
+      };
+      if (scu_policy_validate(image, size, &src.sb) != 0)
+      {
+         free(image);
+         scu_pathclose(&src);
+         return(SCU_EPOLFILE);
+      };
+   };
+   scu_pathclose(&src);
+
+   pol->image    = image;
+   pol->size     = size;
+   pol->hdr      = image;
+   off           = sizeof(scu_policy_header);
+   pol->nodes    = (const scu_policy_node *)((const char *)image + off);
+   off          += pol->hdr->nnodes * sizeof(scu_policy_node);
+   pol->children = (const uint32_t *)((const char *)image + off);
+   off          += pol->hdr->nchildren * sizeof(uint32_t);
+   pol->rules    = (const scu_policy_rule *)((const char *)image + off);
+   off          += pol->hdr->nrules * sizeof(scu_policy_rule);
+   pol->labels   = (const char *)image + off;
+   off          += pol->hdr->nlabels;
+   pol->strings  = (const char *)image + off;
+
+   scu_policy_select(widget);
+
+   return(0);
+}
+#endif
+
+
+void scu_policy_select(const char * widget)
+{
+#ifdef SCU_POLICY
+   size_t               off;
+   scu_policy         * pol;
+
+   assert(widget != NULL);
+
+   pol = &scu_policy_state;
+   if ( (!(pol->enabled)) || (pol->image == NULL) )
+      return;
+
+   // resolve widget to its name offset once so lookups compare integers
+   pol->widget = SCU_POLICY_NONE;
+   for(off = 0; (off < pol->hdr->nstrings); off += strlen(&pol->strings[off]) + 1)
+      if (!(strcmp(&pol->strings[off], widget)))
+         pol->widget = (uint32_t)off;
+#else
+   assert(widget != NULL);
+#endif
+   return;
+}
+
+
+/// parses policy source into unsorted trie entries
+static int scu_policy_parse(const char * src, char * buff, scu_policy_builder * b, scu_policy_entry ** entsp, size_t * countp)
+{
+   size_t               count;
+   size_t               max;
+   size_t               keys;
+   size_t               len;
+   size_t               x;
+   unsigned             line;
+   char               * next;
+   char               * fields[4];
+   char               * save;
+   char               * end;
+   void               * ptr;
+   struct group       * gr;
+   scu_policy_entry   * ent;
+   scu_policy_entry   * ents;
+
+   ents  = NULL;
+   count = 0;
+   max   = 0;
+   keys  = 0;
+
+   for(line = 1; (buff != NULL); line++, buff = next)
+   {
+      if ((next = strchr(buff, '\n')) != NULL)
+         *next++ = '\0';
+      if ((end = strchr(buff, '#')) != NULL)
+         *end = '\0';
+
+      for(x = 0; (x < 4); x++)
+         fields[x] = strtok_r(((x == 0) ? buff : NULL), " \t\r", &save);
+      if (fields[0] == NULL)
+         continue;
+      if ( (fields[2] == NULL) || (fields[3] != NULL) )
+      {
+         fprintf(stderr, "%s: %s:%u: expected `widget group pattern'\n", PROGRAM_NAME, src, line);
+         *entsp = ents;
+         return(SCU_EPOLFILE);
+      };
+
+      if (count == max)
+      {
+         max = (max == 0) ? 64 : (max * 2);
+         if ((ptr = realloc(ents, max * sizeof(scu_policy_entry))) == NULL)
+         {
+            *entsp = ents;
+            return(SCU_ERRNO);
+         };
+         ents = ptr;
+      };
+      ent = &ents[count];
+      memset(ent, 0, sizeof(scu_policy_entry));
+
+      // pattern, trailing '/' allows the subtree and trailing '*' allows
+      // any name within the final component
+      ent->key       = fields[2];
+      ent->len       = strlen(fields[2]);
+      len            = ent->len;
+      ent->rule.type = SCU_POLICY_EXACT;
+      if (ent->key[len-1] == '*')
+      {
+         ent->rule.type = SCU_POLICY_COMPONENT;
+         ent->len--;
+      }
+      else if (ent->key[len-1] == '/')
+         ent->rule.type = SCU_POLICY_SUBTREE;
+      if (ent->key[0] != '/')
+      {
+         fprintf(stderr, "%s: %s:%u: %s: %s\n", PROGRAM_NAME, src, line, ent->key, scu_strerror(SCU_EANCHOR));
+         *entsp = ents;
+         return(SCU_EPOLFILE);
+      };
+      for(x = 1; (x < ent->len); x++)
+      {
+         if ( ((ent->key[x-1] == '.')||(ent->key[x-1] == '/')) &&
+              ((ent->key[x+0] == '.')||(ent->key[x+0] == '/')) )
+            break;
+         if (ent->key[x] == '*')
+            break;
+      };
+      if (x < ent->len)
+      {
+         fprintf(stderr, "%s: %s:%u: %s: %s\n", PROGRAM_NAME, src, line, ent->key, scu_strerror(SCU_EPATH));
+         *entsp = ents;
+         return(SCU_EPOLFILE);
+      };
+      keys += ent->len;
+
+      // group names are resolved now so lookups only compare ids
+      ent->rule.gid = SCU_POLICY_ANY;
+      if (strcmp(fields[1], "*") != 0)
+      {
+         if ((gr = getgrnam(fields[1])) == NULL)
+         {
+            fprintf(stderr, "%s: %s:%u: %s: unknown group\n", PROGRAM_NAME, src, line, fields[1]);
+            *entsp = ents;
+            return(SCU_EPOLFILE);
+         };
+         ent->rule.gid = (uint32_t)gr->gr_gid;
+      };
+
+      // widget names are stored once and referenced by offset
+      ent->rule.widget = SCU_POLICY_ANY;
+      if (strcmp(fields[0], "*") != 0)
+      {
+         for(x = 0; (x < b->nstrings); x += strlen(&b->strings[x]) + 1)
+            if (!(strcmp(&b->strings[x], fields[0])))
+               break;
+         if (x == b->nstrings)
+         {
+            len = strlen(fields[0]) + 1;
+            if ((ptr = realloc(b->strings, b->nstrings + len)) == NULL)
+            {
+               *entsp = ents;
+               return(SCU_ERRNO);
+            };
+            b->strings = ptr;
+            memcpy(&b->strings[b->nstrings], fields[0], len);
+            b->nstrings += len;
+         };
+         ent->rule.widget = (uint32_t)x;
+      };
+
+      count++;
+   };
+
+   // labels never exceed total key length and there is one rule per entry
+   if ((b->labels = malloc(keys + 1)) == NULL)
+   {
+      *entsp = ents;
+      return(SCU_ERRNO);
+   };
+   if ((b->rules = malloc((count + 1) * sizeof(scu_policy_rule))) == NULL)
+   {
+      *entsp = ents;
+      return(SCU_ERRNO);
+   };
+
+   *entsp  = ents;
+   *countp = count;
+
+   return(0);
+}
+
+
+/// verifies file is owned by root and only writable by root
+static int scu_policy_secure(const struct stat * sbp)
+{
+   if (sbp->st_uid != 0)
+      return(SCU_EPOLFILE);
+   if ((sbp->st_mode & (S_IWGRP|S_IWOTH)) != 0)
+      return(SCU_EPOLFILE);
+   return(0);
+}
+
+
+#ifdef SCU_POLICY
+/// verifies image is current and every index stays within its section
+static int scu_policy_validate(const void * image, size_t size, const struct stat * sbp)
+{
+   uint64_t                   total;
+   uint32_t                   x;
+   uint32_t                   y;
+   const char               * ptr;
+   const scu_policy_header  * hdr;
+   const scu_policy_node    * nodes;
+   const uint32_t           * children;
+   const scu_policy_rule    * rules;
+   const char               * strings;
+
+   if (size < sizeof(scu_policy_header))
+      return(SCU_EPOLFILE);
+   hdr = image;
+   if ( (hdr->magic != SCU_POLICY_MAGIC) || (hdr->version != SCU_POLICY_VERSION) )
+      return(SCU_EPOLFILE);
+   if ( (hdr->src_dev        != (uint64_t)sbp->st_dev)  ||
+        (hdr->src_ino        != (uint64_t)sbp->st_ino)  ||
+        (hdr->src_size       != (uint64_t)sbp->st_size) ||
+        (hdr->src_mtime      != (int64_t)sbp->st_mtim.tv_sec) ||
+        (hdr->src_mtime_nsec != (uint32_t)sbp->st_mtim.tv_nsec) )
+      return(SCU_EPOLFILE);
+
+   total  = sizeof(scu_policy_header);
+   total += (uint64_t)hdr->nnodes    * sizeof(scu_policy_node);
+   total += (uint64_t)hdr->nchildren * sizeof(uint32_t);
+   total += (uint64_t)hdr->nrules    * sizeof(scu_policy_rule);
+   total += (uint64_t)hdr->nlabels + hdr->nstrings;
+   if (total != (uint64_t)size)
+      return(SCU_EPOLFILE);
+
+   ptr      = (const char *)image + sizeof(scu_policy_header);
+   nodes    = (const scu_policy_node *)ptr;  ptr += hdr->nnodes * sizeof(scu_policy_node);
+   children = (const uint32_t *)ptr;         ptr += hdr->nchildren * sizeof(uint32_t);
+   rules    = (const scu_policy_rule *)ptr;  ptr += hdr->nrules * sizeof(scu_policy_rule);
+   ptr     += hdr->nlabels;
+   strings  = ptr;
+
+   if ( (hdr->nstrings > 0) && (strings[hdr->nstrings-1] != '\0') )
+      return(SCU_EPOLFILE);
+
+   // children always follow their parent, so walks cannot loop
+   for(x = 0; (x < hdr->nnodes); x++)
+   {
+      if ((uint64_t)nodes[x].label + nodes[x].label_len > hdr->nlabels)
+         return(SCU_EPOLFILE);
+      if ((uint64_t)nodes[x].child + nodes[x].nchild > hdr->nchildren)
+         return(SCU_EPOLFILE);
+      if ((uint64_t)nodes[x].rule + nodes[x].nrule > hdr->nrules)
+         return(SCU_EPOLFILE);
+      for(y = 0; (y < nodes[x].nchild); y++)
+      {
+         if ( (children[nodes[x].child + y] <= x) || (children[nodes[x].child + y] >= hdr->nnodes) )
+            return(SCU_EPOLFILE);
+         if (nodes[children[nodes[x].child + y]].label_len == 0)
+            return(SCU_EPOLFILE);
+      };
+   };
+   for(x = 0; (x < hdr->nrules); x++)
+   {
+      if ( (rules[x].type < SCU_POLICY_EXACT) || (rules[x].type > SCU_POLICY_COMPONENT) )
+         return(SCU_EPOLFILE);
+      if ( (rules[x].widget != SCU_POLICY_ANY) && (rules[x].widget >= hdr->nstrings) )
+         return(SCU_EPOLFILE);
+   };
+
+   return(0);
+}
+#endif
+
+/* end of source */
@@ -0,0 +1,113 @@
+/*
+ *  Secure Core Utilities
+ *  Copyright (C) 2015, 2017 David M. Syzdek <david@syzdek.net>.
+ *
+ *  @SYZDEK_BSD_LICENSE_START@
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of David M. Syzdek nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ *  IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ *  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL DAVID M SYZDEK BE LIABLE FOR
+ *  ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ *  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ *  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ *  OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ *  SUCH DAMAGE.
+ *
+ *  @SYZDEK_BSD_LICENSE_END@
+ */
+/**
+ *  @file policy.h
+ *  Compiled allow-list of paths per widget and invoking group
+ */
+#ifndef __SRC_POLICY_H
+#define __SRC_POLICY_H 1
+
+
+///////////////
+//           //
+//  Headers  //
+//           //
+///////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Headers
+#endif
+
+#include "securecoreutils.h"
+
+#include <inttypes.h>
+
+
+///////////////////
+//               //
+//  Definitions  //
+//               //
+///////////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Definitions
+#endif
+
+#define SCU_POLICY_MAGIC      0x50554353   // "SCUP"
+#define SCU_POLICY_VERSION    1
+#define SCU_POLICY_ANY        0xffffffff   // rule applies to every widget or group
+
+#define SCU_POLICY_EXACT      1     // pattern names a single path
+#define SCU_POLICY_SUBTREE    2     // pattern ends with '/', matches anything below
+#define SCU_POLICY_COMPONENT  3     // pattern ends with '*', matches within last component
+
+#ifdef SCU_POLICY
+#ifndef SCU_POLICY_IMAGE
+#define SCU_POLICY_IMAGE      SCU_POLICY ".bin"
+#endif
+#endif
+
+
+//////////////////
+//              //
+//  Prototypes  //
+//              //
+//////////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Prototypes
+#endif
+
+/// checks path against policy loaded for the current widget
+int scu_policy_check(const char * path);
+
+/// compiles policy source into a binary image
+int scu_policy_compile(const char * src, const char * image);
+
+/// loads policy image, compiling the source in memory if the image is stale
+int scu_policy_load(const char * widget);
+
+/// returns non-zero when a policy image is loaded
+int scu_policy_loaded(void);
+
+/// applies policy to requests of uid instead of the invoking user, fails
+/// for any uid other than root when no policy is loaded
+int scu_policy_peer(uid_t uid);
+
+/// loads policy image even when invoked by root, for services which check
+/// requests of other users with scu_policy_peer()
+int scu_policy_preload(const char * widget);
+
+/// applies rules of another widget from the loaded policy
+void scu_policy_select(const char * widget);
+
+
+#endif /* end of header */
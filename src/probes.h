@@ -0,0 +1,85 @@
+/*
+ *  Secure Core Utilities
+ *  Copyright (C) 2015, 2017 David M. Syzdek <david@syzdek.net>.
+ *
+ *  @SYZDEK_BSD_LICENSE_START@
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of David M. Syzdek nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ *  IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ *  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL DAVID M SYZDEK BE LIABLE FOR
+ *  ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ *  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ *  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ *  OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ *  SUCH DAMAGE.
+ *
+ *  @SYZDEK_BSD_LICENSE_END@
+ */
+/**
+ *  @file probes.h
+ *  Static tracepoints for bpftrace and other USDT consumers
+ */
+#ifndef __SRC_PROBES_H
+#define __SRC_PROBES_H 1
+
+
+///////////////
+//           //
+//  Headers  //
+//           //
+///////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Headers
+#endif
+
+#ifdef USE_USDT
+#include <sys/sdt.h>
+#endif
+
+
+///////////////////
+//               //
+//  Definitions  //
+//               //
+///////////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Definitions
+#endif
+
+// Probes of provider "securecoreutils", arguments are part of the
+// interface and are only ever appended to:
+//
+//    widget__start      (char * widget, int argc)
+//    widget__done       (char * widget, int rc)
+//    pathcheck__entry   (char * path, int opts)
+//    pathcheck__return  (char * path, int rc)
+//    zcat__block        (int64_t len, int64_t offset)   decoded bytes, compressed offset
+//    tail__wakeup       (int fd, int64_t len, int hub)  read after sleep or from hub
+//    write              (int fd, int64_t rc)           bytes written or -1
+//
+// each probe is a single nop until a tracer attaches
+#ifdef USE_USDT
+#define SCU_PROBE2(name, a, b)      DTRACE_PROBE2(securecoreutils, name, a, b)
+#define SCU_PROBE3(name, a, b, c)   DTRACE_PROBE3(securecoreutils, name, a, b, c)
+#else
+#define SCU_PROBE2(name, a, b)      do { } while(0)
+#define SCU_PROBE3(name, a, b, c)   do { } while(0)
+#endif
+
+#endif /* end of header */
@@ -0,0 +1,757 @@
+/*
+ *  Secure Core Utilities
+ *  Copyright (C) 2015, 2017 David M. Syzdek <david@syzdek.net>.
+ *
+ *  @SYZDEK_BSD_LICENSE_START@
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of David M. Syzdek nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ *  IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ *  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL DAVID M SYZDEK BE LIABLE FOR
+ *  ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ *  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ *  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ *  OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ *  SUCH DAMAGE.
+ *
+ *  @SYZDEK_BSD_LICENSE_END@
+ */
+#include "rmtree.h"
+
+///////////////
+//           //
+//  Headers  //
+//           //
+///////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Headers
+#endif
+
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <pthread.h>
+
+#include "uring.h"
+
+
+//////////////////
+//              //
+//  Data Types  //
+//              //
+//////////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Data Types
+#endif
+
+typedef struct scu_rmtree_deque  scu_rmtree_deque;
+typedef struct scu_rmtree_node   scu_rmtree_node;
+typedef struct scu_rmtree_pool   scu_rmtree_pool;
+typedef struct scu_rmtree_worker scu_rmtree_worker;
+
+
+// directory is removed by whichever thread drops the last reference,
+// one held while it is read and one by each subdirectory; the descriptor
+// is closed when unused and over budget, dev and ino verify reopening
+struct scu_rmtree_node
+{
+   scu_rmtree_node    * parent;
+   int                  fd;
+   int                  failed;
+   int                  opened;
+   unsigned             refs;
+   unsigned             users;
+   dev_t                dev;
+   ino_t                ino;
+   char                 name[];
+};
+
+
+// owner pushes and pops at the tail, idle threads steal from the head
+struct scu_rmtree_deque
+{
+   pthread_mutex_t      mutex;
+   scu_rmtree_node   ** nodes;
+   size_t               head;
+   size_t               tail;
+   size_t               size;
+};
+
+
+struct scu_rmtree_pool
+{
+   scu_config         * cnf;
+   const char         * path;
+   dev_t                dev;
+   uint64_t             mnt_id;
+   int                  use_mnt_id;
+   unsigned             jobs;
+   int                  failed;
+   size_t               files;
+   size_t               dirs;
+   size_t               queued;        // nodes waiting in deques
+   size_t               outstanding;   // nodes queued or being read
+   size_t               open;          // directory descriptors held by nodes
+   size_t               budget;        // descriptors kept open while unused
+   pthread_mutex_t      mutex;
+   pthread_mutex_t      fds;
+   pthread_cond_t       work;
+   scu_rmtree_deque   * deques;
+};
+
+
+struct scu_rmtree_worker
+{
+   scu_rmtree_pool    * pool;
+   unsigned             id;
+};
+
+
+//////////////////
+//              //
+//  Prototypes  //
+//              //
+//////////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Prototypes
+#endif
+
+static void scu_rmtree_drop(scu_rmtree_pool * pool, scu_rmtree_node * node);
+static int scu_rmtree_error(scu_rmtree_pool * pool, scu_rmtree_node * node, const char * name, const char * msg);
+static int scu_rmtree_hold(scu_rmtree_pool * pool, scu_rmtree_node * node, scu_rmtree_node * child);
+static int scu_rmtree_install(scu_rmtree_pool * pool, scu_rmtree_node * node, int fd);
+static int scu_rmtree_mount(scu_rmtree_pool * pool, int fd, uint64_t * mnt_idp, dev_t * devp);
+static int scu_rmtree_entry(scu_rmtree_pool * pool, unsigned id, scu_rmtree_node * node, const char * name, int type);
+static scu_rmtree_node * scu_rmtree_pop(scu_rmtree_pool * pool, unsigned id);
+static int scu_rmtree_push(scu_rmtree_pool * pool, unsigned id, scu_rmtree_node * node);
+static int scu_rmtree_read(scu_rmtree_pool * pool, unsigned id, scu_rmtree_node * node, char * buff);
+static void scu_rmtree_release(scu_rmtree_pool * pool, scu_rmtree_node * node, int held);
+static void scu_rmtree_unhold(scu_rmtree_pool * pool, scu_rmtree_node * node);
+static void * scu_rmtree_worker_main(void * arg);
+
+
+/////////////////
+//             //
+//  Functions  //
+//             //
+/////////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Functions
+#endif
+
+int scu_rmtree(scu_config * cnf, scu_path * pp, const char * path, unsigned jobs)
+{
+   unsigned             x;
+   unsigned             started;
+   rlim_t               budget;
+   struct rlimit        rl;
+   scu_rmtree_pool      pool;
+   scu_rmtree_node      top;
+   scu_rmtree_node    * root;
+   scu_rmtree_worker    workers[SCU_RMTREE_JOBS_MAX];
+   pthread_t            threads[SCU_RMTREE_JOBS_MAX];
+
+   assert(cnf  != NULL);
+   assert(pp   != NULL);
+   assert(path != NULL);
+
+   // each thread may keep SCU_RMTREE_FDS directories of its branch open,
+   // deeper levels are closed when unused and reopened when needed, so the
+   // thread count is bounded by the descriptor limit but not the depth
+   if ( (getrlimit(RLIMIT_NOFILE, &rl) == 0) && (rl.rlim_cur != RLIM_INFINITY) )
+   {
+      budget = (rl.rlim_cur > (2 * SCU_RMTREE_FDS)) ? (rl.rlim_cur - SCU_RMTREE_FDS) : SCU_RMTREE_FDS;
+      if ((budget / SCU_RMTREE_FDS) < jobs)
+         jobs = (unsigned)(budget / SCU_RMTREE_FDS);
+   };
+   jobs = (jobs < 1) ? 1 : jobs;
+
+   memset(&pool, 0, sizeof(pool));
+   pool.cnf    = cnf;
+   pool.path   = path;
+   pool.jobs   = jobs;
+   pool.budget = (size_t)jobs * SCU_RMTREE_FDS;
+   if (scu_rmtree_mount(&pool, pp->fd, &pool.mnt_id, &pool.dev) == -1)
+   {
+      fprintf(stderr, "%s: %s: %s: %s\n", PROGRAM_NAME, cnf->widget->name, path, strerror(errno));
+      return(1);
+   };
+
+   // verified parent is never removed, it only anchors the root
+   memset(&top, 0, sizeof(top));
+   top.fd     = pp->dirfd;
+   top.opened = 1;
+   top.refs   = 1;
+   top.users  = 1;
+   if ((root = calloc(1, sizeof(scu_rmtree_node) + strlen(pp->name) + 1)) == NULL)
+   {
+      fprintf(stderr, "%s: %s: %s\n", PROGRAM_NAME, cnf->widget->name, strerror(errno));
+      return(1);
+   };
+   strcpy(root->name, pp->name);
+   root->parent = &top;
+   root->fd     = pp->fd;
+   root->opened = 1;
+   root->dev    = pp->sb.st_dev;
+   root->ino    = pp->sb.st_ino;
+   root->refs   = 1;
+   top.refs++;
+   pool.open    = 1;
+   pp->fd       = -1;
+
+   if ((pool.deques = calloc(jobs, sizeof(scu_rmtree_deque))) == NULL)
+   {
+      fprintf(stderr, "%s: %s: %s\n", PROGRAM_NAME, cnf->widget->name, strerror(errno));
+      close(root->fd);
+      free(root);
+      return(1);
+   };
+   for(x = 0; (x < jobs); x++)
+      pthread_mutex_init(&pool.deques[x].mutex, NULL);
+   pthread_mutex_init(&pool.mutex, NULL);
+   pthread_mutex_init(&pool.fds, NULL);
+   pthread_cond_init(&pool.work, NULL);
+
+   scu_rmtree_push(&pool, 0, root);
+
+   for(started = 1; (started < jobs); started++)
+   {
+      workers[started].pool = &pool;
+      workers[started].id   = started;
+      if (pthread_create(&threads[started], NULL, scu_rmtree_worker_main, &workers[started]) != 0)
+         break;
+   };
+   workers[0].pool = &pool;
+   workers[0].id   = 0;
+   scu_rmtree_worker_main(&workers[0]);
+   for(x = 1; (x < started); x++)
+      pthread_join(threads[x], NULL);
+
+   if ((cnf->verbose))
+      printf("%s: %s: removed %zu files and %zu directories using %u threads\n", PROGRAM_NAME, cnf->widget->name, pool.files, pool.dirs, started);
+
+   for(x = 0; (x < jobs); x++)
+   {
+      free(pool.deques[x].nodes);
+      pthread_mutex_destroy(&pool.deques[x].mutex);
+   };
+   free(pool.deques);
+   pthread_cond_destroy(&pool.work);
+   pthread_mutex_destroy(&pool.fds);
+   pthread_mutex_destroy(&pool.mutex);
+
+   return((pool.failed) ? 1 : 0);
+}
+
+
+/// closes descriptor of a directory which is being removed
+static void scu_rmtree_drop(scu_rmtree_pool * pool, scu_rmtree_node * node)
+{
+   int                  fd;
+
+   pthread_mutex_lock(&pool->fds);
+   fd       = node->fd;
+   node->fd = -1;
+   pool->open -= (fd != -1) ? 1 : 0;
+   pthread_mutex_unlock(&pool->fds);
+   if (fd != -1)
+      close(fd);
+
+   return;
+}
+
+
+/// reports failure and marks directory so its ancestors are kept
+static int scu_rmtree_error(scu_rmtree_pool * pool, scu_rmtree_node * node, const char * name, const char * msg)
+{
+   scu_rmtree_node    * ptr;
+   char                 path[PATH_MAX];
+   char                 tmp[PATH_MAX];
+
+   __atomic_store_n(&node->failed, 1, __ATOMIC_RELAXED);
+   __atomic_store_n(&pool->failed, 1, __ATOMIC_RELAXED);
+   if ((pool->cnf->quiet))
+      return(-1);
+
+   // rebuild path relative to the root for the message, the root itself
+   // is named by the path given on the command line
+   snprintf(path, sizeof(path), "%s", ((name != NULL) && (node->parent != NULL)) ? name : "");
+   for(ptr = node; ((ptr != NULL) && (ptr->parent != NULL) && (ptr->parent->parent != NULL)); ptr = ptr->parent)
+   {
+      if (snprintf(tmp, sizeof(tmp), "%s%s%s", ptr->name, ((path[0] != '\0') ? "/" : ""), path) >= (int)sizeof(tmp))
+         break;
+      memcpy(path, tmp, sizeof(path));
+   };
+   fprintf(stderr, "%s: %s: %s%s%s: %s\n", PROGRAM_NAME, pool->cnf->widget->name, pool->path,
+           ((path[0] != '\0') ? "/" : ""), path, msg);
+
+   return(-1);
+}
+
+
+/// holds descriptor of directory open for the caller, a closed directory is
+/// reopened through ".." of its held child or else from its nearest open
+/// ancestor down, each level verified against the recorded dev and ino
+static int scu_rmtree_hold(scu_rmtree_pool * pool, scu_rmtree_node * node, scu_rmtree_node * child)
+{
+   int                  rc;
+   int                  fd;
+   size_t               count;
+   size_t               x;
+   scu_rmtree_node    * ptr;
+   scu_rmtree_node   ** branch;
+
+   pthread_mutex_lock(&pool->fds);
+   if (node->fd != -1)
+   {
+      node->users++;
+      pthread_mutex_unlock(&pool->fds);
+      return(0);
+   };
+   pthread_mutex_unlock(&pool->fds);
+
+   // walking up from a child costs one open regardless of depth
+   if (child != NULL)
+   {
+      fd = openat(child->fd, "..", O_RDONLY|O_DIRECTORY|O_NOFOLLOW|O_CLOEXEC|O_NOCTTY);
+      return(scu_rmtree_install(pool, node, fd));
+   };
+
+   // branch lists the directory and its ancestors, the root's parent is
+   // never closed and ends the search for an open ancestor
+   for(count = 0, ptr = node; (ptr != NULL); ptr = ptr->parent)
+      count++;
+   if ((branch = malloc(count * sizeof(scu_rmtree_node *))) == NULL)
+      return(-1);
+   for(x = 0, ptr = node; (ptr != NULL); ptr = ptr->parent)
+      branch[x++] = ptr;
+   pthread_mutex_lock(&pool->fds);
+   for(x = 0; (branch[x]->fd == -1); x++);
+   branch[x]->users++;
+   pthread_mutex_unlock(&pool->fds);
+
+   for(rc = 0; ((x > 0) && (rc == 0)); x--)
+   {
+      fd = openat(branch[x]->fd, branch[x-1]->name, O_RDONLY|O_DIRECTORY|O_NOFOLLOW|O_CLOEXEC|O_NOCTTY);
+      rc = scu_rmtree_install(pool, branch[x-1], fd);
+      scu_rmtree_unhold(pool, branch[x]);
+   };
+   free(branch);
+
+   return(rc);
+}
+
+
+/// records opened descriptor of directory as held by the caller
+static int scu_rmtree_install(scu_rmtree_pool * pool, scu_rmtree_node * node, int fd)
+{
+   struct stat          sb;
+
+   if (fd == -1)
+      return(-1);
+   if (fstat(fd, &sb) == -1)
+   {
+      close(fd);
+      return(-1);
+   };
+   if ( ((node->opened)) && ((sb.st_dev != node->dev) || (sb.st_ino != node->ino)) )
+   {
+      close(fd);
+      errno = ESTALE;
+      return(-1);
+   };
+
+   pthread_mutex_lock(&pool->fds);
+   if (node->fd == -1)
+   {
+      node->fd = fd;
+      pool->open++;
+      fd = -1;
+   };
+   if (!(node->opened))
+   {
+      node->dev    = sb.st_dev;
+      node->ino    = sb.st_ino;
+      node->opened = 1;
+   };
+   node->users++;
+   pthread_mutex_unlock(&pool->fds);
+   if (fd != -1)
+      close(fd);
+
+   return(0);
+}
+
+
+/// identifies mount of directory, statx() tells apart bind mounts of one device
+static int scu_rmtree_mount(scu_rmtree_pool * pool, int fd, uint64_t * mnt_idp, dev_t * devp)
+{
+   struct stat          sb;
+#if defined(HAVE_STATX) && defined(STATX_MNT_ID)
+   struct statx         stx;
+
+   if ( (statx(fd, "", AT_EMPTY_PATH|AT_SYMLINK_NOFOLLOW, STATX_MNT_ID, &stx) == 0) &&
+        ((stx.stx_mask & STATX_MNT_ID) != 0) )
+   {
+      pool->use_mnt_id = 1;
+      *mnt_idp = stx.stx_mnt_id;
+   };
+#else
+   (void)pool;
+   *mnt_idp = 0;
+#endif
+   if (fstat(fd, &sb) == -1)
+      return(-1);
+   *devp = sb.st_dev;
+   return(0);
+}
+
+
+/// takes newest node of own deque, or oldest node of another thread's deque
+static scu_rmtree_node * scu_rmtree_pop(scu_rmtree_pool * pool, unsigned id)
+{
+   unsigned             x;
+   scu_rmtree_deque   * dq;
+   scu_rmtree_node    * node;
+
+   node = NULL;
+   dq   = &pool->deques[id];
+   pthread_mutex_lock(&dq->mutex);
+   if (dq->tail > dq->head)
+      node = dq->nodes[--dq->tail];
+   pthread_mutex_unlock(&dq->mutex);
+
+   // stealing the oldest entry takes the largest remaining subtree
+   for(x = 1; ((node == NULL) && (x < pool->jobs)); x++)
+   {
+      dq = &pool->deques[(id + x) % pool->jobs];
+      pthread_mutex_lock(&dq->mutex);
+      if (dq->tail > dq->head)
+         node = dq->nodes[dq->head++];
+      pthread_mutex_unlock(&dq->mutex);
+   };
+
+   if (node != NULL)
+   {
+      pthread_mutex_lock(&pool->mutex);
+      pool->queued--;
+      pthread_mutex_unlock(&pool->mutex);
+   };
+
+   return(node);
+}
+
+
+static int scu_rmtree_push(scu_rmtree_pool * pool, unsigned id, scu_rmtree_node * node)
+{
+   size_t               size;
+   void               * ptr;
+   scu_rmtree_deque   * dq;
+
+   dq = &pool->deques[id];
+   pthread_mutex_lock(&dq->mutex);
+   if (dq->head == dq->tail)
+   {
+      dq->head = 0;
+      dq->tail = 0;
+   };
+   if (dq->tail == dq->size)
+   {
+      if (dq->head > 0)
+      {
+         memmove(dq->nodes, &dq->nodes[dq->head], (dq->tail - dq->head) * sizeof(scu_rmtree_node *));
+         dq->tail -= dq->head;
+         dq->head  = 0;
+      } else {
+         size = (dq->size == 0) ? 64 : (dq->size * 2);
+         if ((ptr = realloc(dq->nodes, size * sizeof(scu_rmtree_node *))) == NULL)
+         {
+            pthread_mutex_unlock(&dq->mutex);
+            return(-1);
+         };
+         dq->nodes = ptr;
+         dq->size  = size;
+      };
+   };
+   // counted before it becomes visible so a thief can never finish
+   // the node ahead of its accounting
+   pthread_mutex_lock(&pool->mutex);
+   pool->queued++;
+   pool->outstanding++;
+   pthread_mutex_unlock(&pool->mutex);
+   dq->nodes[dq->tail++] = node;
+   pthread_mutex_unlock(&dq->mutex);
+
+   pthread_mutex_lock(&pool->mutex);
+   pthread_cond_signal(&pool->work);
+   pthread_mutex_unlock(&pool->mutex);
+
+   return(0);
+}
+
+
+/// queues subdirectory, returns 1 if entry is a file to be unlinked
+static int scu_rmtree_entry(scu_rmtree_pool * pool, unsigned id, scu_rmtree_node * node, const char * name, int type)
+{
+   size_t               len;
+   struct stat          sb;
+   scu_rmtree_node    * child;
+
+   if ( (!(strcmp(name, "."))) || (!(strcmp(name, ".."))) )
+      return(0);
+   if (type == DT_UNKNOWN)
+   {
+      if (fstatat(node->fd, name, &sb, AT_SYMLINK_NOFOLLOW) == -1)
+      {
+         scu_rmtree_error(pool, node, name, strerror(errno));
+         return(0);
+      };
+      type = (S_ISDIR(sb.st_mode)) ? DT_DIR : DT_REG;
+   };
+   if (type != DT_DIR)
+      return(1);
+
+   len = strlen(name);
+   if ((child = calloc(1, sizeof(scu_rmtree_node) + len + 1)) == NULL)
+   {
+      scu_rmtree_error(pool, node, name, strerror(errno));
+      return(0);
+   };
+   memcpy(child->name, name, len + 1);
+   child->parent = node;
+   child->fd     = -1;
+   child->refs   = 1;
+   __atomic_add_fetch(&node->refs, 1, __ATOMIC_RELAXED);
+   if (scu_rmtree_push(pool, id, child) == -1)
+   {
+      __atomic_sub_fetch(&node->refs, 1, __ATOMIC_RELAXED);
+      free(child);
+      scu_rmtree_error(pool, node, name, strerror(ENOMEM));
+      return(0);
+   };
+
+   return(0);
+}
+
+
+/// removes files of directory and queues its subdirectories, returns 0
+/// with the descriptor of the directory held
+static int scu_rmtree_read(scu_rmtree_pool * pool, unsigned id, scu_rmtree_node * node, char * buff)
+{
+   int                  opened;
+   uint64_t             mnt_id;
+   dev_t                dev;
+#ifdef HAVE_GETDENTS64
+   int                  errs[SCU_RMTREE_BUFF / 24];
+   size_t               count;
+   size_t               x;
+   ssize_t              nread;
+   ssize_t              off;
+   const char         * names[SCU_RMTREE_BUFF / 24];
+   struct dirent64    * de;
+#else
+   int                  fd;
+   DIR                * dp;
+   struct dirent      * de;
+#endif
+
+   // directories are opened relative to their verified parent and never
+   // through a symbolic link
+   opened = node->opened;
+   if (scu_rmtree_hold(pool, node, NULL) == -1)
+   {
+      scu_rmtree_error(pool, node->parent, node->name, strerror(errno));
+      node->failed = 1;
+      return(-1);
+   };
+   if (!(opened))
+   {
+      if (scu_rmtree_mount(pool, node->fd, &mnt_id, &dev) == -1)
+      {
+         scu_rmtree_error(pool, node, NULL, strerror(errno));
+         return(0);
+      };
+      if ( (dev != pool->dev) || ((pool->use_mnt_id) && (mnt_id != pool->mnt_id)) )
+      {
+         scu_rmtree_error(pool, node, NULL, "refusing to cross mount point");
+         return(0);
+      };
+   };
+
+#ifdef HAVE_GETDENTS64
+   while ((nread = getdents64(node->fd, buff, SCU_RMTREE_BUFF)) > 0)
+   {
+      count = 0;
+      for(off = 0; (off < nread); off += de->d_reclen)
+      {
+         de = (struct dirent64 *)&buff[off];
+         if ((scu_rmtree_entry(pool, id, node, de->d_name, de->d_type)))
+            names[count++] = de->d_name;
+      };
+
+      // files of one buffer are removed as a single batch
+      scu_uring_unlinkat(node->fd, names, errs, count, 0);
+      for(x = 0; (x < count); x++)
+      {
+         if (errs[x] == 0)
+            __atomic_add_fetch(&pool->files, 1, __ATOMIC_RELAXED);
+         else
+            scu_rmtree_error(pool, node, names[x], strerror(errs[x]));
+      };
+   };
+   if (nread == -1)
+      scu_rmtree_error(pool, node, NULL, strerror(errno));
+#else
+   (void)buff;
+   if ( ((fd = dup(node->fd)) == -1) || ((dp = fdopendir(fd)) == NULL) )
+   {
+      scu_rmtree_error(pool, node, NULL, strerror(errno));
+      return(0);
+   };
+   errno = 0;
+   while ((de = readdir(dp)) != NULL)
+   {
+      if (!(scu_rmtree_entry(pool, id, node, de->d_name, de->d_type)))
+         continue;
+      if (unlinkat(node->fd, de->d_name, 0) == -1)
+         scu_rmtree_error(pool, node, de->d_name, strerror(errno));
+      else
+         __atomic_add_fetch(&pool->files, 1, __ATOMIC_RELAXED);
+      errno = 0;
+   };
+   if (errno != 0)
+      scu_rmtree_error(pool, node, NULL, strerror(errno));
+   closedir(dp);
+#endif
+
+   return(0);
+}
+
+
+/// drops reference and removes directory once all of its subdirectories
+/// are gone, held tells whether the caller holds the node's descriptor
+static void scu_rmtree_release(scu_rmtree_pool * pool, scu_rmtree_node * node, int held)
+{
+   int                  rc;
+   scu_rmtree_node    * parent;
+
+   while ( (node != NULL) && (__atomic_sub_fetch(&node->refs, 1, __ATOMIC_ACQ_REL) == 0) )
+   {
+      parent = node->parent;
+      rc     = -1;
+      if ((__atomic_load_n(&node->failed, __ATOMIC_RELAXED)))
+         __atomic_store_n(&parent->failed, 1, __ATOMIC_RELAXED);
+      else if ((rc = scu_rmtree_hold(pool, parent, (held) ? node : NULL)) == -1)
+         scu_rmtree_error(pool, parent, node->name, strerror(errno));
+      if ((held))
+         scu_rmtree_drop(pool, node);
+      if (rc == 0)
+      {
+         if (unlinkat(parent->fd, node->name, AT_REMOVEDIR) == -1)
+            scu_rmtree_error(pool, parent, node->name, strerror(errno));
+         else
+            __atomic_add_fetch(&pool->dirs, 1, __ATOMIC_RELAXED);
+      };
+      free(node);
+      node = parent;
+      held = (rc == 0) ? 1 : 0;
+   };
+   if ( (node != NULL) && ((held)) )
+      scu_rmtree_unhold(pool, node);
+
+   return;
+}
+
+
+/// releases descriptor held by the caller, closing it if the directory is
+/// otherwise unused and more descriptors than the budget are open
+static void scu_rmtree_unhold(scu_rmtree_pool * pool, scu_rmtree_node * node)
+{
+   int                  fd;
+
+   fd = -1;
+   pthread_mutex_lock(&pool->fds);
+   node->users--;
+   if ( (node->users == 0) && (node->parent != NULL) && (pool->open > pool->budget) )
+   {
+      fd       = node->fd;
+      node->fd = -1;
+      pool->open--;
+   };
+   pthread_mutex_unlock(&pool->fds);
+   if (fd != -1)
+      close(fd);
+
+   return;
+}
+
+
+static void * scu_rmtree_worker_main(void * arg)
+{
+   char                 * buff;
+   scu_rmtree_node      * node;
+   scu_rmtree_pool      * pool;
+   scu_rmtree_worker    * worker;
+
+   worker = arg;
+   pool   = worker->pool;
+
+   if ((buff = malloc(SCU_RMTREE_BUFF)) == NULL)
+      return(NULL);
+
+   while(1)
+   {
+      if ((node = scu_rmtree_pop(pool, worker->id)) == NULL)
+      {
+         pthread_mutex_lock(&pool->mutex);
+         while ( (pool->queued == 0) && (pool->outstanding > 0) )
+            pthread_cond_wait(&pool->work, &pool->mutex);
+         if (pool->outstanding == 0)
+         {
+            pthread_cond_broadcast(&pool->work);
+            pthread_mutex_unlock(&pool->mutex);
+            break;
+         };
+         pthread_mutex_unlock(&pool->mutex);
+         continue;
+      };
+
+      scu_rmtree_release(pool, node, ((scu_rmtree_read(pool, worker->id, node, buff) == 0) ? 1 : 0));
+
+      pthread_mutex_lock(&pool->mutex);
+      if (--pool->outstanding == 0)
+         pthread_cond_broadcast(&pool->work);
+      pthread_mutex_unlock(&pool->mutex);
+   };
+
+   free(buff);
+   scu_uring_close();
+
+   return(NULL);
+}
+
+/* end of source */
@@ -46,7 +46,9 @@
 #include <stdio.h>
 #include <termios.h>
 #include <sys/ioctl.h>
+#ifdef SCU_EASTER_EGGS
 #include <math.h>
+#endif
 #include <assert.h>
 #include <string.h>
 #include <strings.h>
@@ -54,11 +56,20 @@
 #include <sys/stat.h>
 #include <stdlib.h>
 #include <unistd.h>
-
+#include <fcntl.h>
+
+#include "journal.h"
+#include "policy.h"
+#include "probes.h"
+#include "stats.h"
+#include "widget-batch.h"
+#include "widget-broker.h"
 #include "widget-cat.h"
 #include "widget-pathcheck.h"
+#include "widget-prune.h"
 #include "widget-rm.h"
 #include "widget-rmdir.h"
+#include "widget-stats.h"
 #include "widget-tail.h"
 #include "widget-touch.h"
 #include "widget-zcat.h"
@@ -85,7 +96,6 @@
 
 int main(int argc, char * argv[]);
 const char * scu_basename(const char * path);
-const scu_widget * scu_widget_lookup(const char * wname, int exact);
 int scu_widget_syzdek(scu_config * cnf);
 int scu_widget_version(scu_config * cnf);
 int scu_widget_usage(scu_config * cnf);
@@ -102,35 +112,68 @@ int scu_widget_usage(scu_config * cnf);
 
 const scu_widget scu_widget_map[] =
 {
+   {
+      "batch",                                        // widget name
+      "Runs several widget commands read from stdin.",// widget description
+      (const char * const[]) { _PREFIX"batch", NULL },// widget alias
+      scu_widget_batch,                               // widget function
+      0,                                              // widget flags
+   },
+   {
+      "broker",                                       // widget name
+      "Hands validated read-only files to users.",    // widget description
+      (const char * const[]) { _PREFIX"broker", NULL },// widget alias
+      scu_widget_broker,                              // widget function
+      0,                                              // widget flags
+   },
    {
       "cat",                                          // widget name
       "Writes contents of file to standard out.",     // widget description
       (const char * const[]) { _PREFIX"cat", NULL },  // widget alias
       scu_widget_cat,                                 // widget function
+      SCU_WREADONLY,                                  // widget flags
    },
    {
       "help",                                         // widget name
       NULL,                                           // widget description
       (const char * const[]) { "usage", NULL },       // widget alias
       scu_widget_usage,                               // widget function
+      SCU_WREADONLY,                                  // widget flags
    },
    {
       "pathcheck",                                    // widget name
       "Validates path using internal checks.",        // widget description
       (const char * const[]) { _PREFIX"path", NULL }, // widget alias
       scu_widget_pathcheck,                           // widget function
+      SCU_WREADONLY,                                  // widget flags
+   },
+   {
+      "prune",                                        // widget name
+      "Removes old files from a directory.",          // widget description
+      (const char * const[]) { _PREFIX"prune", NULL },// widget alias
+      scu_widget_prune,                               // widget function
+      0,                                              // widget flags
    },
    {
       "rm",                                           // widget name
       "Removes a file.",                              // widget description
       (const char * const[]) { _PREFIX"rm", NULL },   // widget alias
       scu_widget_rm,                                  // widget function
+      0,                                              // widget flags
    },
    {
       "rmdir",                                        // widget name
       "Removes a directory.",                         // widget description
       (const char * const[]) { _PREFIX"rmdir", NULL },// widget alias
       scu_widget_rmdir,                               // widget function
+      0,                                              // widget flags
+   },
+   {
+      "stats",                                        // widget name
+      "Summarizes metrics journal of all widgets.",   // widget description
+      (const char * const[]) { _PREFIX"stats", NULL },// widget alias
+      scu_widget_stats,                               // widget function
+      SCU_WREADONLY,                                  // widget flags
    },
 #ifdef SCU_EASTER_EGGS
    {
@@ -138,6 +181,7 @@ const scu_widget scu_widget_map[] =
       NULL,                                           // widget description
       (const char * const[]) { "david", NULL },       // widget alias
       scu_widget_syzdek,                              // widget function
+      0,                                              // widget flags
    },
 #endif
    {
@@ -145,18 +189,21 @@ const scu_widget scu_widget_map[] =
       "Writes contents of file to standard out.",     // widget description
       (const char * const[]) { _PREFIX"tail", NULL }, // widget alias
       scu_widget_tail,                                // widget function
+      SCU_WREADONLY,                                  // widget flags
    },
    {
       "touch",                                         // widget name
       "Updates access and modify timestamps of file.", // widget description
       (const char * const[]) { _PREFIX"touch", NULL }, // widget alias
       scu_widget_touch,                                // widget function
+      0,                                               // widget flags
    },
    {
       "version",                                      // widget name
       NULL,                                           // widget description
       NULL,                                           // widget alias
       scu_widget_version,                             // widget function
+      SCU_WREADONLY,                                  // widget flags
    },
    {
       "zcat",                                         // widget name
@@ -170,11 +217,15 @@ const scu_widget scu_widget_map[] =
 #endif
 #ifdef USE_LZMA
          "xzcat", _PREFIX"xzcat",
+#endif
+#ifdef USE_ZSTD
+         "zstdcat", _PREFIX"zstdcat",
 #endif
          NULL },                                      // widget alias
       scu_widget_zcat,                                // widget function
+      SCU_WREADONLY,                                  // widget flags
    },
-   { NULL, NULL, NULL, NULL }
+   { NULL, NULL, NULL, NULL, 0 }
 };
 
 
@@ -190,7 +241,9 @@ const scu_widget scu_widget_map[] =
 int main(int argc, char * argv[])
 {
    int            c;
+   int            rc;
    int            opt_index;
+   int            stats;
    scu_config     cnf;
 
    // getopt options
@@ -200,6 +253,7 @@ int main(int argc, char * argv[])
       {"help",             no_argument,       NULL, 'h' },
       {"quiet",            no_argument,       NULL, 'q' },
       {"silent",           no_argument,       NULL, 'q' },
+      {"stats",            no_argument,       NULL, 'S' },
       {"version",          no_argument,       NULL, 'V' },
       {"verbose",          no_argument,       NULL, 'v' },
       { NULL, 0, NULL, 0 }
@@ -208,13 +262,25 @@ int main(int argc, char * argv[])
    memset(&cnf, 0, sizeof(scu_config));
 
    cnf.prog_name = PROGRAM_NAME;
+   stats         = 0;
 
    // skip argument processing if called via alias
    if ((cnf.widget = scu_widget_lookup(scu_basename(argv[0]), 1)) != NULL)
    {
       cnf.argc = argc;
       cnf.argv = argv;
-      return(cnf.widget->func(&cnf));
+      if ((rc = scu_policy_load(cnf.widget->name)) != 0)
+      {
+         fprintf(stderr, "%s: %s: %s\n", PROGRAM_NAME, cnf.widget->name, scu_strerror(rc));
+         return(1);
+      };
+      scu_stats_init(&cnf, 0, scu_journal_open());
+      SCU_PROBE2(widget__start, cnf.widget->name, cnf.argc);
+      rc = cnf.widget->func(&cnf);
+      SCU_PROBE2(widget__done, cnf.widget->name, rc);
+      scu_stats_report(&cnf);
+      scu_journal_append(&cnf, rc);
+      return(rc);
    };
 
    while((c = getopt_long(argc, argv, short_opt, long_opt, &opt_index)) != -1)
@@ -239,6 +305,10 @@ int main(int argc, char * argv[])
          };
          break;
 
+         case 'S':
+         stats = 1;
+         break;
+
          case 'V':
          scu_version();
          return(0);
@@ -281,7 +351,20 @@ int main(int argc, char * argv[])
       return(1);
    };
 
-   return(cnf.widget->func(&cnf));
+   if ((rc = scu_policy_load(cnf.widget->name)) != 0)
+   {
+      fprintf(stderr, "%s: %s: %s\n", PROGRAM_NAME, cnf.widget->name, scu_strerror(rc));
+      return(1);
+   };
+
+   scu_stats_init(&cnf, stats, scu_journal_open());
+   SCU_PROBE2(widget__start, cnf.widget->name, cnf.argc);
+   rc = cnf.widget->func(&cnf);
+   SCU_PROBE2(widget__done, cnf.widget->name, rc);
+   scu_stats_report(&cnf);
+   scu_journal_append(&cnf, rc);
+
+   return(rc);
 }
 
 
@@ -295,80 +378,6 @@ const char * scu_basename(const char * path)
 }
 
 
-/// checks paths
-int scu_pathcheck(const char * path, int opts)
-{
-   int            c;
-   size_t         s;
-   size_t         p;
-   char         * str;
-   char         * ptr;
-   struct stat    sb;
-
-   assert(path != NULL);
-
-   s = strlen(path);
-
-   // verify file is anchored
-   if (path[0] != '/')
-      return(SCU_EANCHOR);
-
-   // verify path does not end in slash
-   if (path[s-1] == '/')
-      return(SCU_EPATH);
-
-   // verify there are no adjacent
-   for(p = 1; p < s; p++)
-   {
-      if ( ((path[p-1] == '.')||(path[p-1] == '/')) &&
-           ((path[p+0] == '.')||(path[p+0] == '/')) )
-      return(SCU_EPATH);
-   };
-
-   // verify file is not a symbolic link
-   if ((c = lstat(path, &sb)) == -1)
-   {
-      if ( ((opts & SCU_ONOTEXISTS) == 0) || (errno != ENOENT) )
-         return(SCU_ERRNO);
-   }
-   else
-   {
-      if ((opts & SCU_ODIR) == 0)
-         if ((sb.st_mode & S_IFMT) != S_IFREG)
-            return(SCU_EFILE);
-      if ((opts & SCU_ODIR) != 0)
-         if ((sb.st_mode & S_IFMT) != S_IFDIR)
-            return(SCU_EDIR);
-   };
-
-   // check path for symlinks
-   if ((str = strdup(path)) == NULL)
-      return(SCU_ERRNO);
-   while((ptr = rindex(str, '/')) != NULL)
-   {
-      ptr[0] = '\0';
-      if (str == ptr)
-         continue;
-      if ((c = lstat(str, &sb)) == -1)
-      {
-         free(str);
-         if ( ((opts & SCU_ONOTEXISTS) == 0) || (errno != ENOENT) )
-            return(SCU_ERRNO);
-         return(0);
-      };
-      if ((sb.st_mode & S_IFMT) == S_IFLNK)
-      {
-         free(str);
-         return(SCU_EFILE);
-      };
-   };
-
-   free(str);
-
-   return(0);
-}
-
-
 void scu_usage(scu_config * cnf)
 {
    int  x;
@@ -379,6 +388,7 @@ void scu_usage(scu_config * cnf)
    printf("\n");
 
    scu_usage_options(cnf);
+   printf("  --stats                   report timings to stderr on exit, as does SCU_STATS=1\n");
    printf("\n");
 
    printf("WIDGETS:\n");
@@ -643,45 +653,4 @@ int scu_widget_version(scu_config * cnf)
 }
 
 
-const char * scu_strerror(int err)
-{
-   if (err < 0)
-      return(strerror(err));
-   switch(err)
-   {
-      case 0:
-      return("success");
-
-      case SCU_ERRNO:
-      return(strerror(errno));
-
-      case SCU_EPATH:
-      return("path contains illegal pattern");
-
-      case SCU_EFILE:
-      return("not a regular file");
-
-      case SCU_EANCHOR:
-      return("not an absolute path");
-
-      default:
-      break;
-   };
-   return("unknown error");
-}
-
-int scu_is_ascii_buffer(const char * buff, ssize_t len)
-{
-   ssize_t pos;
-   assert(buff != NULL);
-
-   for(pos = 0; pos < len; pos++)
-      if ( ( ((buff[pos] < 32) || (buff[pos] > 126)) ) &&
-           ( ((buff[pos] <  9) || (buff[pos] >  13)) ) )
-         return(0);
-
-   return(1);
-}
-
-
 /* end of source */
@@ -57,6 +57,9 @@
 #include <getopt.h>
 #include <unistd.h>
 #include <limits.h>
+#include <inttypes.h>
+#include <sys/types.h>
+#include <sys/stat.h>
 
 
 ///////////////////
@@ -95,6 +98,11 @@
 #endif
 
 
+#ifndef SCU_ZCAT_CACHE_SIZE
+#define SCU_ZCAT_CACHE_SIZE (1024LL*1024LL*1024LL)
+#endif
+
+
 #ifdef LINE_MAX
 #   define SCU_LINE_MAX LINE_MAX
 #elif defined _POSIX2_LINE_MAX
@@ -105,17 +113,31 @@
 #define SCU_BUFF_MAX (SCU_LINE_MAX*20)
 
 
+#ifndef SCU_PATHCACHE_SIZE
+#define SCU_PATHCACHE_SIZE 1024     // slots in directory cache, half may be used
+#endif
+
+
 #define SCU_ESUCCESS 0
 #define SCU_ERRNO    1
 #define SCU_EPATH    2
 #define SCU_EFILE    3
 #define SCU_EANCHOR  4
 #define SCU_EDIR     5
+#define SCU_ECODEC   6
+#define SCU_ECORRUPT 7
+#define SCU_EPOLICY  8
+#define SCU_EPOLFILE 9
+#define SCU_ELIBRARY 10
 
 
 #define SCU_ONONE       0
 #define SCU_ODIR        1
 #define SCU_ONOTEXISTS  2
+#define SCU_ONOPOLICY   4
+
+
+#define SCU_WREADONLY   1     // widget never modifies the filesystem
 
 
 //////////////////
@@ -128,18 +150,41 @@
 #endif
 
 typedef struct scu_config     scu_config;
+typedef struct scu_path       scu_path;
+typedef struct scu_pathcache  scu_pathcache;
+typedef struct scu_pathdir    scu_pathdir;
+typedef struct scu_stats      scu_stats;
 typedef struct scu_widget     scu_widget;
 
 struct scu_config
 {
    int                  quiet;
    int                  verbose;
+   int                  batch;    // run as a command of the batch widget
    int                  opt_index;
    int                  argc;
    const char         * prog_name;
    char              ** argv;
    const char         * short_opt;
    const scu_widget   * widget;
+   scu_stats          * stats;    // NULL unless --stats or SCU_STATS is set
+};
+
+
+struct scu_path
+{
+   int                  dirfd;   // verified parent directory, -1 if missing
+   int                  fd;      // verified file, -1 if it does not exist
+   const char         * name;    // final component of path
+   struct stat          sb;      // status of file, zeroed if it does not exist
+};
+
+
+// verified directories of batch operations, keyed by path prefix
+struct scu_pathcache
+{
+   size_t               count;
+   scu_pathdir        * table;
 };
 
 
@@ -149,6 +194,7 @@ struct scu_widget
    const char        * desc;
    const char * const * alias;
    int  (*func)(scu_config * cnf);
+   int                  flags;
 };
 
 
@@ -161,9 +207,28 @@ struct scu_widget
 #pragma mark - Prototypes
 #endif
 
+/// copies remainder of file to output
+int scu_copy_fd(int outfd, int infd);
+
+/// closes directories held by path cache
+void scu_pathcache_free(scu_pathcache * pc);
+
+/// checks path and stats file relative to a cached parent directory, the
+/// directory descriptor stored in pp belongs to the cache
+int scu_pathcache_stat(scu_pathcache * pc, scu_path * pp, const char * path, int opts);
+
+/// parses number with optional unit suffix
+int scu_parse_units(const char * str, const char * units, int dflt, const uint64_t * scale, uint64_t * valp);
+
 /// checks paths
 int scu_pathcheck(const char * path, int opts);
 
+/// closes descriptors opened by scu_pathopen()
+void scu_pathclose(scu_path * pp);
+
+/// checks path and opens parent directory and file without following symlinks
+int scu_pathopen(scu_path * pp, const char * path, int opts, int flags);
+
 /// Displays secure core utils wrapper usage
 void scu_usage(scu_config * cnf);
 void scu_usage_options(scu_config * cnf);
@@ -177,6 +242,9 @@ const char * scu_strerror(int err);
 /// Displays secure core utils version
 void scu_version(void);
 
+/// finds widget by name, alias or unambiguous prefix
+const scu_widget * scu_widget_lookup(const char * wname, int exact);
+
 int scu_is_ascii_buffer(const char * buff, ssize_t len);
 
 
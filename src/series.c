@@ -0,0 +1,614 @@
+/*
+ *  Secure Core Utilities
+ *  Copyright (C) 2015, 2017 David M. Syzdek <david@syzdek.net>.
+ *
+ *  @SYZDEK_BSD_LICENSE_START@
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of David M. Syzdek nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ *  IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ *  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL DAVID M SYZDEK BE LIABLE FOR
+ *  ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ *  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ *  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ *  OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ *  SUCH DAMAGE.
+ *
+ *  @SYZDEK_BSD_LICENSE_END@
+ */
+#include "series.h"
+
+///////////////
+//           //
+//  Headers  //
+//           //
+///////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Headers
+#endif
+
+#include <assert.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <stdlib.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <pthread.h>
+
+#include "input.h"
+
+
+//////////////////
+//              //
+//  Data Types  //
+//              //
+//////////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Data Types
+#endif
+
+typedef struct scu_series_chunk     scu_series_chunk;
+typedef struct scu_series_entry     scu_series_entry;
+typedef struct scu_series_gen       scu_series_gen;
+typedef struct scu_series_pool      scu_series_pool;
+
+struct scu_series_chunk
+{
+   scu_series_chunk   * next;
+   size_t               len;
+   char                 data[SCU_INPUT_BUFF];
+};
+
+
+struct scu_series_entry
+{
+   unsigned long        gen;
+   char               * path;
+};
+
+
+struct scu_series_gen
+{
+   const char         * path;
+   int                  done;
+   int                  err;
+   int                  errnum;
+   off_t                offset;  // compressed offset of verification failure
+   size_t               queued;
+   scu_series_chunk   * head;
+   scu_series_chunk   * tail;
+};
+
+
+struct scu_series_pool
+{
+   pthread_mutex_t      mutex;
+   pthread_cond_t       data;    // signaled when a chunk is queued or a generation finishes
+   pthread_cond_t       space;   // signaled when the writer dequeues a chunk
+   int                  abort;
+   int                  verify;  // decode without queuing data for the writer
+   size_t               next;
+   size_t               count;
+   scu_series_gen     * gens;
+};
+
+
+/////////////////
+//             //
+//  Variables  //
+//             //
+/////////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Variables
+#endif
+
+static const char * const scu_series_suffixes[] =
+{
+   "",
+   ".Z",
+   ".bz2",
+   ".gz",
+   ".xz",
+   ".zst",
+   NULL
+};
+
+
+//////////////////
+//              //
+//  Prototypes  //
+//              //
+//////////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Prototypes
+#endif
+
+static int scu_series_compare(const void * a, const void * b);
+static int scu_series_parse(const char * name, const char * base, unsigned long * genp);
+static int scu_series_pool_start(scu_config * cnf, scu_series_pool * pool, char ** paths, size_t count, unsigned jobs, pthread_t * threads, unsigned * startedp);
+static void scu_series_pool_stop(scu_series_pool * pool, pthread_t * threads, unsigned started);
+static void * scu_series_worker(void * arg);
+
+
+/////////////////
+//             //
+//  Functions  //
+//             //
+/////////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Functions
+#endif
+
+int scu_series_cat(scu_config * cnf, char ** paths, size_t count, unsigned jobs)
+{
+   int                  rc;
+   size_t               x;
+   unsigned             started;
+   pthread_t            threads[SCU_SERIES_JOBS_MAX];
+   scu_series_pool      pool;
+   scu_series_gen     * gen;
+   scu_series_chunk   * chunk;
+
+   assert(cnf   != NULL);
+   assert(paths != NULL);
+
+   memset(&pool, 0, sizeof(pool));
+   if (scu_series_pool_start(cnf, &pool, paths, count, jobs, threads, &started) == -1)
+      return(1);
+
+   rc = 0;
+   for(x = 0; ((x < count) && (rc == 0)); x++)
+   {
+      gen = &pool.gens[x];
+      if ((cnf->verbose))
+         fprintf(stderr, "%s: %s: %s\n", PROGRAM_NAME, cnf->widget->name, gen->path);
+
+      while(1)
+      {
+         pthread_mutex_lock(&pool.mutex);
+         while ( (gen->head == NULL) && (!(gen->done)) )
+            pthread_cond_wait(&pool.data, &pool.mutex);
+         if ((chunk = gen->head) != NULL)
+         {
+            if ((gen->head = chunk->next) == NULL)
+               gen->tail = NULL;
+            gen->queued--;
+            pthread_cond_broadcast(&pool.space);
+         };
+         pthread_mutex_unlock(&pool.mutex);
+
+         if (chunk == NULL)
+            break;
+         if (write(STDOUT_FILENO, chunk->data, chunk->len) == -1)
+         {
+            fprintf(stderr, "%s: %s: %s\n", PROGRAM_NAME, cnf->widget->name, strerror(errno));
+            free(chunk);
+            rc = 1;
+            break;
+         };
+         free(chunk);
+      };
+
+      if ( (rc == 0) && (gen->err != 0) )
+      {
+         errno = gen->errnum;
+         fprintf(stderr, "%s: %s: %s: %s\n", PROGRAM_NAME, cnf->widget->name, gen->path, scu_strerror(gen->err));
+         rc = 1;
+      };
+   };
+
+   scu_series_pool_stop(&pool, threads, started);
+
+   return(rc);
+}
+
+
+static int scu_series_compare(const void * a, const void * b)
+{
+   const scu_series_entry * ea = a;
+   const scu_series_entry * eb = b;
+
+   // higher generation numbers are older, generation 0 is the live file
+   if (ea->gen != eb->gen)
+   {
+      if (ea->gen == 0)
+         return(1);
+      if (eb->gen == 0)
+         return(-1);
+      return((ea->gen > eb->gen) ? -1 : 1);
+   };
+
+   // plain file is older than its compressed copy during rotation
+   return(strcmp(ea->path, eb->path));
+}
+
+
+int scu_series_discover(const char * base, char *** pathsp, size_t * countp)
+{
+   int                  rc;
+   int                  dfd;
+   size_t               count;
+   size_t               x;
+   unsigned long        gen;
+   char               * dir;
+   char               * name;
+   char              ** paths;
+   DIR                * dp;
+   struct dirent      * de;
+   scu_series_entry   * entries;
+   scu_series_entry   * ptr;
+   scu_path             p;
+
+   assert(base   != NULL);
+   assert(pathsp != NULL);
+   assert(countp != NULL);
+
+   *pathsp = NULL;
+   *countp = 0;
+
+   // base may have been rotated away, but must still be a valid path
+   // within a verified directory
+   if ((rc = scu_pathopen(&p, base, SCU_ONOTEXISTS, O_PATH)) != 0)
+      return(rc);
+   if (p.dirfd == -1)
+   {
+      errno = ENOENT;
+      return(SCU_ERRNO);
+   };
+   dfd = openat(p.dirfd, ".", O_RDONLY|O_DIRECTORY|O_CLOEXEC);
+   scu_pathclose(&p);
+   if (dfd == -1)
+      return(SCU_ERRNO);
+
+   if ((dir = strdup(base)) == NULL)
+   {
+      close(dfd);
+      return(SCU_ERRNO);
+   };
+   name  = rindex(dir, '/');
+   *name = '\0';
+   name  = &name[1];
+   if ((dp = fdopendir(dfd)) == NULL)
+   {
+      close(dfd);
+      free(dir);
+      return(SCU_ERRNO);
+   };
+
+   count   = 0;
+   entries = NULL;
+   while ((de = readdir(dp)) != NULL)
+   {
+#ifdef _DIRENT_HAVE_D_TYPE
+      if ( (de->d_type != DT_REG) && (de->d_type != DT_UNKNOWN) )
+         continue;
+#endif
+      if (scu_series_parse(de->d_name, name, &gen) != 0)
+         continue;
+      if (count >= SCU_SERIES_MAX)
+      {
+         errno = E2BIG;
+         break;
+      };
+      if ((ptr = realloc(entries, sizeof(scu_series_entry) * (count+1))) == NULL)
+         break;
+      entries = ptr;
+      entries[count].gen = gen;
+      if ((entries[count].path = malloc(strlen(dir) + strlen(de->d_name) + 2)) == NULL)
+         break;
+      sprintf(entries[count].path, "%s/%s", dir, de->d_name);
+      count++;
+   };
+   rc = (de != NULL) ? SCU_ERRNO : 0;
+   closedir(dp);
+   free(dir);
+
+   if ( (rc == 0) && (count == 0) )
+   {
+      errno = ENOENT;
+      rc    = SCU_ERRNO;
+   };
+   if ( (rc == 0) && ((paths = malloc(sizeof(char *) * count)) == NULL) )
+      rc = SCU_ERRNO;
+   if (rc != 0)
+   {
+      for(x = 0; x < count; x++)
+         free(entries[x].path);
+      free(entries);
+      return(rc);
+   };
+
+   qsort(entries, count, sizeof(scu_series_entry), scu_series_compare);
+   for(x = 0; x < count; x++)
+      paths[x] = entries[x].path;
+   free(entries);
+
+   *pathsp = paths;
+   *countp = count;
+
+   return(0);
+}
+
+
+void scu_series_free(char ** paths, size_t count)
+{
+   size_t x;
+   if (paths == NULL)
+      return;
+   for(x = 0; x < count; x++)
+      free(paths[x]);
+   free(paths);
+   return;
+}
+
+
+/// matches "base", "base.N", and "base.N.ext" for known compression suffixes
+static int scu_series_parse(const char * name, const char * base, unsigned long * genp)
+{
+   size_t         len;
+   size_t         x;
+   char         * endptr;
+
+   len = strlen(base);
+   if (strncmp(name, base, len) != 0)
+      return(-1);
+   name = &name[len];
+
+   *genp = 0;
+   if (name[0] == '.')
+   {
+      if ( (name[1] < '1') || (name[1] > '9') )
+         return(-1);
+      *genp = strtoul(&name[1], &endptr, 10);
+      name  = endptr;
+   };
+
+   for(x = 0; scu_series_suffixes[x] != NULL; x++)
+      if (!(strcmp(name, scu_series_suffixes[x])))
+         return( ((*genp == 0) && (name[0] != '\0')) ? -1 : 0 );
+
+   return(-1);
+}
+
+
+/// initializes pool and starts decoding threads
+static int scu_series_pool_start(scu_config * cnf, scu_series_pool * pool, char ** paths, size_t count, unsigned jobs, pthread_t * threads, unsigned * startedp)
+{
+   size_t               x;
+   unsigned             started;
+
+   jobs = (jobs < 1)                   ? 1                   : jobs;
+   jobs = (jobs > SCU_SERIES_JOBS_MAX) ? SCU_SERIES_JOBS_MAX : jobs;
+   jobs = (jobs > count)               ? (unsigned)count     : jobs;
+
+   pool->count = count;
+   if ((pool->gens = calloc(count, sizeof(scu_series_gen))) == NULL)
+   {
+      fprintf(stderr, "%s: %s: %s\n", PROGRAM_NAME, cnf->widget->name, strerror(errno));
+      return(-1);
+   };
+   for(x = 0; x < count; x++)
+      pool->gens[x].path = paths[x];
+
+   pthread_mutex_init(&pool->mutex, NULL);
+   pthread_cond_init(&pool->data,   NULL);
+   pthread_cond_init(&pool->space,  NULL);
+
+   // workers claim generations oldest first so the generation being
+   // written is always decoding while the following ones read ahead
+   for(started = 0; started < jobs; started++)
+      if (pthread_create(&threads[started], NULL, scu_series_worker, pool) != 0)
+         break;
+   if (started == 0)
+   {
+      fprintf(stderr, "%s: %s: unable to start decoding threads\n", PROGRAM_NAME, cnf->widget->name);
+      pthread_cond_destroy(&pool->space);
+      pthread_cond_destroy(&pool->data);
+      pthread_mutex_destroy(&pool->mutex);
+      free(pool->gens);
+      return(-1);
+   };
+
+   *startedp = started;
+
+   return(0);
+}
+
+
+/// stops remaining workers and releases unwritten data
+static void scu_series_pool_stop(scu_series_pool * pool, pthread_t * threads, unsigned started)
+{
+   size_t               x;
+   scu_series_chunk   * chunk;
+
+   pthread_mutex_lock(&pool->mutex);
+   pool->abort = 1;
+   pthread_cond_broadcast(&pool->space);
+   pthread_mutex_unlock(&pool->mutex);
+   while (started > 0)
+      pthread_join(threads[--started], NULL);
+
+   for(x = 0; x < pool->count; x++)
+   {
+      while ((chunk = pool->gens[x].head) != NULL)
+      {
+         pool->gens[x].head = chunk->next;
+         free(chunk);
+      };
+   };
+
+   pthread_cond_destroy(&pool->space);
+   pthread_cond_destroy(&pool->data);
+   pthread_mutex_destroy(&pool->mutex);
+   free(pool->gens);
+
+   return;
+}
+
+
+int scu_series_verify(scu_config * cnf, char ** paths, size_t count, unsigned jobs)
+{
+   int                  rc;
+   size_t               x;
+   unsigned             started;
+   pthread_t            threads[SCU_SERIES_JOBS_MAX];
+   scu_series_pool      pool;
+   scu_series_gen     * gen;
+
+   assert(cnf   != NULL);
+   assert(paths != NULL);
+
+   memset(&pool, 0, sizeof(pool));
+   pool.verify = 1;
+   if (scu_series_pool_start(cnf, &pool, paths, count, jobs, threads, &started) == -1)
+      return(1);
+
+   // results are reported in series order as each generation completes
+   rc = 0;
+   for(x = 0; x < count; x++)
+   {
+      gen = &pool.gens[x];
+      pthread_mutex_lock(&pool.mutex);
+      while (!(gen->done))
+         pthread_cond_wait(&pool.data, &pool.mutex);
+      pthread_mutex_unlock(&pool.mutex);
+      scu_series_verify_report(cnf, gen->path, gen->err, gen->errnum, gen->offset);
+      rc = (gen->err != 0) ? 1 : rc;
+   };
+
+   scu_series_pool_stop(&pool, threads, started);
+
+   return(rc);
+}
+
+
+/// prints result of verifying a single file
+void scu_series_verify_report(scu_config * cnf, const char * path, int err, int errnum, off_t offset)
+{
+   errno = errnum;
+   if ( (err == SCU_ECORRUPT) || ((err == SCU_ERRNO) && (offset > 0)) )
+      fprintf(stderr, "%s: %s: %s: %s at offset %jd\n", PROGRAM_NAME, cnf->widget->name, path, scu_strerror(err), (intmax_t)offset);
+   else if (err != 0)
+      fprintf(stderr, "%s: %s: %s: %s\n", PROGRAM_NAME, cnf->widget->name, path, scu_strerror(err));
+   else if ((cnf->verbose))
+      fprintf(stderr, "%s: %s: %s: OK\n", PROGRAM_NAME, cnf->widget->name, path);
+   return;
+}
+
+
+static void * scu_series_worker(void * arg)
+{
+   int                  rc;
+   int                  errnum;
+   ssize_t              len;
+   scu_input          * inp;
+   scu_series_gen     * gen;
+   scu_series_pool    * pool;
+   scu_series_chunk   * chunk;
+
+   pool = arg;
+
+   while(1)
+   {
+      pthread_mutex_lock(&pool->mutex);
+      if ( (pool->next >= pool->count) || ((pool->abort)) )
+      {
+         pthread_mutex_unlock(&pool->mutex);
+         return(NULL);
+      };
+      gen = &pool->gens[pool->next++];
+      pthread_mutex_unlock(&pool->mutex);
+
+      len    = 0;
+      chunk  = NULL;
+      errnum = 0;
+      if ((rc = scu_input_open(&inp, gen->path)) != 0)
+         errnum = errno;
+      if ( (rc == 0) && ((pool->verify)) )
+      {
+         // uncompressed generations have nothing to verify
+         if (scu_input_codec(inp) == SCU_CODEC_RAW)
+            rc = 0;
+         else if ((rc = scu_input_verify(inp, 1)) != 0)
+         {
+            errnum      = errno;
+            gen->offset = scu_input_offset(inp);
+         };
+         scu_input_close(inp);
+      }
+      else if (rc == 0)
+      {
+         while(1)
+         {
+            if ((chunk = malloc(sizeof(scu_series_chunk))) == NULL)
+            {
+               rc     = SCU_ERRNO;
+               errnum = errno;
+               break;
+            };
+            if ((len = scu_input_read(inp, chunk->data, sizeof(chunk->data))) < 1)
+            {
+               rc     = (len == -1) ? scu_input_error(inp) : 0;
+               errnum = errno;
+               break;
+            };
+            chunk->len  = (size_t)len;
+            chunk->next = NULL;
+
+            // bounded read-ahead, block until the writer drains this generation
+            pthread_mutex_lock(&pool->mutex);
+            while ( (gen->queued >= SCU_SERIES_QUEUE) && (!(pool->abort)) )
+               pthread_cond_wait(&pool->space, &pool->mutex);
+            if ((pool->abort))
+            {
+               pthread_mutex_unlock(&pool->mutex);
+               break;
+            };
+            if (gen->tail != NULL)
+               gen->tail->next = chunk;
+            else
+               gen->head = chunk;
+            gen->tail = chunk;
+            gen->queued++;
+            chunk = NULL;
+            pthread_cond_broadcast(&pool->data);
+            pthread_mutex_unlock(&pool->mutex);
+         };
+         free(chunk);
+         scu_input_close(inp);
+      };
+
+      pthread_mutex_lock(&pool->mutex);
+      gen->err    = rc;
+      gen->errnum = errnum;
+      gen->done   = 1;
+      pthread_cond_broadcast(&pool->data);
+      pthread_mutex_unlock(&pool->mutex);
+   };
+
+   return(NULL);
+}
+
+
+/* end of source */
@@ -0,0 +1,189 @@
+/*
+ *  Secure Core Utilities
+ *  Copyright (C) 2015, 2017 David M. Syzdek <david@syzdek.net>.
+ *
+ *  @SYZDEK_BSD_LICENSE_START@
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of David M. Syzdek nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ *  IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ *  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL DAVID M SYZDEK BE LIABLE FOR
+ *  ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ *  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ *  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ *  OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ *  SUCH DAMAGE.
+ *
+ *  @SYZDEK_BSD_LICENSE_END@
+ */
+#include "stats.h"
+
+///////////////
+//           //
+//  Headers  //
+//           //
+///////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Headers
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/resource.h>
+
+
+//////////////////
+//              //
+//  Prototypes  //
+//              //
+//////////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Prototypes
+#endif
+
+static uint64_t scu_stats_now(void);
+
+
+/////////////////
+//             //
+//  Variables  //
+//             //
+/////////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Variables
+#endif
+
+__thread scu_stats * scu_stats_cur = NULL;
+
+static scu_stats scu_stats_run;
+
+static const char * const scu_stats_names[SCU_STATS_PHASES] =
+{
+   "other",
+   "pathcheck",
+   "open",
+   "read",
+   "decode",
+   "write-blocked",
+};
+
+
+/////////////////
+//             //
+//  Functions  //
+//             //
+/////////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Functions
+#endif
+
+uint64_t scu_stats_hash(const char * str)
+{
+   uint64_t             hash;
+   for(hash = 0xcbf29ce484222325ULL; (str[0] != '\0'); str++)
+      hash = (hash ^ (unsigned char)str[0]) * 0x100000001b3ULL;
+   return((hash == 0) ? 1 : hash);
+}
+
+
+void scu_stats_init(scu_config * cnf, int report, int collect)
+{
+   const char         * str;
+   struct timespec      ts;
+
+   if (!(report))
+      if ( ((str = getenv("SCU_STATS")) != NULL) && (str[0] != '\0') && ((strcmp(str, "0"))) )
+         report = 1;
+   if ( (!(report)) && (!(collect)) )
+      return;
+
+   memset(&scu_stats_run, 0, sizeof(scu_stats_run));
+   clock_gettime(CLOCK_REALTIME, &ts);
+   scu_stats_run.phase  = SCU_STATS_OTHER;
+   scu_stats_run.report = report;
+   scu_stats_run.time   = (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+   scu_stats_run.start = scu_stats_now();
+   scu_stats_run.mark  = scu_stats_run.start;
+   scu_stats_cur       = &scu_stats_run;
+   cnf->stats          = &scu_stats_run;
+
+   return;
+}
+
+
+static uint64_t scu_stats_now(void)
+{
+   struct timespec      ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return((uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec);
+}
+
+
+int scu_stats_phase(int phase)
+{
+   int                  prev;
+   uint64_t             now;
+
+   prev = scu_stats_cur->phase;
+   if (phase == prev)
+      return(prev);
+
+   now = scu_stats_now();
+   scu_stats_cur->ns[prev] += now - scu_stats_cur->mark;
+   scu_stats_cur->mark      = now;
+   scu_stats_cur->phase     = phase;
+
+   return(prev);
+}
+
+
+void scu_stats_report(scu_config * cnf)
+{
+   int                  x;
+   uint64_t             wall;
+   uint64_t             bytes;
+   double               mbs;
+   scu_stats          * st;
+   struct rusage        ru;
+
+   if ((st = cnf->stats) == NULL)
+      return;
+
+   scu_stats_phase(SCU_STATS_OTHER);
+   if (!(st->report))
+      return;
+   wall  = st->mark - st->start;
+   bytes = (st->bytes_out > 0) ? st->bytes_out : st->bytes_in;
+   mbs   = (wall > 0) ? ((double)bytes / 1048576.0) / ((double)wall / 1e9) : 0.0;
+   getrusage(RUSAGE_SELF, &ru);
+
+   fprintf(stderr, "%s: %s: stats: wall %.3f ms;", PROGRAM_NAME, cnf->widget->name, (double)wall / 1e6);
+   for(x = 1; (x < SCU_STATS_PHASES); x++)
+      fprintf(stderr, " %s %.3f ms,", scu_stats_names[x], (double)st->ns[x] / 1e6);
+   fprintf(stderr, " %s %.3f ms\n", scu_stats_names[0], (double)st->ns[0] / 1e6);
+   fprintf(stderr, "%s: %s: stats: bytes in %" PRIu64 ", bytes out %" PRIu64 ", %.2f MB/s\n",
+      PROGRAM_NAME, cnf->widget->name, st->bytes_in, st->bytes_out, mbs);
+   fprintf(stderr, "%s: %s: stats: syscalls %" PRIu64 " (read %" PRIu64 ", write %" PRIu64 ", path %" PRIu64 "), peak rss %li kB\n",
+      PROGRAM_NAME, cnf->widget->name, st->reads + st->writes + st->paths, st->reads, st->writes, st->paths, (long)ru.ru_maxrss);
+
+   return;
+}
+
+/* end of source */
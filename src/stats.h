@@ -0,0 +1,144 @@
+/*
+ *  Secure Core Utilities
+ *  Copyright (C) 2015, 2017 David M. Syzdek <david@syzdek.net>.
+ *
+ *  @SYZDEK_BSD_LICENSE_START@
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of David M. Syzdek nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ *  IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ *  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL DAVID M SYZDEK BE LIABLE FOR
+ *  ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ *  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ *  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ *  OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ *  SUCH DAMAGE.
+ *
+ *  @SYZDEK_BSD_LICENSE_END@
+ */
+/**
+ *  @file stats.h
+ *  Per-run counters reported by --stats
+ */
+#ifndef __SRC_STATS_H
+#define __SRC_STATS_H 1
+
+
+///////////////
+//           //
+//  Headers  //
+//           //
+///////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Headers
+#endif
+
+#include "securecoreutils.h"
+
+
+///////////////////
+//               //
+//  Definitions  //
+//               //
+///////////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Definitions
+#endif
+
+#define SCU_STATS_OTHER       0
+#define SCU_STATS_PATHCHECK   1
+#define SCU_STATS_OPEN        2
+#define SCU_STATS_READ        3
+#define SCU_STATS_DECODE      4
+#define SCU_STATS_WRITE       5  // blocked writing output
+#define SCU_STATS_PHASES      6
+
+// call sites cost a single branch unless stats are enabled, time is
+// charged to whichever phase is current when the phase changes
+#define SCU_STATS_SWAP(phase)    ((scu_stats_cur != NULL) ? scu_stats_phase(phase) : 0)
+#define SCU_STATS_SET(phase)     do { if (scu_stats_cur != NULL) scu_stats_phase(phase); } while(0)
+#define SCU_STATS_IN(len)        do { if (scu_stats_cur != NULL) { scu_stats_cur->reads++;  scu_stats_cur->bytes_in  += ((len) > 0) ? (uint64_t)(len) : 0; }; } while(0)
+#define SCU_STATS_OUT(len)       do { if (scu_stats_cur != NULL) { scu_stats_cur->writes++; scu_stats_cur->bytes_out += ((len) > 0) ? (uint64_t)(len) : 0; }; } while(0)
+#define SCU_STATS_COPY(len)      do { if (scu_stats_cur != NULL) { scu_stats_cur->writes++; scu_stats_cur->bytes_in += (uint64_t)(len); scu_stats_cur->bytes_out += (uint64_t)(len); }; } while(0)
+#define SCU_STATS_SYSCALL(n)     do { if (scu_stats_cur != NULL) scu_stats_cur->paths += (n); } while(0)
+#define SCU_STATS_PATH(str)      do { if ( (scu_stats_cur != NULL) && (scu_stats_cur->path == 0) ) scu_stats_cur->path = scu_stats_hash(str); } while(0)
+
+
+//////////////////
+//              //
+//  Data Types  //
+//              //
+//////////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Data Types
+#endif
+
+struct scu_stats
+{
+   int                  phase;
+   int                  report;                    // print counters on exit
+   uint64_t             start;                     // nanoseconds
+   uint64_t             mark;                      // nanoseconds at last phase change
+   uint64_t             ns[SCU_STATS_PHASES];
+   uint64_t             bytes_in;
+   uint64_t             bytes_out;
+   uint64_t             reads;                     // read and pread calls
+   uint64_t             writes;                    // write and sendfile calls
+   uint64_t             paths;                     // open, openat and stat calls
+   uint64_t             path;                      // hash of first checked path
+   uint64_t             time;                      // wall clock at start, nanoseconds
+};
+
+
+/////////////////
+//             //
+//  Variables  //
+//             //
+/////////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Variables
+#endif
+
+// set only in the thread running the widget, workers are not counted
+extern __thread scu_stats * scu_stats_cur;
+
+
+//////////////////
+//              //
+//  Prototypes  //
+//              //
+//////////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Prototypes
+#endif
+
+/// returns 64-bit FNV-1a hash of string, never 0
+uint64_t scu_stats_hash(const char * str);
+
+/// enables counters when reported by option or SCU_STATS environment
+/// variable, or when collected for the metrics journal
+void scu_stats_init(scu_config * cnf, int report, int collect);
+
+/// changes current phase and returns previous phase
+int scu_stats_phase(int phase);
+
+/// prints counters of run to stderr
+void scu_stats_report(scu_config * cnf);
+
+
+#endif /* end of header */
@@ -0,0 +1,382 @@
+/*
+ *  Secure Core Utilities
+ *  Copyright (C) 2015, 2017 David M. Syzdek <david@syzdek.net>.
+ *
+ *  @SYZDEK_BSD_LICENSE_START@
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of David M. Syzdek nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ *  IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ *  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL DAVID M SYZDEK BE LIABLE FOR
+ *  ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ *  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ *  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ *  OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ *  SUCH DAMAGE.
+ *
+ *  @SYZDEK_BSD_LICENSE_END@
+ */
+#include "tail.h"
+
+///////////////
+//           //
+//  Headers  //
+//           //
+///////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Headers
+#endif
+
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "stats.h"
+
+
+//////////////////
+//              //
+//  Prototypes  //
+//              //
+//////////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Prototypes
+#endif
+
+static int scu_tail_bytes(int fd, const struct stat * sb, size_t opts,
+   off_t optnum, scu_tail_out out, void * ctx);
+static int scu_tail_copy(int fd, scu_tail_out out, void * ctx);
+static int scu_tail_lines(int fd, const struct stat * sb, size_t opts,
+   off_t optnum, scu_tail_out out, void * ctx);
+static ssize_t scu_tail_read(int fd, void * buff, size_t size, off_t offset);
+static int scu_tail_stream(scu_input * inp, size_t opts, off_t optnum,
+   scu_tail_out out, void * ctx);
+static off_t scu_tail_stream_offset(const char * data, size_t datalen,
+   size_t opts, off_t optnum);
+
+
+/////////////////
+//             //
+//  Functions  //
+//             //
+/////////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Functions
+#endif
+
+int scu_tail(scu_input * inp, size_t opts, off_t optnum, scu_tail_out out, void * ctx)
+{
+   int               fd;
+   struct stat       sb;
+
+   assert(inp != NULL);
+   assert(out != NULL);
+
+   // compressed files are decoded as a stream since they cannot be seeked
+   if (scu_input_codec(inp) != SCU_CODEC_RAW)
+      return(scu_tail_stream(inp, opts, optnum, out, ctx));
+
+   fd = scu_input_fd(inp);
+   memcpy(&sb, scu_input_stat(inp), sizeof(sb));
+   if (lseek(fd, 0, SEEK_SET) == -1)
+      return(SCU_ERRNO);
+
+   if ((opts & SCU_TAIL_OBYTES) != 0)
+      return(scu_tail_bytes(fd, &sb, opts, optnum, out, ctx));
+   return(scu_tail_lines(fd, &sb, opts, optnum, out, ctx));
+}
+
+
+static int scu_tail_bytes(int fd, const struct stat * sb, size_t opts,
+   off_t optnum, scu_tail_out out, void * ctx)
+{
+   off_t    off;
+
+   if ((opts & SCU_TAIL_OBOL) == 0)
+      off = (sb->st_size < optnum) ? 0 : sb->st_size - optnum;
+   else
+      off = (sb->st_size < optnum) ? sb->st_size : optnum;
+
+   if (lseek(fd, off, SEEK_SET) == -1)
+      return(SCU_ERRNO);
+
+   return(scu_tail_copy(fd, out, ctx));
+}
+
+
+/// passes remainder of file to out
+static int scu_tail_copy(int fd, scu_tail_out out, void * ctx)
+{
+   char     buff[SCU_BUFF_MAX];
+   ssize_t  len;
+
+   while ((len = scu_tail_read(fd, buff, sizeof(buff), -1)) > 0)
+      if ((*out)(ctx, buff, (size_t)len) == -1)
+         return(SCU_ERRNO);
+
+   return((len == -1) ? SCU_ERRNO : 0);
+}
+
+
+static int scu_tail_lines(int fd, const struct stat * sb, size_t opts,
+   off_t optnum, scu_tail_out out, void * ctx)
+{
+   char     buff[SCU_BUFF_MAX];
+   ssize_t  bufflen;
+   ssize_t  len;
+   off_t    linecount;
+   off_t    seek;
+   ssize_t  pos;
+   off_t    found;
+
+   // start line count from beginning of file
+   if ((opts & SCU_TAIL_OBOL) != 0)
+   {
+      len         = 1;
+      linecount   = 1;
+
+      while ((linecount < optnum) && (len > 0))
+      {
+         if ((len = scu_tail_read(fd, buff, sizeof(buff), -1)) == -1)
+            return(SCU_ERRNO);
+
+         for (pos = 0; ((pos < len) && (linecount < optnum)); pos++)
+         {
+            if (buff[pos] == '\n')
+               linecount++;
+            if (linecount >= optnum)
+            {
+               if ((*out)(ctx, &buff[pos+1], (size_t)(len-pos-1)) == -1)
+                  return(SCU_ERRNO);
+            };
+         };
+      };
+   };
+
+   // start line count from end of file
+   if ((opts & SCU_TAIL_OBOL) == 0)
+   {
+      linecount = 0;
+      seek      = sb->st_size;
+      found     = 0;
+
+      while ((linecount <= optnum) && (seek > 0))
+      {
+         if (seek > (off_t)sizeof(buff))
+         {
+            bufflen  = sizeof(buff);
+            seek    -= bufflen;
+         } else {
+            bufflen  = seek;
+            seek     = 0;
+         };
+
+         if ((len = scu_tail_read(fd, buff, (size_t)bufflen, seek)) == -1)
+            return(SCU_ERRNO);
+
+         for (pos = len; ((pos > 0) && (linecount <= optnum)); pos--)
+         {
+            if (buff[pos-1] == '\n')
+               linecount++;
+            if (linecount > optnum)
+               found = seek + pos;
+         };
+      };
+
+      if (lseek(fd, found, SEEK_SET) == -1)
+         return(SCU_ERRNO);
+   };
+
+   return(scu_tail_copy(fd, out, ctx));
+}
+
+
+int scu_tail_range(scu_input * inp, uint64_t offset, uint64_t len, scu_tail_out out, void * ctx)
+{
+   char     buff[SCU_BUFF_MAX];
+   int      fd;
+   size_t   size;
+   ssize_t  rc;
+
+   assert(inp != NULL);
+   assert(out != NULL);
+
+   // plain files are read in place, decoded data up to offset is discarded
+   if (scu_input_codec(inp) == SCU_CODEC_RAW)
+   {
+      fd = scu_input_fd(inp);
+      while (len > 0)
+      {
+         size = (len < sizeof(buff)) ? (size_t)len : sizeof(buff);
+         if ((rc = scu_tail_read(fd, buff, size, (off_t)offset)) == -1)
+            return(SCU_ERRNO);
+         if (rc == 0)
+            break;
+         if ((*out)(ctx, buff, (size_t)rc) == -1)
+            return(SCU_ERRNO);
+         offset += (uint64_t)rc;
+         len    -= (uint64_t)rc;
+      };
+      return(0);
+   };
+
+   while (len > 0)
+   {
+      if ((rc = scu_input_read(inp, buff, sizeof(buff))) == -1)
+         return(scu_input_error(inp));
+      if (rc == 0)
+         break;
+      if (offset >= (uint64_t)rc)
+      {
+         offset -= (uint64_t)rc;
+         continue;
+      };
+      size = (size_t)((uint64_t)rc - offset);
+      size = (len < size) ? (size_t)len : size;
+      if ((*out)(ctx, &buff[offset], size) == -1)
+         return(SCU_ERRNO);
+      len   -= size;
+      offset = 0;
+   };
+
+   return(0);
+}
+
+
+/// reads plain file at offset, or at the file position if offset is -1
+static ssize_t scu_tail_read(int fd, void * buff, size_t size, off_t offset)
+{
+   int      phase;
+   ssize_t  len;
+
+   phase = SCU_STATS_SWAP(SCU_STATS_READ);
+   len   = (offset == -1) ? read(fd, buff, size) : pread(fd, buff, size, offset);
+   SCU_STATS_IN(len);
+   SCU_STATS_SET(phase);
+
+   return(len);
+}
+
+
+static int scu_tail_stream(scu_input * inp, size_t opts, off_t optnum,
+   scu_tail_out out, void * ctx)
+{
+   char     buff[SCU_BUFF_MAX];
+   char   * data;
+   char   * ptr;
+   size_t   size;
+   size_t   datalen;
+   ssize_t  len;
+   ssize_t  pos;
+   off_t    skip;
+   off_t    found;
+
+   data     = NULL;
+   size     = 0;
+   datalen  = 0;
+   skip     = 0;
+   if ((opts & SCU_TAIL_OBOL) != 0)
+      skip = ((opts & SCU_TAIL_OBYTES) != 0) ? optnum : optnum - 1;
+
+   while ((len = scu_input_read(inp, buff, sizeof(buff))) > 0)
+   {
+      // start count from beginning of file, discard leading bytes or lines
+      if ((opts & SCU_TAIL_OBOL) != 0)
+      {
+         for (pos = 0; ((pos < len) && (skip > 0)); pos++)
+            if ( ((opts & SCU_TAIL_OBYTES) != 0) || (buff[pos] == '\n') )
+               skip--;
+         if ((pos < len) && ((*out)(ctx, &buff[pos], (size_t)(len - pos)) == -1))
+            return(SCU_ERRNO);
+         continue;
+      };
+
+      // start count from end of file, retain only the trailing data
+      if ((datalen + (size_t)len) > size)
+      {
+         size = (size == 0) ? (sizeof(buff) * 4) : (size * 2);
+         if ((ptr = realloc(data, size)) == NULL)
+         {
+            free(data);
+            return(SCU_ERRNO);
+         };
+         data = ptr;
+      };
+      memcpy(&data[datalen], buff, (size_t)len);
+      datalen += (size_t)len;
+
+      if ((datalen + sizeof(buff)) <= size)
+         continue;
+      if ((found = scu_tail_stream_offset(data, datalen, opts, optnum)) > 0)
+      {
+         memmove(data, &data[found], datalen - (size_t)found);
+         datalen -= (size_t)found;
+      };
+   };
+   if (len == -1)
+   {
+      free(data);
+      return(scu_input_error(inp));
+   };
+
+   if ((opts & SCU_TAIL_OBOL) != 0)
+      return(0);
+
+   found = scu_tail_stream_offset(data, datalen, opts, optnum);
+   if ( ((size_t)found < datalen) && ((*out)(ctx, &data[found], datalen - (size_t)found) == -1) )
+   {
+      free(data);
+      return(SCU_ERRNO);
+   };
+
+   free(data);
+
+   return(0);
+}
+
+
+/// returns offset of the last optnum lines or bytes within buffer
+static off_t scu_tail_stream_offset(const char * data, size_t datalen,
+   size_t opts, off_t optnum)
+{
+   off_t    pos;
+   off_t    linecount;
+   off_t    found;
+
+   if ((opts & SCU_TAIL_OBYTES) != 0)
+      return(((off_t)datalen < optnum) ? 0 : (off_t)datalen - optnum);
+
+   found     = 0;
+   linecount = 0;
+   for (pos = (off_t)datalen; ((pos > 0) && (linecount <= optnum)); pos--)
+   {
+      if (data[pos-1] == '\n')
+         linecount++;
+      if (linecount > optnum)
+         found = pos;
+   };
+
+   return(found);
+}
+
+/* end of source */
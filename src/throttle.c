@@ -0,0 +1,496 @@
+/*
+ *  Secure Core Utilities
+ *  Copyright (C) 2015, 2017 David M. Syzdek <david@syzdek.net>.
+ *
+ *  @SYZDEK_BSD_LICENSE_START@
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of David M. Syzdek nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ *  IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ *  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL DAVID M SYZDEK BE LIABLE FOR
+ *  ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ *  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ *  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ *  OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ *  SUCH DAMAGE.
+ *
+ *  @SYZDEK_BSD_LICENSE_END@
+ */
+#include "throttle.h"
+
+///////////////
+//           //
+//  Headers  //
+//           //
+///////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Headers
+#endif
+
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/file.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+
+
+//////////////////
+//              //
+//  Data Types  //
+//              //
+//////////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Data Types
+#endif
+
+typedef struct scu_throttle_dir  scu_throttle_dir;
+typedef struct scu_throttle_file scu_throttle_file;
+
+
+struct scu_throttle_dir
+{
+   int                  fd;
+   dev_t                dev;
+   uint64_t             mnt_id;
+};
+
+
+struct scu_throttle_file
+{
+   int                  fd;         // locked while a worker owns the file
+   size_t               dir;
+   char                 name[32];
+};
+
+
+struct scu_throttle
+{
+   uint64_t             rate;
+   size_t               ndirs;
+   size_t               nfiles;
+   size_t               maxfiles;
+   scu_throttle_dir   * dirs;
+   scu_throttle_file  * files;
+};
+
+
+//////////////////
+//              //
+//  Prototypes  //
+//              //
+//////////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Prototypes
+#endif
+
+static int scu_throttle_add(scu_throttle * th, int fd, size_t dir, const char * name);
+static void scu_throttle_adopt(scu_throttle * th, size_t dir);
+static int scu_throttle_dir_open(scu_config * cnf, scu_throttle * th, int dirfd, const char * path, size_t * dirp);
+static int scu_throttle_mount(int fd, dev_t * devp, ino_t * inop, uint64_t * mnt_idp);
+static void scu_throttle_shrink(scu_throttle * th);
+
+
+/////////////////
+//             //
+//  Functions  //
+//             //
+/////////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Functions
+#endif
+
+static int scu_throttle_add(scu_throttle * th, int fd, size_t dir, const char * name)
+{
+   size_t               max;
+   void               * ptr;
+
+   if (th->nfiles == th->maxfiles)
+   {
+      max = (th->maxfiles == 0) ? 16 : (th->maxfiles * 2);
+      if ((ptr = realloc(th->files, max * sizeof(scu_throttle_file))) == NULL)
+         return(-1);
+      th->files    = ptr;
+      th->maxfiles = max;
+   };
+   th->files[th->nfiles].fd  = fd;
+   th->files[th->nfiles].dir = dir;
+   snprintf(th->files[th->nfiles].name, sizeof(th->files[0].name), "%s", name);
+   th->nfiles++;
+
+   return(0);
+}
+
+
+/// takes over files left in holding by a worker which did not finish
+static void scu_throttle_adopt(scu_throttle * th, size_t dir)
+{
+   int                  fd;
+   int                  dfd;
+   DIR                * dp;
+   struct dirent      * de;
+   struct stat          sb;
+
+   if ( ((dfd = dup(th->dirs[dir].fd)) == -1) || ((dp = fdopendir(dfd)) == NULL) )
+   {
+      if (dfd != -1)
+         close(dfd);
+      return;
+   };
+   while ((de = readdir(dp)) != NULL)
+   {
+      if (de->d_name[0] == '.')
+         continue;
+      if (strlen(de->d_name) >= sizeof(th->files[0].name))
+         continue;
+      if ((fd = openat(th->dirs[dir].fd, de->d_name, O_WRONLY|O_NOFOLLOW|O_NONBLOCK|O_CLOEXEC|O_NOCTTY)) == -1)
+         continue;
+      if ( (fstat(fd, &sb) == -1) || (!(S_ISREG(sb.st_mode))) ||
+           (flock(fd, LOCK_EX|LOCK_NB) == -1) ||
+           (scu_throttle_add(th, fd, dir, de->d_name) == -1) )
+         close(fd);
+   };
+   closedir(dp);
+
+   return;
+}
+
+
+/// opens root-only holding directory at the top of the filesystem of dirfd,
+/// rename() cannot move a file across filesystems
+static int scu_throttle_dir_open(scu_config * cnf, scu_throttle * th, int dirfd, const char * path, size_t * dirp)
+{
+   int                  fd;
+   int                  up;
+   size_t               x;
+   dev_t                dev;
+   dev_t                updev;
+   ino_t                ino;
+   ino_t                upino;
+   uint64_t             mnt_id;
+   uint64_t             upmnt_id;
+   void               * ptr;
+   struct stat          sb;
+
+   if (scu_throttle_mount(dirfd, &dev, &ino, &mnt_id) == -1)
+   {
+      fprintf(stderr, "%s: %s: %s: %s\n", PROGRAM_NAME, cnf->widget->name, path, strerror(errno));
+      return(-1);
+   };
+   for(x = 0; (x < th->ndirs); x++)
+   {
+      if ( (th->dirs[x].dev == dev) && (th->dirs[x].mnt_id == mnt_id) )
+      {
+         *dirp = x;
+         return(0);
+      };
+   };
+
+   // walk up until the parent belongs to another mount or is the directory itself
+   if ((fd = openat(dirfd, ".", O_PATH|O_DIRECTORY|O_CLOEXEC)) == -1)
+   {
+      fprintf(stderr, "%s: %s: %s: %s\n", PROGRAM_NAME, cnf->widget->name, path, strerror(errno));
+      return(-1);
+   };
+   while(1)
+   {
+      if ( ((up = openat(fd, "..", O_PATH|O_DIRECTORY|O_CLOEXEC)) == -1) ||
+           (scu_throttle_mount(up, &updev, &upino, &upmnt_id) == -1) )
+      {
+         fprintf(stderr, "%s: %s: %s: %s\n", PROGRAM_NAME, cnf->widget->name, path, strerror(errno));
+         if (up != -1)
+            close(up);
+         close(fd);
+         return(-1);
+      };
+      if ( (updev != dev) || (upmnt_id != mnt_id) || (upino == ino) )
+      {
+         close(up);
+         break;
+      };
+      close(fd);
+      fd  = up;
+      ino = upino;
+   };
+
+   if ( (mkdirat(fd, SCU_THROTTLE_DIR, 0700) == -1) && (errno != EEXIST) )
+   {
+      fprintf(stderr, "%s: %s: %s: %s\n", PROGRAM_NAME, cnf->widget->name, SCU_THROTTLE_DIR, strerror(errno));
+      close(fd);
+      return(-1);
+   };
+   up = openat(fd, SCU_THROTTLE_DIR, O_RDONLY|O_DIRECTORY|O_NOFOLLOW|O_CLOEXEC);
+   close(fd);
+   if (up == -1)
+   {
+      fprintf(stderr, "%s: %s: %s: %s\n", PROGRAM_NAME, cnf->widget->name, SCU_THROTTLE_DIR, strerror(errno));
+      return(-1);
+   };
+   if ( (fstat(up, &sb) == -1) || (sb.st_uid != 0) || ((sb.st_mode & 077) != 0) )
+   {
+      fprintf(stderr, "%s: %s: %s: holding directory is not restricted to root\n", PROGRAM_NAME, cnf->widget->name, SCU_THROTTLE_DIR);
+      close(up);
+      return(-1);
+   };
+
+   if ((ptr = realloc(th->dirs, (th->ndirs + 1) * sizeof(scu_throttle_dir))) == NULL)
+   {
+      fprintf(stderr, "%s: %s: %s\n", PROGRAM_NAME, cnf->widget->name, strerror(errno));
+      close(up);
+      return(-1);
+   };
+   th->dirs = ptr;
+   th->dirs[th->ndirs].fd     = up;
+   th->dirs[th->ndirs].dev    = dev;
+   th->dirs[th->ndirs].mnt_id = mnt_id;
+   *dirp = th->ndirs++;
+
+   scu_throttle_adopt(th, *dirp);
+
+   return(0);
+}
+
+
+void scu_throttle_free(scu_throttle * th)
+{
+   size_t               x;
+
+   if (th == NULL)
+      return;
+   for(x = 0; (x < th->nfiles); x++)
+      close(th->files[x].fd);
+   for(x = 0; (x < th->ndirs); x++)
+      close(th->dirs[x].fd);
+   free(th->files);
+   free(th->dirs);
+   free(th);
+
+   return;
+}
+
+
+int scu_throttle_hold(scu_config * cnf, scu_throttle * th, int dirfd, const char * name, const char * path)
+{
+   int                  fd;
+   size_t               dir;
+   char                 hname[32];
+   struct stat          sb;
+   struct stat          hsb;
+
+   assert(cnf  != NULL);
+   assert(th   != NULL);
+   assert(name != NULL);
+
+   if (geteuid() != 0)
+   {
+      fprintf(stderr, "%s: %s: %s: throttled removal requires root\n", PROGRAM_NAME, cnf->widget->name, path);
+      return(-1);
+   };
+
+   // file is truncated through this descriptor, so only a single link to a
+   // regular file may be held
+   if ((fd = openat(dirfd, name, O_WRONLY|O_NOFOLLOW|O_NONBLOCK|O_CLOEXEC|O_NOCTTY)) == -1)
+   {
+      fprintf(stderr, "%s: %s: %s: %s\n", PROGRAM_NAME, cnf->widget->name, path, strerror(errno));
+      return(-1);
+   };
+   if (fstat(fd, &sb) == -1)
+   {
+      fprintf(stderr, "%s: %s: %s: %s\n", PROGRAM_NAME, cnf->widget->name, path, strerror(errno));
+      close(fd);
+      return(-1);
+   };
+   if ( (!(S_ISREG(sb.st_mode))) || (sb.st_nlink != 1) )
+   {
+      close(fd);
+      return(1);
+   };
+
+   if (scu_throttle_dir_open(cnf, th, dirfd, path, &dir) == -1)
+   {
+      close(fd);
+      return(-1);
+   };
+   snprintf(hname, sizeof(hname), "%ju", (uintmax_t)sb.st_ino);
+   if ( (flock(fd, LOCK_EX|LOCK_NB) == -1) || (renameat(dirfd, name, th->dirs[dir].fd, hname) == -1) )
+   {
+      fprintf(stderr, "%s: %s: %s: %s\n", PROGRAM_NAME, cnf->widget->name, path, strerror(errno));
+      close(fd);
+      return(-1);
+   };
+
+   // name may have been replaced between open and rename
+   if ( (fstatat(th->dirs[dir].fd, hname, &hsb, AT_SYMLINK_NOFOLLOW) == -1) ||
+        (hsb.st_dev != sb.st_dev) || (hsb.st_ino != sb.st_ino) )
+   {
+      renameat(th->dirs[dir].fd, hname, dirfd, name);
+      fprintf(stderr, "%s: %s: %s: file changed during removal\n", PROGRAM_NAME, cnf->widget->name, path);
+      close(fd);
+      return(-1);
+   };
+
+   if (scu_throttle_add(th, fd, dir, hname) == -1)
+   {
+      fprintf(stderr, "%s: %s: %s: %s\n", PROGRAM_NAME, cnf->widget->name, path, strerror(errno));
+      close(fd);
+      return(-1);
+   };
+
+   return(0);
+}
+
+
+scu_throttle * scu_throttle_init(uint64_t rate)
+{
+   scu_throttle       * th;
+
+   if ((th = calloc(1, sizeof(scu_throttle))) == NULL)
+      return(NULL);
+   th->rate = rate;
+
+   return(th);
+}
+
+
+/// identifies directory and the mount it belongs to
+static int scu_throttle_mount(int fd, dev_t * devp, ino_t * inop, uint64_t * mnt_idp)
+{
+   struct stat          sb;
+#if defined(HAVE_STATX) && defined(STATX_MNT_ID)
+   struct statx         stx;
+#endif
+
+   *mnt_idp = 0;
+#if defined(HAVE_STATX) && defined(STATX_MNT_ID)
+   if ( (statx(fd, "", AT_EMPTY_PATH|AT_SYMLINK_NOFOLLOW, STATX_MNT_ID, &stx) == 0) &&
+        ((stx.stx_mask & STATX_MNT_ID) != 0) )
+      *mnt_idp = stx.stx_mnt_id;
+#endif
+   if (fstat(fd, &sb) == -1)
+      return(-1);
+   *devp = sb.st_dev;
+   *inop = sb.st_ino;
+
+   return(0);
+}
+
+
+/// shortens each file from the end in small steps so the filesystem frees
+/// a bounded number of blocks per transaction, then unlinks the empty file
+static void scu_throttle_shrink(scu_throttle * th)
+{
+   size_t               x;
+   off_t                size;
+   off_t                step;
+   struct stat          sb;
+   struct timespec      ts;
+
+   step = (off_t)(th->rate / SCU_THROTTLE_HZ);
+   step = (step < SCU_THROTTLE_MIN) ? SCU_THROTTLE_MIN : step;
+   ts.tv_sec  = 0;
+   ts.tv_nsec = 1000000000L / SCU_THROTTLE_HZ;
+
+   for(x = 0; (x < th->nfiles); x++)
+   {
+      if (fstat(th->files[x].fd, &sb) == -1)
+         continue;
+      for(size = sb.st_size; (size > 0); )
+      {
+         size = (size > step) ? (size - step) : 0;
+         if (ftruncate(th->files[x].fd, size) == -1)
+            break;
+         if (size > 0)
+            nanosleep(&ts, NULL);
+      };
+      // a file which could not be emptied is left for the next worker
+      if (size == 0)
+         unlinkat(th->dirs[th->files[x].dir].fd, th->files[x].name, 0);
+   };
+
+   return;
+}
+
+
+int scu_throttle_start(scu_config * cnf, scu_throttle * th)
+{
+   int                  fd;
+   int                  status;
+   pid_t                pid;
+
+   assert(cnf != NULL);
+   assert(th  != NULL);
+
+   if (th->nfiles == 0)
+   {
+      scu_throttle_free(th);
+      return(0);
+   };
+
+   // worker is started through an intermediate child so it is reparented
+   // to init and the command returns once every file is in holding
+   fflush(stdout);
+   fflush(stderr);
+   if ((pid = fork()) == -1)
+   {
+      fprintf(stderr, "%s: %s: %s\n", PROGRAM_NAME, cnf->widget->name, strerror(errno));
+      scu_throttle_free(th);
+      return(-1);
+   };
+   if (pid == 0)
+   {
+      setsid();
+      if ((pid = fork()) != 0)
+         _exit((pid == -1) ? 1 : 0);
+      signal(SIGHUP, SIG_IGN);
+      if (chdir("/") == -1)
+         _exit(1);
+      if ((fd = open("/dev/null", O_RDWR)) != -1)
+      {
+         dup2(fd, STDIN_FILENO);
+         dup2(fd, STDOUT_FILENO);
+         dup2(fd, STDERR_FILENO);
+         if (fd > STDERR_FILENO)
+            close(fd);
+      };
+      scu_throttle_shrink(th);
+      _exit(0);
+   };
+
+   if ( (waitpid(pid, &status, 0) == -1) || (!(WIFEXITED(status))) || (WEXITSTATUS(status) != 0) )
+   {
+      fprintf(stderr, "%s: %s: unable to start removal worker, files remain in %s\n", PROGRAM_NAME, cnf->widget->name, SCU_THROTTLE_DIR);
+      scu_throttle_free(th);
+      return(-1);
+   };
+   if ((cnf->verbose))
+      printf("%s: %s: removing %zu held files at %ju bytes/s in background\n", PROGRAM_NAME, cnf->widget->name, th->nfiles, (uintmax_t)th->rate);
+   scu_throttle_free(th);
+
+   return(0);
+}
+
+/* end of source */
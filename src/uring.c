@@ -0,0 +1,349 @@
+/*
+ *  Secure Core Utilities
+ *  Copyright (C) 2015, 2017 David M. Syzdek <david@syzdek.net>.
+ *
+ *  @SYZDEK_BSD_LICENSE_START@
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of David M. Syzdek nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ *  IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ *  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL DAVID M SYZDEK BE LIABLE FOR
+ *  ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ *  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ *  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ *  OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ *  SUCH DAMAGE.
+ *
+ *  @SYZDEK_BSD_LICENSE_END@
+ */
+#include "uring.h"
+
+///////////////
+//           //
+//  Headers  //
+//           //
+///////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Headers
+#endif
+
+#include <assert.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#ifdef USE_IO_URING
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+
+//////////////////
+//              //
+//  Data Types  //
+//              //
+//////////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Data Types
+#endif
+
+#ifdef USE_IO_URING
+typedef struct scu_uring scu_uring;
+
+struct scu_uring
+{
+   int                     fd;
+   int                     failed;     // setup was attempted and is unusable
+   unsigned                entries;
+   void                  * sq_ring;
+   void                  * cq_ring;
+   size_t                  sq_size;
+   size_t                  cq_size;
+   size_t                  sqes_size;
+   unsigned              * sq_tail;
+   unsigned              * sq_mask;
+   unsigned              * sq_array;
+   unsigned              * cq_head;
+   unsigned              * cq_tail;
+   unsigned              * cq_mask;
+   struct io_uring_sqe   * sqes;
+   struct io_uring_cqe   * cqes;
+};
+#endif
+
+
+/////////////////
+//             //
+//  Variables  //
+//             //
+/////////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Variables
+#endif
+
+#ifdef USE_IO_URING
+// rings are single producer, each thread submits through its own
+static __thread scu_uring scu_uring_ring = { .fd = -1 };
+#endif
+
+
+//////////////////
+//              //
+//  Prototypes  //
+//              //
+//////////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Prototypes
+#endif
+
+#ifdef USE_IO_URING
+static scu_uring * scu_uring_open(void);
+static int scu_uring_submit(scu_uring * ring, int dirfd, const char * const * names, int * errs, size_t count, int flags);
+#endif
+
+
+/////////////////
+//             //
+//  Functions  //
+//             //
+/////////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Functions
+#endif
+
+void scu_uring_close(void)
+{
+#ifdef USE_IO_URING
+   scu_uring          * ring;
+
+   ring = &scu_uring_ring;
+   if (ring->fd == -1)
+      return;
+   munmap(ring->sqes, ring->sqes_size);
+   if (ring->cq_size != 0)
+      munmap(ring->cq_ring, ring->cq_size);
+   munmap(ring->sq_ring, ring->sq_size);
+   close(ring->fd);
+   memset(ring, 0, sizeof(scu_uring));
+   ring->fd = -1;
+#endif
+   return;
+}
+
+
+const char * scu_uring_backend(void)
+{
+#ifdef USE_IO_URING
+   if (scu_uring_open() != NULL)
+      return("io_uring");
+#endif
+   return("unlinkat");
+}
+
+
+#ifdef USE_IO_URING
+/// maps submission and completion rings, NULL if the kernel lacks unlinkat ops
+static scu_uring * scu_uring_open(void)
+{
+   int                        fd;
+   char                     * ptr;
+   scu_uring                * ring;
+   struct io_uring_params     params;
+   struct io_uring_probe    * probe;
+
+   ring = &scu_uring_ring;
+   if ((ring->failed))
+      return(NULL);
+   if (ring->fd != -1)
+      return(ring);
+   ring->failed = 1;
+
+   memset(&params, 0, sizeof(params));
+   if ((fd = (int)syscall(__NR_io_uring_setup, SCU_URING_ENTRIES, &params)) == -1)
+      return(NULL);
+
+   // IORING_OP_UNLINKAT arrived in 5.11, older rings reject it per request
+   if ((probe = calloc(1, sizeof(struct io_uring_probe) + (256 * sizeof(struct io_uring_probe_op)))) == NULL)
+   {
+      close(fd);
+      return(NULL);
+   };
+   if ( (syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE, probe, 256) == -1) ||
+        (probe->ops_len <= IORING_OP_UNLINKAT) ||
+        ((probe->ops[IORING_OP_UNLINKAT].flags & IO_URING_OP_SUPPORTED) == 0) )
+   {
+      free(probe);
+      close(fd);
+      return(NULL);
+   };
+   free(probe);
+
+   ring->sq_size   = params.sq_off.array + (params.sq_entries * sizeof(unsigned));
+   ring->cq_size   = params.cq_off.cqes  + (params.cq_entries * sizeof(struct io_uring_cqe));
+   ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+   if ((params.features & IORING_FEAT_SINGLE_MMAP) != 0)
+   {
+      ring->sq_size = (ring->cq_size > ring->sq_size) ? ring->cq_size : ring->sq_size;
+      ring->cq_size = 0;
+   };
+
+   ring->sq_ring = mmap(NULL, ring->sq_size, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+   if (ring->sq_ring == MAP_FAILED)
+   {
+      close(fd);
+      return(NULL);
+   };
+   ring->cq_ring = ring->sq_ring;
+   if (ring->cq_size != 0)
+   {
+      ring->cq_ring = mmap(NULL, ring->cq_size, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+      if (ring->cq_ring == MAP_FAILED)
+      {
+         munmap(ring->sq_ring, ring->sq_size);
+         close(fd);
+         return(NULL);
+      };
+   };
+   ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, fd, IORING_OFF_SQES);
+   if (ring->sqes == MAP_FAILED)
+   {
+      if (ring->cq_size != 0)
+         munmap(ring->cq_ring, ring->cq_size);
+      munmap(ring->sq_ring, ring->sq_size);
+      close(fd);
+      return(NULL);
+   };
+
+   ptr            = ring->sq_ring;
+   ring->sq_tail  = (unsigned *)(ptr + params.sq_off.tail);
+   ring->sq_mask  = (unsigned *)(ptr + params.sq_off.ring_mask);
+   ring->sq_array = (unsigned *)(ptr + params.sq_off.array);
+   ptr            = ring->cq_ring;
+   ring->cq_head  = (unsigned *)(ptr + params.cq_off.head);
+   ring->cq_tail  = (unsigned *)(ptr + params.cq_off.tail);
+   ring->cq_mask  = (unsigned *)(ptr + params.cq_off.ring_mask);
+   ring->cqes     = (struct io_uring_cqe *)(ptr + params.cq_off.cqes);
+   ring->entries  = params.sq_entries;
+   ring->fd       = fd;
+   ring->failed   = 0;
+
+   return(ring);
+}
+
+
+/// queues up to one ring of unlinks and waits for every completion
+static int scu_uring_submit(scu_uring * ring, int dirfd, const char * const * names, int * errs, size_t count, int flags)
+{
+   unsigned                tail;
+   unsigned                head;
+   unsigned                idx;
+   size_t                  x;
+   size_t                  done;
+   size_t                  sent;
+   long                    rc;
+   struct io_uring_sqe   * sqe;
+   struct io_uring_cqe   * cqe;
+
+   tail = *ring->sq_tail;
+   for(x = 0; (x < count); x++, tail++)
+   {
+      idx = tail & *ring->sq_mask;
+      sqe = &ring->sqes[idx];
+      memset(sqe, 0, sizeof(struct io_uring_sqe));
+      sqe->opcode       = IORING_OP_UNLINKAT;
+      sqe->fd           = dirfd;
+      sqe->addr         = (uint64_t)(uintptr_t)names[x];
+      sqe->unlink_flags = (uint32_t)flags;
+      sqe->user_data    = (uint64_t)x;
+      ring->sq_array[idx] = idx;
+   };
+   __atomic_store_n(ring->sq_tail, tail, __ATOMIC_RELEASE);
+
+   // kernel returns without waiting when it submits only part of the
+   // entries, the rest are submitted by the next call
+   for(done = 0, sent = 0; (done < count); )
+   {
+      rc = syscall(__NR_io_uring_enter, ring->fd, (unsigned)(count - sent), (unsigned)(count - done), IORING_ENTER_GETEVENTS, NULL, 0);
+      if ( (rc == -1) && (errno != EINTR) )
+         return(-1);
+      if ( (rc == 0) && (sent < count) )
+         return(-1);
+      if ( (rc > 0) && (sent < count) )
+         sent += ((size_t)rc < (count - sent)) ? (size_t)rc : (count - sent);
+      head = *ring->cq_head;
+      while (head != __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE))
+      {
+         cqe = &ring->cqes[head & *ring->cq_mask];
+         if (cqe->user_data < count)
+            errs[cqe->user_data] = (cqe->res < 0) ? -cqe->res : 0;
+         head++;
+         done++;
+      };
+      __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+   };
+
+   return(0);
+}
+#endif
+
+
+void scu_uring_unlinkat(int dirfd, const char * const * names, int * errs, size_t count, int flags)
+{
+   size_t         x;
+#ifdef USE_IO_URING
+   size_t         len;
+   scu_uring    * ring;
+#endif
+
+   assert(names != NULL);
+   assert(errs  != NULL);
+
+   // entries keep -1 until their completion is reaped, only those are
+   // removed with unlinkat() if the ring fails part way through a batch
+   for(x = 0; (x < count); x++)
+      errs[x] = -1;
+
+   // one io_uring_enter() covers a ring of unlinks instead of a syscall each
+#ifdef USE_IO_URING
+   if ((ring = scu_uring_open()) != NULL)
+   {
+      for(x = 0; (x < count); x += len)
+      {
+         len = ((count - x) > ring->entries) ? ring->entries : (count - x);
+         if (scu_uring_submit(ring, dirfd, &names[x], &errs[x], len, flags) == -1)
+         {
+            ring->failed = 1;
+            break;
+         };
+      };
+      if (x >= count)
+         return;
+   };
+#endif
+
+   for(x = 0; (x < count); x++)
+      if (errs[x] == -1)
+         errs[x] = (unlinkat(dirfd, names[x], flags) == -1) ? errno : 0;
+
+   return;
+}
+
+/* end of source */
@@ -0,0 +1,535 @@
+/*
+ *  Secure Core Utilities
+ *  Copyright (C) 2015, 2017 David M. Syzdek <david@syzdek.net>.
+ *
+ *  @SYZDEK_BSD_LICENSE_START@
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of David M. Syzdek nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ *  IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ *  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL DAVID M SYZDEK BE LIABLE FOR
+ *  ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ *  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ *  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ *  OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ *  SUCH DAMAGE.
+ *
+ *  @SYZDEK_BSD_LICENSE_END@
+ */
+#include "widget-batch.h"
+
+///////////////
+//           //
+//  Headers  //
+//           //
+///////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Headers
+#endif
+
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include "policy.h"
+
+
+///////////////////
+//               //
+//  Definitions  //
+//               //
+///////////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Definitions
+#endif
+
+#define SCU_BATCH_JOBS_MAX 64
+
+#ifndef SCU_BATCH_OUTPUT_MAX
+#define SCU_BATCH_OUTPUT_MAX (64LL*1024LL*1024LL)
+#endif
+
+
+//////////////////
+//              //
+//  Data Types  //
+//              //
+//////////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Data Types
+#endif
+
+typedef struct scu_batch_cmd scu_batch_cmd;
+
+struct scu_batch_cmd
+{
+   int                  argc;
+   int                  fd;         // captured standard out
+   int                  rc;
+   int                  done;
+   pid_t                pid;
+   char              ** argv;
+   const scu_widget   * widget;
+};
+
+
+//////////////////
+//              //
+//  Prototypes  //
+//              //
+//////////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Prototypes
+#endif
+
+int scu_widget_batch_emit(scu_config * cnf, scu_batch_cmd * cmd, size_t idx);
+int scu_widget_batch_read(scu_config * cnf, char ** bufp, scu_batch_cmd ** cmdsp, size_t * countp);
+int scu_widget_batch_start(scu_config * cnf, scu_batch_cmd * cmd);
+void scu_widget_batch_usage(scu_config * cnf);
+
+
+/////////////////
+//             //
+//  Functions  //
+//             //
+/////////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Functions
+#endif
+
+int scu_widget_batch(scu_config * cnf)
+{
+   int            c;
+   int            opt_index;
+   int            failed;
+   int            status;
+   int            exclusive;
+   int            policy;
+   unsigned       jobs;
+   unsigned       running;
+   size_t         count;
+   size_t         next;
+   size_t         emitted;
+   size_t         x;
+   pid_t          pid;
+   char         * buff;
+   char         * endptr;
+   scu_batch_cmd * cmds;
+
+   // getopt options
+   static char   short_opt[] = "+hj:qVv";
+   static struct option long_opt[] =
+   {
+      {"help",             no_argument,       NULL, 'h' },
+      {"jobs",             required_argument, NULL, 'j' },
+      {"quiet",            no_argument,       NULL, 'q' },
+      {"silent",           no_argument,       NULL, 'q' },
+      {"version",          no_argument,       NULL, 'V' },
+      {"verbose",          no_argument,       NULL, 'v' },
+      { NULL, 0, NULL, 0 }
+   };
+
+   assert(cnf != NULL);
+   cnf->short_opt = short_opt;
+
+   jobs = 1;
+
+   while((c = getopt_long(cnf->argc, cnf->argv, short_opt, long_opt, &opt_index)) != -1)
+   {
+      switch(c)
+      {
+         case -1:	/* no more arguments */
+         case 0:	/* long options toggles */
+         break;
+
+         case 'h':
+         scu_widget_batch_usage(cnf);
+         return(0);
+
+         case 'j':
+         jobs = (unsigned)strtoul(optarg, &endptr, 10);
+         if ( (endptr == optarg) || (endptr[0] != '\0') || (jobs < 1) || (jobs > SCU_BATCH_JOBS_MAX) )
+         {
+            fprintf(stderr, "%s: %s: invalid value for `-j' -- %s\n", PROGRAM_NAME, cnf->widget->name, optarg);
+            return(1);
+         };
+         break;
+
+         case 'q':
+         cnf->quiet = 1;
+         if ((cnf->verbose))
+         {
+            fprintf(stderr, "%s: %s: incompatible options\n", PROGRAM_NAME, cnf->widget->name);
+            fprintf(stderr, "Try `%s --help' for more information.\n", PROGRAM_NAME);
+            return(1);
+         };
+         break;
+
+         case 'V':
+         printf("%s widget\n", cnf->widget->name);
+         scu_version();
+         return(0);
+
+         case 'v':
+         cnf->verbose++;
+         if ((cnf->quiet))
+         {
+            fprintf(stderr, "%s: %s: incompatible options\n", PROGRAM_NAME, cnf->widget->name);
+            fprintf(stderr, "Try `%s %s --help' for more information.\n", PROGRAM_NAME, cnf->widget->name);
+            return(1);
+         };
+         break;
+
+         case '?':
+         fprintf(stderr, "Try `%s %s --help' for more information.\n", PROGRAM_NAME, cnf->widget->name);
+         return(1);
+
+         default:
+         fprintf(stderr, "%s: %s: unrecognized option `--%c'\n", PROGRAM_NAME, cnf->widget->name, c);
+         fprintf(stderr, "Try `%s %s --help' for more information.\n", PROGRAM_NAME, cnf->widget->name);
+         return(1);
+      };
+   };
+
+   if ((cnf->argc - optind) > 0)
+   {
+      fprintf(stderr, "%s: unrecognized argument `-- %s'\n", PROGRAM_NAME, cnf->argv[optind]);
+      fprintf(stderr, "Try `%s %s --help' for more information.\n", PROGRAM_NAME, cnf->widget->name);
+      return(1);
+   };
+
+   // whole list is read before any command runs, commands get /dev/null
+   // as standard in
+   if (scu_widget_batch_read(cnf, &buff, &cmds, &count) == -1)
+      return(1);
+
+   // commands which modify files run only when a path policy restricts them
+   policy = -1;
+   for(x = 0; (x < count); x++)
+   {
+      if ( (cmds[x].widget == NULL) || ((cmds[x].widget->flags & SCU_WREADONLY) != 0) )
+         continue;
+      if (policy == -1)
+         policy = ( ((scu_policy_loaded())) || ((scu_policy_preload(cnf->widget->name) == 0) && ((scu_policy_loaded()))) ) ? 1 : 0;
+      if ((policy))
+         continue;
+      fprintf(stderr, "%s: %s: command %zu: `%s' requires a path policy\n", PROGRAM_NAME, cnf->widget->name, x, cmds[x].widget->name);
+      cmds[x].widget = NULL;
+      cmds[x].rc     = 1;
+   };
+
+   // read-only commands run concurrently, any other command waits for
+   // the running ones and runs alone; output is written in input order
+   failed    = 0;
+   running   = 0;
+   exclusive = 0;
+   next      = 0;
+   emitted   = 0;
+   while (emitted < count)
+   {
+      while ( (next < count) && (running < jobs) && (!(exclusive)) )
+      {
+         if (cmds[next].widget == NULL)
+         {
+            cmds[next++].done = 1;
+            continue;
+         };
+         if ((cmds[next].widget->flags & SCU_WREADONLY) == 0)
+         {
+            if (running > 0)
+               break;
+            exclusive = 1;
+         };
+         if (scu_widget_batch_start(cnf, &cmds[next]) == -1)
+         {
+            cmds[next++].done = 1;
+            exclusive = 0;
+            continue;
+         };
+         running++;
+         next++;
+      };
+
+      while ( (emitted < next) && (cmds[emitted].done) )
+      {
+         failed |= (cmds[emitted].rc != 0) ? 1 : 0;
+         if (scu_widget_batch_emit(cnf, &cmds[emitted], emitted) == -1)
+            failed = 1;
+         emitted++;
+      };
+      if (running == 0)
+         continue;
+
+      if ((pid = waitpid(-1, &status, 0)) == -1)
+      {
+         if (errno == EINTR)
+            continue;
+         fprintf(stderr, "%s: %s: %s\n", PROGRAM_NAME, cnf->widget->name, strerror(errno));
+         failed = 1;
+         break;
+      };
+      for(x = emitted; (x < next); x++)
+      {
+         if (cmds[x].pid != pid)
+            continue;
+         cmds[x].rc   = (WIFEXITED(status)) ? WEXITSTATUS(status) : (128 + WTERMSIG(status));
+         cmds[x].done = 1;
+         cmds[x].pid  = 0;
+         exclusive    = 0;
+         running--;
+      };
+   };
+
+   for(x = 0; (x < count); x++)
+      if (cmds[x].fd != -1)
+         close(cmds[x].fd);
+   free(cmds);
+   free(buff);
+
+   return((failed) ? 1 : 0);
+}
+
+
+/// writes frame header "index status length" followed by captured output
+int scu_widget_batch_emit(scu_config * cnf, scu_batch_cmd * cmd, size_t idx)
+{
+   struct stat          sb;
+
+   sb.st_size = 0;
+   if ( (cmd->fd != -1) && (fstat(cmd->fd, &sb) == -1) )
+   {
+      fprintf(stderr, "%s: %s: %s\n", PROGRAM_NAME, cnf->widget->name, strerror(errno));
+      return(-1);
+   };
+   printf("%zu %i %jd\n", idx, cmd->rc, (intmax_t)sb.st_size);
+   fflush(stdout);
+   if (cmd->fd == -1)
+      return(0);
+
+   if ( (lseek(cmd->fd, 0, SEEK_SET) == -1) || (scu_copy_fd(STDOUT_FILENO, cmd->fd) == -1) )
+   {
+      fprintf(stderr, "%s: %s: %s\n", PROGRAM_NAME, cnf->widget->name, strerror(errno));
+      return(-1);
+   };
+   close(cmd->fd);
+   cmd->fd = -1;
+
+   return(0);
+}
+
+
+/// splits NUL terminated arguments into commands ended by an empty argument
+int scu_widget_batch_read(scu_config * cnf, char ** bufp, scu_batch_cmd ** cmdsp, size_t * countp)
+{
+   size_t               len;
+   size_t               size;
+   size_t               off;
+   size_t               count;
+   size_t               nargs;
+   size_t               x;
+   ssize_t              rd;
+   char               * buff;
+   char              ** args;
+   scu_batch_cmd      * cmds;
+   void               * ptr;
+
+   buff = NULL;
+   size = 0;
+   len  = 0;
+   do
+   {
+      if ((size - len) < 4096)
+      {
+         size = (size == 0) ? 65536 : (size * 2);
+         if ((ptr = realloc(buff, size + 2)) == NULL)
+         {
+            fprintf(stderr, "%s: %s: %s\n", PROGRAM_NAME, cnf->widget->name, strerror(errno));
+            free(buff);
+            return(-1);
+         };
+         buff = ptr;
+      };
+      if ( ((rd = read(STDIN_FILENO, &buff[len], size - len)) == -1) && (errno != EINTR) )
+      {
+         fprintf(stderr, "%s: %s: stdin: %s\n", PROGRAM_NAME, cnf->widget->name, strerror(errno));
+         free(buff);
+         return(-1);
+      };
+      len += (rd > 0) ? (size_t)rd : 0;
+   } while (rd != 0);
+
+   // final command does not need its terminators
+   if (buff == NULL)
+   {
+      *bufp   = NULL;
+      *cmdsp  = NULL;
+      *countp = 0;
+      return(0);
+   };
+   if ( (len > 0) && (buff[len-1] != '\0') )
+      buff[len++] = '\0';
+   if ( (len > 1) && (buff[len-2] != '\0') )
+      buff[len++] = '\0';
+
+   // one pointer per argument plus the NULL ending each vector
+   for(off = 0, count = 0, nargs = 0; (off < len); off += strlen(&buff[off]) + 1)
+   {
+      nargs++;
+      count += (buff[off] == '\0') ? 1 : 0;
+   };
+   cmds = calloc(count + 1, sizeof(scu_batch_cmd));
+   args = calloc(nargs + 1, sizeof(char *));
+   if ( (cmds == NULL) || (args == NULL) )
+   {
+      fprintf(stderr, "%s: %s: %s\n", PROGRAM_NAME, cnf->widget->name, strerror(errno));
+      free(cmds);
+      free(args);
+      free(buff);
+      return(-1);
+   };
+
+   // the argument array is owned by the first command
+   for(off = 0, x = 0; (x < count); x++)
+   {
+      cmds[x].fd   = -1;
+      cmds[x].argv = args;
+      for(; (buff[off] != '\0'); off += strlen(&buff[off]) + 1)
+         *args++ = &buff[off];
+      *args++ = NULL;
+      off++;
+      cmds[x].argc = (int)(args - cmds[x].argv - 1);
+      if (cmds[x].argc == 0)
+      {
+         fprintf(stderr, "%s: %s: command %zu: missing widget\n", PROGRAM_NAME, cnf->widget->name, x);
+         cmds[x].rc = 1;
+      }
+      else if ( ((cmds[x].widget = scu_widget_lookup(cmds[x].argv[0], 0)) == NULL) || (cmds[x].widget == cnf->widget) )
+      {
+         fprintf(stderr, "%s: %s: command %zu: unknown or ambiguous widget -- \"%s\"\n", PROGRAM_NAME, cnf->widget->name, x, cmds[x].argv[0]);
+         cmds[x].widget = NULL;
+         cmds[x].rc     = 1;
+      };
+   };
+
+   *bufp   = buff;
+   *cmdsp  = cmds;
+   *countp = count;
+
+   return(0);
+}
+
+
+/// forks command with standard out captured in an anonymous file of at
+/// most SCU_BATCH_OUTPUT_MAX bytes, each command keeps getopt, policy and
+/// widget state of its own
+int scu_widget_batch_start(scu_config * cnf, scu_batch_cmd * cmd)
+{
+   int                  fd;
+   struct rlimit        rl;
+   scu_config           wcnf;
+#ifndef HAVE_MEMFD_CREATE
+   FILE               * fs;
+#endif
+
+#ifdef HAVE_MEMFD_CREATE
+   if ((cmd->fd = memfd_create("scu-batch", MFD_CLOEXEC)) == -1)
+#else
+   if ( ((fs = tmpfile()) == NULL) || ((cmd->fd = dup(fileno(fs))) == -1) || (fclose(fs) != 0) )
+#endif
+   {
+      fprintf(stderr, "%s: %s: %s\n", PROGRAM_NAME, cnf->widget->name, strerror(errno));
+      cmd->rc = 1;
+      return(-1);
+   };
+
+   fflush(stdout);
+   fflush(stderr);
+   if ((cmd->pid = fork()) == -1)
+   {
+      fprintf(stderr, "%s: %s: %s\n", PROGRAM_NAME, cnf->widget->name, strerror(errno));
+      cmd->rc = 1;
+      return(-1);
+   };
+   if (cmd->pid != 0)
+      return(0);
+
+   if ((fd = open("/dev/null", O_RDONLY)) != -1)
+   {
+      dup2(fd, STDIN_FILENO);
+      close(fd);
+   };
+   if (dup2(cmd->fd, STDOUT_FILENO) == -1)
+      _exit(1);
+
+   // output is held until it can be written in order, so its size is
+   // bounded and writes beyond the limit fail with EFBIG
+   rl.rlim_cur = (rlim_t)SCU_BATCH_OUTPUT_MAX;
+   rl.rlim_max = (rlim_t)SCU_BATCH_OUTPUT_MAX;
+   signal(SIGXFSZ, SIG_IGN);
+   if (setrlimit(RLIMIT_FSIZE, &rl) == -1)
+      _exit(1);
+
+   memset(&wcnf, 0, sizeof(wcnf));
+   wcnf.prog_name = cnf->prog_name;
+   wcnf.widget    = cmd->widget;
+   wcnf.argc      = cmd->argc;
+   wcnf.argv      = cmd->argv;
+   wcnf.batch     = 1;
+   optind         = 0;
+   scu_policy_select(cmd->widget->name);
+
+   cmd->rc = cmd->widget->func(&wcnf);
+   fflush(stdout);
+   _exit(cmd->rc & 0xff);
+}
+
+
+void scu_widget_batch_usage(scu_config * cnf)
+{
+   scu_usage_summary(cnf, " [OPTIONS] < commands");
+   printf("\n");
+   scu_usage_options(cnf);
+   printf("  -j, --jobs=N              run up to N read-only commands concurrently [1]\n");
+   printf("\n");
+   printf("INPUT:\n");
+   printf("   Each command is a widget name followed by its arguments, every\n");
+   printf("   argument ends with a NUL byte and an empty argument ends the command.\n");
+   printf("   Commands may not start another batch, a broker listener (-l) or\n");
+   printf("   follow a file (tail -f).  Commands which modify files (rm, rmdir,\n");
+   printf("   touch, ...) are refused unless a path policy is installed.\n");
+   printf("\n");
+   printf("OUTPUT:\n");
+   printf("   For each command in input order, a line \"INDEX STATUS LENGTH\" followed\n");
+   printf("   by LENGTH bytes written by the command to standard out.  Output of a\n");
+   printf("   command is limited to %lli bytes, larger output fails the command.\n", (long long)SCU_BATCH_OUTPUT_MAX);
+   printf("\n");
+   return;
+}
+
+
+/* end of source */
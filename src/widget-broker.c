@@ -0,0 +1,256 @@
+/*
+ *  Secure Core Utilities
+ *  Copyright (C) 2015, 2017 David M. Syzdek <david@syzdek.net>.
+ *
+ *  @SYZDEK_BSD_LICENSE_START@
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of David M. Syzdek nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ *  IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ *  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL DAVID M SYZDEK BE LIABLE FOR
+ *  ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ *  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ *  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ *  OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ *  SUCH DAMAGE.
+ *
+ *  @SYZDEK_BSD_LICENSE_END@
+ */
+#include "widget-broker.h"
+
+///////////////
+//           //
+//  Headers  //
+//           //
+///////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Headers
+#endif
+
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <grp.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "broker.h"
+
+
+//////////////////
+//              //
+//  Prototypes  //
+//              //
+//////////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Prototypes
+#endif
+
+void scu_widget_broker_usage(scu_config * cnf);
+
+
+/////////////////
+//             //
+//  Functions  //
+//             //
+/////////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Functions
+#endif
+
+int scu_widget_broker(scu_config * cnf)
+{
+   int            c;
+   int            opt_index;
+   int            rc;
+   int            fd;
+   int            listener;
+   uint32_t       op;
+   gid_t          gid;
+   char         * endptr;
+   const char   * sockpath;
+   struct group * gr;
+
+   // getopt options
+   static char   short_opt[] = "+g:hlqS:Vvz";
+   static struct option long_opt[] =
+   {
+      {"decode",           no_argument,       NULL, 'z' },
+      {"group",            required_argument, NULL, 'g' },
+      {"help",             no_argument,       NULL, 'h' },
+      {"listen",           no_argument,       NULL, 'l' },
+      {"quiet",            no_argument,       NULL, 'q' },
+      {"silent",           no_argument,       NULL, 'q' },
+      {"socket",           required_argument, NULL, 'S' },
+      {"version",          no_argument,       NULL, 'V' },
+      {"verbose",          no_argument,       NULL, 'v' },
+      { NULL, 0, NULL, 0 }
+   };
+
+   assert(cnf != NULL);
+   cnf->short_opt = short_opt;
+
+   listener = 0;
+   op       = SCU_BROKER_OPEN;
+   gid      = (gid_t)-1;
+   sockpath = NULL;
+
+   while((c = getopt_long(cnf->argc, cnf->argv, short_opt, long_opt, &opt_index)) != -1)
+   {
+      switch(c)
+      {
+         case -1:	/* no more arguments */
+         case 0:	/* long options toggles */
+         break;
+
+         case 'g':
+         if ((gr = getgrnam(optarg)) != NULL)
+         {
+            gid = gr->gr_gid;
+            break;
+         };
+         gid = (gid_t)strtoul(optarg, &endptr, 10);
+         if ( (endptr == optarg) || (endptr[0] != '\0') || (gid == (gid_t)-1) )
+         {
+            fprintf(stderr, "%s: %s: unknown group -- %s\n", PROGRAM_NAME, cnf->widget->name, optarg);
+            return(1);
+         };
+         break;
+
+         case 'h':
+         scu_widget_broker_usage(cnf);
+         return(0);
+
+         case 'l':
+         listener = 1;
+         break;
+
+         case 'S':
+         sockpath = optarg;
+         break;
+
+         case 'q':
+         cnf->quiet = 1;
+         if ((cnf->verbose))
+         {
+            fprintf(stderr, "%s: %s: incompatible options\n", PROGRAM_NAME, cnf->widget->name);
+            fprintf(stderr, "Try `%s --help' for more information.\n", PROGRAM_NAME);
+            return(1);
+         };
+         break;
+
+         case 'V':
+         printf("%s widget\n", cnf->widget->name);
+         scu_version();
+         return(0);
+
+         case 'v':
+         cnf->verbose++;
+         if ((cnf->quiet))
+         {
+            fprintf(stderr, "%s: %s: incompatible options\n", PROGRAM_NAME, cnf->widget->name);
+            fprintf(stderr, "Try `%s %s --help' for more information.\n", PROGRAM_NAME, cnf->widget->name);
+            return(1);
+         };
+         break;
+
+         case 'z':
+         op = SCU_BROKER_DECODE;
+         break;
+
+         case '?':
+         fprintf(stderr, "Try `%s %s --help' for more information.\n", PROGRAM_NAME, cnf->widget->name);
+         return(1);
+
+         default:
+         fprintf(stderr, "%s: %s: unrecognized option `--%c'\n", PROGRAM_NAME, cnf->widget->name, c);
+         fprintf(stderr, "Try `%s %s --help' for more information.\n", PROGRAM_NAME, cnf->widget->name);
+         return(1);
+      };
+   };
+
+   if ( ((listener)) && ((cnf->batch)) )
+   {
+      fprintf(stderr, "%s: %s: `-l' may not be used within batch\n", PROGRAM_NAME, cnf->widget->name);
+      return(1);
+   };
+   if ((listener))
+   {
+      // root listens only on the socket chosen when it was built
+      if (sockpath != NULL)
+      {
+         fprintf(stderr, "%s: %s: `-S' may not be used with `-l'\n", PROGRAM_NAME, cnf->widget->name);
+         return(1);
+      };
+      if ((cnf->argc - optind) > 0)
+      {
+         fprintf(stderr, "%s: unrecognized argument `-- %s'\n", PROGRAM_NAME, cnf->argv[optind]);
+         fprintf(stderr, "Try `%s %s --help' for more information.\n", PROGRAM_NAME, cnf->widget->name);
+         return(1);
+      };
+      return(scu_broker_listen(cnf, gid));
+   };
+
+   if ((cnf->argc - optind) < 1)
+   {
+      fprintf(stderr, "%s: %s: missing required argument\n", PROGRAM_NAME, cnf->widget->name);
+      fprintf(stderr, "Try `%s %s --help' for more information.\n", PROGRAM_NAME, cnf->widget->name);
+      return(1);
+   };
+   if ((cnf->argc - optind) > 1)
+   {
+      fprintf(stderr, "%s: unrecognized argument `-- %s'\n", PROGRAM_NAME, cnf->argv[optind+1]);
+      fprintf(stderr, "Try `%s %s --help' for more information.\n", PROGRAM_NAME, cnf->widget->name);
+      return(1);
+   };
+
+   // the broker validates the path with the rules of the calling user and
+   // hands back a descriptor, data is then read without the broker
+   if ((rc = scu_broker_open(((sockpath)) ? sockpath : SCU_BROKER_SOCKET, op, cnf->argv[optind], &fd)) != 0)
+   {
+      fprintf(stderr, "%s: %s: %s: %s\n", PROGRAM_NAME, cnf->widget->name, cnf->argv[optind], scu_strerror(rc));
+      return(1);
+   };
+   rc = scu_copy_fd(STDOUT_FILENO, fd);
+   if (rc == -1)
+      fprintf(stderr, "%s: %s: %s\n", PROGRAM_NAME, cnf->widget->name, strerror(errno));
+   close(fd);
+
+   return((rc == -1) ? 1 : 0);
+}
+
+
+void scu_widget_broker_usage(scu_config * cnf)
+{
+   scu_usage_summary(cnf, " [OPTIONS] file");
+   printf("\n");
+   scu_usage_options(cnf);
+   printf("  -g, --group=GROUP         allow members of GROUP to use the broker\n");
+   printf("  -l, --listen              serve requests on the socket\n");
+   printf("  -S, --socket=PATH         connect to broker socket [%s]\n", SCU_BROKER_SOCKET);
+   printf("  -z, --decode              request decompressed contents of file\n");
+   printf("\n");
+   scu_usage_restrictions();
+   printf("\n");
+   return;
+}
+
+
+/* end of source */
@@ -46,11 +46,14 @@
 #include <errno.h>
 #include <stdio.h>
 #include <string.h>
-#include <fcntl.h>
 #include <sys/types.h>
 #include <sys/uio.h>
 #include <unistd.h>
 
+#include "input.h"
+#include "probes.h"
+#include "stats.h"
+
 
 //////////////////
 //              //
@@ -77,10 +80,10 @@ int scu_widget_cat(scu_config * cnf)
 {
    int            c;
    int            opt_index;
-   int            fd;
    int            rc;
-   char           buff[512];
+   char           buff[SCU_BUFF_MAX];
    ssize_t        len;
+   scu_input    * inp;
 
    // getopt options
    static char   short_opt[] = "+hqVv";
@@ -158,57 +161,59 @@ int scu_widget_cat(scu_config * cnf)
       return(1);
    };
 
-   if ((rc = scu_pathcheck(cnf->argv[optind], 0)) != 0)
+   // checks file for restriction validations and detects compression
+   if ((rc = scu_input_open(&inp, cnf->argv[optind])) != 0)
    {
       fprintf(stderr, "%s: %s: %s\n", PROGRAM_NAME, cnf->widget->name, scu_strerror(rc));
       return(1);
    };
 
-   if ((fd = open(cnf->argv[optind], O_RDONLY)) == -1)
+   if ((len = scu_input_read(inp, buff, sizeof(buff))) == -1)
    {
-      fprintf(stderr, "%s: %s: %s\n", PROGRAM_NAME, cnf->widget->name, strerror(errno));
+      fprintf(stderr, "%s: %s: %s\n", PROGRAM_NAME, cnf->widget->name, scu_strerror(scu_input_error(inp)));
+      scu_input_close(inp);
       return(1);
    };
 
-   if ((len = read(fd, buff, 8)) == -1)
+   if (!(scu_is_ascii_buffer(buff, (len < 8) ? len : 8)))
    {
-      fprintf(stderr, "%s: %s: %s\n", PROGRAM_NAME, cnf->widget->name, strerror(errno));
-      close(fd);
-      return(1);
-   };
-
-   if (!(scu_is_ascii_buffer(buff, len)))
-   {
-      fprintf(stderr, "%s: %s: binary file, try `zcat'\n", PROGRAM_NAME, cnf->widget->name);
-      close(fd);
+      fprintf(stderr, "%s: %s: binary file\n", PROGRAM_NAME, cnf->widget->name);
+      scu_input_close(inp);
       return(1);
    }
 
-   if ((len = write(STDOUT_FILENO, buff, len)) == -1)
-   {
-      fprintf(stderr, "%s: %s: %s\n", PROGRAM_NAME, cnf->widget->name, strerror(errno));
-      close(fd);
-      return(1);
-   };
-
    while (len > 0)
    {
-      if ((len = read(fd, buff, sizeof(buff))) == -1)
+      SCU_STATS_SET(SCU_STATS_WRITE);
+      len = write(STDOUT_FILENO, buff, len);
+      SCU_STATS_OUT(len);
+      SCU_PROBE2(write, STDOUT_FILENO, (int64_t)len);
+      SCU_STATS_SET(SCU_STATS_OTHER);
+      if (len == -1)
       {
          fprintf(stderr, "%s: %s: %s\n", PROGRAM_NAME, cnf->widget->name, strerror(errno));
-         close(fd);
+         scu_input_close(inp);
          return(1);
       };
 
-      if ((len = write(STDOUT_FILENO, buff, len)) == -1)
+      // plain files are copied without passing through user space
+      if (scu_input_codec(inp) == SCU_CODEC_RAW)
       {
-         fprintf(stderr, "%s: %s: %s\n", PROGRAM_NAME, cnf->widget->name, strerror(errno));
-         close(fd);
+         if ((rc = scu_copy_fd(STDOUT_FILENO, scu_input_fd(inp))) == -1)
+            fprintf(stderr, "%s: %s: %s\n", PROGRAM_NAME, cnf->widget->name, strerror(errno));
+         scu_input_close(inp);
+         return((rc == -1) ? 1 : 0);
+      };
+
+      if ((len = scu_input_read(inp, buff, sizeof(buff))) == -1)
+      {
+         fprintf(stderr, "%s: %s: %s\n", PROGRAM_NAME, cnf->widget->name, scu_strerror(scu_input_error(inp)));
+         scu_input_close(inp);
          return(1);
       };
    };
 
-   close(fd);
+   scu_input_close(inp);
 
    return(0);
 }
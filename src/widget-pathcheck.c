@@ -43,7 +43,12 @@
 #endif
 
 #include <assert.h>
+#include <errno.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "policy.h"
 
 
 //////////////////
@@ -55,6 +60,8 @@
 #pragma mark - Prototypes
 #endif
 
+int scu_widget_pathcheck_batch(scu_config * cnf, int opts, int delim);
+int scu_widget_pathcheck_compile(scu_config * cnf);
 void scu_widget_pathcheck_usage(scu_config * cnf);
 
 
@@ -73,11 +80,15 @@ int scu_widget_pathcheck(scu_config * cnf)
    int            opt_index;
    int            rc;
    int            opts;
+   int            compile;
+   int            batch;
+   int            delim;
 
    // getopt options
-   static char   short_opt[] = "+dihqVv";
+   static char   short_opt[] = "+0bdihPqVv";
    static struct option long_opt[] =
    {
+      {"batch",            no_argument,       NULL, 'b' },
       {"help",             no_argument,       NULL, 'h' },
       {"ignore",           no_argument,       NULL, 'i' },
       {"quiet",            no_argument,       NULL, 'q' },
@@ -85,13 +96,18 @@ int scu_widget_pathcheck(scu_config * cnf)
       {"version",          no_argument,       NULL, 'V' },
       {"verbose",          no_argument,       NULL, 'v' },
       {"directory",        no_argument,       NULL, 'd' },
+      {"compile-policy",   no_argument,       NULL, 'P' },
+      {"null",             no_argument,       NULL, '0' },
       { NULL, 0, NULL, 0 }
    };
 
    assert(cnf != NULL);
    cnf->short_opt = short_opt;
 
-   opts = 0;
+   opts    = 0;
+   compile = 0;
+   batch   = 0;
+   delim   = '\n';
 
    while((c = getopt_long(cnf->argc, cnf->argv, short_opt, long_opt, &opt_index)) != -1)
    {
@@ -101,6 +117,15 @@ int scu_widget_pathcheck(scu_config * cnf)
          case 0:	/* long options toggles */
          break;
 
+         case '0':
+         batch = 1;
+         delim = '\0';
+         break;
+
+         case 'b':
+         batch = 1;
+         break;
+
          case 'd':
          opts |= SCU_ODIR;
          break;
@@ -113,6 +138,10 @@ int scu_widget_pathcheck(scu_config * cnf)
          scu_widget_pathcheck_usage(cnf);
          return(0);
 
+         case 'P':
+         compile = 1;
+         break;
+
          case 's':
          cnf->quiet = 1;
          if ((cnf->verbose))
@@ -149,6 +178,11 @@ int scu_widget_pathcheck(scu_config * cnf)
       };
    };
 
+   if ((compile))
+      return(scu_widget_pathcheck_compile(cnf));
+   if ((batch))
+      return(scu_widget_pathcheck_batch(cnf, opts, delim));
+
    if ((cnf->argc - optind) < 1)
    {
       fprintf(stderr, "%s: %s: missing required argument\n", PROGRAM_NAME, cnf->widget->name);
@@ -173,13 +207,91 @@ int scu_widget_pathcheck(scu_config * cnf)
 }
 
 
+/// checks delimited paths from stdin, writing one verdict per path in input order
+int scu_widget_pathcheck_batch(scu_config * cnf, int opts, int delim)
+{
+   int                  rc;
+   int                  failed;
+   char               * line;
+   size_t               size;
+   ssize_t              len;
+   scu_path             p;
+   scu_pathcache        pc;
+
+   if (cnf->argc != optind)
+   {
+      fprintf(stderr, "%s: unrecognized argument `-- %s'\n", PROGRAM_NAME, cnf->argv[optind]);
+      fprintf(stderr, "Try `%s %s --help' for more information.\n", PROGRAM_NAME, cnf->widget->name);
+      return(1);
+   };
+
+   memset(&pc, 0, sizeof(pc));
+   line   = NULL;
+   size   = 0;
+   failed = 0;
+
+   // ancestors shared between paths are opened once and reused by
+   // descriptor, leaving a single fstatat() per path
+   while ((len = getdelim(&line, &size, delim, stdin)) != -1)
+   {
+      if ( (len > 0) && (line[len-1] == delim) )
+         line[--len] = '\0';
+      if ((rc = scu_pathcache_stat(&pc, &p, line, opts)) != 0)
+         failed = 1;
+      if (!(cnf->quiet))
+         printf("%s: %s%c", line, ((rc == 0) ? "OK" : scu_strerror(rc)), delim);
+   };
+   if (ferror(stdin))
+   {
+      fprintf(stderr, "%s: %s: stdin: %s\n", PROGRAM_NAME, cnf->widget->name, strerror(errno));
+      failed = 1;
+   };
+
+   free(line);
+   scu_pathcache_free(&pc);
+
+   return(failed);
+}
+
+
+/// compiles policy source into image mapped by widgets at startup
+int scu_widget_pathcheck_compile(scu_config * cnf)
+{
+#ifdef SCU_POLICY
+   int            rc;
+
+   if (cnf->argc != optind)
+   {
+      fprintf(stderr, "%s: unrecognized argument `-- %s'\n", PROGRAM_NAME, cnf->argv[optind]);
+      fprintf(stderr, "Try `%s %s --help' for more information.\n", PROGRAM_NAME, cnf->widget->name);
+      return(1);
+   };
+   if ((rc = scu_policy_compile(SCU_POLICY, SCU_POLICY_IMAGE)) != 0)
+   {
+      if (!(cnf->quiet))
+         fprintf(stderr, "%s: %s: %s: %s\n", PROGRAM_NAME, cnf->widget->name, SCU_POLICY, scu_strerror(rc));
+      return(1);
+   };
+   if ((cnf->verbose))
+      printf("%s: %s: compiled %s\n", PROGRAM_NAME, cnf->widget->name, SCU_POLICY_IMAGE);
+   return(0);
+#else
+   fprintf(stderr, "%s: %s: path policy support not enabled\n", PROGRAM_NAME, cnf->widget->name);
+   return(1);
+#endif
+}
+
+
 void scu_widget_pathcheck_usage(scu_config * cnf)
 {
    scu_usage_summary(cnf, " [OPTIONS] file");
    printf("\n");
    scu_usage_options(cnf);
+   printf("  -0, --null                paths on stdin are NUL terminated (implies -b)\n");
+   printf("  -b, --batch               check paths read from stdin, one verdict per path\n");
    printf("  -d, --directory           check path for directory instead of file\n");
    printf("  -i, --ignore              ignore non-existent files and directories\n");
+   printf("  -P, --compile-policy      compile path policy into binary image\n");
    printf("\n");
    scu_usage_restrictions();
    printf("\n");
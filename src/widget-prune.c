@@ -0,0 +1,600 @@
+/*
+ *  Secure Core Utilities
+ *  Copyright (C) 2015, 2017 David M. Syzdek <david@syzdek.net>.
+ *
+ *  @SYZDEK_BSD_LICENSE_START@
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of David M. Syzdek nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ *  IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ *  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL DAVID M SYZDEK BE LIABLE FOR
+ *  ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ *  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ *  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ *  OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ *  SUCH DAMAGE.
+ *
+ *  @SYZDEK_BSD_LICENSE_END@
+ */
+#include "widget-prune.h"
+
+///////////////
+//           //
+//  Headers  //
+//           //
+///////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Headers
+#endif
+
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <inttypes.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <fnmatch.h>
+#include <time.h>
+
+#include "policy.h"
+#include "uring.h"
+
+
+///////////////////
+//               //
+//  Definitions  //
+//               //
+///////////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Definitions
+#endif
+
+#define SCU_PRUNE_BUFF     (1024*1024)   // getdents64() buffer, thousands of entries per call
+#define SCU_PRUNE_ARENA    (1024*1024)   // block size for storing entry names
+
+
+//////////////////
+//              //
+//  Data Types  //
+//              //
+//////////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Data Types
+#endif
+
+typedef struct scu_prune         scu_prune;
+typedef struct scu_prune_file    scu_prune_file;
+
+
+struct scu_prune_file
+{
+   const char         * name;
+   int64_t              mtime;
+   uint32_t             mtime_nsec;
+   uint64_t             size;
+};
+
+
+struct scu_prune
+{
+   int                  dfd;
+   int                  needsize;
+   const char         * dir;
+   const char         * match;
+   size_t               count;
+   size_t               max;
+   size_t               denied;
+   size_t               narena;
+   size_t               arena_used;
+   scu_prune_file     * files;
+   char              ** arena;
+};
+
+
+//////////////////
+//              //
+//  Prototypes  //
+//              //
+//////////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Prototypes
+#endif
+
+int scu_widget_prune_add(scu_prune * pr, const char * name, size_t len, const struct stat * sbp);
+int scu_widget_prune_compare(const void * a, const void * b);
+int scu_widget_prune_entry(scu_prune * pr, char * path, size_t dlen, const char * name, int type);
+void scu_widget_prune_free(scu_prune * pr);
+int scu_widget_prune_scan(scu_config * cnf, scu_prune * pr);
+int scu_widget_prune_stat(scu_prune * pr, const char * name, int type, struct stat * sbp);
+void scu_widget_prune_usage(scu_config * cnf);
+
+
+/////////////////
+//             //
+//  Functions  //
+//             //
+/////////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Functions
+#endif
+
+int scu_widget_prune(scu_config * cnf)
+{
+   int            c;
+   int            opt_index;
+   int            rc;
+   int            dryrun;
+   int            full;
+   int          * errs;
+   size_t         x;
+   size_t         count;
+   size_t         kept;
+   uint64_t       age;
+   uint64_t       keep_count;
+   uint64_t       keep_bytes;
+   uint64_t       bytes;
+   uint64_t       removed;
+   int64_t        cutoff;
+   const char  ** names;
+   scu_prune_file * file;
+   scu_prune      pr;
+   scu_path       p;
+
+   static const uint64_t age_scale[]  = { 1, 60, 3600, 86400, 604800 };
+   static const uint64_t size_scale[] = { 1, 1024, 1048576, 1073741824, 1099511627776ULL };
+
+   // getopt options
+   static char   short_opt[] = "+a:c:hm:nqS:Vv";
+   static struct option long_opt[] =
+   {
+      {"help",             no_argument,       NULL, 'h' },
+      {"quiet",            no_argument,       NULL, 'q' },
+      {"silent",           no_argument,       NULL, 'q' },
+      {"version",          no_argument,       NULL, 'V' },
+      {"verbose",          no_argument,       NULL, 'v' },
+      {"age",              required_argument, NULL, 'a' },
+      {"count",            required_argument, NULL, 'c' },
+      {"dry-run",          no_argument,       NULL, 'n' },
+      {"match",            required_argument, NULL, 'm' },
+      {"size",             required_argument, NULL, 'S' },
+      { NULL, 0, NULL, 0 }
+   };
+
+   assert(cnf != NULL);
+   cnf->short_opt = short_opt;
+
+   memset(&pr, 0, sizeof(pr));
+   dryrun     = 0;
+   age        = 0;
+   keep_count = UINT64_MAX;
+   keep_bytes = UINT64_MAX;
+
+   while((c = getopt_long(cnf->argc, cnf->argv, short_opt, long_opt, &opt_index)) != -1)
+   {
+      switch(c)
+      {
+         case -1:	/* no more arguments */
+         case 0:	/* long options toggles */
+         break;
+
+         case 'a':
+         if ( (scu_parse_units(optarg, "smhdw", 3, age_scale, &age) == -1) || (age == 0) )
+         {
+            fprintf(stderr, "%s: %s: invalid age -- \"%s\"\n", PROGRAM_NAME, cnf->widget->name, optarg);
+            return(1);
+         };
+         break;
+
+         case 'c':
+         if (scu_parse_units(optarg, "", 0, size_scale, &keep_count) == -1)
+         {
+            fprintf(stderr, "%s: %s: invalid count -- \"%s\"\n", PROGRAM_NAME, cnf->widget->name, optarg);
+            return(1);
+         };
+         break;
+
+         case 'h':
+         scu_widget_prune_usage(cnf);
+         return(0);
+
+         case 'm':
+         pr.match = optarg;
+         break;
+
+         case 'n':
+         dryrun = 1;
+         break;
+
+         case 'S':
+         if (scu_parse_units(optarg, "bKMGT", 0, size_scale, &keep_bytes) == -1)
+         {
+            fprintf(stderr, "%s: %s: invalid size -- \"%s\"\n", PROGRAM_NAME, cnf->widget->name, optarg);
+            return(1);
+         };
+         pr.needsize = 1;
+         break;
+
+         case 's':
+         cnf->quiet = 1;
+         if ((cnf->verbose))
+         {
+            fprintf(stderr, "%s: %s: incompatible options\n", PROGRAM_NAME, cnf->widget->name);
+            fprintf(stderr, "Try `%s --help' for more information.\n", PROGRAM_NAME);
+            return(1);
+         };
+         break;
+
+         case 'V':
+         printf("%s widget\n", cnf->widget->name);
+         scu_version();
+         return(0);
+
+         case 'v':
+         cnf->verbose++;
+         if ((cnf->quiet))
+         {
+            fprintf(stderr, "%s: %s: incompatible options\n", PROGRAM_NAME, cnf->widget->name);
+            fprintf(stderr, "Try `%s %s --help' for more information.\n", PROGRAM_NAME, cnf->widget->name);
+            return(1);
+         };
+         break;
+
+         case '?':
+         fprintf(stderr, "Try `%s %s --help' for more information.\n", PROGRAM_NAME, cnf->widget->name);
+         return(1);
+
+         default:
+         fprintf(stderr, "%s: %s: unrecognized option `--%c'\n", PROGRAM_NAME, cnf->widget->name, c);
+         fprintf(stderr, "Try `%s %s --help' for more information.\n", PROGRAM_NAME, cnf->widget->name);
+         return(1);
+      };
+   };
+
+   if ((cnf->argc - optind) < 1)
+   {
+      fprintf(stderr, "%s: %s: missing required argument\n", PROGRAM_NAME, cnf->widget->name);
+      fprintf(stderr, "Try `%s %s --help' for more information.\n", PROGRAM_NAME, cnf->widget->name);
+      return(1);
+   };
+   if ((cnf->argc - optind) > 1)
+   {
+      fprintf(stderr, "%s: unrecognized argument `-- %s'\n", PROGRAM_NAME, cnf->argv[optind+1]);
+      fprintf(stderr, "Try `%s %s --help' for more information.\n", PROGRAM_NAME, cnf->widget->name);
+      return(1);
+   };
+   if ( (age == 0) && (keep_count == UINT64_MAX) && (keep_bytes == UINT64_MAX) )
+   {
+      fprintf(stderr, "%s: %s: one of --age, --count or --size is required\n", PROGRAM_NAME, cnf->widget->name);
+      fprintf(stderr, "Try `%s %s --help' for more information.\n", PROGRAM_NAME, cnf->widget->name);
+      return(1);
+   };
+
+   pr.needsize = ((cnf->verbose)) ? 1 : pr.needsize;
+
+   // directory is validated as a whole, each file is later checked
+   // against the policy by its own path
+   pr.dir = cnf->argv[optind];
+   if ((rc = scu_pathopen(&p, pr.dir, SCU_ODIR|SCU_ONOPOLICY, O_RDONLY|O_DIRECTORY)) != 0)
+   {
+      fprintf(stderr, "%s: %s: %s\n", PROGRAM_NAME, cnf->widget->name, scu_strerror(rc));
+      return(1);
+   };
+   pr.dfd = p.fd;
+
+   if ((rc = scu_widget_prune_scan(cnf, &pr)) != 0)
+   {
+      scu_pathclose(&p);
+      scu_widget_prune_free(&pr);
+      return(1);
+   };
+
+   // retention by count or size keeps the newest files, age alone does
+   // not depend on order
+   if ( (keep_count != UINT64_MAX) || (keep_bytes != UINT64_MAX) )
+      qsort(pr.files, pr.count, sizeof(scu_prune_file), scu_widget_prune_compare);
+   cutoff  = (age > 0) ? ((int64_t)time(NULL) - (int64_t)age) : INT64_MIN;
+   kept    = 0;
+   bytes   = 0;
+   full    = 0;
+   count   = 0;
+   removed = 0;
+   for(x = 0; (x < pr.count); x++)
+   {
+      file = &pr.files[x];
+      if ( (file->mtime >= cutoff) && (kept < keep_count) && (!(full)) &&
+           ((keep_bytes - bytes) >= file->size) )
+      {
+         kept++;
+         bytes += file->size;
+         continue;
+      };
+      if ((keep_bytes - bytes) < file->size)
+         full = 1;
+      pr.files[count++] = *file;
+      removed += file->size;
+   };
+
+   if ( (dryrun) || (cnf->verbose) )
+      for(x = 0; (x < count); x++)
+         printf("%s%s/%s\n", ((dryrun) ? "" : "removing "), pr.dir, pr.files[x].name);
+   if ( (dryrun) || (count == 0) )
+   {
+      scu_pathclose(&p);
+      scu_widget_prune_free(&pr);
+      return(0);
+   };
+
+   names = malloc(count * sizeof(char *));
+   errs  = malloc(count * sizeof(int));
+   if ( (names == NULL) || (errs == NULL) )
+   {
+      fprintf(stderr, "%s: %s: %s\n", PROGRAM_NAME, cnf->widget->name, strerror(errno));
+      free(names);
+      free(errs);
+      scu_pathclose(&p);
+      scu_widget_prune_free(&pr);
+      return(1);
+   };
+   for(x = 0; (x < count); x++)
+      names[x] = pr.files[x].name;
+
+   // names are removed relative to the verified directory descriptor
+   scu_uring_unlinkat(pr.dfd, names, errs, count, 0);
+   for(x = 0, rc = 0; (x < count); x++)
+   {
+      if (errs[x] == 0)
+         continue;
+      if (!(cnf->quiet))
+         fprintf(stderr, "%s: %s: %s/%s: %s\n", PROGRAM_NAME, cnf->widget->name, pr.dir, names[x], strerror(errs[x]));
+      removed -= pr.files[x].size;
+      rc = 1;
+   };
+   if ((cnf->verbose))
+      printf("%s: %s: removed %zu of %zu files (%" PRIu64 " bytes)\n", PROGRAM_NAME, cnf->widget->name, count, pr.count, removed);
+
+   free(names);
+   free(errs);
+   scu_pathclose(&p);
+   scu_widget_prune_free(&pr);
+
+   return(rc);
+}
+
+
+/// stores file, names are packed into blocks which are never moved
+int scu_widget_prune_add(scu_prune * pr, const char * name, size_t len, const struct stat * sbp)
+{
+   char              * str;
+   void              * ptr;
+   scu_prune_file    * file;
+
+   if (pr->count == pr->max)
+   {
+      pr->max = (pr->max == 0) ? 4096 : (pr->max * 2);
+      if ((ptr = realloc(pr->files, pr->max * sizeof(scu_prune_file))) == NULL)
+         return(-1);
+      pr->files = ptr;
+   };
+
+   if ( (pr->narena == 0) || ((pr->arena_used + len + 1) > SCU_PRUNE_ARENA) )
+   {
+      if ((ptr = realloc(pr->arena, (pr->narena + 1) * sizeof(char *))) == NULL)
+         return(-1);
+      pr->arena = ptr;
+      if ((pr->arena[pr->narena] = malloc(SCU_PRUNE_ARENA)) == NULL)
+         return(-1);
+      pr->narena++;
+      pr->arena_used = 0;
+   };
+   str = &pr->arena[pr->narena-1][pr->arena_used];
+   memcpy(str, name, len + 1);
+   pr->arena_used += len + 1;
+
+   file             = &pr->files[pr->count++];
+   file->name       = str;
+   file->mtime      = (int64_t)sbp->st_mtim.tv_sec;
+   file->mtime_nsec = (uint32_t)sbp->st_mtim.tv_nsec;
+   file->size       = (uint64_t)sbp->st_size;
+
+   return(0);
+}
+
+
+/// orders files newest first
+int scu_widget_prune_compare(const void * a, const void * b)
+{
+   const scu_prune_file * fa = a;
+   const scu_prune_file * fb = b;
+   if (fa->mtime != fb->mtime)
+      return((fa->mtime > fb->mtime) ? -1 : 1);
+   if (fa->mtime_nsec != fb->mtime_nsec)
+      return((fa->mtime_nsec > fb->mtime_nsec) ? -1 : 1);
+   return(strcmp(fb->name, fa->name));
+}
+
+
+void scu_widget_prune_free(scu_prune * pr)
+{
+   size_t         x;
+   for(x = 0; (x < pr->narena); x++)
+      free(pr->arena[x]);
+   free(pr->arena);
+   free(pr->files);
+   memset(pr, 0, sizeof(scu_prune));
+   return;
+}
+
+
+/// filters directory entry and stores it if it is a permitted regular file
+int scu_widget_prune_entry(scu_prune * pr, char * path, size_t dlen, const char * name, int type)
+{
+   size_t               len;
+   struct stat          sb;
+
+   // hidden names may not be addressed by any widget
+   if (name[0] == '.')
+      return(0);
+   if ( (type != DT_REG) && (type != DT_UNKNOWN) )
+      return(0);
+   if ( (pr->match != NULL) && (fnmatch(pr->match, name, FNM_PERIOD) != 0) )
+      return(0);
+
+   len = strlen(name);
+   if ((dlen + len) >= PATH_MAX)
+      return(0);
+   memcpy(&path[dlen], name, len + 1);
+   if (scu_policy_check(path) != 0)
+   {
+      pr->denied++;
+      return(0);
+   };
+
+   if (scu_widget_prune_stat(pr, name, type, &sb) != 0)
+      return(0);
+   if (!(S_ISREG(sb.st_mode)))
+      return(0);
+
+   return(scu_widget_prune_add(pr, name, len, &sb));
+}
+
+
+/// reads directory in large batches and stats candidate files
+int scu_widget_prune_scan(scu_config * cnf, scu_prune * pr)
+{
+   int                  rc;
+   size_t               dlen;
+   char                 path[PATH_MAX];
+#ifdef HAVE_GETDENTS64
+   char               * buff;
+   ssize_t              nread;
+   ssize_t              off;
+   struct dirent64    * de;
+#else
+   int                  fd;
+   DIR                * dp;
+   struct dirent      * de;
+#endif
+
+   dlen = strlen(pr->dir);
+   if (dlen >= (sizeof(path) - 2))
+   {
+      fprintf(stderr, "%s: %s: %s: %s\n", PROGRAM_NAME, cnf->widget->name, pr->dir, strerror(ENAMETOOLONG));
+      return(-1);
+   };
+   memcpy(path, pr->dir, dlen);
+   path[dlen++] = '/';
+   rc = 0;
+
+#ifdef HAVE_GETDENTS64
+   // a single call returns thousands of entries instead of readdir()'s
+   // 32 KiB refills
+   if ((buff = malloc(SCU_PRUNE_BUFF)) == NULL)
+   {
+      fprintf(stderr, "%s: %s: %s\n", PROGRAM_NAME, cnf->widget->name, strerror(errno));
+      return(-1);
+   };
+   while ( (rc == 0) && ((nread = getdents64(pr->dfd, buff, SCU_PRUNE_BUFF)) > 0) )
+   {
+      for(off = 0; ((rc == 0) && (off < nread)); off += de->d_reclen)
+      {
+         de = (struct dirent64 *)&buff[off];
+         rc = scu_widget_prune_entry(pr, path, dlen, de->d_name, de->d_type);
+      };
+   };
+   free(buff);
+   if ( (rc == 0) && (nread == -1) )
+      rc = -1;
+#else
+   if ( ((fd = dup(pr->dfd)) == -1) || ((dp = fdopendir(fd)) == NULL) )
+   {
+      fprintf(stderr, "%s: %s: %s: %s\n", PROGRAM_NAME, cnf->widget->name, pr->dir, strerror(errno));
+      return(-1);
+   };
+   errno = 0;
+   while ( (rc == 0) && ((de = readdir(dp)) != NULL) )
+      rc = scu_widget_prune_entry(pr, path, dlen, de->d_name, de->d_type);
+   if ( (rc == 0) && (errno != 0) )
+      rc = -1;
+   closedir(dp);
+#endif
+   if (rc != 0)
+   {
+      fprintf(stderr, "%s: %s: %s: %s\n", PROGRAM_NAME, cnf->widget->name, pr->dir, strerror(errno));
+      return(-1);
+   };
+
+   if ( (pr->denied > 0) && (cnf->verbose) )
+      printf("%s: %s: skipped %zu files not permitted by policy\n", PROGRAM_NAME, cnf->widget->name, pr->denied);
+
+   return(0);
+}
+
+
+/// stats entry without following symlinks, requesting only needed fields
+int scu_widget_prune_stat(scu_prune * pr, const char * name, int type, struct stat * sbp)
+{
+#ifdef HAVE_STATX
+   unsigned             mask;
+   struct statx         stx;
+
+   mask  = STATX_MTIME;
+   mask |= (type == DT_UNKNOWN) ? STATX_TYPE : 0;
+   mask |= (pr->needsize)       ? STATX_SIZE : 0;
+   if (statx(pr->dfd, name, AT_SYMLINK_NOFOLLOW|AT_NO_AUTOMOUNT, mask, &stx) == -1)
+      return(-1);
+
+   memset(sbp, 0, sizeof(struct stat));
+   sbp->st_mode          = (type == DT_UNKNOWN) ? stx.stx_mode : S_IFREG;
+   sbp->st_size          = (pr->needsize) ? (off_t)stx.stx_size : 0;
+   sbp->st_mtim.tv_sec   = (time_t)stx.stx_mtime.tv_sec;
+   sbp->st_mtim.tv_nsec  = (long)stx.stx_mtime.tv_nsec;
+
+   return(0);
+#else
+   if (fstatat(pr->dfd, name, sbp, AT_SYMLINK_NOFOLLOW) == -1)
+      return(-1);
+   if (!(pr->needsize))
+      sbp->st_size = 0;
+   return(0);
+#endif
+}
+
+
+void scu_widget_prune_usage(scu_config * cnf)
+{
+   scu_usage_summary(cnf, " [OPTIONS] directory");
+   printf("\n");
+   scu_usage_options(cnf);
+   printf("  -a, --age=AGE             remove files modified more than AGE ago (s, m, h, d, w; default d)\n");
+   printf("  -c, --count=NUM           keep only the NUM newest files\n");
+   printf("  -m, --match=PATTERN       only consider file names matching shell pattern\n");
+   printf("  -n, --dry-run             list files which would be removed\n");
+   printf("  -S, --size=SIZE           keep newest files up to SIZE total bytes (K, M, G, T)\n");
+   printf("\n");
+   scu_usage_restrictions();
+   printf("\n");
+   return;
+}
+
+/* end of source */
@@ -45,11 +45,34 @@
 #include <assert.h>
 #include <errno.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <strings.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <unistd.h>
+#include <fcntl.h>
+
+#include "throttle.h"
+#include "uring.h"
+
+
+//////////////////
+//              //
+//  Data Types  //
+//              //
+//////////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Data Types
+#endif
+
+typedef struct scu_rm_file scu_rm_file;
+
+struct scu_rm_file
+{
+   const char         * path;
+   size_t               dirlen;     // length of parent directory within path
+};
 
 
 //////////////////
@@ -61,6 +84,9 @@
 #pragma mark - Prototypes
 #endif
 
+int scu_widget_rm_compare(const void * a, const void * b);
+int scu_widget_rm_confirm(scu_config * cnf, int fromstdin);
+int scu_widget_rm_files(scu_config * cnf, const char ** paths, size_t count, int force, int prompt, int fromstdin, uint64_t rate);
 void scu_widget_rm_usage(scu_config * cnf);
 
 
@@ -77,17 +103,23 @@ int scu_widget_rm(scu_config * cnf)
 {
    int            force;
    int            prompt;
+   int            fromstdin;
    int            c;
    int            opt_index;
    int            rc;
-   int            readonly;
+   size_t         count;
+   size_t         max;
+   size_t         size;
    ssize_t        len;
-   char           anwser[16];
-   uid_t          uid;
-   struct stat    sb;
+   char         * line;
+   uint64_t       rate;
+   const char  ** paths;
+   void         * ptr;
+
+   static const uint64_t size_scale[] = { 1, 1024, 1048576, 1073741824, 1099511627776ULL };
 
    // getopt options
-   static char   short_opt[] = "+fhiqVv";
+   static char   short_opt[] = "+0fhiqT:Vv";
    static struct option long_opt[] =
    {
       {"help",             no_argument,       NULL, 'h' },
@@ -96,16 +128,18 @@ int scu_widget_rm(scu_config * cnf)
       {"version",          no_argument,       NULL, 'V' },
       {"verbose",          no_argument,       NULL, 'v' },
       {"force",            no_argument,       NULL, 'f' },
+      {"null",             no_argument,       NULL, '0' },
+      {"throttle",         required_argument, NULL, 'T' },
       { NULL, 0, NULL, 0 }
    };
 
    assert(cnf != NULL);
    cnf->short_opt = short_opt;
 
-   force    = 0;
-   prompt   = 0;
-   readonly = 0;
-   uid      = getuid();
+   force     = 0;
+   prompt    = 0;
+   fromstdin = 0;
+   rate      = 0;
 
    while((c = getopt_long(cnf->argc, cnf->argv, short_opt, long_opt, &opt_index)) != -1)
    {
@@ -115,6 +149,10 @@ int scu_widget_rm(scu_config * cnf)
          case 0:	/* long options toggles */
          break;
 
+         case '0':
+         fromstdin = 1;
+         break;
+
          case 'f':
          force  = 1;
          prompt = 0;
@@ -129,6 +167,14 @@ int scu_widget_rm(scu_config * cnf)
          force  = 0;
          break;
 
+         case 'T':
+         if ( (scu_parse_units(optarg, "bKMGT", 0, size_scale, &rate) == -1) || (rate == 0) )
+         {
+            fprintf(stderr, "%s: %s: invalid rate -- \"%s\"\n", PROGRAM_NAME, cnf->widget->name, optarg);
+            return(1);
+         };
+         break;
+
          case 's':
          cnf->quiet = 1;
          if ((cnf->verbose))
@@ -140,7 +186,7 @@ int scu_widget_rm(scu_config * cnf)
          break;
 
          case 'V':
-         printf("%s widget\n", cnf->widget->name);
+         printf("%s widget (unlink backend: %s)\n", cnf->widget->name, scu_uring_backend());
          scu_version();
          return(0);
 
@@ -165,85 +211,256 @@ int scu_widget_rm(scu_config * cnf)
       };
    };
 
-   if ((cnf->argc - optind) < 1)
+   if ((fromstdin))
+   {
+      if ((cnf->argc - optind) > 0)
+      {
+         fprintf(stderr, "%s: unrecognized argument `-- %s'\n", PROGRAM_NAME, cnf->argv[optind]);
+         fprintf(stderr, "Try `%s %s --help' for more information.\n", PROGRAM_NAME, cnf->widget->name);
+         return(1);
+      };
+   }
+   else if ((cnf->argc - optind) < 1)
    {
       fprintf(stderr, "%s: %s: missing required argument\n", PROGRAM_NAME, cnf->widget->name);
       fprintf(stderr, "Try `%s %s --help' for more information.\n", PROGRAM_NAME, cnf->widget->name);
       return(1);
    };
-   if ((cnf->argc - optind) > 1)
+
+   if (!(fromstdin))
+      return(scu_widget_rm_files(cnf, (const char **)&cnf->argv[optind], (size_t)(cnf->argc - optind), force, prompt, 0, rate));
+
+   // read NUL terminated list of files
+   paths = NULL;
+   count = 0;
+   max   = 0;
+   line  = NULL;
+   size  = 0;
+   while ((len = getdelim(&line, &size, '\0', stdin)) != -1)
    {
-      fprintf(stderr, "%s: unrecognized argument `-- %s'\n", PROGRAM_NAME, cnf->argv[optind+1]);
-      fprintf(stderr, "Try `%s %s --help' for more information.\n", PROGRAM_NAME, cnf->widget->name);
-      return(1);
+      if (count == max)
+      {
+         max = (max == 0) ? 256 : (max * 2);
+         if ((ptr = realloc(paths, max * sizeof(char *))) == NULL)
+            break;
+         paths = ptr;
+      };
+      paths[count++] = line;
+      line = NULL;
+      size = 0;
    };
+   free(line);
+   if ( (ferror(stdin)) || (len != -1) )
+   {
+      fprintf(stderr, "%s: %s: stdin: %s\n", PROGRAM_NAME, cnf->widget->name, strerror(errno));
+      rc = 1;
+   } else {
+      rc = scu_widget_rm_files(cnf, paths, count, force, prompt, 1, rate);
+   };
+
+   while (count > 0)
+      free((char *)paths[--count]);
+   free(paths);
 
-   // checks file for restriction validations
-   if ((rc = stat(cnf->argv[optind], &sb)) == -1)
+   return(rc);
+}
+
+
+/// orders files by parent directory so each directory forms one batch
+int scu_widget_rm_compare(const void * a, const void * b)
+{
+   int                  rc;
+   const scu_rm_file  * fa = a;
+   const scu_rm_file  * fb = b;
+   if ((rc = memcmp(fa->path, fb->path, (fa->dirlen < fb->dirlen) ? fa->dirlen : fb->dirlen)) != 0)
+      return(rc);
+   if (fa->dirlen != fb->dirlen)
+      return((fa->dirlen < fb->dirlen) ? -1 : 1);
+   return(strcmp(fa->path, fb->path));
+}
+
+
+/// reads answer from terminal when stdin holds the list of files
+int scu_widget_rm_confirm(scu_config * cnf, int fromstdin)
+{
+   int            fd;
+   ssize_t        len;
+   char           anwser[16];
+
+   fflush(stdout);
+   fd = STDIN_FILENO;
+   if ( (fromstdin) && ((fd = open("/dev/tty", O_RDONLY|O_CLOEXEC|O_NOCTTY)) == -1) )
+   {
+      fprintf(stderr, "%s: %s: /dev/tty: %s\n", PROGRAM_NAME, cnf->widget->name, strerror(errno));
+      return(-1);
+   };
+   len = read(fd, anwser, sizeof(anwser));
+   if (fd != STDIN_FILENO)
+      close(fd);
+   if (len == -1)
+   {
+      fprintf(stderr, "%s: %s:%s\n", PROGRAM_NAME, cnf->widget->name, strerror(errno));
+      return(-1);
+   };
+   if ( (len < 1) || ((anwser[0] != 'y') && (anwser[0] != 'Y')) )
+      return(0);
+   return(1);
+}
+
+
+int scu_widget_rm_files(scu_config * cnf, const char ** paths, size_t count, int force, int prompt, int fromstdin, uint64_t rate)
+{
+   int            rc;
+   int            failed;
+   int            dirfd;
+   size_t         nfiles;
+   size_t         nreadonly;
+   size_t         x;
+   size_t         y;
+   size_t         z;
+   uid_t          uid;
+   int          * errs;
+   const char  ** names;
+   scu_rm_file  * files;
+   scu_path       p;
+   scu_pathcache  pc;
+   scu_throttle * th;
+
+   uid       = getuid();
+   failed    = 0;
+   nfiles    = 0;
+   nreadonly = 0;
+   th        = NULL;
+   memset(&pc, 0, sizeof(pc));
+
+   if ( (rate != 0) && ((th = scu_throttle_init(rate)) == NULL) )
    {
-      if (errno == ENOENT)
-         return(0);
       fprintf(stderr, "%s: %s: %s\n", PROGRAM_NAME, cnf->widget->name, strerror(errno));
       return(1);
    };
-   if ((rc = scu_pathcheck(cnf->argv[optind], 0)) != 0)
+
+   files = malloc((count + 1) * sizeof(scu_rm_file));
+   names = malloc((count + 1) * sizeof(char *));
+   errs  = malloc((count + 1) * sizeof(int));
+   if ( (files == NULL) || (names == NULL) || (errs == NULL) )
    {
-      fprintf(stderr, "%s: %s: %s\n", PROGRAM_NAME, cnf->widget->name, scu_strerror(rc));
+      fprintf(stderr, "%s: %s: %s\n", PROGRAM_NAME, cnf->widget->name, strerror(errno));
+      free(files);
+      free(names);
+      free(errs);
+      scu_throttle_free(th);
       return(1);
    };
-   if (!(S_ISREG(sb.st_mode)))
+
+   // checks files for restriction validations, ancestors shared by
+   // several files are verified once through the directory cache
+   for(x = 0; (x < count); x++)
    {
-      fprintf(stderr, "%s: %s: not a regular file\n", PROGRAM_NAME, cnf->widget->name);
-      return(1);
+      if ((rc = scu_pathcache_stat(&pc, &p, paths[x], SCU_ONOTEXISTS)) != 0)
+      {
+         if (count > 1)
+            fprintf(stderr, "%s: %s: %s: %s\n", PROGRAM_NAME, cnf->widget->name, paths[x], scu_strerror(rc));
+         else
+            fprintf(stderr, "%s: %s: %s\n", PROGRAM_NAME, cnf->widget->name, scu_strerror(rc));
+         failed = 1;
+         continue;
+      };
+      if (p.sb.st_mode == 0)
+         continue;
+
+      // determine if file is read-only
+      if ( ((!(p.sb.st_mode & S_IWUSR)) && (uid != 0)) ||
+           ((p.sb.st_uid != uid) && (uid != 0)) )
+         nreadonly++;
+
+      files[nfiles].path   = paths[x];
+      files[nfiles].dirlen = (size_t)(p.name - paths[x]);
+      nfiles++;
    };
 
-   // determine if file is read-only
-   if ( (!(sb.st_mode & S_IWUSR)) && (uid != 0) )
-      readonly = 1;
-   if ( (sb.st_uid != uid) && (uid != 0) )
-      readonly = 1;
+   // prompt for confirmation once for the whole batch
+   if ( (force != 1) && (nfiles > 0) && ((prompt == 1) || (nreadonly > 0)) )
+   {
+      if (nfiles > 1)
+         printf("%s: %s: remove %zu files, %zu read-only? ", PROGRAM_NAME, cnf->widget->name, nfiles, nreadonly);
+      else if (nreadonly > 0)
+         printf("%s: %s: remove read-only file %s? ", PROGRAM_NAME, cnf->widget->name, files[0].path);
+      else
+         printf("%s: %s: remove file %s? ", PROGRAM_NAME, cnf->widget->name, files[0].path);
+      if ((rc = scu_widget_rm_confirm(cnf, fromstdin)) != 1)
+         nfiles = 0;
+      if (rc == -1)
+         failed = 1;
+   };
 
-   // prompt for confirmation
-   if (force != 1)
+   // files are revalidated and removed relative to the verified directory
+   // one directory at a time, rather than resolving each path again
+   qsort(files, nfiles, sizeof(scu_rm_file), scu_widget_rm_compare);
+   for(x = 0; (x < nfiles); x = y)
    {
-      if (readonly == 1)
-         printf("%s: %s: remove read-only file %s? ", PROGRAM_NAME, cnf->widget->name, cnf->argv[optind]);
-      else if (prompt == 1)
-         printf("%s: %s: remove file %s? ", PROGRAM_NAME, cnf->widget->name, cnf->argv[optind]);
-      if ( (prompt == 1) || (readonly == 1) )
+      for(y = x; (y < nfiles); y++)
+         if ( (files[y].dirlen != files[x].dirlen) || ((memcmp(files[y].path, files[x].path, files[x].dirlen))) )
+            break;
+      for(z = x, count = 0, dirfd = -1; (z < y); z++)
       {
-         fflush(stdout);
-         if ((len = read(STDIN_FILENO, anwser, sizeof(anwser))) == -1)
+         if ((rc = scu_pathcache_stat(&pc, &p, files[z].path, SCU_ONOTEXISTS)) != 0)
          {
-            fprintf(stderr, "%s: %s:%s\n", PROGRAM_NAME, cnf->widget->name, strerror(errno));
-            return(1);
+            fprintf(stderr, "%s: %s: %s: %s\n", PROGRAM_NAME, cnf->widget->name, files[z].path, scu_strerror(rc));
+            failed = 1;
+            continue;
          };
-         if ((anwser[0] != 'y') && (anwser[0] != 'Y'))
-            return(0);
+         if (p.sb.st_mode == 0)
+            continue;
+         if ((cnf->verbose))
+            printf("removing %s\n", files[z].path);
+
+         // files needing more than a second at the throttled rate are
+         // moved aside and shrunk by a background worker
+         if ( (th != NULL) && (S_ISREG(p.sb.st_mode)) && ((uint64_t)p.sb.st_size > rate) && (p.sb.st_nlink == 1) )
+         {
+            if ((rc = scu_throttle_hold(cnf, th, p.dirfd, p.name, files[z].path)) == -1)
+               failed = 1;
+            if (rc != 1)
+               continue;
+         };
+
+         files[x + count] = files[z];
+         names[count++]   = p.name;
+         dirfd            = p.dirfd;
+      };
+      if (count == 0)
+         continue;
+      scu_uring_unlinkat(dirfd, names, errs, count, 0);
+      for(z = 0; (z < count); z++)
+      {
+         if (errs[z] == 0)
+            continue;
+         fprintf(stderr, "%s: %s: %s: %s\n", PROGRAM_NAME, cnf->widget->name, files[x + z].path, strerror(errs[z]));
+         failed = 1;
       };
    };
 
-   if ((cnf->verbose))
-      printf("removing %s\n", cnf->argv[optind]);
+   if ( (th != NULL) && (scu_throttle_start(cnf, th) == -1) )
+      failed = 1;
 
-   if ((rc = unlink(cnf->argv[optind])) == -1)
-   {
-      fprintf(stderr, "%s: %s: %s: %s\n", PROGRAM_NAME, cnf->widget->name,
-              cnf->argv[optind], strerror(errno));
-      return(1);
-   };
+   scu_pathcache_free(&pc);
+   free(files);
+   free(names);
+   free(errs);
 
-   return(0);
+   return(failed);
 }
 
 
 void scu_widget_rm_usage(scu_config * cnf)
 {
-   scu_usage_summary(cnf, " [OPTIONS] file");
+   scu_usage_summary(cnf, " [OPTIONS] file ...");
    printf("\n");
    scu_usage_options(cnf);
-   printf("  -i                        prompt for confirmation\n");
-   printf("  -f, --force               ignore nonexistent files\n");
+   printf("  -0, --null                read NUL terminated list of files from stdin\n");
+   printf("  -f, --force               ignore nonexistent files and never prompt\n");
+   printf("  -i                        prompt for confirmation once for all files\n");
+   printf("  -T, --throttle=RATE       shrink large files in background by RATE bytes/s\n");
    printf("\n");
    scu_usage_restrictions();
    printf("\n");
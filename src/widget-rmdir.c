@@ -45,11 +45,15 @@
 #include <assert.h>
 #include <errno.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <strings.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <unistd.h>
+#include <fcntl.h>
+
+#include "rmtree.h"
 
 
 //////////////////
@@ -78,13 +82,19 @@ int scu_widget_rmdir(scu_config * cnf)
    int            c;
    int            opt_index;
    int            rc;
-   struct stat    sb;
+   int            recursive;
+   unsigned       jobs;
+   long           cpus;
+   char         * endptr;
+   scu_path       p;
 
    // getopt options
-   static char   short_opt[] = "+fhiqVv";
+   static char   short_opt[] = "+fhij:qrVv";
    static struct option long_opt[] =
    {
       {"help",             no_argument,       NULL, 'h' },
+      {"jobs",             required_argument, NULL, 'j' },
+      {"recursive",        no_argument,       NULL, 'r' },
       {"quiet",            no_argument,       NULL, 'q' },
       {"silent",           no_argument,       NULL, 'q' },
       {"version",          no_argument,       NULL, 'V' },
@@ -95,6 +105,11 @@ int scu_widget_rmdir(scu_config * cnf)
    assert(cnf != NULL);
    cnf->short_opt = short_opt;
 
+   recursive = 0;
+   jobs      = SCU_RMTREE_JOBS;
+   if ( ((cpus = sysconf(_SC_NPROCESSORS_ONLN)) > 0) && (cpus < SCU_RMTREE_JOBS) )
+      jobs = (unsigned)cpus;
+
    while((c = getopt_long(cnf->argc, cnf->argv, short_opt, long_opt, &opt_index)) != -1)
    {
       switch(c)
@@ -107,6 +122,19 @@ int scu_widget_rmdir(scu_config * cnf)
          scu_widget_rmdir_usage(cnf);
          return(0);
 
+         case 'j':
+         jobs = (unsigned)strtoul(optarg, &endptr, 10);
+         if ( (endptr == optarg) || (endptr[0] != '\0') || (jobs < 1) || (jobs > SCU_RMTREE_JOBS_MAX) )
+         {
+            fprintf(stderr, "%s: %s: invalid value for `-j' -- %s\n", PROGRAM_NAME, cnf->widget->name, optarg);
+            return(1);
+         };
+         break;
+
+         case 'r':
+         recursive = 1;
+         break;
+
          case 's':
          cnf->quiet = 1;
          if ((cnf->verbose))
@@ -156,34 +184,37 @@ int scu_widget_rmdir(scu_config * cnf)
       return(1);
    };
 
-   // checks file for restriction validations
-   if ((rc = stat(cnf->argv[optind], &sb)) == -1)
-   {
-      if (errno == ENOENT)
-         return(0);
-      fprintf(stderr, "%s: %s: %s\n", PROGRAM_NAME, cnf->widget->name, strerror(errno));
-      return(1);
-   };
-   if ((rc = scu_pathcheck(cnf->argv[optind], 1)) != 0)
+   // checks file for restriction validations, a tree is read through the
+   // validated descriptor so it is opened for reading instead of O_PATH
+   if ((rc = scu_pathopen(&p, cnf->argv[optind], SCU_ODIR|SCU_ONOTEXISTS, ((recursive) ? O_RDONLY|O_DIRECTORY : O_PATH))) != 0)
    {
       fprintf(stderr, "%s: %s: %s\n", PROGRAM_NAME, cnf->widget->name, scu_strerror(rc));
       return(1);
    };
-   if (!(S_ISDIR(sb.st_mode)))
+   if (p.fd == -1)
    {
-      fprintf(stderr, "%s: %s: not a directory\n", PROGRAM_NAME, cnf->widget->name);
-      return(1);
+      scu_pathclose(&p);
+      return(0);
    };
 
    if ((cnf->verbose))
       printf("removing %s\n", cnf->argv[optind]);
 
-   if ((rc = rmdir(cnf->argv[optind])) == -1)
+   if ((recursive))
+   {
+      rc = scu_rmtree(cnf, &p, cnf->argv[optind], jobs);
+      scu_pathclose(&p);
+      return(rc);
+   };
+
+   if ((rc = unlinkat(p.dirfd, p.name, AT_REMOVEDIR)) == -1)
    {
       fprintf(stderr, "%s: %s: %s: %s\n", PROGRAM_NAME, cnf->widget->name,
               cnf->argv[optind], strerror(errno));
+      scu_pathclose(&p);
       return(1);
    };
+   scu_pathclose(&p);
 
    return(0);
 }
@@ -196,8 +227,11 @@ void scu_widget_rmdir_usage(scu_config * cnf)
    scu_usage_options(cnf);
    printf("  -i                        prompt for confirmation\n");
    printf("  -f, --force               ignore nonexistent files\n");
+   printf("  -j, --jobs=N              remove subtrees with up to N threads [%i]\n", SCU_RMTREE_JOBS);
+   printf("  -r, --recursive           remove directory and its contents\n");
    printf("\n");
    scu_usage_restrictions();
+   printf("   Recursive removal does not follow symlinks or cross mount points.\n");
    printf("\n");
    return;
 }
@@ -0,0 +1,555 @@
+/*
+ *  Secure Core Utilities
+ *  Copyright (C) 2015, 2017 David M. Syzdek <david@syzdek.net>.
+ *
+ *  @SYZDEK_BSD_LICENSE_START@
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of David M. Syzdek nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ *  IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ *  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL DAVID M SYZDEK BE LIABLE FOR
+ *  ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ *  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ *  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ *  OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ *  SUCH DAMAGE.
+ *
+ *  @SYZDEK_BSD_LICENSE_END@
+ */
+#include "widget-stats.h"
+
+///////////////
+//           //
+//  Headers  //
+//           //
+///////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Headers
+#endif
+
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pwd.h>
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "journal.h"
+
+
+///////////////////
+//               //
+//  Definitions  //
+//               //
+///////////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Definitions
+#endif
+
+#define SCU_WIDGET_STATS_TOP     10
+#define SCU_WIDGET_STATS_BAR     40
+
+
+//////////////////
+//              //
+//  Data Types  //
+//              //
+//////////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Data Types
+#endif
+
+typedef struct scu_widget_stats_agg scu_widget_stats_agg;
+
+
+// totals of records sharing a user or path
+struct scu_widget_stats_agg
+{
+   uint64_t             key;
+   size_t               runs;
+   size_t               errors;
+   uint64_t             bytes;
+   uint64_t             wall;       // longest run, nanoseconds
+};
+
+
+//////////////////
+//              //
+//  Prototypes  //
+//              //
+//////////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Prototypes
+#endif
+
+static size_t scu_widget_stats_aggregate(scu_journal_rec * recs, size_t count, int bypath, scu_widget_stats_agg * aggs);
+static int scu_widget_stats_cmp_agg(const void * a, const void * b);
+static int scu_widget_stats_cmp_path(const void * a, const void * b);
+static int scu_widget_stats_cmp_uid(const void * a, const void * b);
+static int scu_widget_stats_cmp_widget(const void * a, const void * b);
+static void scu_widget_stats_histogram(scu_journal_rec * recs, size_t count);
+static void scu_widget_stats_paths(scu_journal_rec * recs, size_t count, size_t top);
+static void scu_widget_stats_users(scu_journal_rec * recs, size_t count, size_t top);
+static void scu_widget_stats_widgets(scu_journal_rec * recs, size_t count);
+void scu_widget_stats_usage(scu_config * cnf);
+
+
+/////////////////
+//             //
+//  Functions  //
+//             //
+/////////////////
+#ifdef __SECURECOREUTILS_PMARK
+#pragma mark - Functions
+#endif
+
+int scu_widget_stats(scu_config * cnf)
+{
+   int                        c;
+   int                        opt_index;
+   int                        rc;
+   size_t                     count;
+   size_t                     top;
+   size_t                     len;
+   uint64_t                   seq;
+   uint64_t                   next;
+   uint64_t                   since;
+   char                     * endptr;
+   const char               * path;
+   const char               * widget;
+   const scu_journal_head   * head;
+   scu_journal_rec          * recs;
+   struct timespec            ts;
+
+   // getopt options
+   static char   short_opt[] = "+f:hn:qs:Vvw:";
+   static struct option long_opt[] =
+   {
+      {"file",             required_argument, NULL, 'f' },
+      {"help",             no_argument,       NULL, 'h' },
+      {"top",              required_argument, NULL, 'n' },
+      {"quiet",            no_argument,       NULL, 'q' },
+      {"silent",           no_argument,       NULL, 'q' },
+      {"since",            required_argument, NULL, 's' },
+      {"version",          no_argument,       NULL, 'V' },
+      {"verbose",          no_argument,       NULL, 'v' },
+      {"widget",           required_argument, NULL, 'w' },
+      { NULL, 0, NULL, 0 }
+   };
+
+   assert(cnf != NULL);
+   cnf->short_opt = short_opt;
+
+#ifdef SCU_METRICS
+   path   = SCU_METRICS;
+#else
+   path   = NULL;
+#endif
+   widget = NULL;
+   top    = SCU_WIDGET_STATS_TOP;
+   since  = 0;
+
+   while((c = getopt_long(cnf->argc, cnf->argv, short_opt, long_opt, &opt_index)) != -1)
+   {
+      switch(c)
+      {
+         case -1:	/* no more arguments */
+         case 0:	/* long options toggles */
+         break;
+
+         case 'f':
+         // a copy of the ring may be read, but only by root itself
+         if (getuid() != 0)
+         {
+            fprintf(stderr, "%s: %s: option `-f' requires root\n", PROGRAM_NAME, cnf->widget->name);
+            return(1);
+         };
+         path = optarg;
+         break;
+
+         case 'h':
+         scu_widget_stats_usage(cnf);
+         return(0);
+
+         case 'n':
+         top = (size_t)strtoul(optarg, &endptr, 10);
+         if ( (endptr == optarg) || (endptr[0] != '\0') )
+         {
+            fprintf(stderr, "%s: %s: invalid value for `-n' -- %s\n", PROGRAM_NAME, cnf->widget->name, optarg);
+            return(1);
+         };
+         break;
+
+         case 'q':
+         cnf->quiet = 1;
+         if ((cnf->verbose))
+         {
+            fprintf(stderr, "%s: %s: incompatible options\n", PROGRAM_NAME, cnf->widget->name);
+            fprintf(stderr, "Try `%s %s --help' for more information.\n", PROGRAM_NAME, cnf->widget->name);
+            return(1);
+         };
+         break;
+
+         case 's':
+         since = (uint64_t)strtoull(optarg, &endptr, 10);
+         if ( (endptr == optarg) || (endptr[0] != '\0') )
+         {
+            fprintf(stderr, "%s: %s: invalid value for `-s' -- %s\n", PROGRAM_NAME, cnf->widget->name, optarg);
+            return(1);
+         };
+         clock_gettime(CLOCK_REALTIME, &ts);
+         since = (uint64_t)ts.tv_sec - ((since < (uint64_t)ts.tv_sec) ? since : (uint64_t)ts.tv_sec);
+         since = since * 1000000000;
+         break;
+
+         case 'V':
+         printf("%s widget\n", cnf->widget->name);
+         scu_version();
+         return(0);
+
+         case 'v':
+         cnf->verbose++;
+         if ((cnf->quiet))
+         {
+            fprintf(stderr, "%s: %s: incompatible options\n", PROGRAM_NAME, cnf->widget->name);
+            fprintf(stderr, "Try `%s %s --help' for more information.\n", PROGRAM_NAME, cnf->widget->name);
+            return(1);
+         };
+         break;
+
+         case 'w':
+         widget = optarg;
+         break;
+
+         case '?':
+         fprintf(stderr, "Try `%s %s --help' for more information.\n", PROGRAM_NAME, cnf->widget->name);
+         return(1);
+
+         default:
+         fprintf(stderr, "%s: %s: unrecognized option `--%c'\n", PROGRAM_NAME, cnf->widget->name, c);
+         fprintf(stderr, "Try `%s %s --help' for more information.\n", PROGRAM_NAME, cnf->widget->name);
+         return(1);
+      };
+   };
+
+   if ((cnf->argc - optind) > 0)
+   {
+      fprintf(stderr, "%s: unrecognized argument `-- %s'\n", PROGRAM_NAME, cnf->argv[optind]);
+      fprintf(stderr, "Try `%s %s --help' for more information.\n", PROGRAM_NAME, cnf->widget->name);
+      return(1);
+   };
+   if (path == NULL)
+   {
+      fprintf(stderr, "%s: %s: metrics journal was not enabled at build time (--with-metrics)\n", PROGRAM_NAME, cnf->widget->name);
+      return(1);
+   };
+
+   if ((rc = scu_journal_map(path, &head, &len)) != 0)
+   {
+      fprintf(stderr, "%s: %s: %s: %s\n", PROGRAM_NAME, cnf->widget->name, path, scu_strerror(rc));
+      return(1);
+   };
+
+   // records are copied out so writers are never waited on
+   next = __atomic_load_n(&head->next, __ATOMIC_ACQUIRE);
+   seq  = (next > head->slots) ? (next - head->slots) : 0;
+   if ((recs = malloc((size_t)(next - seq + 1) * sizeof(scu_journal_rec))) == NULL)
+   {
+      fprintf(stderr, "%s: %s: %s\n", PROGRAM_NAME, cnf->widget->name, strerror(errno));
+      munmap((void *)head, len);
+      return(1);
+   };
+   for(count = 0; (seq < next); seq++)
+   {
+      if (scu_journal_read(head, seq, &recs[count]) == -1)
+         continue;
+      if (recs[count].time < since)
+         continue;
+      if ( (widget != NULL) && ((strcmp(recs[count].widget, widget))) )
+         continue;
+      count++;
+   };
+   munmap((void *)head, len);
+
+   if ((cnf->verbose))
+      printf("%zu records of %" PRIu64 " appended\n\n", count, next);
+   if (count == 0)
+   {
+      free(recs);
+      return(0);
+   };
+
+   scu_widget_stats_widgets(recs, count);
+   scu_widget_stats_histogram(recs, count);
+   scu_widget_stats_users(recs, count, top);
+   scu_widget_stats_paths(recs, count, top);
+
+   free(recs);
+
+   return(0);
+}
+
+
+/// sums sorted records by uid or path, returns number of aggregates
+static size_t scu_widget_stats_aggregate(scu_journal_rec * recs, size_t count, int bypath, scu_widget_stats_agg * aggs)
+{
+   size_t               x;
+   size_t               n;
+   uint64_t             key;
+
+   for(x = 0, n = 0; (x < count); x++)
+   {
+      key = (bypath) ? recs[x].path : recs[x].uid;
+      if ( (n == 0) || (aggs[n-1].key != key) )
+      {
+         memset(&aggs[n], 0, sizeof(scu_widget_stats_agg));
+         aggs[n++].key = key;
+      };
+      aggs[n-1].runs++;
+      aggs[n-1].errors += (recs[x].status != 0) ? 1 : 0;
+      aggs[n-1].bytes  += recs[x].bytes_out;
+      aggs[n-1].wall    = (recs[x].wall > aggs[n-1].wall) ? recs[x].wall : aggs[n-1].wall;
+   };
+
+   return(n);
+}
+
+
+/// orders aggregates by bytes served, then runs
+static int scu_widget_stats_cmp_agg(const void * a, const void * b)
+{
+   const scu_widget_stats_agg * x = a;
+   const scu_widget_stats_agg * y = b;
+   if (x->bytes != y->bytes)
+      return((x->bytes < y->bytes) ? 1 : -1);
+   if (x->runs != y->runs)
+      return((x->runs < y->runs) ? 1 : -1);
+   return((x->key < y->key) ? -1 : (x->key > y->key));
+}
+
+
+static int scu_widget_stats_cmp_path(const void * a, const void * b)
+{
+   const scu_journal_rec * x = a;
+   const scu_journal_rec * y = b;
+   return((x->path < y->path) ? -1 : (x->path > y->path));
+}
+
+
+static int scu_widget_stats_cmp_uid(const void * a, const void * b)
+{
+   const scu_journal_rec * x = a;
+   const scu_journal_rec * y = b;
+   return((x->uid < y->uid) ? -1 : (x->uid > y->uid));
+}
+
+
+/// orders records by widget, then by duration for percentiles
+static int scu_widget_stats_cmp_widget(const void * a, const void * b)
+{
+   int                     rc;
+   const scu_journal_rec * x = a;
+   const scu_journal_rec * y = b;
+   if ((rc = strncmp(x->widget, y->widget, SCU_JOURNAL_WIDGET)) != 0)
+      return(rc);
+   return((x->wall < y->wall) ? -1 : (x->wall > y->wall));
+}
+
+
+/// prints durations of runs in power of two buckets of microseconds
+static void scu_widget_stats_histogram(scu_journal_rec * recs, size_t count)
+{
+   size_t               x;
+   size_t               b;
+   size_t               lo;
+   size_t               hi;
+   size_t               max;
+   size_t               buckets[64];
+   uint64_t             us;
+
+   memset(buckets, 0, sizeof(buckets));
+   for(x = 0, lo = 63, hi = 0; (x < count); x++)
+   {
+      for(b = 0, us = recs[x].wall / 1000; (us > 0); us >>= 1, b++);
+      buckets[b]++;
+      lo = (b < lo) ? b : lo;
+      hi = (b > hi) ? b : hi;
+   };
+   for(b = lo, max = 1; (b <= hi); b++)
+      max = (buckets[b] > max) ? buckets[b] : max;
+
+   printf("%-14s %8s\n", "DURATION", "RUNS");
+   for(b = lo; (b <= hi); b++)
+   {
+      printf("< %9" PRIu64 " us %8zu ", ((uint64_t)1 << b), buckets[b]);
+      for(x = 0; (x < ((buckets[b] * SCU_WIDGET_STATS_BAR + max - 1) / max)); x++)
+         putchar('#');
+      printf("\n");
+   };
+   printf("\n");
+
+   return;
+}
+
+
+/// prints paths run most often, paths are only known by hash
+static void scu_widget_stats_paths(scu_journal_rec * recs, size_t count, size_t top)
+{
+   size_t                  x;
+   size_t                  n;
+   scu_widget_stats_agg  * aggs;
+
+   if ((aggs = malloc(count * sizeof(scu_widget_stats_agg))) == NULL)
+      return;
+   qsort(recs, count, sizeof(scu_journal_rec), scu_widget_stats_cmp_path);
+   n = scu_widget_stats_aggregate(recs, count, 1, aggs);
+   qsort(aggs, n, sizeof(scu_widget_stats_agg), scu_widget_stats_cmp_agg);
+
+   printf("%-16s %8s %8s %10s %14s\n", "PATH HASH", "RUNS", "ERRORS", "MAX MS", "BYTES OUT");
+   for(x = 0; ((x < n) && (x < top)); x++)
+   {
+      if (aggs[x].key == 0)
+         printf("%-16s", "(none)");
+      else
+         printf("%016" PRIx64, aggs[x].key);
+      printf(" %8zu %8zu %10.3f %14" PRIu64 "\n", aggs[x].runs, aggs[x].errors, (double)aggs[x].wall / 1e6, aggs[x].bytes);
+   };
+   printf("\n");
+
+   free(aggs);
+
+   return;
+}
+
+
+/// prints users served the most bytes
+static void scu_widget_stats_users(scu_journal_rec * recs, size_t count, size_t top)
+{
+   size_t                  x;
+   size_t                  n;
+   char                    name[32];
+   struct passwd         * pw;
+   scu_widget_stats_agg  * aggs;
+
+   if ((aggs = malloc(count * sizeof(scu_widget_stats_agg))) == NULL)
+      return;
+   qsort(recs, count, sizeof(scu_journal_rec), scu_widget_stats_cmp_uid);
+   n = scu_widget_stats_aggregate(recs, count, 0, aggs);
+   qsort(aggs, n, sizeof(scu_widget_stats_agg), scu_widget_stats_cmp_agg);
+
+   printf("%-16s %8s %8s %10s %14s\n", "USER", "RUNS", "ERRORS", "MAX MS", "BYTES OUT");
+   for(x = 0; ((x < n) && (x < top)); x++)
+   {
+      if ((pw = getpwuid((uid_t)aggs[x].key)) != NULL)
+         snprintf(name, sizeof(name), "%s", pw->pw_name);
+      else
+         snprintf(name, sizeof(name), "%" PRIu64, aggs[x].key);
+      printf("%-16s %8zu %8zu %10.3f %14" PRIu64 "\n", name, aggs[x].runs, aggs[x].errors, (double)aggs[x].wall / 1e6, aggs[x].bytes);
+   };
+   printf("\n");
+
+   free(aggs);
+
+   return;
+}
+
+
+/// prints latency percentiles and mean time per phase of each widget
+static void scu_widget_stats_widgets(scu_journal_rec * recs, size_t count)
+{
+   size_t               x;
+   size_t               y;
+   size_t               n;
+   size_t               errors;
+   size_t               first;
+   uint64_t             bytes;
+   uint64_t             ns[SCU_STATS_PHASES];
+   char                 name[SCU_JOURNAL_WIDGET + 1];
+
+   qsort(recs, count, sizeof(scu_journal_rec), scu_widget_stats_cmp_widget);
+
+   printf("%-12s %8s %8s %10s %10s %10s %10s %14s\n", "WIDGET", "RUNS", "ERRORS", "P50 MS", "P90 MS", "P99 MS", "MAX MS", "BYTES OUT");
+   for(first = 0; (first < count); first += n)
+   {
+      for(n = 0, errors = 0, bytes = 0; ((first + n) < count); n++)
+      {
+         if ((strncmp(recs[first].widget, recs[first+n].widget, SCU_JOURNAL_WIDGET)))
+            break;
+         errors += (recs[first+n].status != 0) ? 1 : 0;
+         bytes  += recs[first+n].bytes_out;
+      };
+      memcpy(name, recs[first].widget, SCU_JOURNAL_WIDGET);
+      name[SCU_JOURNAL_WIDGET] = '\0';
+
+      // nearest rank of records sorted by duration
+      printf("%-12s %8zu %8zu %10.3f %10.3f %10.3f %10.3f %14" PRIu64 "\n", name, n, errors,
+         (double)recs[first + (n * 50 + 99) / 100 - 1].wall / 1e6,
+         (double)recs[first + (n * 90 + 99) / 100 - 1].wall / 1e6,
+         (double)recs[first + (n * 99 + 99) / 100 - 1].wall / 1e6,
+         (double)recs[first + n - 1].wall / 1e6, bytes);
+   };
+   printf("\n");
+
+   printf("%-12s %10s %10s %10s %10s %10s %10s\n", "WIDGET", "CHECK MS", "OPEN MS", "READ MS", "DECODE MS", "WRITE MS", "OTHER MS");
+   for(first = 0; (first < count); first += n)
+   {
+      memset(ns, 0, sizeof(ns));
+      for(n = 0; ((first + n) < count); n++)
+      {
+         if ((strncmp(recs[first].widget, recs[first+n].widget, SCU_JOURNAL_WIDGET)))
+            break;
+         for(y = 0; (y < SCU_STATS_PHASES); y++)
+            ns[y] += recs[first+n].ns[y];
+      };
+      memcpy(name, recs[first].widget, SCU_JOURNAL_WIDGET);
+      name[SCU_JOURNAL_WIDGET] = '\0';
+      printf("%-12s", name);
+      for(x = 1; (x < SCU_STATS_PHASES); x++)
+         printf(" %10.3f", (double)ns[x] / (double)n / 1e6);
+      printf(" %10.3f\n", (double)ns[SCU_STATS_OTHER] / (double)n / 1e6);
+   };
+   printf("\n");
+
+   return;
+}
+
+
+void scu_widget_stats_usage(scu_config * cnf)
+{
+   scu_usage_summary(cnf, " [OPTIONS]");
+   printf("\n");
+   scu_usage_options(cnf);
+   printf("  -f, --file=FILE           read ring FILE instead of the journal (root only)\n");
+   printf("  -n, --top=N               list N busiest users and paths [%i]\n", SCU_WIDGET_STATS_TOP);
+   printf("  -s, --since=SECONDS       only include runs of the last SECONDS\n");
+   printf("  -w, --widget=NAME         only include runs of widget NAME\n");
+   printf("\n");
+#ifdef SCU_METRICS
+   printf("JOURNAL:\n");
+   printf("   %s\n", SCU_METRICS);
+   printf("\n");
+#endif
+   return;
+}
+
+
+/* end of source */
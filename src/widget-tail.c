@@ -56,19 +56,11 @@
 #include <time.h>
 #include <signal.h>
 
-
-///////////////////
-//               //
-//  Definitions  //
-//               //
-///////////////////
-#ifdef __SECURECOREUTILS_PMARK
-#pragma mark - Definitions
-#endif
-
-#define SCU_TAIL_OBOL      0x01
-#define SCU_TAIL_OBYTES    0x02
-#define SCU_TAIL_OFOLLOW   0x04
+#include "follow.h"
+#include "input.h"
+#include "probes.h"
+#include "stats.h"
+#include "tail.h"
 
 
 //////////////////
@@ -80,11 +72,9 @@
 #pragma mark - Prototypes
 #endif
 
-int scu_widget_tail_bytes(scu_config * cnf, int fd, struct stat * sb,
-   size_t opts, off_t optnum);
 int scu_widget_tail_follow(scu_config * cnf, int fd);
-int scu_widget_tail_lines(scu_config * cnf, int fd, struct stat * sb,
-   size_t opts, off_t optnum);
+int scu_widget_tail_follow_hub(scu_config * cnf, int fd, int sd, uint64_t hub);
+int scu_widget_tail_out(void * ctx, const char * buff, size_t len);
 void scu_widget_tail_usage(scu_config * cnf);
 void scu_widget_tail_follow_alarm(int sig);
 
@@ -119,7 +109,7 @@ int scu_widget_tail(scu_config * cnf)
    off_t          optnum;
    char         * endptr;
    size_t         opts;
-   struct stat    sb;
+   scu_input    * inp;
 
    // getopt options
    static char   short_opt[] = "+c:fhn:qVv";
@@ -257,6 +247,11 @@ int scu_widget_tail(scu_config * cnf)
       fprintf(stderr, "Try `%s %s --help' for more information.\n", PROGRAM_NAME, cnf->widget->name);
       return(1);
    };
+   if ( ((opts & SCU_TAIL_OFOLLOW) != 0) && ((cnf->batch)) )
+   {
+      fprintf(stderr, "%s: %s: `-f' may not be used within batch\n", PROGRAM_NAME, cnf->widget->name);
+      return(1);
+   };
    if ((cnf->argc - optind) > 1)
    {
       fprintf(stderr, "%s: unrecognized argument `-- %s'\n", PROGRAM_NAME, cnf->argv[optind+1]);
@@ -264,85 +259,39 @@ int scu_widget_tail(scu_config * cnf)
       return(1);
    };
 
-   if ((rc = scu_pathcheck(cnf->argv[optind], 0)) != 0)
+   // checks file for restriction validations and detects compression
+   if ((rc = scu_input_open(&inp, cnf->argv[optind])) != 0)
    {
       fprintf(stderr, "%s: %s: %s\n", PROGRAM_NAME, cnf->widget->name, scu_strerror(rc));
       return(1);
    };
 
-   if ((fd = open(cnf->argv[optind], O_RDONLY)) == -1)
+   // compressed files cannot grow in place
+   if ( ((opts & SCU_TAIL_OFOLLOW) != 0) && (scu_input_codec(inp) != SCU_CODEC_RAW) )
    {
-      fprintf(stderr, "%s: %s: %s\n", PROGRAM_NAME, cnf->widget->name, strerror(errno));
+      fprintf(stderr, "%s: %s: cannot follow %s compressed file\n", PROGRAM_NAME, cnf->widget->name, scu_input_codec_name(scu_input_codec(inp)));
+      scu_input_close(inp);
       return(1);
    };
 
-   if ((rc = fstat(fd, &sb)) == -1)
+   if ((rc = scu_tail(inp, opts, optnum, scu_widget_tail_out, NULL)) != 0)
    {
-      fprintf(stderr, "%s: %s: %s\n", PROGRAM_NAME, cnf->widget->name, strerror(errno));
-      close(fd);
+      fprintf(stderr, "%s: %s: %s\n", PROGRAM_NAME, cnf->widget->name, scu_strerror(rc));
+      scu_input_close(inp);
       return(1);
    };
-
-   if ((opts & SCU_TAIL_OBYTES) != 0)
-   {
-      if ((rc = scu_widget_tail_bytes(cnf, fd, &sb, opts, optnum)) == -1)
-      {
-         close(fd);
-         return(1);
-      };
-   };
-
-   if ((opts & SCU_TAIL_OBYTES) == 0)
-   {
-      if ((rc = scu_widget_tail_lines(cnf, fd, &sb, opts, optnum)) == -1)
-      {
-         close(fd);
-         return(1);
-      };
-   };
+   fd = scu_input_fd(inp);
 
    if ((opts & SCU_TAIL_OFOLLOW) != 0)
    {
-      if (!(scu_widget_tail_follow(cnf, fd)))
+      if (scu_widget_tail_follow(cnf, fd) == -1)
       {
-         close(fd);
+         scu_input_close(inp);
          return(1);
       };
    };
 
-   close(fd);
-
-   return(0);
-}
-
-
-int scu_widget_tail_bytes(scu_config * cnf, int fd, struct stat * sb,
-   size_t opts, off_t optnum)
-{
-   off_t    rc;
-   off_t    off;
-   char     buff[SCU_BUFF_MAX];
-   ssize_t  len;
-
-   if ((opts & SCU_TAIL_OBOL) == 0)
-      off = (sb->st_size < optnum) ? 0 : sb->st_size - optnum;
-   else
-      off = (sb->st_size < optnum) ? sb->st_size : optnum;
-
-   if ((rc = lseek(fd, off, SEEK_SET)) == -1)
-   {
-      fprintf(stderr, "%s: %s: %s\n", PROGRAM_NAME, cnf->widget->name, strerror(errno));
-      return(-1);
-   };
-
-   while ((len = read(fd, buff, sizeof(buff))) > 0)
-   {
-      if ((len = write(STDOUT_FILENO, buff, len)) == -1)
-      {
-         fprintf(stderr, "%s: %s: %s\n", PROGRAM_NAME, cnf->widget->name, strerror(errno));
-         return(-1);
-      };
-   };
+   scu_input_close(inp);
 
    return(0);
 }
@@ -357,6 +306,9 @@ int scu_widget_tail_follow(scu_config * cnf, int fd)
    unsigned          tailtimeout;
    char            * value;
    char            * ptr;
+   int               sd;
+   uint64_t          hub;
+   struct sigaction  sa;
 
    alarm_seconds   = SCU_TAIL_TIMEOUT;
    ts.tv_sec       = 0;
@@ -371,13 +323,27 @@ int scu_widget_tail_follow(scu_config * cnf, int fd)
    };
    if (alarm_seconds > 0)
    {
-      signal(SIGALRM, scu_widget_tail_follow_alarm);
+      // without SA_RESTART the alarm also ends a read from the hub
+      memset(&sa, 0, sizeof(sa));
+      sa.sa_handler = scu_widget_tail_follow_alarm;
+      sigaction(SIGALRM, &sa, NULL);
       alarm(alarm_seconds);
    };
 
+   // a hub shared by every follower of the file reads the appends once,
+   // the file is polled directly if no hub can be used or it drops us
+   if ((sd = scu_follow_subscribe(fd, &hub)) != -1)
+   {
+      if (scu_widget_tail_follow_hub(cnf, fd, sd, hub) == -1)
+         return(-1);
+   };
+
    while (!(timeout_alarmed))
    {
-      switch (len = read(fd, buff, sizeof(buff)))
+      len = read(fd, buff, sizeof(buff));
+      SCU_STATS_IN(len);
+      SCU_PROBE3(tail__wakeup, fd, (int64_t)len, 0);
+      switch (len)
       {
          case -1:
          fprintf(stderr, "%s: %s: read: %s\n", PROGRAM_NAME, cnf->widget->name, strerror(errno));
@@ -388,7 +354,7 @@ int scu_widget_tail_follow(scu_config * cnf, int fd)
          break;
 
          default:
-         if ((len = write(STDOUT_FILENO, buff, len)) == -1)
+         if (scu_widget_tail_out(NULL, buff, (size_t)len) == -1)
          {
             fprintf(stderr, "%s: %s: write: %s\n", PROGRAM_NAME, cnf->widget->name, strerror(errno));
             return(-1);
@@ -401,117 +367,118 @@ int scu_widget_tail_follow(scu_config * cnf, int fd)
 }
 
 
-void scu_widget_tail_follow_alarm(int sig)
+/// copies the stream of the hub to standard out and leaves the offset of
+/// the file after the last byte written
+int scu_widget_tail_follow_hub(scu_config * cnf, int fd, int sd, uint64_t hub)
 {
-   timeout_alarmed = 1;
-   signal (sig, scu_widget_tail_follow_alarm);
-   alarm(1);
-   fprintf(stderr, "\n\n*** TAIL WIDGET TIMEOUT EXPIRED ***\n\n\n");
-   return;
-}
-
+   char              buff[SCU_BUFF_MAX];
+   ssize_t           len;
+   off_t             pos;
+   uint64_t          skip;
 
-int scu_widget_tail_lines(scu_config * cnf, int fd, struct stat * sb,
-   size_t opts, off_t optnum)
-{
-   char     buff[SCU_BUFF_MAX];
-   off_t    rc;
-   ssize_t  bufflen;
-   ssize_t  len;
-   off_t    linecount;
-   off_t    seek;
-   ssize_t  pos;
-   off_t    found;
-
-   // start line count from beginning of file
-   if ((opts & SCU_TAIL_OBOL) != 0)
+   if ((pos = lseek(fd, 0, SEEK_CUR)) == -1)
    {
-      len         = 1;
-      linecount   = 1;
-
-      while ((linecount < optnum) && (len > 0))
-      {
-         if ((len = read(fd, buff, sizeof(buff))) == -1)
-         {
-            fprintf(stderr, "%s: %s: %s\n", PROGRAM_NAME, cnf->widget->name, strerror(errno));
-            return(-1);
-         };
-
-         for (pos = 0; ((pos < len) && (linecount < optnum)); pos++)
-         {
-            if (buff[pos] == '\n')
-               linecount++;
-            if (linecount >= optnum)
-            {
-               if ((len = write(STDIN_FILENO, &buff[pos+1], (len-pos-1))) == -1)
-               {
-                  fprintf(stderr, "%s: %s: %s\n", PROGRAM_NAME, cnf->widget->name, strerror(errno));
-                  return(-1);
-               };
-            };
-         };
-      };
+      close(sd);
+      return(0);
    };
 
-   // start line count from end of file
-   if ((opts & SCU_TAIL_OBOL) == 0)
+   // appends between our last read and the start of the stream are read
+   // from the file, bytes we already have are skipped in the stream
+   skip = ((uint64_t)pos > hub) ? (uint64_t)pos - hub : 0;
+   while ((uint64_t)pos < hub)
    {
-      linecount = 0;
-      seek      = sb->st_size;
-      found     = 0;
-
-      while ((linecount <= optnum) && (seek > 0))
+      len = ((hub - (uint64_t)pos) < sizeof(buff)) ? (ssize_t)(hub - (uint64_t)pos) : (ssize_t)sizeof(buff);
+      if ((len = pread(fd, buff, len, pos)) == -1)
       {
-         if (seek > (off_t)sizeof(buff))
-         {
-            bufflen  = sizeof(buff);
-            seek    -= bufflen;
-         } else {
-            bufflen  = seek;
-            seek     = 0;
-         };
-
-         if ((rc = lseek(fd, seek, SEEK_SET)) == -1)
-         {
-            fprintf(stderr, "%s: %s: %s\n", PROGRAM_NAME, cnf->widget->name, strerror(errno));
-            return(-1);
-         };
+         fprintf(stderr, "%s: %s: read: %s\n", PROGRAM_NAME, cnf->widget->name, strerror(errno));
+         close(sd);
+         return(-1);
+      };
 
-         if ((len = read(fd, buff, bufflen)) == -1)
+      // the stream cannot be joined without a hole if the file was
+      // truncated, the file is polled from the last byte written instead
+      if (len == 0)
+      {
+         close(sd);
+         if ((cnf->verbose))
+            fprintf(stderr, "%s: %s: file truncated, polling file\n", PROGRAM_NAME, cnf->widget->name);
+         if (lseek(fd, pos, SEEK_SET) == -1)
          {
             fprintf(stderr, "%s: %s: %s\n", PROGRAM_NAME, cnf->widget->name, strerror(errno));
             return(-1);
          };
-
-         for (pos = len; ((pos > 0) && (linecount <= optnum)); pos--)
-         {
-            if (buff[pos-1] == '\n')
-               linecount++;
-            if (linecount > optnum)
-               found = seek + pos;
-         };
+         return(0);
       };
-
-      if ((rc = lseek(fd, found, SEEK_SET)) == -1)
+      if (scu_widget_tail_out(NULL, buff, (size_t)len) == -1)
       {
-         fprintf(stderr, "%s: %s: %s\n", PROGRAM_NAME, cnf->widget->name, strerror(errno));
+         fprintf(stderr, "%s: %s: write: %s\n", PROGRAM_NAME, cnf->widget->name, strerror(errno));
+         close(sd);
          return(-1);
       };
+      pos += len;
    };
 
-   while ((len = read(fd, buff, sizeof(buff))) > 0)
+   while ( (!(timeout_alarmed)) && ((len = read(sd, buff, sizeof(buff))) > 0) )
    {
-      if ((len = write(STDOUT_FILENO, buff, len)) == -1)
+      SCU_PROBE3(tail__wakeup, fd, (int64_t)len, 1);
+      if (skip >= (uint64_t)len)
+      {
+         skip -= (uint64_t)len;
+         continue;
+      };
+      if (scu_widget_tail_out(NULL, &buff[skip], (size_t)len - skip) == -1)
       {
-         fprintf(stderr, "%s: %s: %s\n", PROGRAM_NAME, cnf->widget->name, strerror(errno));
+         fprintf(stderr, "%s: %s: write: %s\n", PROGRAM_NAME, cnf->widget->name, strerror(errno));
+         close(sd);
          return(-1);
       };
+      pos  += len - skip;
+      skip  = 0;
+   };
+   close(sd);
+
+   if ( (!(timeout_alarmed)) && ((cnf->verbose)) )
+      fprintf(stderr, "%s: %s: follow hub disconnected, polling file\n", PROGRAM_NAME, cnf->widget->name);
+   if (lseek(fd, pos, SEEK_SET) == -1)
+   {
+      fprintf(stderr, "%s: %s: %s\n", PROGRAM_NAME, cnf->widget->name, strerror(errno));
+      return(-1);
    };
 
    return(0);
 }
 
 
+void scu_widget_tail_follow_alarm(int sig)
+{
+   timeout_alarmed = 1;
+   signal (sig, scu_widget_tail_follow_alarm);
+   alarm(1);
+   fprintf(stderr, "\n\n*** TAIL WIDGET TIMEOUT EXPIRED ***\n\n\n");
+   return;
+}
+
+
+/// writes data selected by scu_tail() to standard out
+int scu_widget_tail_out(void * ctx, const char * buff, size_t len)
+{
+   int      phase;
+   ssize_t  rc;
+   (void)ctx;
+   phase = SCU_STATS_SWAP(SCU_STATS_WRITE);
+   for(rc = 0; (len > 0); buff += rc, len -= (size_t)rc)
+   {
+      rc = write(STDOUT_FILENO, buff, len);
+      SCU_STATS_OUT(rc);
+      SCU_PROBE2(write, STDOUT_FILENO, (int64_t)rc);
+      if (rc == -1)
+         break;
+   };
+   SCU_STATS_SET(phase);
+   return((rc == -1) ? -1 : 0);
+}
+
+
 void scu_widget_tail_usage(scu_config * cnf)
 {
    scu_usage_summary(cnf, " [OPTIONS] file");
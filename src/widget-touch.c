@@ -45,6 +45,7 @@
 #include <assert.h>
 #include <errno.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <strings.h>
 #include <sys/types.h>
@@ -64,6 +65,8 @@
 #pragma mark - Prototypes
 #endif
 
+int scu_widget_touch_files(scu_config * cnf, const char ** paths, size_t count, int oflags, const struct timespec * ts);
+time_t scu_widget_touch_mktime(struct tm * tmp);
 void scu_widget_touch_usage(scu_config * cnf);
 time_t scu_widget_touch_strtime(char * s, time_t t);
 
@@ -82,23 +85,28 @@ int scu_widget_touch(scu_config * cnf)
    int            c;
    int            opt_index;
    int            rc;
-   int            fd;
    int            opts;
    int            oflags;
-   int            sflags;
+   int            fromstdin;
    time_t         t;
+   size_t         count;
+   size_t         max;
+   size_t         size;
+   ssize_t        len;
+   char         * line;
    char         * reffile;
-   struct stat    sb;
-   struct stat    refsb;
-   struct timeval curtime[2];
-   struct timeval settime[2];
+   const char  ** paths;
+   void         * ptr;
+   scu_path       refp;
+   struct timespec ts[2];
 
    // getopt options
-   static char   short_opt[] = "+cfhqr:t:Vv";
+   static char   short_opt[] = "+0cfhqr:t:Vv";
    static struct option long_opt[] =
    {
       {"no-create",        no_argument,       NULL, 'c' },
       {"help",             no_argument,       NULL, 'h' },
+      {"null",             no_argument,       NULL, '0' },
       {"quiet",            no_argument,       NULL, 'q' },
       {"reference",        no_argument,       NULL, 'r' },
       {"silent",           no_argument,       NULL, 'q' },
@@ -112,13 +120,13 @@ int scu_widget_touch(scu_config * cnf)
 
    opts                = -1;
    oflags              = O_CREAT;
-   sflags              = SCU_ONOTEXISTS;
+   fromstdin           = 0;
    reffile             = NULL;
    t                   = time(NULL);
-   curtime[0].tv_sec   = curtime[1].tv_sec  = t;
-   curtime[0].tv_usec  = curtime[1].tv_usec = 0;
-   settime[0].tv_sec   = settime[1].tv_sec  = t;
-   settime[0].tv_usec  = settime[1].tv_usec = 0;
+
+   // kernel stamps the current time itself, with full precision
+   ts[0].tv_sec        = ts[1].tv_sec  = 0;
+   ts[0].tv_nsec       = ts[1].tv_nsec = UTIME_NOW;
 
    while((c = getopt_long(cnf->argc, cnf->argv, short_opt, long_opt, &opt_index)) != -1)
    {
@@ -128,6 +136,10 @@ int scu_widget_touch(scu_config * cnf)
          case 0:	/* long options toggles */
          break;
 
+         case '0':
+         fromstdin = 1;
+         break;
+
          case 'a':
          if (opts != 2)
          {
@@ -160,7 +172,7 @@ int scu_widget_touch(scu_config * cnf)
          break;
 
          case 'r':
-         if (settime[0].tv_sec != t)
+         if (ts[0].tv_nsec != UTIME_NOW)
          {
             fprintf(stderr, "%s: %s: incompatible options\n", PROGRAM_NAME, cnf->widget->name);
             fprintf(stderr, "Try `%s --help' for more information.\n", PROGRAM_NAME);
@@ -186,13 +198,14 @@ int scu_widget_touch(scu_config * cnf)
             fprintf(stderr, "Try `%s --help' for more information.\n", PROGRAM_NAME);
             return(1);
          };
-         if ((settime[1].tv_sec = scu_widget_touch_strtime(optarg, t)) == 0)
+         if ((ts[1].tv_sec = scu_widget_touch_strtime(optarg, t)) == 0)
          {
             fprintf(stderr, "%s: %s: invalid time specification\n", PROGRAM_NAME, cnf->widget->name);
             fprintf(stderr, "Try `%s %s --help' for more information.\n", PROGRAM_NAME, cnf->widget->name);
             return(1);
          };
-         settime[0].tv_sec = settime[1].tv_sec;
+         ts[0].tv_sec  = ts[1].tv_sec;
+         ts[0].tv_nsec = ts[1].tv_nsec = 0;
          break;
 
          case 'V':
@@ -221,87 +234,170 @@ int scu_widget_touch(scu_config * cnf)
       };
    };
 
-   if ((cnf->argc - optind) < 1)
+   if ((fromstdin))
    {
-      fprintf(stderr, "%s: %s: missing required argument\n", PROGRAM_NAME, cnf->widget->name);
-      fprintf(stderr, "Try `%s %s --help' for more information.\n", PROGRAM_NAME, cnf->widget->name);
-      return(1);
-   };
-   if ((cnf->argc - optind) > 1)
+      if ((cnf->argc - optind) > 0)
+      {
+         fprintf(stderr, "%s: unrecognized argument `-- %s'\n", PROGRAM_NAME, cnf->argv[optind]);
+         fprintf(stderr, "Try `%s %s --help' for more information.\n", PROGRAM_NAME, cnf->widget->name);
+         return(1);
+      };
+   }
+   else if ((cnf->argc - optind) < 1)
    {
-      fprintf(stderr, "%s: unrecognized argument `-- %s'\n", PROGRAM_NAME, cnf->argv[optind+1]);
+      fprintf(stderr, "%s: %s: missing required argument\n", PROGRAM_NAME, cnf->widget->name);
       fprintf(stderr, "Try `%s %s --help' for more information.\n", PROGRAM_NAME, cnf->widget->name);
       return(1);
    };
 
 
-   // checks file for restriction validations
-   if ((rc = scu_pathcheck(cnf->argv[optind], sflags)) != 0)
+   // obtains time stamp from reference file
+   if (reffile != NULL)
    {
-      if ((rc = scu_pathcheck(cnf->argv[optind], sflags | SCU_ODIR)) != 0)
+      if ((rc = scu_pathopen(&refp, reffile, 0, O_PATH)) != 0)
       {
-         fprintf(stderr, "%s: %s: %s\n", PROGRAM_NAME, cnf->widget->name, scu_strerror(rc));
+         fprintf(stderr, "%s: %s: reference file: %s\n", PROGRAM_NAME, cnf->widget->name, scu_strerror(rc));
          return(1);
       };
+      ts[0] = refp.sb.st_atim;
+      ts[1] = refp.sb.st_mtim;
+      scu_pathclose(&refp);
    };
 
 
-   // obtains current atime/time or creates file if needed
-   if ((rc = stat(cnf->argv[optind], &sb)) != -1)
-   {
-      curtime[0].tv_sec  = sb.st_atime;
-      curtime[1].tv_sec  = sb.st_mtime;
-   }
-   else if ((oflags & O_CREAT) == O_CREAT)
+   // determines whether to update atime, mtime, or both
+   if (opts == 0)
+      ts[1].tv_nsec = UTIME_OMIT;
+   if (opts == 1)
+      ts[0].tv_nsec = UTIME_OMIT;
+
+
+   if (!(fromstdin))
+      return(scu_widget_touch_files(cnf, (const char **)&cnf->argv[optind], (size_t)(cnf->argc - optind), oflags, ts));
+
+   // read NUL terminated list of files
+   paths = NULL;
+   count = 0;
+   max   = 0;
+   line  = NULL;
+   size  = 0;
+   while ((len = getdelim(&line, &size, '\0', stdin)) != -1)
    {
-      if ((fd = open(cnf->argv[optind], oflags)) == -1)
+      if (count == max)
       {
-         fprintf(stderr, "%s: %s: %s\n", PROGRAM_NAME, cnf->widget->name, strerror(errno));
-         return(1);
+         max = (max == 0) ? 256 : (max * 2);
+         if ((ptr = realloc(paths, max * sizeof(char *))) == NULL)
+            break;
+         paths = ptr;
       };
-      close(fd);
-   }
-   else
-      return(0);
-   
+      paths[count++] = line;
+      line = NULL;
+      size = 0;
+   };
+   free(line);
+   if ( (ferror(stdin)) || (len != -1) )
+   {
+      fprintf(stderr, "%s: %s: stdin: %s\n", PROGRAM_NAME, cnf->widget->name, strerror(errno));
+      rc = 1;
+   } else {
+      rc = scu_widget_touch_files(cnf, paths, count, oflags, ts);
+   };
 
-   // obtains time stamp from reference file
-   if (reffile != NULL)
+   while (count > 0)
+      free((char *)paths[--count]);
+   free(paths);
+
+   return(rc);
+}
+
+
+/// applies one set of time stamps to every file, ancestors shared by
+/// several files are verified once through the directory cache
+int scu_widget_touch_files(scu_config * cnf, const char ** paths, size_t count, int oflags, const struct timespec * ts)
+{
+   int            rc;
+   int            fd;
+   int            failed;
+   size_t         x;
+   scu_path       p;
+   scu_pathcache  pc;
+
+   failed = 0;
+   memset(&pc, 0, sizeof(pc));
+
+   for(x = 0; (x < count); x++)
    {
-      if ((rc = scu_pathcheck(reffile, 0)) != 0)
+      // checks file for restriction validations, directories are allowed
+      rc = scu_pathcache_stat(&pc, &p, paths[x], SCU_ONOTEXISTS);
+      if ( (rc == SCU_EFILE) && (S_ISDIR(p.sb.st_mode)) )
+         rc = 0;
+      if (rc != 0)
       {
-         fprintf(stderr, "%s: %s: reference file: %s\n", PROGRAM_NAME, cnf->widget->name, scu_strerror(rc));
-         return(1);
+         if (count > 1)
+            fprintf(stderr, "%s: %s: %s: %s\n", PROGRAM_NAME, cnf->widget->name, paths[x], scu_strerror(rc));
+         else
+            fprintf(stderr, "%s: %s: %s\n", PROGRAM_NAME, cnf->widget->name, scu_strerror(rc));
+         failed = 1;
+         continue;
       };
-      if ((rc = stat(reffile, &refsb)) == -1)
+
+      // updates existing file relative to the verified directory
+      if (p.sb.st_mode != 0)
       {
-         fprintf(stderr, "%s: %s: reference file: %s\n", PROGRAM_NAME, cnf->widget->name, strerror(errno));
-         return(1);
+         if (utimensat(p.dirfd, p.name, ts, AT_SYMLINK_NOFOLLOW) == -1)
+         {
+            fprintf(stderr, "%s: %s: %s: %s\n", PROGRAM_NAME, cnf->widget->name, paths[x], strerror(errno));
+            failed = 1;
+         };
+         continue;
+      };
+
+      // creates missing file and stamps the new descriptor
+      if ((oflags & O_CREAT) == 0)
+         continue;
+      if (p.dirfd == -1)
+      {
+         fprintf(stderr, "%s: %s: %s: %s\n", PROGRAM_NAME, cnf->widget->name, paths[x], strerror(ENOENT));
+         failed = 1;
+         continue;
+      };
+      if ((fd = openat(p.dirfd, p.name, oflags|O_WRONLY|O_NOFOLLOW|O_NONBLOCK|O_NOCTTY|O_CLOEXEC, 0666)) == -1)
+      {
+         fprintf(stderr, "%s: %s: %s: %s\n", PROGRAM_NAME, cnf->widget->name, paths[x], strerror(errno));
+         failed = 1;
+         continue;
+      };
+      if (futimens(fd, ts) == -1)
+      {
+         fprintf(stderr, "%s: %s: %s: %s\n", PROGRAM_NAME, cnf->widget->name, paths[x], strerror(errno));
+         failed = 1;
       };
-      settime[0].tv_sec  = refsb.st_atime;
-      settime[1].tv_sec  = refsb.st_mtime;
+      close(fd);
    };
 
+   scu_pathcache_free(&pc);
 
-   // determines whether to update atime, mtime, or both
-   if ( (opts == 0) || (opts == -1) )
-   {
-      curtime[0].tv_sec = settime[0].tv_sec;
-   };
-   if ( (opts == 1) || (opts == -1) )
-   {
-      curtime[1].tv_sec = settime[1].tv_sec;
-   };
+   return(failed);
+}
 
 
-   // updates time stamps
-   if ((rc = utimes(cnf->argv[optind], curtime)) == -1)
-   {
-      fprintf(stderr, "%s: %s: %s\n", PROGRAM_NAME, cnf->widget->name, strerror(errno));
-      return(1);
-   };
+/// converts local broken-down time without mktime(), which checks the
+/// time zone files again on every call, localtime_r() uses the zone
+/// loaded once by tzset()
+time_t scu_widget_touch_mktime(struct tm * tmp)
+{
+   time_t               t;
+   time_t               utc;
+   struct tm            local;
 
-   return(0);
+   // offset at the result may differ from the guess across a DST change
+   utc = timegm(tmp);
+   localtime_r(&utc, &local);
+   t   = utc - local.tm_gmtoff;
+   localtime_r(&t, &local);
+   t   = utc - local.tm_gmtoff;
+
+   return(t);
 }
 
 
@@ -315,53 +411,60 @@ time_t scu_widget_touch_strtime(char * s, time_t t)
    ptr = NULL;
    len = strlen(s);
 
+   tzset();
    localtime_r(&t, &tm_time);
+   tm_time.tm_sec = 0;
 
    // CCYYMMDDhhmm.SS
    if (len == 15)
    {
       if ((ptr = strptime(s, "%Y%m%d%H%M.%S\0", &tm_time)) != NULL)
-         t = mktime(&tm_time);
+         t = scu_widget_touch_mktime(&tm_time);
    };
 
    // YYMMDDhhmm.SS
    if (len == 13)
    {
       localtime_r(&t, &tm_time);
+      tm_time.tm_sec = 0;
       if ((ptr = strptime(s, "%y%m%d%H%M.%S\0", &tm_time)) != NULL)
-         t = mktime(&tm_time);
+         t = scu_widget_touch_mktime(&tm_time);
    };
 
    // MMDDhhmm.SS
    if (len == 11)
    {
       localtime_r(&t, &tm_time);
+      tm_time.tm_sec = 0;
       if ((ptr = strptime(s, "%m%d%H%M.%S\0", &tm_time)) != NULL)
-         t = mktime(&tm_time);
+         t = scu_widget_touch_mktime(&tm_time);
    };
 
    // CCYYMMDDhhmm
    if (len == 12)
    {
       localtime_r(&t, &tm_time);
+      tm_time.tm_sec = 0;
       if ((ptr = strptime(s, "%Y%m%d%H%M\0", &tm_time)) != NULL)
-         t = mktime(&tm_time);
+         t = scu_widget_touch_mktime(&tm_time);
    };
 
    // YYMMDDhhmm
    if (len == 10)
    {
       localtime_r(&t, &tm_time);
+      tm_time.tm_sec = 0;
       if ((ptr = strptime(s, "%y%m%d%H%M\0", &tm_time)) != NULL)
-         t = mktime(&tm_time);
+         t = scu_widget_touch_mktime(&tm_time);
    };
 
    // MMDDhhmm
    if (len == 8)
    {
       localtime_r(&t, &tm_time);
+      tm_time.tm_sec = 0;
       if ((ptr = strptime(s, "%m%d%H%M\0", &tm_time)) != NULL)
-         t = mktime(&tm_time);
+         t = scu_widget_touch_mktime(&tm_time);
    };
 
    // return invalid if string contains more than a date
@@ -374,9 +477,10 @@ time_t scu_widget_touch_strtime(char * s, time_t t)
 
 void scu_widget_touch_usage(scu_config * cnf)
 {
-   scu_usage_summary(cnf, " [OPTIONS] file");
+   scu_usage_summary(cnf, " [OPTIONS] file ...");
    printf("\n");
    scu_usage_options(cnf);
+   printf("  -0, --null                read NUL terminated list of files from stdin\n");
    printf("  -a                        change only access time\n");
    printf("  -c, --no-create           do not create files\n");
    printf("  -f                        ignored (for compatibility with GNU coreutils)\n");
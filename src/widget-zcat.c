@@ -55,36 +55,11 @@
 #include <fcntl.h>
 #include <stdlib.h>
 
-#ifdef USE_ZLIB
-#include <zlib.h>
-#endif
-
-#ifdef USE_BZIP2
-#include <bzlib.h>
-#endif
-
-#ifdef USE_LZMA
-#include <lzma.h>
-#endif
-
-#include "lzw/lzw.h"
-
-
-/////////////////
-//             //
-//  Variables  //
-//             //
-/////////////////
-#ifdef __SECURECOREUTILS_PMARK
-#pragma mark - Variables
-#endif
-
-const uint8_t scm_magic_bz2[3]   = { 0x42, 0x5a, 0x68 };                   // tar.bz2
-const uint8_t scm_magic_gz[2]    = { 0x1f, 0x8b };                         // tar.gz
-const uint8_t scm_magic_lz4[4]   = { 0x04, 0x22, 0x4d, 0x18 };             // tar.lz4
-const uint8_t scm_magic_z_lzw[2] = { 0x1f, 0x9d };                         // tar.Z
-const uint8_t scm_magic_z_lzh[2] = { 0x1f, 0xa0 };                         // tar.Z
-const uint8_t scm_magic_lzma[6]  = { 0xfd, 0x37, 0x7a, 0x58, 0x5a, 0x00 }; // tar.xz
+#include "cache.h"
+#include "input.h"
+#include "probes.h"
+#include "series.h"
+#include "stats.h"
 
 
 //////////////////
@@ -96,13 +71,7 @@ const uint8_t scm_magic_lzma[6]  = { 0xfd, 0x37, 0x7a, 0x58, 0x5a, 0x00 }; // ta
 #pragma mark - Prototypes
 #endif
 
-int scu_widget_zcat_bz2(scu_config * cnf);
-int scu_widget_zcat_gz(scu_config * cnf);
-int scu_widget_zcat_lzma(scu_config * cnf);
-#ifdef USE_LZMA
-int scu_widget_zcat_lzma_perror(scu_config * cnf, lzma_ret ret);
-#endif
-int scu_widget_zcat_lzw(scu_config * cnf);
+int scu_widget_zcat_list(scu_config * cnf, char ** paths, size_t count);
 void scu_widget_zcat_usage(scu_config * cnf);
 
 
@@ -117,20 +86,36 @@ void scu_widget_zcat_usage(scu_config * cnf);
 
 int scu_widget_zcat(scu_config * cnf)
 {
-   int            fd;
    int            c;
    int            opt_index;
    int            rc;
-   uint8_t        magic[16];
+   int            fd;
+   int            series;
+   int            nocache;
+   int            verify;
+   int            list;
+   unsigned       jobs;
+   long           cpus;
+   size_t         count;
+   char           buff[SCU_INPUT_BUFF];
+   char        ** paths;
+   char         * endptr;
    ssize_t        len;
+   scu_input    * inp;
+   scu_cache    * cache;
 
    // getopt options
-   static char   short_opt[] = "+hqVv";
+   static char   short_opt[] = "+Chj:lqstVv";
    static struct option long_opt[] =
    {
+      {"no-cache",         no_argument,       NULL, 'C' },
       {"help",             no_argument,       NULL, 'h' },
+      {"jobs",             required_argument, NULL, 'j' },
+      {"list",             no_argument,       NULL, 'l' },
       {"quiet",            no_argument,       NULL, 'q' },
+      {"series",           no_argument,       NULL, 's' },
       {"silent",           no_argument,       NULL, 'q' },
+      {"test",             no_argument,       NULL, 't' },
       {"version",          no_argument,       NULL, 'V' },
       {"verbose",          no_argument,       NULL, 'v' },
       { NULL, 0, NULL, 0 }
@@ -139,7 +124,13 @@ int scu_widget_zcat(scu_config * cnf)
    assert(cnf != NULL);
    cnf->short_opt = short_opt;
 
-   bzero(magic, sizeof(magic));
+   series  = 0;
+   nocache = 0;
+   verify  = 0;
+   list    = 0;
+   jobs    = SCU_SERIES_JOBS;
+   if ( ((cpus = sysconf(_SC_NPROCESSORS_ONLN)) > 0) && (cpus < SCU_SERIES_JOBS) )
+      jobs = (unsigned)cpus;
 
    while((c = getopt_long(cnf->argc, cnf->argv, short_opt, long_opt, &opt_index)) != -1)
    {
@@ -149,11 +140,28 @@ int scu_widget_zcat(scu_config * cnf)
          case 0:	/* long options toggles */
          break;
 
+         case 'C':
+         nocache = 1;
+         break;
+
          case 'h':
          scu_widget_zcat_usage(cnf);
          return(0);
 
-         case 's':
+         case 'j':
+         jobs = (unsigned)strtoul(optarg, &endptr, 10);
+         if ( (endptr == optarg) || (endptr[0] != '\0') || (jobs < 1) || (jobs > SCU_SERIES_JOBS_MAX) )
+         {
+            fprintf(stderr, "%s: %s: invalid value for `-j' -- %s\n", PROGRAM_NAME, cnf->widget->name, optarg);
+            return(1);
+         };
+         break;
+
+         case 'l':
+         list = 1;
+         break;
+
+         case 'q':
          cnf->quiet = 1;
          if ((cnf->verbose))
          {
@@ -163,8 +171,16 @@ int scu_widget_zcat(scu_config * cnf)
          };
          break;
 
+         case 's':
+         series = 1;
+         break;
+
+         case 't':
+         verify = 1;
+         break;
+
          case 'V':
-         printf("%s widget\n", cnf->widget->name);
+         printf("%s widget (gzip backend: %s)\n", cnf->widget->name, scu_input_gzip_backend());
          scu_version();
          return(0);
 
@@ -195,186 +211,171 @@ int scu_widget_zcat(scu_config * cnf)
       fprintf(stderr, "Try `%s %s --help' for more information.\n", PROGRAM_NAME, cnf->widget->name);
       return(1);
    };
-   if ((cnf->argc - optind) > 1)
+   if ( ((cnf->argc - optind) > 1) && ( ((series)) || ((!(list)) && (!(verify))) ) )
    {
       fprintf(stderr, "%s: unrecognized argument `-- %s'\n", PROGRAM_NAME, cnf->argv[optind+1]);
       fprintf(stderr, "Try `%s %s --help' for more information.\n", PROGRAM_NAME, cnf->widget->name);
       return(1);
    };
 
-   // checks file for restriction validations
-   if ((rc = scu_pathcheck(cnf->argv[optind], 0)) != 0)
-   {
-      fprintf(stderr, "%s: %s: %s\n", PROGRAM_NAME, cnf->widget->name, scu_strerror(rc));
-      return(1);
-   };
-
-   // read magic number
-   if ((fd = open(cnf->argv[optind], O_RDONLY)) == -1)
+   // decodes rotated generations of file in chronological order
+   if ((series))
    {
-      fprintf(stderr, "%s: %s: %s\n", PROGRAM_NAME, cnf->widget->name, strerror(errno));
-      return(1);
-   };
-   if ((len = read(fd, magic, sizeof(magic))) == -1)
-   {
-      fprintf(stderr, "%s: %s: %s\n", PROGRAM_NAME, cnf->widget->name, strerror(errno));
-      close(fd);
-      return(1);
+      if ((rc = scu_series_discover(cnf->argv[optind], &paths, &count)) != 0)
+      {
+         fprintf(stderr, "%s: %s: %s\n", PROGRAM_NAME, cnf->widget->name, scu_strerror(rc));
+         return(1);
+      };
+      if ((list))
+         rc = scu_widget_zcat_list(cnf, paths, count);
+      else if ((verify))
+         rc = scu_series_verify(cnf, paths, count, jobs);
+      else
+         rc = scu_series_cat(cnf, paths, count, jobs);
+      scu_series_free(paths, count);
+      return(rc);
    };
-   close(fd);
-
-
-   // processes gzip file
-#ifdef USE_ZLIB
-   if (!( memcmp(magic, scm_magic_gz, sizeof(scm_magic_gz)) ))
-      return(scu_widget_zcat_gz(cnf));
-#endif
-
-#ifdef USE_BZIP2
-   if (!( memcmp(magic, scm_magic_bz2, sizeof(scm_magic_bz2)) ))
-      return(scu_widget_zcat_bz2(cnf));
-#endif
 
-#ifdef USE_LZMA
-   if (!( memcmp(magic, scm_magic_lzma, sizeof(scm_magic_lzma)) ))
-      return(scu_widget_zcat_lzma(cnf));
-#endif
-
-   if (!( memcmp(magic, scm_magic_z_lzw, sizeof(scm_magic_z_lzw)) ))
-      return(scu_widget_zcat_lzw(cnf));
-
-//   if (!( memcmp(magic, scm_magic_z_lzh, sizeof(scm_magic_z_lzh)) ))
-//      return(scu_widget_zcat_lzh(cnf));
-
-   fprintf(stderr, "%s: %s: unable to determine compression algorithms\n", PROGRAM_NAME, cnf->widget->name);
-   return(1);
-}
+   // reports sizes from archive trailers and indexes
+   if ((list))
+      return(scu_widget_zcat_list(cnf, &cnf->argv[optind], (size_t)(cnf->argc - optind)));
 
+   // verifies several archives concurrently
+   if ( ((verify)) && ((cnf->argc - optind) > 1) )
+      return(scu_series_verify(cnf, &cnf->argv[optind], (size_t)(cnf->argc - optind), jobs));
 
-#ifdef USE_BZIP2
-int scu_widget_zcat_bz2(scu_config * cnf)
-{
-   int         bzerror;
-   char        buff[16384];
-   ssize_t     len;
-   FILE      * fs;
-   BZFILE    * bz2;
-
-   if ((fs = fopen(cnf->argv[optind], "r")) == NULL)
+   // checks file for restriction validations and detects compression
+   if ((rc = scu_input_open(&inp, cnf->argv[optind])) != 0)
    {
-      fprintf(stderr, "%s: %s: %s\n", PROGRAM_NAME, cnf->widget->name, strerror(errno));
+      fprintf(stderr, "%s: %s: %s\n", PROGRAM_NAME, cnf->widget->name, scu_strerror(rc));
       return(1);
    };
-
-   bz2 = BZ2_bzReadOpen(&bzerror, fs, 0, 1, NULL, 0);
-   if (bzerror != BZ_OK)
+   if (scu_input_codec(inp) == SCU_CODEC_RAW)
    {
-      fprintf(stderr, "%s: %s: error with decompression\n", PROGRAM_NAME, cnf->widget->name);
-      BZ2_bzReadClose(&bzerror, bz2);
-      fclose(fs);
+      fprintf(stderr, "%s: %s: %s\n", PROGRAM_NAME, cnf->widget->name, scu_strerror(SCU_ECODEC));
+      scu_input_close(inp);
       return(1);
    };
 
-   while ((len = BZ2_bzRead(&bzerror, bz2, buff, sizeof(buff))) > 0)
+   // decodes without output to verify integrity checks of archive
+   if ((verify))
    {
-      if ((len = write(STDOUT_FILENO, buff, len)) == -1)
-      {
-         fprintf(stderr, "%s: %s: %s\n", PROGRAM_NAME, cnf->widget->name, strerror(errno));
-         BZ2_bzReadClose(&bzerror, bz2);
-         fclose(fs);
-         return(1);
-      };
+      rc = scu_input_verify(inp, jobs);
+      scu_series_verify_report(cnf, cnf->argv[optind], rc, errno, scu_input_offset(inp));
+      scu_input_close(inp);
+      return((rc != 0) ? 1 : 0);
    };
 
-   BZ2_bzReadClose(&bzerror, bz2);
-   fclose(fs);
-
-   return(0);
-}
-#endif
-
-
-#ifdef USE_ZLIB
-int scu_widget_zcat_gz(scu_config * cnf)
-{
-   gzFile   gz;
-   char     buff[4096];
-   int      gzlen;
-   ssize_t  len;
-
-   errno = 0;
-
-   if ((gz = gzopen(cnf->argv[optind], "rb")) == NULL)
+   // serves previously decompressed copy of archive
+   cache = NULL;
+   if (!(nocache))
    {
-      if (errno == 0)
+      if ((fd = scu_cache_fetch(inp)) != -1)
       {
-         fprintf(stderr, "%s: %s: insufficient memory\n", PROGRAM_NAME, cnf->widget->name);
-         return(1);
+         if ((cnf->verbose))
+            fprintf(stderr, "%s: %s: cache hit\n", PROGRAM_NAME, cnf->widget->name);
+         scu_input_close(inp);
+         if ((rc = scu_copy_fd(STDOUT_FILENO, fd)) == -1)
+            fprintf(stderr, "%s: %s: %s\n", PROGRAM_NAME, cnf->widget->name, strerror(errno));
+         close(fd);
+         return((rc == -1) ? 1 : 0);
       };
+      if ( ((cache = scu_cache_create(inp)) != NULL) && ((cnf->verbose)) )
+         fprintf(stderr, "%s: %s: cache miss\n", PROGRAM_NAME, cnf->widget->name);
    };
 
-   while((gzlen = gzread(gz, buff, sizeof(buff))) > 0)
+   while ((len = scu_input_read(inp, buff, sizeof(buff))) > 0)
    {
-      if ((len = write(STDOUT_FILENO, buff, gzlen)) == -1)
+      SCU_PROBE2(zcat__block, (int64_t)len, (int64_t)scu_input_offset(inp));
+      scu_cache_write(cache, buff, (size_t)len);
+      SCU_STATS_SET(SCU_STATS_WRITE);
+      len = write(STDOUT_FILENO, buff, len);
+      SCU_STATS_OUT(len);
+      SCU_PROBE2(write, STDOUT_FILENO, (int64_t)len);
+      SCU_STATS_SET(SCU_STATS_OTHER);
+      if (len == -1)
       {
          fprintf(stderr, "%s: %s: %s\n", PROGRAM_NAME, cnf->widget->name, strerror(errno));
-         gzclose(gz);
+         scu_cache_abort(cache);
+         scu_input_close(inp);
          return(1);
       };
    };
-   if (gzlen == -1)
+   if (len == -1)
    {
-      fprintf(stderr, "%s: %s: %s\n", PROGRAM_NAME, cnf->widget->name, gzerror(gz, NULL));
-      gzclose(gz);
+      fprintf(stderr, "%s: %s: %s\n", PROGRAM_NAME, cnf->widget->name, scu_strerror(scu_input_error(inp)));
+      scu_cache_abort(cache);
+      scu_input_close(inp);
       return(1);
    };
 
-   gzclose(gz);
+   if ( (scu_cache_commit(cache) == -1) && ((cnf->verbose)) )
+      fprintf(stderr, "%s: %s: unable to store archive in cache\n", PROGRAM_NAME, cnf->widget->name);
+
+   scu_input_close(inp);
 
    return(0);
 }
-#endif
 
 
-int scu_widget_zcat_lzw(scu_config * cnf)
+int scu_widget_zcat_list(scu_config * cnf, char ** paths, size_t count)
 {
-   int            fd;
-   lzwFile      * lzw;
-   char           buff[4096];
-   ssize_t        len;
-
-   if ((fd = open(cnf->argv[optind], O_RDONLY)) == -1)
-   {
-      fprintf(stderr, "%s: %s: %s\n", cnf->prog_name, cnf->widget->name, strerror(errno));
-      return(1);
-   };
-
-   if ((lzw = lzw_fdopen(fd)) == NULL)
-   {
-      fprintf(stderr, "%s: %s: %s\n", cnf->prog_name, cnf->widget->name, strerror(errno));
-      close(fd);
-      return(1);
-   };
-
-   while((len = lzw_read(lzw, buff, sizeof(buff))) > 0)
+   int            rc;
+   int            err;
+   int            exact;
+   int            approx;
+   size_t         x;
+   uint64_t       size;
+   uint64_t       csize;
+   uint64_t       total;
+   uint64_t       ctotal;
+   char           str[32];
+   scu_input    * inp;
+
+   assert(cnf   != NULL);
+   assert(paths != NULL);
+
+   if (!(cnf->quiet))
+      printf("%15s %15s %6s  %-8s %s\n", "compressed", "uncompressed", "ratio", "codec", "name");
+
+   rc     = 0;
+   total  = 0;
+   ctotal = 0;
+   approx = 0;
+   for(x = 0; x < count; x++)
    {
-      if ((len = write(STDOUT_FILENO, buff, len)) == -1)
+      if ((err = scu_input_open(&inp, paths[x])) == 0)
       {
-         fprintf(stderr, "%s: %s: %s\n", cnf->prog_name, cnf->widget->name, strerror(errno));
-         lzw_close(lzw);
-         return(1);
+         if ((err = scu_input_info(inp, &size, &exact)) == 0)
+         {
+            // estimated sizes are marked with a leading tilde
+            csize = (uint64_t)scu_input_stat(inp)->st_size;
+            snprintf(str, sizeof(str), "%s%" PRIu64, ((exact)) ? "" : "~", size);
+            printf("%15" PRIu64 " %15s %5.1f%%  %-8s %s\n", csize, str,
+               (size > 0) ? (100.0 * (1.0 - ((double)csize / (double)size))) : 0.0,
+               scu_input_codec_name(scu_input_codec(inp)), paths[x]);
+            total  += size;
+            ctotal += csize;
+            approx |= !(exact);
+         };
+         scu_input_close(inp);
+      };
+      if (err != 0)
+      {
+         fprintf(stderr, "%s: %s: %s: %s\n", PROGRAM_NAME, cnf->widget->name, paths[x], scu_strerror(err));
+         rc = 1;
       };
    };
-   if (len == -1)
+
+   if (count > 1)
    {
-      fprintf(stderr, "%s: %s: %s\n", cnf->prog_name, cnf->widget->name, strerror(errno));
-      lzw_close(lzw);
-      return(1);
+      snprintf(str, sizeof(str), "%s%" PRIu64, ((approx)) ? "~" : "", total);
+      printf("%15" PRIu64 " %15s %5.1f%%  %-8s %s\n", ctotal, str,
+         (total > 0) ? (100.0 * (1.0 - ((double)ctotal / (double)total))) : 0.0,
+         "", "(totals)");
    };
 
-   lzw_close(lzw);
-
-   return(0);
+   return(rc);
 }
 
 
@@ -383,6 +384,12 @@ void scu_widget_zcat_usage(scu_config * cnf)
    scu_usage_summary(cnf, " [OPTIONS] file");
    printf("\n");
    scu_usage_options(cnf);
+   printf("  -C, --no-cache            do not use cache of decompressed archives\n");
+   printf("  -j, --jobs=N              decode up to N files or BGZF members concurrently [%i]\n", SCU_SERIES_JOBS);
+   printf("  -l, --list                list compressed and uncompressed sizes of each file\n");
+   printf("  -s, --series              output file and its rotated generations, oldest first\n");
+   printf("  -t, --test                verify integrity of each compressed file without output,\n");
+   printf("                            -j applies to BGZF members, other files decode serially\n");
    printf("\n");
    scu_usage_restrictions();
    printf("\n");
@@ -390,126 +397,4 @@ void scu_widget_zcat_usage(scu_config * cnf)
 }
 
 
-#ifdef USE_LZMA
-int scu_widget_zcat_lzma(scu_config * cnf)
-{
-   int            fd;
-   lzma_ret       ret;
-   lzma_stream    strm;
-   lzma_action    action;
-   uint8_t        in[16384];
-   uint8_t        out[16384];
-   ssize_t        len;
-   int            eof;
-
-   bzero(&strm, sizeof(strm));
-   action         = LZMA_RUN;
-   strm.next_in   = in;
-   strm.next_out  = out;
-   strm.avail_in  = 0;
-   strm.avail_out = sizeof(out);
-
-   if ((fd = open(cnf->argv[optind], O_RDONLY)) == -1)
-   {
-      fprintf(stderr, "%s: %s: %s\n", cnf->prog_name, cnf->widget->name, strerror(errno));
-      return(1);
-   };
-
-   if ((ret = lzma_stream_decoder(&strm, UINT64_MAX, LZMA_CONCATENATED)) != LZMA_OK)
-   {
-      scu_widget_zcat_lzma_perror(cnf, ret);
-      close(fd);
-      return(1);
-   };
-
-   ret = LZMA_OK;
-   eof = 0;
-   while (ret == LZMA_OK)
-   {
-      // read from compressed file if input buffer is empty
-      if ((strm.avail_in == 0) && (!(eof)))
-      {
-         if ((len = read(fd, in, sizeof(in))) == -1)
-         {
-            fprintf(stderr, "%s: %s: %s\n", cnf->prog_name, cnf->widget->name, strerror(errno));
-            close(fd);
-            return(1);
-         };
-         strm.next_in   = in;
-         strm.avail_in  = len;
-         if (len < (ssize_t)sizeof(in))
-         {
-            action = LZMA_FINISH;
-            eof = 1;
-         };
-      };
-
-      // uncompress file
-      if ((ret = lzma_code(&strm, action)) != LZMA_OK)
-      {
-         if (ret != LZMA_STREAM_END)
-         {
-            scu_widget_zcat_lzma_perror(cnf, ret);
-            close(fd);
-            return(1);
-         };
-      };
-
-      // print uncompressed data if buffer is full or done inflating data
-      if ((strm.avail_out == 0) || (ret == LZMA_STREAM_END))
-      {
-         if ((len = write(STDOUT_FILENO, out, (sizeof(out) - strm.avail_out))) == -1)
-         {
-            fprintf(stderr, "%s: %s: %s\n", cnf->prog_name, cnf->widget->name, strerror(errno));
-            close(fd);
-            return(1);
-         };
-         strm.avail_out = sizeof(out);
-         strm.next_out  = out;
-      };
-   };
-
-   close(fd);
-
-   return(0);
-}
-
-
-int scu_widget_zcat_lzma_perror(scu_config * cnf, lzma_ret ret)
-{
-   switch(ret)
-   {
-      case LZMA_BUF_ERROR:
-      fprintf(stderr, "%s: %s: truncated or corrupt file\n", cnf->prog_name, cnf->widget->name);
-      return(1);
-
-      case LZMA_DATA_ERROR:
-      fprintf(stderr, "%s: %s: compressed file is corrupt\n", cnf->prog_name, cnf->widget->name);
-      return(1);
-
-      case LZMA_FORMAT_ERROR:
-      fprintf(stderr, "%s: %s: invalid LZMA format\n", cnf->prog_name, cnf->widget->name);
-      return(1);
-
-      case LZMA_MEM_ERROR:
-      fprintf(stderr, "%s: %s: out of virtual memory\n", cnf->prog_name, cnf->widget->name);
-      return(1);
-
-      case LZMA_OPTIONS_ERROR:
-      fprintf(stderr, "%s: %s: unsupported LZMA options\n", cnf->prog_name, cnf->widget->name);
-      return(1);
-
-      case LZMA_STREAM_END:
-      fprintf(stderr, "%s: %s: end of LZMA stream\n", cnf->prog_name, cnf->widget->name);
-      return(0);
-
-      default:
-      fprintf(stderr, "%s: %s: unknown LZMA error\n", cnf->prog_name, cnf->widget->name);
-      break;
-
-   };
-   return(1);
-}
-#endif
-
 /* end of source */
@@ -0,0 +1,86 @@
+#!/bin/sh
+#
+#   Secure Core Utilities
+#   Copyright (C) 2015, 2017 David M. Syzdek <david@syzdek.net>.
+#
+#   @SYZDEK_BSD_LICENSE_START@
+#
+#   Redistribution and use in source and binary forms, with or without
+#   modification, are permitted provided that the following conditions are
+#   met:
+#
+#      * Redistributions of source code must retain the above copyright
+#        notice, this list of conditions and the following disclaimer.
+#      * Redistributions in binary form must reproduce the above copyright
+#        notice, this list of conditions and the following disclaimer in the
+#        documentation and/or other materials provided with the distribution.
+#      * Neither the name of David M. Syzdek nor the
+#        names of its contributors may be used to endorse or promote products
+#        derived from this software without specific prior written permission.
+#
+#   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+#   IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+#   THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+#   PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL DAVID M SYZDEK BE LIABLE FOR
+#   ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+#   DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+#   SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+#   CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+#   LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+#   OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+#   SUCH DAMAGE.
+#
+#   @SYZDEK_BSD_LICENSE_END@
+#
+#   tests/usdt-probes.sh - verifies USDT probes are present in ELF notes
+#
+#   Environment:
+#      SCU            path to securecoreutils binary   [src/securecoreutils]
+#      SCU_USDT       "yes" when configured with --enable-usdt [no]
+#      READELF        readelf from binutils            [readelf]
+#
+#   Exits 77 (skipped) when USDT probes were not configured.
+#
+
+SCU=${SCU:-src/securecoreutils}
+SCU_USDT=${SCU_USDT:-no}
+READELF=${READELF:-readelf}
+
+# provider:name of every probe in src/probes.h
+USDT_PROBES="securecoreutils:pathcheck__entry
+securecoreutils:pathcheck__return
+securecoreutils:tail__wakeup
+securecoreutils:widget__done
+securecoreutils:widget__start
+securecoreutils:write
+securecoreutils:zcat__block"
+
+
+if test "x${SCU_USDT}" != "xyes";then
+   echo "usdt-probes: skipping, configured without --enable-usdt" 1>&2
+   exit 77
+fi
+if ! command -v "${READELF}" > /dev/null 2>&1;then
+   echo "usdt-probes: skipping, ${READELF} not found" 1>&2
+   exit 77
+fi
+test -x "${SCU}" || { echo "usdt-probes: missing ${SCU}" 1>&2; exit 1; }
+
+NOTES=`"${READELF}" -n "${SCU}"` || exit 1
+NOTES=`echo "${NOTES}" | ${AWK:-awk} '
+   /Provider:/ { provider = $2 }
+   /Name:/     { print provider ":" $2 }'`
+
+RC=0
+for PROBE in ${USDT_PROBES};do
+   if echo "${NOTES}" | grep -x -F "${PROBE}" > /dev/null;then
+      echo "usdt-probes: ${PROBE}: OK"
+   else
+      echo "usdt-probes: ${PROBE}: missing from ${SCU}" 1>&2
+      RC=1
+   fi
+done
+
+exit ${RC}
+
+# end of script